@@ -1,9 +1,14 @@
 /**
  * @file ble_config.c
  * @brief BLE configuration component implementation
+ *
+ * Stack-independent part: configuration values, provisioning window and
+ * configuration change events. The GATT server itself lives in the
+ * Bluedroid or NimBLE backend selected by the BT host Kconfig choice.
  */
 
 #include "ble_config.h"
+#include "ble_config_priv.h"
 #include "timemachine_events.h"
 #include "network.h"
 #include "clock_panel.h"
@@ -12,108 +17,74 @@
 #include "weather.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_system.h"
 #include "esp_bt.h"
-#include "esp_bt_main.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gatts_api.h"
-#include "esp_gatt_common_api.h"
-#include "esp_bt_device.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
 #include <string.h>
 
 static const char *TAG = "ble_config";
 
-#define GATTS_SERVICE_UUID_NETWORK     0x00FF
-#define GATTS_CHAR_UUID_WIFI_SSID      0xFF01
-#define GATTS_CHAR_UUID_WIFI_PASSWORD  0xFF02
-#define GATTS_CHAR_UUID_WIFI_AUTHMODE  0xFF03
-
-#define GATTS_SERVICE_UUID_CLOCK       0x01FF
-#define GATTS_CHAR_UUID_TIME_FORMAT    0xFF11
-#define GATTS_CHAR_UUID_SHOW_SECONDS   0xFF12
-
-#define GATTS_SERVICE_UUID_NTP         0x02FF
-#define GATTS_CHAR_UUID_TIMEZONE       0xFF21
-#define GATTS_CHAR_UUID_NTP_SERVER1    0xFF22
-#define GATTS_CHAR_UUID_NTP_SERVER2    0xFF23
-#define GATTS_CHAR_UUID_SYNC_INTERVAL  0xFF24
-
-#define GATTS_SERVICE_UUID_LANGUAGE    0x03FF
-#define GATTS_CHAR_UUID_LANGUAGE       0xFF31
-
-#define GATTS_SERVICE_UUID_WEATHER     0x04FF
-#define GATTS_CHAR_UUID_WEATHER_API_KEY    0xFF41
-#define GATTS_CHAR_UUID_WEATHER_LOCATION   0xFF42
-
-#define GATTS_NUM_HANDLE_NETWORK       8
-#define GATTS_NUM_HANDLE_CLOCK         6
-#define GATTS_NUM_HANDLE_NTP           10
-#define GATTS_NUM_HANDLE_LANGUAGE      4
-#define GATTS_NUM_HANDLE_WEATHER       6
-
-#define DEVICE_NAME                    "TimeMachine"
-#define GATTS_TAG                      "GATTS_CONFIG"
-
-// Service handles
-enum {
-    IDX_SVC_NETWORK,
-    IDX_CHAR_WIFI_SSID,
-    IDX_CHAR_VAL_WIFI_SSID,
-    IDX_CHAR_WIFI_PASSWORD,
-    IDX_CHAR_VAL_WIFI_PASSWORD,
-    IDX_CHAR_WIFI_AUTHMODE,
-    IDX_CHAR_VAL_WIFI_AUTHMODE,
-    HRS_NETWORK_IDX_NB,
+// ============================================================================
+// GATT Layout
+// ============================================================================
+
+#define RW (BLE_CONFIG_CHAR_F_READ | BLE_CONFIG_CHAR_F_WRITE)
+
+static const ble_config_char_def_t s_network_chars[] = {
+    { GATTS_CHAR_UUID_WIFI_SSID,         BLE_CHAR_WIFI_SSID,          RW },
+    { GATTS_CHAR_UUID_WIFI_PASSWORD,     BLE_CHAR_WIFI_PASSWORD,      RW },
+    { GATTS_CHAR_UUID_WIFI_AUTHMODE,     BLE_CHAR_WIFI_AUTHMODE,      RW },
+};
+
+static const ble_config_char_def_t s_clock_chars[] = {
+    { GATTS_CHAR_UUID_TIME_FORMAT,       BLE_CHAR_TIME_FORMAT,        RW },
+    { GATTS_CHAR_UUID_SHOW_SECONDS,      BLE_CHAR_SHOW_SECONDS,       RW },
 };
 
-enum {
-    IDX_SVC_CLOCK,
-    IDX_CHAR_TIME_FORMAT,
-    IDX_CHAR_VAL_TIME_FORMAT,
-    IDX_CHAR_SHOW_SECONDS,
-    IDX_CHAR_VAL_SHOW_SECONDS,
-    HRS_CLOCK_IDX_NB,
+static const ble_config_char_def_t s_ntp_chars[] = {
+    { GATTS_CHAR_UUID_TIMEZONE,          BLE_CHAR_TIMEZONE,           RW },
+    { GATTS_CHAR_UUID_NTP_SERVER1,       BLE_CHAR_NTP_SERVER1,        RW },
+    { GATTS_CHAR_UUID_NTP_SERVER2,       BLE_CHAR_NTP_SERVER2,        RW },
+    { GATTS_CHAR_UUID_SYNC_INTERVAL,     BLE_CHAR_SYNC_INTERVAL,      RW },
 };
 
-enum {
-    IDX_SVC_NTP,
-    IDX_CHAR_TIMEZONE,
-    IDX_CHAR_VAL_TIMEZONE,
-    IDX_CHAR_NTP_SERVER1,
-    IDX_CHAR_VAL_NTP_SERVER1,
-    IDX_CHAR_NTP_SERVER2,
-    IDX_CHAR_VAL_NTP_SERVER2,
-    IDX_CHAR_SYNC_INTERVAL,
-    IDX_CHAR_VAL_SYNC_INTERVAL,
-    HRS_NTP_IDX_NB,
+static const ble_config_char_def_t s_language_chars[] = {
+    { GATTS_CHAR_UUID_LANGUAGE,          BLE_CHAR_LANGUAGE,           RW },
 };
 
-enum {
-    IDX_SVC_LANGUAGE,
-    IDX_CHAR_LANGUAGE,
-    IDX_CHAR_VAL_LANGUAGE,
-    HRS_LANGUAGE_IDX_NB,
+static const ble_config_char_def_t s_weather_chars[] = {
+    { GATTS_CHAR_UUID_WEATHER_API_KEY,   BLE_CHAR_WEATHER_API_KEY,    RW },
+    { GATTS_CHAR_UUID_WEATHER_LOCATION,  BLE_CHAR_WEATHER_LOCATION,   RW },
 };
 
-enum {
-    IDX_SVC_WEATHER,
-    IDX_CHAR_WEATHER_API_KEY,
-    IDX_CHAR_VAL_WEATHER_API_KEY,
-    IDX_CHAR_WEATHER_LOCATION,
-    IDX_CHAR_VAL_WEATHER_LOCATION,
-    HRS_WEATHER_IDX_NB,
+static const ble_config_char_def_t s_telemetry_chars[] = {
+    { GATTS_CHAR_UUID_TELEMETRY,         BLE_CHAR_TELEMETRY,          BLE_CONFIG_CHAR_F_READ | BLE_CONFIG_CHAR_F_NOTIFY },
+    { GATTS_CHAR_UUID_TELEMETRY_RATE,    BLE_CHAR_TELEMETRY_INTERVAL, RW },
 };
 
+#define CHAR_COUNT(chars) (sizeof(chars) / sizeof(chars[0]))
+
+const ble_config_service_def_t ble_config_services[] = {
+    { GATTS_SERVICE_UUID_NETWORK,     CHAR_COUNT(s_network_chars),    s_network_chars },
+    { GATTS_SERVICE_UUID_CLOCK,       CHAR_COUNT(s_clock_chars),      s_clock_chars },
+    { GATTS_SERVICE_UUID_NTP,         CHAR_COUNT(s_ntp_chars),        s_ntp_chars },
+    { GATTS_SERVICE_UUID_LANGUAGE,    CHAR_COUNT(s_language_chars),   s_language_chars },
+    { GATTS_SERVICE_UUID_WEATHER,     CHAR_COUNT(s_weather_chars),    s_weather_chars },
+    { GATTS_SERVICE_UUID_TELEMETRY,   CHAR_COUNT(s_telemetry_chars),  s_telemetry_chars },
+};
+
+const size_t ble_config_service_count =
+    sizeof(ble_config_services) / sizeof(ble_config_services[0]);
+
+// ============================================================================
+// Private State
+// ============================================================================
+
 static bool s_connected = false;
 static bool s_initialized = false;
-static uint16_t s_gatts_if = ESP_GATT_IF_NONE;
-static uint16_t s_conn_id = 0;
-
-// Service handle tables
-static uint16_t s_network_handle_table[HRS_NETWORK_IDX_NB];
-static uint16_t s_clock_handle_table[HRS_CLOCK_IDX_NB];
-static uint16_t s_ntp_handle_table[HRS_NTP_IDX_NB];
-static uint16_t s_language_handle_table[HRS_LANGUAGE_IDX_NB];
-static uint16_t s_weather_handle_table[HRS_WEATHER_IDX_NB];
+static bool s_released = false;
 
 // Configuration buffers
 static char s_wifi_ssid[32] = {0};
@@ -129,52 +100,25 @@ static uint8_t s_language = 0;
 static char s_weather_api_key[64] = {0};
 static char s_weather_location[64] = {0};
 
-// Forward declarations
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
-
-// Advertising data
-static uint8_t s_adv_service_uuid128[16] = {
-    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
-    0x00, 0x10, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
-};
-
-static esp_ble_adv_data_t s_adv_data = {
-    .set_scan_rsp = false,
-    .include_name = true,
-    .include_txpower = true,
-    .min_interval = 0x0006,
-    .max_interval = 0x0010,
-    .appearance = 0x00,
-    .manufacturer_len = 0,
-    .p_manufacturer_data = NULL,
-    .service_data_len = 0,
-    .p_service_data = NULL,
-    .service_uuid_len = sizeof(s_adv_service_uuid128),
-    .p_service_uuid = s_adv_service_uuid128,
-    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
-};
+// Provisioning window state
+static TimerHandle_t s_window_timer = NULL;
+static bool s_window_expired = false;
+static bool s_hold_active = false;
+static bool s_shutdown_pending = false;
+static portMUX_TYPE s_window_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_event_handler_instance_t s_long_press_handler = NULL;
+static esp_event_handler_instance_t s_release_handler = NULL;
 
-static esp_ble_adv_params_t s_adv_params = {
-    .adv_int_min = 0x20,
-    .adv_int_max = 0x40,
-    .adv_type = ADV_TYPE_IND,
-    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
-    .channel_map = ADV_CHNL_ALL,
-    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-};
-
-// GATT profile
-static struct gatts_profile_inst {
-    esp_gatts_cb_t gatts_cb;
-    uint16_t gatts_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-} s_profile = {
-    .gatts_cb = gatts_profile_event_handler,
-    .gatts_if = ESP_GATT_IF_NONE,
-};
+// Forward declarations
+static esp_err_t start_provisioning_window(void);
+static void stop_provisioning_window(void);
+static void maybe_close_window(void);
+static void window_timer_callback(TimerHandle_t timer);
+static void shutdown_task(void *pvParameters);
+static void input_long_press_handler(void* arg, esp_event_base_t base,
+                                     int32_t event_id, void* event_data);
+static void input_release_handler(void* arg, esp_event_base_t base,
+                                  int32_t event_id, void* event_data);
 
 // ============================================================================
 // Public API
@@ -187,71 +131,33 @@ esp_err_t ble_config_init(void)
         return ESP_OK;
     }
 
-    ESP_LOGI(TAG, "Initializing BLE configuration...");
-
-    // Initialize NVS (required for BLE)
-    // Already initialized in main, but just in case
-
-    // Release classic BT memory
-    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
-
-    // Initialize BT controller
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    esp_err_t ret = esp_bt_controller_init(&bt_cfg);
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to initialize BT controller: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    // Enable BT controller in BLE mode
-    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to enable BT controller: %s", esp_err_to_name(ret));
-        return ret;
+    if (s_released) {
+        ESP_LOGW(TAG, "BLE memory was released, restart required");
+        return ESP_ERR_INVALID_STATE;
     }
 
-    // Initialize Bluedroid
-    ret = esp_bluedroid_init();
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to initialize Bluedroid: %s", esp_err_to_name(ret));
-        return ret;
-    }
+    ESP_LOGI(TAG, "Initializing BLE configuration (%s)...", ble_config_backend.name);
 
-    ret = esp_bluedroid_enable();
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to enable Bluedroid: %s", esp_err_to_name(ret));
-        return ret;
-    }
+    uint32_t heap_before = esp_get_free_heap_size();
 
-    // Register callbacks
-    ret = esp_ble_gatts_register_callback(gatts_event_handler);
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to register GATTS callback: %s", esp_err_to_name(ret));
+    esp_err_t ret = ble_config_backend.start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start %s: %s", ble_config_backend.name, esp_err_to_name(ret));
         return ret;
     }
 
-    ret = esp_ble_gap_register_callback(gap_event_handler);
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to register GAP callback: %s", esp_err_to_name(ret));
-        return ret;
-    }
+    s_initialized = true;
 
-    // Register application profile
-    ret = esp_ble_gatts_app_register(0);
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to register app: %s", esp_err_to_name(ret));
-        return ret;
-    }
+    uint32_t heap_after = esp_get_free_heap_size();
+    ESP_LOGI(TAG, "BLE configuration initialized (free heap: %lu -> %lu bytes, -%lu)",
+             heap_before, heap_after, heap_before - heap_after);
 
-    // Set MTU
-    ret = esp_ble_gatt_set_local_mtu(500);
-    if (ret) {
-        ESP_LOGE(TAG, "Failed to set MTU: %s", esp_err_to_name(ret));
+    ret = start_provisioning_window();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Provisioning window unavailable, BLE stays on: %s",
+                 esp_err_to_name(ret));
     }
 
-    s_initialized = true;
-    ESP_LOGI(TAG, "BLE configuration initialized");
-
     return ESP_OK;
 }
 
@@ -263,10 +169,10 @@ void ble_config_deinit(void)
 
     ESP_LOGI(TAG, "Deinitializing BLE configuration...");
 
-    esp_bluedroid_disable();
-    esp_bluedroid_deinit();
-    esp_bt_controller_disable();
-    esp_bt_controller_deinit();
+    stop_provisioning_window();
+    ble_config_telemetry_stop();
+
+    ble_config_backend.stop();
 
     s_initialized = false;
     s_connected = false;
@@ -279,61 +185,40 @@ bool ble_config_is_connected(void)
     return s_connected;
 }
 
-// ============================================================================
-// Private - GAP Event Handler
-// ============================================================================
-
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+bool ble_config_is_active(void)
 {
-    switch (event) {
-    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-        esp_ble_gap_start_advertising(&s_adv_params);
-        break;
-    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-        if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-            ESP_LOGE(TAG, "Advertising start failed");
-        } else {
-            ESP_LOGI(TAG, "Advertising started");
-        }
-        break;
-    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
-        if (param->adv_stop_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-            ESP_LOGE(TAG, "Advertising stop failed");
-        } else {
-            ESP_LOGI(TAG, "Advertising stopped");
-        }
-        break;
-    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
-        ESP_LOGI(TAG, "Connection params updated");
-        break;
-    default:
-        break;
-    }
+    return s_initialized;
 }
 
 // ============================================================================
-// Private - GATTS Event Handlers
+// Backend Callbacks
 // ============================================================================
 
-static void handle_write_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+static void copy_string(char *dest, size_t dest_size, const uint8_t *data, size_t len)
 {
-    uint16_t handle = param->write.handle;
+    memset(dest, 0, dest_size);
+    memcpy(dest, data, len < dest_size ? len : dest_size - 1);
+}
 
+void ble_config_on_write(ble_config_char_t id, const uint8_t *data, size_t len)
+{
+    switch (id) {
     // Network service characteristics
-    if (handle == s_network_handle_table[IDX_CHAR_VAL_WIFI_SSID]) {
-        memset(s_wifi_ssid, 0, sizeof(s_wifi_ssid));
-        memcpy(s_wifi_ssid, param->write.value,
-               param->write.len < sizeof(s_wifi_ssid) ? param->write.len : sizeof(s_wifi_ssid) - 1);
+    case BLE_CHAR_WIFI_SSID:
+        copy_string(s_wifi_ssid, sizeof(s_wifi_ssid), data, len);
         ESP_LOGI(TAG, "WiFi SSID updated: %s", s_wifi_ssid);
+        break;
 
-    } else if (handle == s_network_handle_table[IDX_CHAR_VAL_WIFI_PASSWORD]) {
-        memset(s_wifi_password, 0, sizeof(s_wifi_password));
-        memcpy(s_wifi_password, param->write.value,
-               param->write.len < sizeof(s_wifi_password) ? param->write.len : sizeof(s_wifi_password) - 1);
+    case BLE_CHAR_WIFI_PASSWORD:
+        copy_string(s_wifi_password, sizeof(s_wifi_password), data, len);
         ESP_LOGI(TAG, "WiFi password updated");
+        break;
 
-    } else if (handle == s_network_handle_table[IDX_CHAR_VAL_WIFI_AUTHMODE]) {
-        s_wifi_authmode = param->write.value[0];
+    case BLE_CHAR_WIFI_AUTHMODE: {
+        if (len < 1) {
+            break;
+        }
+        s_wifi_authmode = data[0];
         ESP_LOGI(TAG, "WiFi authmode updated: %d", s_wifi_authmode);
 
         // Emit NETWORK_CONFIG_CHANGED event
@@ -345,15 +230,23 @@ static void handle_write_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t
         };
         esp_event_post(TIMEMACHINE_EVENT, NETWORK_CONFIG_CHANGED,
                       &config, sizeof(config), portMAX_DELAY);
+        break;
     }
 
     // Clock service characteristics
-    else if (handle == s_clock_handle_table[IDX_CHAR_VAL_TIME_FORMAT]) {
-        s_time_format = param->write.value[0];
+    case BLE_CHAR_TIME_FORMAT:
+        if (len < 1) {
+            break;
+        }
+        s_time_format = data[0];
         ESP_LOGI(TAG, "Time format updated: %d", s_time_format);
+        break;
 
-    } else if (handle == s_clock_handle_table[IDX_CHAR_VAL_SHOW_SECONDS]) {
-        s_show_seconds = param->write.value[0];
+    case BLE_CHAR_SHOW_SECONDS: {
+        if (len < 1) {
+            break;
+        }
+        s_show_seconds = data[0];
         ESP_LOGI(TAG, "Show seconds updated: %d", s_show_seconds);
 
         // Emit CLOCK_CONFIG_CHANGED event
@@ -364,29 +257,30 @@ static void handle_write_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t
         esp_event_post(TIMEMACHINE_EVENT, CLOCK_CONFIG_CHANGED,
                       &config, sizeof(config), portMAX_DELAY);
         ESP_LOGI(TAG, "Clock config changed event posted");
+        break;
     }
 
     // NTP service characteristics
-    else if (handle == s_ntp_handle_table[IDX_CHAR_VAL_TIMEZONE]) {
-        memset(s_timezone, 0, sizeof(s_timezone));
-        memcpy(s_timezone, param->write.value,
-               param->write.len < sizeof(s_timezone) ? param->write.len : sizeof(s_timezone) - 1);
+    case BLE_CHAR_TIMEZONE:
+        copy_string(s_timezone, sizeof(s_timezone), data, len);
         ESP_LOGI(TAG, "Timezone updated: %s", s_timezone);
+        break;
 
-    } else if (handle == s_ntp_handle_table[IDX_CHAR_VAL_NTP_SERVER1]) {
-        memset(s_ntp_server1, 0, sizeof(s_ntp_server1));
-        memcpy(s_ntp_server1, param->write.value,
-               param->write.len < sizeof(s_ntp_server1) ? param->write.len : sizeof(s_ntp_server1) - 1);
+    case BLE_CHAR_NTP_SERVER1:
+        copy_string(s_ntp_server1, sizeof(s_ntp_server1), data, len);
         ESP_LOGI(TAG, "NTP server1 updated: %s", s_ntp_server1);
+        break;
 
-    } else if (handle == s_ntp_handle_table[IDX_CHAR_VAL_NTP_SERVER2]) {
-        memset(s_ntp_server2, 0, sizeof(s_ntp_server2));
-        memcpy(s_ntp_server2, param->write.value,
-               param->write.len < sizeof(s_ntp_server2) ? param->write.len : sizeof(s_ntp_server2) - 1);
+    case BLE_CHAR_NTP_SERVER2:
+        copy_string(s_ntp_server2, sizeof(s_ntp_server2), data, len);
         ESP_LOGI(TAG, "NTP server2 updated: %s", s_ntp_server2);
+        break;
 
-    } else if (handle == s_ntp_handle_table[IDX_CHAR_VAL_SYNC_INTERVAL]) {
-        memcpy(&s_sync_interval, param->write.value, sizeof(uint32_t));
+    case BLE_CHAR_SYNC_INTERVAL: {
+        if (len < sizeof(uint32_t)) {
+            break;
+        }
+        memcpy(&s_sync_interval, data, sizeof(uint32_t));
         ESP_LOGI(TAG, "Sync interval updated: %lu", s_sync_interval);
 
         // Emit NTP_CONFIG_CHANGED event
@@ -399,11 +293,15 @@ static void handle_write_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t
         esp_event_post(TIMEMACHINE_EVENT, NTP_CONFIG_CHANGED,
                       &config, sizeof(config), portMAX_DELAY);
         ESP_LOGI(TAG, "NTP config changed event posted");
+        break;
     }
 
     // Language service characteristic
-    else if (handle == s_language_handle_table[IDX_CHAR_VAL_LANGUAGE]) {
-        s_language = param->write.value[0];
+    case BLE_CHAR_LANGUAGE: {
+        if (len < 1) {
+            break;
+        }
+        s_language = data[0];
         ESP_LOGI(TAG, "Language updated: %d", s_language);
 
         // Emit LANGUAGE_CHANGED event
@@ -411,19 +309,17 @@ static void handle_write_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t
         esp_event_post(TIMEMACHINE_EVENT, LANGUAGE_CHANGED,
                       &lang, sizeof(lang), portMAX_DELAY);
         ESP_LOGI(TAG, "Language changed event posted");
+        break;
     }
 
     // Weather service characteristics
-    else if (handle == s_weather_handle_table[IDX_CHAR_VAL_WEATHER_API_KEY]) {
-        memset(s_weather_api_key, 0, sizeof(s_weather_api_key));
-        memcpy(s_weather_api_key, param->write.value,
-               param->write.len < sizeof(s_weather_api_key) ? param->write.len : sizeof(s_weather_api_key) - 1);
+    case BLE_CHAR_WEATHER_API_KEY:
+        copy_string(s_weather_api_key, sizeof(s_weather_api_key), data, len);
         ESP_LOGI(TAG, "Weather API key updated");
+        break;
 
-    } else if (handle == s_weather_handle_table[IDX_CHAR_VAL_WEATHER_LOCATION]) {
-        memset(s_weather_location, 0, sizeof(s_weather_location));
-        memcpy(s_weather_location, param->write.value,
-               param->write.len < sizeof(s_weather_location) ? param->write.len : sizeof(s_weather_location) - 1);
+    case BLE_CHAR_WEATHER_LOCATION: {
+        copy_string(s_weather_location, sizeof(s_weather_location), data, len);
         ESP_LOGI(TAG, "Weather location updated: %s", s_weather_location);
 
         // Emit WEATHER_CONFIG_CHANGED event
@@ -435,305 +331,241 @@ static void handle_write_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t
         esp_event_post(TIMEMACHINE_EVENT, WEATHER_CONFIG_CHANGED,
                       &config, sizeof(config), portMAX_DELAY);
         ESP_LOGI(TAG, "Weather config changed event posted");
+        break;
     }
 
-    // Send response if needed
-    if (param->write.need_rsp) {
-        esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
-                                   param->write.trans_id, ESP_GATT_OK, NULL);
+    // Telemetry service characteristics
+    case BLE_CHAR_TELEMETRY_INTERVAL: {
+        if (len < sizeof(uint16_t)) {
+            break;
+        }
+        uint16_t interval_ms;
+        memcpy(&interval_ms, data, sizeof(uint16_t));
+        ble_config_telemetry_set_interval(interval_ms);
+        break;
+    }
+
+    default:
+        break;
     }
 }
 
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+size_t ble_config_on_read(ble_config_char_t id, uint8_t *buf, size_t max_len)
 {
-    switch (event) {
-    case ESP_GATTS_REG_EVT:
-        ESP_LOGI(TAG, "GATT server registered, app_id=%d", param->reg.app_id);
-
-        s_gatts_if = gatts_if;
-
-        // Set device name
-        esp_ble_gap_set_device_name(DEVICE_NAME);
-
-        // Configure advertising
-        esp_ble_gap_config_adv_data(&s_adv_data);
-
-        // Create services
-        esp_ble_gatts_create_service(gatts_if,
-            &(esp_gatt_srvc_id_t){
-                .is_primary = true,
-                .id = {
-                    .uuid = {.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_SERVICE_UUID_NETWORK}},
-                    .inst_id = 0,
-                }
-            },
-            GATTS_NUM_HANDLE_NETWORK);
+    const void *value = NULL;
+    size_t len = 0;
+    uint16_t interval_ms;
+
+    switch (id) {
+    case BLE_CHAR_WIFI_SSID:        value = s_wifi_ssid;        len = strlen(s_wifi_ssid); break;
+    case BLE_CHAR_WIFI_AUTHMODE:    value = &s_wifi_authmode;   len = 1; break;
+    case BLE_CHAR_TIME_FORMAT:      value = &s_time_format;     len = 1; break;
+    case BLE_CHAR_SHOW_SECONDS:     value = &s_show_seconds;    len = 1; break;
+    case BLE_CHAR_TIMEZONE:         value = s_timezone;         len = strlen(s_timezone); break;
+    case BLE_CHAR_NTP_SERVER1:      value = s_ntp_server1;      len = strlen(s_ntp_server1); break;
+    case BLE_CHAR_NTP_SERVER2:      value = s_ntp_server2;      len = strlen(s_ntp_server2); break;
+    case BLE_CHAR_SYNC_INTERVAL:    value = &s_sync_interval;   len = sizeof(s_sync_interval); break;
+    case BLE_CHAR_LANGUAGE:         value = &s_language;        len = 1; break;
+    case BLE_CHAR_WEATHER_LOCATION: value = s_weather_location; len = strlen(s_weather_location); break;
+    case BLE_CHAR_TELEMETRY:
+        return ble_config_telemetry_read(buf, max_len);
+    case BLE_CHAR_TELEMETRY_INTERVAL:
+        interval_ms = ble_config_telemetry_get_interval();
+        value = &interval_ms;
+        len = sizeof(interval_ms);
         break;
-
-    case ESP_GATTS_CREATE_EVT:
-        ESP_LOGI(TAG, "Service created: handle=%d", param->create.service_handle);
-
-        // Store handles and start services based on UUID
-        if (param->create.service_id.id.uuid.uuid.uuid16 == GATTS_SERVICE_UUID_NETWORK) {
-            s_network_handle_table[IDX_SVC_NETWORK] = param->create.service_handle;
-            esp_ble_gatts_start_service(s_network_handle_table[IDX_SVC_NETWORK]);
-
-            // Add WIFI_SSID characteristic
-            esp_ble_gatts_add_char(s_network_handle_table[IDX_SVC_NETWORK],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_WIFI_SSID}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (param->create.service_id.id.uuid.uuid.uuid16 == GATTS_SERVICE_UUID_CLOCK) {
-            s_clock_handle_table[IDX_SVC_CLOCK] = param->create.service_handle;
-            esp_ble_gatts_start_service(s_clock_handle_table[IDX_SVC_CLOCK]);
-
-            esp_ble_gatts_add_char(s_clock_handle_table[IDX_SVC_CLOCK],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_TIME_FORMAT}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (param->create.service_id.id.uuid.uuid.uuid16 == GATTS_SERVICE_UUID_NTP) {
-            s_ntp_handle_table[IDX_SVC_NTP] = param->create.service_handle;
-            esp_ble_gatts_start_service(s_ntp_handle_table[IDX_SVC_NTP]);
-
-            esp_ble_gatts_add_char(s_ntp_handle_table[IDX_SVC_NTP],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_TIMEZONE}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (param->create.service_id.id.uuid.uuid.uuid16 == GATTS_SERVICE_UUID_LANGUAGE) {
-            s_language_handle_table[IDX_SVC_LANGUAGE] = param->create.service_handle;
-            esp_ble_gatts_start_service(s_language_handle_table[IDX_SVC_LANGUAGE]);
-
-            esp_ble_gatts_add_char(s_language_handle_table[IDX_SVC_LANGUAGE],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_LANGUAGE}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (param->create.service_id.id.uuid.uuid.uuid16 == GATTS_SERVICE_UUID_WEATHER) {
-            s_weather_handle_table[IDX_SVC_WEATHER] = param->create.service_handle;
-            esp_ble_gatts_start_service(s_weather_handle_table[IDX_SVC_WEATHER]);
-
-            esp_ble_gatts_add_char(s_weather_handle_table[IDX_SVC_WEATHER],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_WEATHER_API_KEY}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-        }
+    default:
+        // Secrets (WiFi password, API key) are write-only
         break;
+    }
 
-    case ESP_GATTS_ADD_CHAR_EVT: {
-        ESP_LOGI(TAG, "Characteristic added: handle=%d, uuid=0x%x",
-                 param->add_char.attr_handle, param->add_char.char_uuid.uuid.uuid16);
-
-        // Map characteristic handles
-        uint16_t char_uuid = param->add_char.char_uuid.uuid.uuid16;
-
-        // Network characteristics
-        if (char_uuid == GATTS_CHAR_UUID_WIFI_SSID) {
-            s_network_handle_table[IDX_CHAR_WIFI_SSID] = param->add_char.attr_handle;
-            s_network_handle_table[IDX_CHAR_VAL_WIFI_SSID] = param->add_char.attr_handle;
-
-            // Add next characteristic
-            esp_ble_gatts_add_char(s_network_handle_table[IDX_SVC_NETWORK],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_WIFI_PASSWORD}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (char_uuid == GATTS_CHAR_UUID_WIFI_PASSWORD) {
-            s_network_handle_table[IDX_CHAR_WIFI_PASSWORD] = param->add_char.attr_handle;
-            s_network_handle_table[IDX_CHAR_VAL_WIFI_PASSWORD] = param->add_char.attr_handle;
-
-            esp_ble_gatts_add_char(s_network_handle_table[IDX_SVC_NETWORK],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_WIFI_AUTHMODE}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (char_uuid == GATTS_CHAR_UUID_WIFI_AUTHMODE) {
-            s_network_handle_table[IDX_CHAR_WIFI_AUTHMODE] = param->add_char.attr_handle;
-            s_network_handle_table[IDX_CHAR_VAL_WIFI_AUTHMODE] = param->add_char.attr_handle;
-
-            // Network service complete, create clock service
-            esp_ble_gatts_create_service(gatts_if,
-                &(esp_gatt_srvc_id_t){
-                    .is_primary = true,
-                    .id = {
-                        .uuid = {.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_SERVICE_UUID_CLOCK}},
-                        .inst_id = 0,
-                    }
-                },
-                GATTS_NUM_HANDLE_CLOCK);
-        }
+    if (len > max_len) {
+        len = max_len;
+    }
+    if (value != NULL && len > 0) {
+        memcpy(buf, value, len);
+    }
+    return len;
+}
 
-        // Clock characteristics
-        else if (char_uuid == GATTS_CHAR_UUID_TIME_FORMAT) {
-            s_clock_handle_table[IDX_CHAR_TIME_FORMAT] = param->add_char.attr_handle;
-            s_clock_handle_table[IDX_CHAR_VAL_TIME_FORMAT] = param->add_char.attr_handle;
-
-            esp_ble_gatts_add_char(s_clock_handle_table[IDX_SVC_CLOCK],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_SHOW_SECONDS}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (char_uuid == GATTS_CHAR_UUID_SHOW_SECONDS) {
-            s_clock_handle_table[IDX_CHAR_SHOW_SECONDS] = param->add_char.attr_handle;
-            s_clock_handle_table[IDX_CHAR_VAL_SHOW_SECONDS] = param->add_char.attr_handle;
-
-            // Clock service complete, create NTP service
-            esp_ble_gatts_create_service(gatts_if,
-                &(esp_gatt_srvc_id_t){
-                    .is_primary = true,
-                    .id = {
-                        .uuid = {.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_SERVICE_UUID_NTP}},
-                        .inst_id = 0,
-                    }
-                },
-                GATTS_NUM_HANDLE_NTP);
-        }
+void ble_config_on_subscribe(ble_config_char_t id, bool enabled)
+{
+    if (id != BLE_CHAR_TELEMETRY) {
+        return;
+    }
 
-        // NTP characteristics
-        else if (char_uuid == GATTS_CHAR_UUID_TIMEZONE) {
-            s_ntp_handle_table[IDX_CHAR_TIMEZONE] = param->add_char.attr_handle;
-            s_ntp_handle_table[IDX_CHAR_VAL_TIMEZONE] = param->add_char.attr_handle;
-
-            esp_ble_gatts_add_char(s_ntp_handle_table[IDX_SVC_NTP],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_NTP_SERVER1}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (char_uuid == GATTS_CHAR_UUID_NTP_SERVER1) {
-            s_ntp_handle_table[IDX_CHAR_NTP_SERVER1] = param->add_char.attr_handle;
-            s_ntp_handle_table[IDX_CHAR_VAL_NTP_SERVER1] = param->add_char.attr_handle;
-
-            esp_ble_gatts_add_char(s_ntp_handle_table[IDX_SVC_NTP],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_NTP_SERVER2}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (char_uuid == GATTS_CHAR_UUID_NTP_SERVER2) {
-            s_ntp_handle_table[IDX_CHAR_NTP_SERVER2] = param->add_char.attr_handle;
-            s_ntp_handle_table[IDX_CHAR_VAL_NTP_SERVER2] = param->add_char.attr_handle;
-
-            esp_ble_gatts_add_char(s_ntp_handle_table[IDX_SVC_NTP],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_SYNC_INTERVAL}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
-
-        } else if (char_uuid == GATTS_CHAR_UUID_SYNC_INTERVAL) {
-            s_ntp_handle_table[IDX_CHAR_SYNC_INTERVAL] = param->add_char.attr_handle;
-            s_ntp_handle_table[IDX_CHAR_VAL_SYNC_INTERVAL] = param->add_char.attr_handle;
-
-            // NTP service complete, create language service
-            esp_ble_gatts_create_service(gatts_if,
-                &(esp_gatt_srvc_id_t){
-                    .is_primary = true,
-                    .id = {
-                        .uuid = {.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_SERVICE_UUID_LANGUAGE}},
-                        .inst_id = 0,
-                    }
-                },
-                GATTS_NUM_HANDLE_LANGUAGE);
-        }
+    ESP_LOGI(TAG, "Telemetry notifications %s", enabled ? "enabled" : "disabled");
+    if (enabled) {
+        ble_config_telemetry_start();
+    } else {
+        ble_config_telemetry_stop();
+    }
+}
 
-        // Language characteristic
-        else if (char_uuid == GATTS_CHAR_UUID_LANGUAGE) {
-            s_language_handle_table[IDX_CHAR_LANGUAGE] = param->add_char.attr_handle;
-            s_language_handle_table[IDX_CHAR_VAL_LANGUAGE] = param->add_char.attr_handle;
-
-            // Language service complete, create weather service
-            esp_ble_gatts_create_service(gatts_if,
-                &(esp_gatt_srvc_id_t){
-                    .is_primary = true,
-                    .id = {
-                        .uuid = {.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_SERVICE_UUID_WEATHER}},
-                        .inst_id = 0,
-                    }
-                },
-                GATTS_NUM_HANDLE_WEATHER);
-        }
+void ble_config_on_connect(void)
+{
+    s_connected = true;
+}
 
-        // Weather characteristics
-        else if (char_uuid == GATTS_CHAR_UUID_WEATHER_API_KEY) {
-            s_weather_handle_table[IDX_CHAR_WEATHER_API_KEY] = param->add_char.attr_handle;
-            s_weather_handle_table[IDX_CHAR_VAL_WEATHER_API_KEY] = param->add_char.attr_handle;
+bool ble_config_on_disconnect(void)
+{
+    s_connected = false;
+    ble_config_telemetry_stop();
 
-            esp_ble_gatts_add_char(s_weather_handle_table[IDX_SVC_WEATHER],
-                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = GATTS_CHAR_UUID_WEATHER_LOCATION}},
-                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                NULL, NULL);
+    if (s_window_expired) {
+        maybe_close_window();
+        return false;
+    }
+    return true;
+}
 
-        } else if (char_uuid == GATTS_CHAR_UUID_WEATHER_LOCATION) {
-            s_weather_handle_table[IDX_CHAR_WEATHER_LOCATION] = param->add_char.attr_handle;
-            s_weather_handle_table[IDX_CHAR_VAL_WEATHER_LOCATION] = param->add_char.attr_handle;
+// ============================================================================
+// Private - Provisioning Window
+// ============================================================================
 
-            ESP_LOGI(TAG, "All services and characteristics created");
-        }
-        break;
+static esp_err_t start_provisioning_window(void)
+{
+    if (CONFIG_TIMEMACHINE_BLE_WINDOW_S == 0) {
+        ESP_LOGI(TAG, "Provisioning window disabled, BLE stays on");
+        return ESP_OK;
     }
 
-    case ESP_GATTS_CONNECT_EVT: {
-        ESP_LOGI(TAG, "Client connected: conn_id=%d", param->connect.conn_id);
-        s_connected = true;
-        s_conn_id = param->connect.conn_id;
-        s_gatts_if = gatts_if;
-
-        // Update connection parameters for more stable connection
-        esp_ble_conn_update_params_t conn_params = {0};
-        memcpy(conn_params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
-        conn_params.min_int = 0x10;    // 20ms (in 1.25ms units)
-        conn_params.max_int = 0x20;    // 40ms (in 1.25ms units)
-        conn_params.latency = 0;       // No slave latency
-        conn_params.timeout = 400;     // 4000ms supervision timeout (in 10ms units)
-        esp_ble_gap_update_conn_params(&conn_params);
-        break;
+    s_window_expired = false;
+    s_hold_active = false;
+    s_shutdown_pending = false;
+
+    s_window_timer = xTimerCreate(
+        "ble_window",
+        pdMS_TO_TICKS(CONFIG_TIMEMACHINE_BLE_WINDOW_S * 1000),
+        pdFALSE,  // One-shot timer
+        NULL,
+        window_timer_callback
+    );
+    if (s_window_timer == NULL) {
+        ESP_LOGE(TAG, "Failed to create window timer");
+        return ESP_ERR_NO_MEM;
     }
 
-    case ESP_GATTS_DISCONNECT_EVT:
-        ESP_LOGI(TAG, "Client disconnected");
-        s_connected = false;
-        esp_ble_gap_start_advertising(&s_adv_params);
-        break;
+    // Track long presses so the window stays open while the sensor is held
+    esp_err_t err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        INPUT_LONG_PRESS,
+        input_long_press_handler,
+        NULL,
+        &s_long_press_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register INPUT_LONG_PRESS handler");
+        stop_provisioning_window();
+        return err;
+    }
 
-    case ESP_GATTS_WRITE_EVT:
-        handle_write_event(gatts_if, param);
-        break;
+    err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        INPUT_RELEASE,
+        input_release_handler,
+        NULL,
+        &s_release_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register INPUT_RELEASE handler");
+        stop_provisioning_window();
+        return err;
+    }
 
-    case ESP_GATTS_MTU_EVT:
-        ESP_LOGI(TAG, "MTU exchanged: %d", param->mtu.mtu);
-        break;
+    xTimerStart(s_window_timer, 0);
+    ESP_LOGI(TAG, "Provisioning window open for %ds", CONFIG_TIMEMACHINE_BLE_WINDOW_S);
 
-    default:
-        break;
+    return ESP_OK;
+}
+
+static void stop_provisioning_window(void)
+{
+    if (s_window_timer != NULL) {
+        xTimerStop(s_window_timer, 0);
+        xTimerDelete(s_window_timer, 0);
+        s_window_timer = NULL;
+    }
+
+    if (s_release_handler != NULL) {
+        esp_event_handler_instance_unregister(TIMEMACHINE_EVENT, INPUT_RELEASE,
+                                              s_release_handler);
+        s_release_handler = NULL;
+    }
+
+    if (s_long_press_handler != NULL) {
+        esp_event_handler_instance_unregister(TIMEMACHINE_EVENT, INPUT_LONG_PRESS,
+                                              s_long_press_handler);
+        s_long_press_handler = NULL;
     }
 }
 
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+static void maybe_close_window(void)
 {
-    if (event == ESP_GATTS_REG_EVT) {
-        if (param->reg.status == ESP_GATT_OK) {
-            s_profile.gatts_if = gatts_if;
-        } else {
-            ESP_LOGE(TAG, "Registration failed: app_id=%d, status=%d",
-                     param->reg.app_id, param->reg.status);
-            return;
-        }
+    if (!s_window_expired || s_connected || s_hold_active) {
+        return;
     }
 
-    if (gatts_if == ESP_GATT_IF_NONE || gatts_if == s_profile.gatts_if) {
-        if (s_profile.gatts_cb) {
-            s_profile.gatts_cb(event, gatts_if, param);
-        }
+    bool schedule = false;
+    portENTER_CRITICAL(&s_window_lock);
+    if (!s_shutdown_pending) {
+        s_shutdown_pending = true;
+        schedule = true;
+    }
+    portEXIT_CRITICAL(&s_window_lock);
+
+    if (!schedule) {
+        return;
+    }
+
+    // Tearing down the host blocks until its task acknowledges, which must
+    // not happen in the timer daemon or the BT callback context
+    if (xTaskCreate(shutdown_task, "ble_shutdown", 3072, NULL, 3, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create shutdown task");
+        s_shutdown_pending = false;
+    }
+}
+
+static void window_timer_callback(TimerHandle_t timer)
+{
+    ESP_LOGI(TAG, "Provisioning window expired%s",
+             s_connected ? ", waiting for client to disconnect" :
+             s_hold_active ? ", waiting for long press release" : "");
+    s_window_expired = true;
+    maybe_close_window();
+}
+
+static void shutdown_task(void *pvParameters)
+{
+    uint32_t heap_before = esp_get_free_heap_size();
+
+    ble_config_deinit();
+
+    // Releases the controller memory (esp_bt_controller_mem_release) and the
+    // BT host .bss/.data. BLE cannot be restarted until the next boot.
+    esp_err_t err = esp_bt_mem_release(ESP_BT_MODE_BTDM);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to release BT memory: %s", esp_err_to_name(err));
+    } else {
+        s_released = true;
     }
+
+    uint32_t heap_after = esp_get_free_heap_size();
+    ESP_LOGI(TAG, "BLE shut down (free heap: %lu -> %lu bytes, +%lu)",
+             heap_before, heap_after, heap_after - heap_before);
+
+    vTaskDelete(NULL);
+}
+
+static void input_long_press_handler(void* arg, esp_event_base_t base,
+                                     int32_t event_id, void* event_data)
+{
+    s_hold_active = true;
+}
+
+static void input_release_handler(void* arg, esp_event_base_t base,
+                                  int32_t event_id, void* event_data)
+{
+    s_hold_active = false;
+    maybe_close_window();
 }
@@ -0,0 +1,476 @@
+/**
+ * @file ble_config_bluedroid.c
+ * @brief Bluedroid host backend for the BLE configuration component
+ */
+
+#include "ble_config_priv.h"
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_gatt_common_api.h"
+#include "esp_bt_device.h"
+#include <string.h>
+
+static const char *TAG = "ble_config";
+
+static uint16_t s_gatts_if = ESP_GATT_IF_NONE;
+static uint16_t s_conn_id = 0;
+
+// Handles assigned by the stack while the GATT table is being built
+static uint16_t s_service_handles[8];
+static uint16_t s_char_handles[BLE_CHAR_COUNT];
+static uint16_t s_cccd_handles[BLE_CHAR_COUNT];
+static uint16_t s_cccd_values[BLE_CHAR_COUNT];
+static bool s_connected = false;
+
+// Services and characteristics are created one at a time, each completion
+// event triggers the next step
+static size_t s_build_service_idx = 0;
+static size_t s_build_char_idx = 0;
+
+// Forward declarations
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+
+// Advertising data
+static uint8_t s_adv_service_uuid128[16] = {
+    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
+    0x00, 0x10, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
+};
+
+static esp_ble_adv_data_t s_adv_data = {
+    .set_scan_rsp = false,
+    .include_name = true,
+    .include_txpower = true,
+    .min_interval = 0x0006,
+    .max_interval = 0x0010,
+    .appearance = 0x00,
+    .manufacturer_len = 0,
+    .p_manufacturer_data = NULL,
+    .service_data_len = 0,
+    .p_service_data = NULL,
+    .service_uuid_len = sizeof(s_adv_service_uuid128),
+    .p_service_uuid = s_adv_service_uuid128,
+    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+};
+
+static esp_ble_adv_params_t s_adv_params = {
+    .adv_int_min = 0x20,
+    .adv_int_max = 0x40,
+    .adv_type = ADV_TYPE_IND,
+    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+    .channel_map = ADV_CHNL_ALL,
+    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+
+// GATT profile
+static struct gatts_profile_inst {
+    esp_gatts_cb_t gatts_cb;
+    uint16_t gatts_if;
+    uint16_t app_id;
+    uint16_t conn_id;
+} s_profile = {
+    .gatts_cb = gatts_profile_event_handler,
+    .gatts_if = ESP_GATT_IF_NONE,
+};
+
+// ============================================================================
+// Backend Lifecycle
+// ============================================================================
+
+static esp_err_t bluedroid_start(void)
+{
+    // Release classic BT memory
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
+    // Initialize BT controller
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    esp_err_t ret = esp_bt_controller_init(&bt_cfg);
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to initialize BT controller: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Enable BT controller in BLE mode
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to enable BT controller: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Initialize Bluedroid
+    ret = esp_bluedroid_init();
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to initialize Bluedroid: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to enable Bluedroid: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Register callbacks
+    ret = esp_ble_gatts_register_callback(gatts_event_handler);
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to register GATTS callback: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gap_register_callback(gap_event_handler);
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to register GAP callback: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Register application profile
+    ret = esp_ble_gatts_app_register(0);
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to register app: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Set MTU
+    ret = esp_ble_gatt_set_local_mtu(500);
+    if (ret) {
+        ESP_LOGE(TAG, "Failed to set MTU: %s", esp_err_to_name(ret));
+    }
+
+    return ESP_OK;
+}
+
+static void bluedroid_stop(void)
+{
+    esp_bluedroid_disable();
+    esp_bluedroid_deinit();
+    esp_bt_controller_disable();
+    esp_bt_controller_deinit();
+
+    s_gatts_if = ESP_GATT_IF_NONE;
+    s_profile.gatts_if = ESP_GATT_IF_NONE;
+    s_connected = false;
+}
+
+static esp_err_t bluedroid_notify(ble_config_char_t id, const uint8_t *data, size_t len)
+{
+    if (!s_connected || !(s_cccd_values[id] & 0x0001)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_char_handles[id],
+                                       len, (uint8_t *)data, false);
+}
+
+// ============================================================================
+// Private - GAP Event Handler
+// ============================================================================
+
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
+        esp_ble_gap_start_advertising(&s_adv_params);
+        break;
+    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+        if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(TAG, "Advertising start failed");
+        } else {
+            ESP_LOGI(TAG, "Advertising started");
+        }
+        break;
+    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+        if (param->adv_stop_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(TAG, "Advertising stop failed");
+        } else {
+            ESP_LOGI(TAG, "Advertising stopped");
+        }
+        break;
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+        ESP_LOGI(TAG, "Connection params updated");
+        break;
+    default:
+        break;
+    }
+}
+
+// ============================================================================
+// Private - GATT Table Construction
+// ============================================================================
+
+static void create_service(esp_gatt_if_t gatts_if, size_t service_idx)
+{
+    const ble_config_service_def_t *service = &ble_config_services[service_idx];
+
+    // One handle for the service, two per characteristic (declaration + value)
+    // and one per client configuration descriptor
+    uint16_t num_handles = 1 + 2 * service->char_count;
+    for (size_t i = 0; i < service->char_count; i++) {
+        if (service->chars[i].flags & BLE_CONFIG_CHAR_F_NOTIFY) {
+            num_handles++;
+        }
+    }
+
+    esp_ble_gatts_create_service(gatts_if,
+        &(esp_gatt_srvc_id_t){
+            .is_primary = true,
+            .id = {
+                .uuid = {.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = service->uuid}},
+                .inst_id = 0,
+            }
+        },
+        num_handles);
+}
+
+static void add_char(size_t service_idx, size_t char_idx)
+{
+    const ble_config_char_def_t *def = &ble_config_services[service_idx].chars[char_idx];
+    esp_gatt_perm_t perm = 0;
+    esp_gatt_char_prop_t prop = 0;
+
+    if (def->flags & BLE_CONFIG_CHAR_F_READ) {
+        perm |= ESP_GATT_PERM_READ;
+        prop |= ESP_GATT_CHAR_PROP_BIT_READ;
+    }
+    if (def->flags & BLE_CONFIG_CHAR_F_WRITE) {
+        perm |= ESP_GATT_PERM_WRITE;
+        prop |= ESP_GATT_CHAR_PROP_BIT_WRITE;
+    }
+    if (def->flags & BLE_CONFIG_CHAR_F_NOTIFY) {
+        prop |= ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+    }
+
+    esp_ble_gatts_add_char(s_service_handles[service_idx],
+        &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = def->uuid}},
+        perm, prop, NULL, NULL);
+}
+
+static void add_next(esp_gatt_if_t gatts_if)
+{
+    const ble_config_service_def_t *service = &ble_config_services[s_build_service_idx];
+
+    if (++s_build_char_idx < service->char_count) {
+        // Add next characteristic
+        add_char(s_build_service_idx, s_build_char_idx);
+    } else if (++s_build_service_idx < ble_config_service_count) {
+        // Service complete, create next service
+        create_service(gatts_if, s_build_service_idx);
+    } else {
+        ESP_LOGI(TAG, "All services and characteristics created");
+    }
+}
+
+static bool lookup_cccd(uint16_t handle, ble_config_char_t *id)
+{
+    for (int i = 0; i < BLE_CHAR_COUNT; i++) {
+        if (s_cccd_handles[i] != 0 && s_cccd_handles[i] == handle) {
+            *id = (ble_config_char_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool lookup_char(uint16_t handle, ble_config_char_t *id)
+{
+    for (int i = 0; i < BLE_CHAR_COUNT; i++) {
+        if (s_char_handles[i] == handle) {
+            *id = (ble_config_char_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// Private - GATTS Event Handlers
+// ============================================================================
+
+static void handle_write_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    ble_config_char_t id;
+
+    if (lookup_cccd(param->write.handle, &id)) {
+        if (param->write.len == 2) {
+            s_cccd_values[id] = param->write.value[0] | (param->write.value[1] << 8);
+            ble_config_on_subscribe(id, (s_cccd_values[id] & 0x0001) != 0);
+        }
+    } else if (lookup_char(param->write.handle, &id)) {
+        ble_config_on_write(id, param->write.value, param->write.len);
+    }
+
+    // Send response if needed
+    if (param->write.need_rsp) {
+        esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
+                                   param->write.trans_id, ESP_GATT_OK, NULL);
+    }
+}
+
+static void handle_read_event(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    if (!param->read.need_rsp) {
+        return;
+    }
+
+    esp_gatt_rsp_t rsp = {0};
+    rsp.attr_value.handle = param->read.handle;
+
+    uint8_t value[BLE_CONFIG_MAX_VALUE_LEN];
+    size_t len = 0;
+    ble_config_char_t id;
+    if (lookup_cccd(param->read.handle, &id)) {
+        value[0] = s_cccd_values[id] & 0xFF;
+        value[1] = s_cccd_values[id] >> 8;
+        len = 2;
+    } else if (lookup_char(param->read.handle, &id)) {
+        len = ble_config_on_read(id, value, sizeof(value));
+    }
+
+    // Long values are read in several requests at increasing offsets
+    if (param->read.offset < len) {
+        rsp.attr_value.offset = param->read.offset;
+        rsp.attr_value.len = len - param->read.offset;
+        memcpy(rsp.attr_value.value, value + param->read.offset, rsp.attr_value.len);
+    }
+
+    esp_ble_gatts_send_response(gatts_if, param->read.conn_id,
+                               param->read.trans_id, ESP_GATT_OK, &rsp);
+}
+
+static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_GATTS_REG_EVT:
+        ESP_LOGI(TAG, "GATT server registered, app_id=%d", param->reg.app_id);
+
+        s_gatts_if = gatts_if;
+
+        // Set device name
+        esp_ble_gap_set_device_name(DEVICE_NAME);
+
+        // Configure advertising
+        esp_ble_gap_config_adv_data(&s_adv_data);
+
+        // Create services, starting with the first one
+        s_build_service_idx = 0;
+        s_build_char_idx = 0;
+        create_service(gatts_if, s_build_service_idx);
+        break;
+
+    case ESP_GATTS_CREATE_EVT:
+        ESP_LOGI(TAG, "Service created: handle=%d", param->create.service_handle);
+
+        s_service_handles[s_build_service_idx] = param->create.service_handle;
+        esp_ble_gatts_start_service(param->create.service_handle);
+
+        // Add first characteristic of this service
+        s_build_char_idx = 0;
+        add_char(s_build_service_idx, s_build_char_idx);
+        break;
+
+    case ESP_GATTS_ADD_CHAR_EVT: {
+        ESP_LOGI(TAG, "Characteristic added: handle=%d, uuid=0x%x",
+                 param->add_char.attr_handle, param->add_char.char_uuid.uuid.uuid16);
+
+        const ble_config_char_def_t *def =
+            &ble_config_services[s_build_service_idx].chars[s_build_char_idx];
+        s_char_handles[def->id] = param->add_char.attr_handle;
+
+        if (def->flags & BLE_CONFIG_CHAR_F_NOTIFY) {
+            // Client configuration descriptor, continue once it is added
+            esp_ble_gatts_add_char_descr(s_service_handles[s_build_service_idx],
+                &(esp_bt_uuid_t){.len = ESP_UUID_LEN_16, .uuid = {.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG}},
+                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                NULL, NULL);
+            break;
+        }
+
+        add_next(gatts_if);
+        break;
+    }
+
+    case ESP_GATTS_ADD_CHAR_DESCR_EVT: {
+        const ble_config_char_def_t *def =
+            &ble_config_services[s_build_service_idx].chars[s_build_char_idx];
+        s_cccd_handles[def->id] = param->add_char_descr.attr_handle;
+
+        add_next(gatts_if);
+        break;
+    }
+
+    case ESP_GATTS_CONNECT_EVT: {
+        ESP_LOGI(TAG, "Client connected: conn_id=%d", param->connect.conn_id);
+        s_conn_id = param->connect.conn_id;
+        s_gatts_if = gatts_if;
+        s_connected = true;
+        ble_config_on_connect();
+
+        // Update connection parameters for more stable connection
+        esp_ble_conn_update_params_t conn_params = {0};
+        memcpy(conn_params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+        conn_params.min_int = 0x10;    // 20ms (in 1.25ms units)
+        conn_params.max_int = 0x20;    // 40ms (in 1.25ms units)
+        conn_params.latency = 0;       // No slave latency
+        conn_params.timeout = 400;     // 4000ms supervision timeout (in 10ms units)
+        esp_ble_gap_update_conn_params(&conn_params);
+        break;
+    }
+
+    case ESP_GATTS_DISCONNECT_EVT:
+        ESP_LOGI(TAG, "Client disconnected");
+        s_connected = false;
+        memset(s_cccd_values, 0, sizeof(s_cccd_values));
+        if (ble_config_on_disconnect()) {
+            esp_ble_gap_start_advertising(&s_adv_params);
+        }
+        break;
+
+    case ESP_GATTS_WRITE_EVT:
+        handle_write_event(gatts_if, param);
+        break;
+
+    case ESP_GATTS_READ_EVT:
+        handle_read_event(gatts_if, param);
+        break;
+
+    case ESP_GATTS_MTU_EVT:
+        ESP_LOGI(TAG, "MTU exchanged: %d", param->mtu.mtu);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    if (event == ESP_GATTS_REG_EVT) {
+        if (param->reg.status == ESP_GATT_OK) {
+            s_profile.gatts_if = gatts_if;
+        } else {
+            ESP_LOGE(TAG, "Registration failed: app_id=%d, status=%d",
+                     param->reg.app_id, param->reg.status);
+            return;
+        }
+    }
+
+    if (gatts_if == ESP_GATT_IF_NONE || gatts_if == s_profile.gatts_if) {
+        if (s_profile.gatts_cb) {
+            s_profile.gatts_cb(event, gatts_if, param);
+        }
+    }
+}
+
+// ============================================================================
+// Backend Export
+// ============================================================================
+
+const ble_config_backend_t ble_config_backend = {
+    .start = bluedroid_start,
+    .stop = bluedroid_stop,
+    .notify = bluedroid_notify,
+    .name = "bluedroid"
+};
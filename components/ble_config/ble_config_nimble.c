@@ -0,0 +1,343 @@
+/**
+ * @file ble_config_nimble.c
+ * @brief NimBLE host backend for the BLE configuration component
+ */
+
+#include "ble_config_priv.h"
+#include "esp_log.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#include <string.h>
+
+static const char *TAG = "ble_config";
+
+#define MAX_SERVICES 8
+
+static uint8_t s_own_addr_type;
+static uint16_t s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+static bool s_host_synced = false;
+
+// GATT table built from the shared layout; NimBLE keeps pointers into these
+static ble_uuid16_t s_service_uuids[MAX_SERVICES];
+static ble_uuid16_t s_char_uuids[BLE_CHAR_COUNT];
+static struct ble_gatt_chr_def s_chr_defs[BLE_CHAR_COUNT + MAX_SERVICES];
+static struct ble_gatt_svc_def s_svc_defs[MAX_SERVICES + 1];
+static uint16_t s_char_handles[BLE_CHAR_COUNT];
+
+// Forward declarations
+static int gap_event_handler(struct ble_gap_event *event, void *arg);
+
+// ============================================================================
+// Private - GATT Access
+// ============================================================================
+
+static int gatt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                          struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    ble_config_char_t id = (ble_config_char_t)(uintptr_t)arg;
+
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_READ_CHR: {
+        uint8_t buf[BLE_CONFIG_MAX_VALUE_LEN];
+        size_t len = ble_config_on_read(id, buf, sizeof(buf));
+        return os_mbuf_append(ctxt->om, buf, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    case BLE_GATT_ACCESS_OP_WRITE_CHR: {
+        uint8_t buf[BLE_CONFIG_MAX_VALUE_LEN];
+        uint16_t len = 0;
+        if (OS_MBUF_PKTLEN(ctxt->om) > sizeof(buf)) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0) {
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+        ble_config_on_write(id, buf, len);
+        return 0;
+    }
+
+    default:
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+static esp_err_t build_gatt_table(void)
+{
+    if (ble_config_service_count > MAX_SERVICES) {
+        ESP_LOGE(TAG, "Too many services: %d", (int)ble_config_service_count);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t chr_idx = 0;
+    memset(s_svc_defs, 0, sizeof(s_svc_defs));
+    memset(s_chr_defs, 0, sizeof(s_chr_defs));
+
+    for (size_t s = 0; s < ble_config_service_count; s++) {
+        const ble_config_service_def_t *service = &ble_config_services[s];
+
+        s_service_uuids[s] = (ble_uuid16_t)BLE_UUID16_INIT(service->uuid);
+        s_svc_defs[s].type = BLE_GATT_SVC_TYPE_PRIMARY;
+        s_svc_defs[s].uuid = &s_service_uuids[s].u;
+        s_svc_defs[s].characteristics = &s_chr_defs[chr_idx];
+
+        for (size_t c = 0; c < service->char_count; c++) {
+            ble_config_char_t id = service->chars[c].id;
+
+            s_char_uuids[id] = (ble_uuid16_t)BLE_UUID16_INIT(service->chars[c].uuid);
+            s_chr_defs[chr_idx].uuid = &s_char_uuids[id].u;
+            s_chr_defs[chr_idx].access_cb = gatt_access_cb;
+            s_chr_defs[chr_idx].arg = (void *)(uintptr_t)id;
+            s_chr_defs[chr_idx].flags =
+                ((service->chars[c].flags & BLE_CONFIG_CHAR_F_READ) ? BLE_GATT_CHR_F_READ : 0) |
+                ((service->chars[c].flags & BLE_CONFIG_CHAR_F_WRITE) ? BLE_GATT_CHR_F_WRITE : 0) |
+                ((service->chars[c].flags & BLE_CONFIG_CHAR_F_NOTIFY) ? BLE_GATT_CHR_F_NOTIFY : 0);
+            s_chr_defs[chr_idx].val_handle = &s_char_handles[id];
+            chr_idx++;
+        }
+
+        // Zeroed entry terminates this service's characteristic list
+        chr_idx++;
+    }
+
+    int rc = ble_gatts_count_cfg(s_svc_defs);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to count GATT config: %d", rc);
+        return ESP_FAIL;
+    }
+
+    rc = ble_gatts_add_svcs(s_svc_defs);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to add GATT services: %d", rc);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+// ============================================================================
+// Private - Advertising
+// ============================================================================
+
+static void start_advertising(void)
+{
+    struct ble_hs_adv_fields fields = {0};
+    static const ble_uuid16_t adv_uuid = BLE_UUID16_INIT(GATTS_SERVICE_UUID_NETWORK);
+    const char *name = ble_svc_gap_device_name();
+
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.tx_pwr_lvl_is_present = 1;
+    fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+    fields.name = (const uint8_t *)name;
+    fields.name_len = strlen(name);
+    fields.name_is_complete = 1;
+    fields.uuids16 = &adv_uuid;
+    fields.num_uuids16 = 1;
+    fields.uuids16_is_complete = 1;
+
+    int rc = ble_gap_adv_set_fields(&fields);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to set advertising data: %d", rc);
+        return;
+    }
+
+    struct ble_gap_adv_params adv_params = {
+        .conn_mode = BLE_GAP_CONN_MODE_UND,
+        .disc_mode = BLE_GAP_DISC_MODE_GEN,
+        .itvl_min = 0x20,
+        .itvl_max = 0x40,
+    };
+
+    rc = ble_gap_adv_start(s_own_addr_type, NULL, BLE_HS_FOREVER,
+                           &adv_params, gap_event_handler, NULL);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Advertising start failed: %d", rc);
+    } else {
+        ESP_LOGI(TAG, "Advertising started");
+    }
+}
+
+// ============================================================================
+// Private - GAP Event Handler
+// ============================================================================
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg)
+{
+    switch (event->type) {
+    case BLE_GAP_EVENT_CONNECT:
+        if (event->connect.status != 0) {
+            ESP_LOGW(TAG, "Connection failed: %d", event->connect.status);
+            start_advertising();
+            break;
+        }
+
+        ESP_LOGI(TAG, "Client connected: conn_handle=%d", event->connect.conn_handle);
+        s_conn_handle = event->connect.conn_handle;
+        ble_config_on_connect();
+
+        // Update connection parameters for more stable connection
+        struct ble_gap_upd_params conn_params = {
+            .itvl_min = 0x10,              // 20ms (in 1.25ms units)
+            .itvl_max = 0x20,              // 40ms (in 1.25ms units)
+            .latency = 0,                  // No slave latency
+            .supervision_timeout = 400,    // 4000ms supervision timeout (in 10ms units)
+        };
+        ble_gap_update_params(s_conn_handle, &conn_params);
+        break;
+
+    case BLE_GAP_EVENT_DISCONNECT:
+        ESP_LOGI(TAG, "Client disconnected: reason=%d", event->disconnect.reason);
+        s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+        if (ble_config_on_disconnect()) {
+            start_advertising();
+        }
+        break;
+
+    case BLE_GAP_EVENT_CONN_UPDATE:
+        ESP_LOGI(TAG, "Connection params updated");
+        break;
+
+    case BLE_GAP_EVENT_ADV_COMPLETE:
+        ESP_LOGI(TAG, "Advertising stopped");
+        break;
+
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        // NimBLE adds and stores the CCCD itself, only forward the state
+        for (int i = 0; i < BLE_CHAR_COUNT; i++) {
+            if (s_char_handles[i] == event->subscribe.attr_handle) {
+                ble_config_on_subscribe((ble_config_char_t)i, event->subscribe.cur_notify);
+                break;
+            }
+        }
+        break;
+
+    case BLE_GAP_EVENT_MTU:
+        ESP_LOGI(TAG, "MTU exchanged: %d", event->mtu.value);
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+// ============================================================================
+// Private - Host Task
+// ============================================================================
+
+static void on_sync(void)
+{
+    int rc = ble_hs_util_ensure_addr(0);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to ensure address: %d", rc);
+        return;
+    }
+
+    rc = ble_hs_id_infer_auto(0, &s_own_addr_type);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to infer address type: %d", rc);
+        return;
+    }
+
+    s_host_synced = true;
+    start_advertising();
+}
+
+static void on_reset(int reason)
+{
+    ESP_LOGW(TAG, "Host reset: reason=%d", reason);
+    s_host_synced = false;
+}
+
+static void host_task(void *param)
+{
+    // Returns only when nimble_port_stop() is called
+    nimble_port_run();
+    nimble_port_freertos_deinit();
+}
+
+// ============================================================================
+// Backend Lifecycle
+// ============================================================================
+
+static esp_err_t nimble_start(void)
+{
+    // Initializes the controller and the host
+    esp_err_t ret = nimble_port_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize NimBLE: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+
+    ret = build_gatt_table();
+    if (ret != ESP_OK) {
+        nimble_port_deinit();
+        return ret;
+    }
+
+    int rc = ble_svc_gap_device_name_set(DEVICE_NAME);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to set device name: %d", rc);
+    }
+
+    // Set MTU
+    rc = ble_att_set_preferred_mtu(500);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to set MTU: %d", rc);
+    }
+
+    nimble_port_freertos_init(host_task);
+
+    return ESP_OK;
+}
+
+static esp_err_t nimble_notify(ble_config_char_t id, const uint8_t *data, size_t len)
+{
+    if (s_conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(data, len);
+    if (om == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Consumes the mbuf, also on failure
+    return ble_gatts_notify_custom(s_conn_handle, s_char_handles[id], om) == 0 ?
+           ESP_OK : ESP_FAIL;
+}
+
+static void nimble_stop(void)
+{
+    if (s_host_synced) {
+        ble_gap_adv_stop();
+    }
+
+    // Blocks until the host task has left nimble_port_run()
+    nimble_port_stop();
+    nimble_port_deinit();
+
+    s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    s_host_synced = false;
+}
+
+// ============================================================================
+// Backend Export
+// ============================================================================
+
+const ble_config_backend_t ble_config_backend = {
+    .start = nimble_start,
+    .stop = nimble_stop,
+    .notify = nimble_notify,
+    .name = "nimble"
+};
@@ -0,0 +1,168 @@
+/**
+ * @file ble_config_priv.h
+ * @brief Internal interface between the BLE configuration core and host backends
+ *
+ * The core (ble_config.c) owns the configuration values, the provisioning
+ * window and the events emitted on writes. Backends (Bluedroid or NimBLE)
+ * only translate their stack's GATT callbacks into the calls below.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEVICE_NAME                    "TimeMachine"
+
+#define GATTS_SERVICE_UUID_NETWORK     0x00FF
+#define GATTS_CHAR_UUID_WIFI_SSID      0xFF01
+#define GATTS_CHAR_UUID_WIFI_PASSWORD  0xFF02
+#define GATTS_CHAR_UUID_WIFI_AUTHMODE  0xFF03
+
+#define GATTS_SERVICE_UUID_CLOCK       0x01FF
+#define GATTS_CHAR_UUID_TIME_FORMAT    0xFF11
+#define GATTS_CHAR_UUID_SHOW_SECONDS   0xFF12
+
+#define GATTS_SERVICE_UUID_NTP         0x02FF
+#define GATTS_CHAR_UUID_TIMEZONE       0xFF21
+#define GATTS_CHAR_UUID_NTP_SERVER1    0xFF22
+#define GATTS_CHAR_UUID_NTP_SERVER2    0xFF23
+#define GATTS_CHAR_UUID_SYNC_INTERVAL  0xFF24
+
+#define GATTS_SERVICE_UUID_LANGUAGE    0x03FF
+#define GATTS_CHAR_UUID_LANGUAGE       0xFF31
+
+#define GATTS_SERVICE_UUID_WEATHER     0x04FF
+#define GATTS_CHAR_UUID_WEATHER_API_KEY    0xFF41
+#define GATTS_CHAR_UUID_WEATHER_LOCATION   0xFF42
+
+#define GATTS_SERVICE_UUID_TELEMETRY   0x05FF
+#define GATTS_CHAR_UUID_TELEMETRY      0xFF51
+#define GATTS_CHAR_UUID_TELEMETRY_RATE 0xFF52
+
+#define BLE_CONFIG_MAX_VALUE_LEN       64
+
+/**
+ * @brief Configuration characteristics, independent of the host stack
+ */
+typedef enum {
+    BLE_CHAR_WIFI_SSID,
+    BLE_CHAR_WIFI_PASSWORD,
+    BLE_CHAR_WIFI_AUTHMODE,
+    BLE_CHAR_TIME_FORMAT,
+    BLE_CHAR_SHOW_SECONDS,
+    BLE_CHAR_TIMEZONE,
+    BLE_CHAR_NTP_SERVER1,
+    BLE_CHAR_NTP_SERVER2,
+    BLE_CHAR_SYNC_INTERVAL,
+    BLE_CHAR_LANGUAGE,
+    BLE_CHAR_WEATHER_API_KEY,
+    BLE_CHAR_WEATHER_LOCATION,
+    BLE_CHAR_TELEMETRY,
+    BLE_CHAR_TELEMETRY_INTERVAL,
+    BLE_CHAR_COUNT,
+} ble_config_char_t;
+
+/**
+ * @brief Characteristic properties
+ */
+#define BLE_CONFIG_CHAR_F_READ     (1 << 0)
+#define BLE_CONFIG_CHAR_F_WRITE    (1 << 1)
+#define BLE_CONFIG_CHAR_F_NOTIFY   (1 << 2)  /**< Backend adds a CCCD and reports subscriptions */
+
+/**
+ * @brief Characteristic definition
+ */
+typedef struct {
+    uint16_t uuid;             /**< 16-bit characteristic UUID */
+    ble_config_char_t id;      /**< Core characteristic ID */
+    uint8_t flags;             /**< BLE_CONFIG_CHAR_F_* */
+} ble_config_char_def_t;
+
+/**
+ * @brief Service definition
+ */
+typedef struct {
+    uint16_t uuid;                        /**< 16-bit service UUID */
+    uint8_t char_count;                   /**< Number of characteristics */
+    const ble_config_char_def_t *chars;   /**< Characteristic definitions */
+} ble_config_service_def_t;
+
+/**
+ * @brief GATT layout shared by all backends
+ */
+extern const ble_config_service_def_t ble_config_services[];
+extern const size_t ble_config_service_count;
+
+/**
+ * @brief BLE host backend interface
+ */
+typedef struct {
+    esp_err_t (*start)(void);  /**< Bring up controller and host, register services, advertise */
+    void (*stop)(void);        /**< Stop advertising, tear down host and controller */
+    esp_err_t (*notify)(ble_config_char_t id, const uint8_t *data, size_t len);  /**< Notify the connected client */
+    const char *name;
+} ble_config_backend_t;
+
+/**
+ * @brief Backend selected at build time (Bluedroid or NimBLE)
+ */
+extern const ble_config_backend_t ble_config_backend;
+
+/**
+ * @brief Handle a write to a configuration characteristic
+ */
+void ble_config_on_write(ble_config_char_t id, const uint8_t *data, size_t len);
+
+/**
+ * @brief Copy the current value of a characteristic for a read request
+ *
+ * @return Number of bytes written to buf
+ */
+size_t ble_config_on_read(ble_config_char_t id, uint8_t *buf, size_t max_len);
+
+/**
+ * @brief Notify the core that the client (un)subscribed to a characteristic
+ */
+void ble_config_on_subscribe(ble_config_char_t id, bool enabled);
+
+/**
+ * @brief Notify the core that a client connected
+ */
+void ble_config_on_connect(void);
+
+/**
+ * @brief Notify the core that the client disconnected
+ *
+ * @return true if the backend should resume advertising
+ */
+bool ble_config_on_disconnect(void);
+
+// ============================================================================
+// Telemetry (ble_config_telemetry.c)
+// ============================================================================
+
+/**
+ * @brief Start periodic telemetry notifications
+ */
+void ble_config_telemetry_start(void);
+
+/**
+ * @brief Stop periodic telemetry notifications
+ */
+void ble_config_telemetry_stop(void);
+
+/**
+ * @brief Collect a telemetry snapshot (ble_config_telemetry_t)
+ *
+ * @return Number of bytes written to buf
+ */
+size_t ble_config_telemetry_read(uint8_t *buf, size_t max_len);
+
+/**
+ * @brief Get/set the notification interval in milliseconds (0 = notifications off)
+ */
+uint16_t ble_config_telemetry_get_interval(void);
+void ble_config_telemetry_set_interval(uint16_t interval_ms);
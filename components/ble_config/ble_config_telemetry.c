@@ -0,0 +1,208 @@
+/**
+ * @file ble_config_telemetry.c
+ * @brief Runtime performance counters exposed over BLE
+ *
+ * Collects heap, stack, event loop, render, NTP and weather metrics into a
+ * packed ble_config_telemetry_t and notifies it to a subscribed client at
+ * a configurable rate.
+ */
+
+#include "ble_config.h"
+#include "ble_config_priv.h"
+#include "display.h"
+#include "ntp_sync.h"
+#include "weather.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "ble_config";
+
+#define MIN_INTERVAL_MS 100
+
+// The default event loop does not expose its queue depth, so its backlog is
+// measured as the delay between posting a probe event and its dispatch
+ESP_EVENT_DEFINE_BASE(BLE_TELEMETRY_EVENT);
+
+enum {
+    TELEMETRY_PROBE,
+};
+
+static const char *s_watched_tasks[BLE_CONFIG_TELEMETRY_MAX_TASKS] = {
+    "sys_evt",
+    "Tmr Svc",
+    "netjobs",
+    "touch",
+};
+
+static esp_timer_handle_t s_notify_timer = NULL;
+static esp_event_handler_instance_t s_probe_handler = NULL;
+static uint16_t s_interval_ms = CONFIG_TIMEMACHINE_BLE_TELEMETRY_INTERVAL_MS;
+static uint16_t s_sequence = 0;
+static bool s_subscribed = false;
+static volatile uint32_t s_event_loop_lag_us = 0;
+
+// Forward declarations
+static void notify_timer_callback(void *arg);
+static void probe_handler(void* arg, esp_event_base_t base,
+                          int32_t event_id, void* event_data);
+static void restart_timer(void);
+
+// ============================================================================
+// Internal API
+// ============================================================================
+
+void ble_config_telemetry_start(void)
+{
+    if (s_notify_timer == NULL) {
+        esp_timer_create_args_t timer_args = {
+            .callback = notify_timer_callback,
+            .name = "ble_telemetry",
+        };
+        if (esp_timer_create(&timer_args, &s_notify_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create telemetry timer");
+            return;
+        }
+    }
+
+    if (s_probe_handler == NULL) {
+        esp_err_t err = esp_event_handler_instance_register(
+            BLE_TELEMETRY_EVENT,
+            TELEMETRY_PROBE,
+            probe_handler,
+            NULL,
+            &s_probe_handler
+        );
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to register probe handler, event loop lag unavailable");
+        }
+    }
+
+    s_subscribed = true;
+    restart_timer();
+}
+
+void ble_config_telemetry_stop(void)
+{
+    s_subscribed = false;
+
+    if (s_notify_timer != NULL) {
+        esp_timer_stop(s_notify_timer);
+        esp_timer_delete(s_notify_timer);
+        s_notify_timer = NULL;
+    }
+
+    if (s_probe_handler != NULL) {
+        esp_event_handler_instance_unregister(BLE_TELEMETRY_EVENT, TELEMETRY_PROBE,
+                                              s_probe_handler);
+        s_probe_handler = NULL;
+    }
+}
+
+uint16_t ble_config_telemetry_get_interval(void)
+{
+    return s_interval_ms;
+}
+
+void ble_config_telemetry_set_interval(uint16_t interval_ms)
+{
+    if (interval_ms != 0 && interval_ms < MIN_INTERVAL_MS) {
+        interval_ms = MIN_INTERVAL_MS;
+    }
+
+    s_interval_ms = interval_ms;
+    ESP_LOGI(TAG, "Telemetry interval updated: %u ms", s_interval_ms);
+
+    if (s_subscribed) {
+        restart_timer();
+    }
+}
+
+size_t ble_config_telemetry_read(uint8_t *buf, size_t max_len)
+{
+    ble_config_telemetry_t record = {
+        .version = BLE_CONFIG_TELEMETRY_VERSION,
+        .task_count = BLE_CONFIG_TELEMETRY_MAX_TASKS,
+        .sequence = s_sequence++,
+        .uptime_s = (uint32_t)(esp_timer_get_time() / 1000000),
+        .free_heap = esp_get_free_heap_size(),
+        .min_free_heap = esp_get_minimum_free_heap_size(),
+        .event_loop_lag_us = s_event_loop_lag_us,
+    };
+
+    display_stats_t display_stats;
+    if (display_get_stats(&display_stats) == ESP_OK) {
+        record.frame_count = display_stats.frame_count;
+        record.render_us = display_stats.last_render_us;
+        record.render_max_us = display_stats.max_render_us;
+    }
+
+    ntp_sync_stats_t ntp_stats;
+    if (ntp_sync_get_stats(&ntp_stats) == ESP_OK) {
+        record.ntp_offset_ms = (int32_t)(ntp_stats.last_offset_us / 1000);
+    }
+
+    weather_stats_t weather_stats;
+    if (weather_get_stats(&weather_stats) == ESP_OK && weather_stats.fetch_count > 0) {
+        record.weather_fetch_ms = weather_stats.last_duration_ms > UINT16_MAX ?
+                                  UINT16_MAX : weather_stats.last_duration_ms;
+        record.weather_status = weather_stats.last_http_status > 0 ?
+                                weather_stats.last_http_status : -1;
+    }
+
+    // On ESP-IDF the high-water mark is reported in bytes
+    for (int i = 0; i < BLE_CONFIG_TELEMETRY_MAX_TASKS; i++) {
+        TaskHandle_t task = xTaskGetHandle(s_watched_tasks[i]);
+        UBaseType_t free_bytes = task ? uxTaskGetStackHighWaterMark(task) : UINT16_MAX;
+        record.stack_free[i] = free_bytes > UINT16_MAX ? UINT16_MAX : free_bytes;
+    }
+
+    size_t len = sizeof(record) < max_len ? sizeof(record) : max_len;
+    memcpy(buf, &record, len);
+    return len;
+}
+
+// ============================================================================
+// Private
+// ============================================================================
+
+static void restart_timer(void)
+{
+    if (s_notify_timer == NULL) {
+        return;
+    }
+
+    esp_timer_stop(s_notify_timer);
+    if (s_interval_ms > 0) {
+        esp_timer_start_periodic(s_notify_timer, (uint64_t)s_interval_ms * 1000);
+    }
+}
+
+static void notify_timer_callback(void *arg)
+{
+    // Probe the event loop; the result shows up in the next record
+    int64_t posted_at = esp_timer_get_time();
+    if (esp_event_post(BLE_TELEMETRY_EVENT, TELEMETRY_PROBE,
+                       &posted_at, sizeof(posted_at), 0) != ESP_OK) {
+        s_event_loop_lag_us = UINT32_MAX;
+    }
+
+    uint8_t buf[sizeof(ble_config_telemetry_t)];
+    size_t len = ble_config_telemetry_read(buf, sizeof(buf));
+
+    esp_err_t err = ble_config_backend.notify(BLE_CHAR_TELEMETRY, buf, len);
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "Telemetry notify failed: %s", esp_err_to_name(err));
+    }
+}
+
+static void probe_handler(void* arg, esp_event_base_t base,
+                          int32_t event_id, void* event_data)
+{
+    int64_t posted_at = *(int64_t *)event_data;
+    s_event_loop_lag_us = (uint32_t)(esp_timer_get_time() - posted_at);
+}
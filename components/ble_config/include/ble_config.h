@@ -11,6 +11,35 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+#define BLE_CONFIG_TELEMETRY_VERSION    1
+#define BLE_CONFIG_TELEMETRY_MAX_TASKS  4
+
+/**
+ * @brief Telemetry record sent on the telemetry characteristic (0xFF51)
+ *
+ * Little-endian, packed. Clients need an ATT MTU of at least 51 to receive
+ * a full notification. Watched tasks, in order: sys_evt, Tmr Svc,
+ * netjobs (NTP syncs and weather fetches), touch (0xFFFF when the task
+ * does not exist, e.g. touch with the input script).
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;              /**< BLE_CONFIG_TELEMETRY_VERSION */
+    uint8_t task_count;           /**< Entries in stack_free */
+    uint16_t sequence;            /**< Incremented for every record */
+    uint32_t uptime_s;            /**< Seconds since boot */
+    uint32_t free_heap;           /**< Current free heap (bytes) */
+    uint32_t min_free_heap;       /**< Lowest free heap since boot (bytes) */
+    uint32_t event_loop_lag_us;   /**< Post-to-dispatch delay of the last probe event (UINT32_MAX = queue full) */
+    uint32_t frame_count;         /**< Scenes rendered */
+    uint32_t render_us;           /**< Last render duration */
+    uint32_t render_max_us;       /**< Longest render duration */
+    int32_t ntp_offset_ms;        /**< Clock correction applied by the last NTP sync */
+    uint16_t weather_fetch_ms;    /**< Duration of the last weather fetch */
+    int16_t weather_status;       /**< Last HTTP status, -1 on transport error, 0 if never fetched */
+    uint16_t stack_free[BLE_CONFIG_TELEMETRY_MAX_TASKS];  /**< Stack high-water marks (bytes) */
+} ble_config_telemetry_t;
 
 /**
  * @brief Initialize BLE configuration service
@@ -20,8 +49,15 @@
  * - Clock configuration (time format, show seconds)
  * - NTP configuration (timezone, servers, sync interval)
  * - Language configuration
+ * - Telemetry (read/notify performance counters, see ble_config_telemetry_t)
  *
- * @return ESP_OK on success, error code otherwise
+ * When CONFIG_TIMEMACHINE_BLE_WINDOW_S is non-zero, BLE is only available
+ * for that many seconds after init (longer while a client is connected or
+ * a long press is held). Afterwards the stack is shut down and its memory
+ * released, so BLE cannot be started again until reboot.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if BLE memory was
+ *         already released, error code otherwise
  */
 esp_err_t ble_config_init(void);
 
@@ -36,3 +72,10 @@ void ble_config_deinit(void);
  * @return true if connected, false otherwise
  */
 bool ble_config_is_connected(void);
+
+/**
+ * @brief Check if the BLE stack is currently running
+ *
+ * @return true while the provisioning window is open, false otherwise
+ */
+bool ble_config_is_active(void);
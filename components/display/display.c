@@ -1,18 +1,57 @@
 #include "display.h"
 #include "display_max7219.h"
+#include "transition.h"
 #include "timemachine_events.h"
+#include "perf.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "display";
 
+// Transition frames are flushed in the default event loop task, not in the
+// esp_timer task where the SPI transfer would hold up every other timer
+ESP_EVENT_DEFINE_BASE(DISPLAY_TRANSITION_EVENT);
+
+enum {
+    DISPLAY_TRANSITION_STEP,    /**< The transition timer ticked */
+};
+
 static const display_driver_t *s_driver = NULL;
 static bool s_initialized = false;
 static esp_event_handler_instance_t s_display_event_handler = NULL;
+static esp_event_handler_instance_t s_step_handler = NULL;
+static display_stats_t s_stats = {0};
+
+// Serializes flushes from the event loop and other tasks presenting frames.
+// Guards s_shown, s_transition and s_stats.
+static SemaphoreHandle_t s_mutex = NULL;
+
+// Frame currently on the display
+static display_frame_t s_shown = {0};
+
+static struct {
+    bool active;
+    display_transition_type_t type;
+    display_frame_t from;
+    display_frame_t to;
+    uint32_t step;
+    uint32_t steps;
+    int64_t frame_us;
+    int64_t start_us;
+    int64_t last_frame_us;
+    esp_timer_handle_t timer;
+    volatile bool step_pending;     // A step event is queued, later ticks are dropped
+} s_transition = {0};
 
 // Forward declarations
 static void display_event_handler(void* arg, esp_event_base_t base,
                                    int32_t event_id, void* event_data);
+static void transition_timer_callback(void *arg);
+static void transition_step_handler(void* arg, esp_event_base_t base,
+                                    int32_t event_id, void* event_data);
 
 // ============================================================================
 // Public API - Lifecycle
@@ -29,10 +68,34 @@ esp_err_t display_init(void)
 
     ESP_LOGI(TAG, "Using driver: %s", s_driver->name);
 
+    s_mutex = xSemaphoreCreateMutex();
+    if (s_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = transition_timer_callback,
+        .name = "display_transition"
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_transition.timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create transition timer");
+        vSemaphoreDelete(s_mutex);
+        s_mutex = NULL;
+        return err;
+    }
+
+    transition_init();
+
     // Initialize driver
-    esp_err_t err = s_driver->init();
+    err = s_driver->init();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize driver");
+        esp_timer_delete(s_transition.timer);
+        s_transition.timer = NULL;
+        vSemaphoreDelete(s_mutex);
+        s_mutex = NULL;
         return err;
     }
 
@@ -45,9 +108,28 @@ esp_err_t display_init(void)
         &s_display_event_handler
     );
 
+    if (err == ESP_OK) {
+        err = esp_event_handler_instance_register(
+            DISPLAY_TRANSITION_EVENT,
+            DISPLAY_TRANSITION_STEP,
+            transition_step_handler,
+            NULL,
+            &s_step_handler
+        );
+        if (err != ESP_OK) {
+            esp_event_handler_instance_unregister(DISPLAY_EVENT, RENDER_SCENE,
+                                                  s_display_event_handler);
+            s_display_event_handler = NULL;
+        }
+    }
+
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register event handler");
         s_driver->deinit();
+        esp_timer_delete(s_transition.timer);
+        s_transition.timer = NULL;
+        vSemaphoreDelete(s_mutex);
+        s_mutex = NULL;
         return err;
     }
 
@@ -73,16 +155,170 @@ void display_deinit(void)
         s_display_event_handler = NULL;
     }
 
+    if (s_step_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            DISPLAY_TRANSITION_EVENT,
+            DISPLAY_TRANSITION_STEP,
+            s_step_handler
+        );
+        s_step_handler = NULL;
+    }
+
+    if (s_transition.timer != NULL) {
+        esp_timer_stop(s_transition.timer);
+        esp_timer_delete(s_transition.timer);
+        s_transition.timer = NULL;
+    }
+    s_transition.active = false;
+    s_transition.step_pending = false;
+
     // Deinitialize driver
     if (s_driver && s_driver->deinit) {
         s_driver->deinit();
     }
 
+    if (s_mutex != NULL) {
+        vSemaphoreDelete(s_mutex);
+        s_mutex = NULL;
+    }
+
     s_initialized = false;
 
     ESP_LOGI(TAG, "Display deinitialized");
 }
 
+// ============================================================================
+// Private - Flushing
+// ============================================================================
+
+/**
+ * @brief Send a frame to the driver, s_mutex must be held
+ */
+static void flush_locked(const display_frame_t *frame)
+{
+    int64_t start = esp_timer_get_time();
+    s_driver->flush(frame);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    s_shown = *frame;
+    perf_boot_mark(PERF_BOOT_FIRST_PIXEL);
+
+    s_stats.frame_count++;
+    s_stats.last_render_us = elapsed;
+    if (elapsed > s_stats.max_render_us) {
+        s_stats.max_render_us = elapsed;
+    }
+}
+
+// ============================================================================
+// Public API - Frames
+// ============================================================================
+
+esp_err_t display_rasterize(const display_scene_t *scene, display_frame_t *frame)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (scene == NULL || frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return s_driver->rasterize(scene, frame);
+}
+
+esp_err_t display_present(const display_frame_t *frame)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_transition.active) {
+        // Let the running transition land on the updated content
+        s_transition.to = *frame;
+    } else {
+        perf_input_mark(PERF_INPUT_RENDER_STARTED);
+        flush_locked(frame);
+        perf_input_mark(PERF_INPUT_FLUSHED);
+    }
+    xSemaphoreGive(s_mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t display_present_transition(const display_frame_t *frame,
+                                     const display_transition_t *transition)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (transition == NULL || transition->type == DISPLAY_TRANSITION_NONE ||
+        transition->frame_ms == 0 || transition->duration_ms <= transition->frame_ms) {
+        return display_present(frame);
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    esp_timer_stop(s_transition.timer);
+
+    // Start from whatever is on the display, even mid-transition
+    s_transition.active = true;
+    s_transition.type = transition->type;
+    s_transition.from = s_shown;
+    s_transition.to = *frame;
+    s_transition.step = 1;
+    s_transition.steps = transition->duration_ms / transition->frame_ms;
+    s_transition.frame_us = (int64_t)transition->frame_ms * 1000;
+
+    // First step right away, it is what the input latency trace waits for
+    display_frame_t composed;
+    transition_compose(s_transition.type, &s_transition.from, &s_transition.to,
+                       s_transition.step, s_transition.steps, &composed);
+
+    perf_input_mark(PERF_INPUT_RENDER_STARTED);
+    flush_locked(&composed);
+    perf_input_mark(PERF_INPUT_FLUSHED);
+
+    s_transition.start_us = esp_timer_get_time();
+    s_transition.last_frame_us = s_transition.start_us;
+
+    esp_timer_start_periodic(s_transition.timer, (uint64_t)s_transition.frame_us);
+
+    xSemaphoreGive(s_mutex);
+
+    return ESP_OK;
+}
+
+// ============================================================================
+// Public API - Statistics
+// ============================================================================
+
+esp_err_t display_get_stats(display_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_mutex != NULL) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        *stats = s_stats;
+        xSemaphoreGive(s_mutex);
+    } else {
+        *stats = s_stats;
+    }
+    return ESP_OK;
+}
+
 // ============================================================================
 // Private - Event Handlers
 // ============================================================================
@@ -90,11 +326,72 @@ void display_deinit(void)
 static void display_event_handler(void* arg, esp_event_base_t base,
                                    int32_t event_id, void* event_data)
 {
-    if (event_id == RENDER_SCENE && s_driver && s_driver->render) {
+    if (event_id == RENDER_SCENE) {
         display_scene_t *scene = (display_scene_t *)event_data;
+        display_frame_t frame;
 
-        if (scene) {
-            s_driver->render(scene);
+        if (scene && display_rasterize(scene, &frame) == ESP_OK) {
+            display_present(&frame);
         }
     }
 }
+
+static void transition_timer_callback(void *arg)
+{
+    // Runs in the esp_timer task: hand over to the event loop. While a step
+    // is still queued the tick is dropped, the next step catches up
+    if (s_transition.step_pending) {
+        return;
+    }
+    s_transition.step_pending = true;
+    if (esp_event_post(DISPLAY_TRANSITION_EVENT, DISPLAY_TRANSITION_STEP, NULL, 0, 0) != ESP_OK) {
+        s_transition.step_pending = false;
+    }
+}
+
+static void transition_step_handler(void* arg, esp_event_base_t base,
+                                    int32_t event_id, void* event_data)
+{
+    s_transition.step_pending = false;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    if (!s_transition.active) {
+        xSemaphoreGive(s_mutex);
+        return;
+    }
+
+    // Skip the steps of dropped ticks so the duration holds
+    int64_t now = esp_timer_get_time();
+    uint32_t due = (uint32_t)((now - s_transition.start_us) / s_transition.frame_us) + 1;
+    s_transition.step = due > s_transition.step ? due : s_transition.step + 1;
+    if (s_transition.step > s_transition.steps) {
+        s_transition.step = s_transition.steps;
+    }
+
+    display_frame_t composed;
+    transition_compose(s_transition.type, &s_transition.from, &s_transition.to,
+                       s_transition.step, s_transition.steps, &composed);
+    flush_locked(&composed);
+
+    now = esp_timer_get_time();
+    uint32_t interval = (uint32_t)(now - s_transition.last_frame_us);
+    if (interval > s_stats.max_frame_interval_us) {
+        s_stats.max_frame_interval_us = interval;
+    }
+    s_transition.last_frame_us = now;
+
+    if (s_transition.step >= s_transition.steps) {
+        esp_timer_stop(s_transition.timer);
+        s_transition.active = false;
+
+        s_stats.transition_count++;
+        s_stats.last_transition_us = (uint32_t)(now - s_transition.start_us);
+        s_stats.last_transition_frames = s_transition.steps;
+
+        ESP_LOGD(TAG, "Transition done: %lu frames in %lu us",
+                 s_stats.last_transition_frames, s_stats.last_transition_us);
+    }
+
+    xSemaphoreGive(s_mutex);
+}
@@ -4,19 +4,65 @@
 #include "scene.h"
 
 
+#define DISPLAY_DEVICES 4   /**< Cascaded 8x8 modules (32 columns) */
+
+/**
+ * @brief Rasterized frame
+ *
+ * One word per 8x8 module: byte c of devices[d] is column d * 8 + c,
+ * bit r of that byte is row r.
+ */
+typedef struct {
+    uint64_t devices[DISPLAY_DEVICES];
+} display_frame_t;
+
+/**
+ * @brief Transition effects between frames
+ */
+typedef enum {
+    DISPLAY_TRANSITION_NONE = 0,  /**< Instant cut */
+    DISPLAY_TRANSITION_SLIDE,     /**< Outgoing frame slides out to the left */
+    DISPLAY_TRANSITION_WIPE,      /**< Incoming frame is revealed row by row */
+    DISPLAY_TRANSITION_DISSOLVE,  /**< Pixels switch over in ordered-dither order */
+} display_transition_type_t;
+
+/**
+ * @brief Transition parameters
+ */
+typedef struct {
+    display_transition_type_t type;
+    uint16_t duration_ms;   /**< Total duration */
+    uint16_t frame_ms;      /**< Time between composed frames */
+} display_transition_t;
+
 /**
  * @brief Display driver interface
  *
- * Drivers handle rendering display scenes.
- * They listen to RENDER_SCENE events.
+ * Drivers rasterize scenes into frames and flush frames to the hardware.
+ * rasterize() only touches the frame it is given and may be called from
+ * any task.
  */
 typedef struct {
     esp_err_t (*init)(void);
-    void (*render)(const display_scene_t *scene);
+    esp_err_t (*rasterize)(const display_scene_t *scene, display_frame_t *frame);
+    void (*flush)(const display_frame_t *frame);
     void (*deinit)(void);
     const char *name;
 } display_driver_t;
 
+/**
+ * @brief Display render statistics
+ */
+typedef struct {
+    uint32_t frame_count;            /**< Frames flushed since init (including transition steps) */
+    uint32_t last_render_us;         /**< Duration of the last flush */
+    uint32_t max_render_us;          /**< Longest flush since init */
+    uint32_t transition_count;       /**< Transitions completed since init */
+    uint32_t last_transition_us;     /**< First to last frame of the last transition */
+    uint32_t last_transition_frames; /**< Frames flushed by the last transition */
+    uint32_t max_frame_interval_us;  /**< Longest gap between transition frames since init */
+} display_stats_t;
+
 /**
  * @brief Initialize display
  *
@@ -32,3 +78,48 @@ esp_err_t display_init(void);
  */
 void display_deinit(void);
 
+/**
+ * @brief Rasterize a scene into a frame without displaying it
+ *
+ * Safe to call from any task, used to prepare frames ahead of time.
+ *
+ * @param scene Scene to rasterize
+ * @param frame Receives the pixels
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the scene has no content,
+ *         ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t display_rasterize(const display_scene_t *scene, display_frame_t *frame);
+
+/**
+ * @brief Show a rasterized frame
+ *
+ * If a transition is running, the frame becomes its new target instead,
+ * so periodic panel updates do not cut transitions short.
+ *
+ * @param frame Frame to show
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t display_present(const display_frame_t *frame);
+
+/**
+ * @brief Show a frame with a transition from the current contents
+ *
+ * The first step is flushed before returning, the remaining ones every
+ * frame_ms from the default event loop, paced by an esp_timer. Steps the
+ * loop is too busy for are skipped so the duration holds. A running
+ * transition is restarted from what is currently on the display.
+ *
+ * @param frame      Frame to show
+ * @param transition Effect, NULL or DISPLAY_TRANSITION_NONE for a cut
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t display_present_transition(const display_frame_t *frame,
+                                     const display_transition_t *transition);
+
+/**
+ * @brief Get render statistics
+ *
+ * @param stats Pointer to store statistics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t display_get_stats(display_stats_t *stats);
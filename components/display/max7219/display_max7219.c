@@ -23,7 +23,7 @@ static const char *TAG = "display_max7219";
 #define MAX7219_PIN_CS    10  // Chip Select
 
 #define SPI_HOST         SPI2_HOST
-#define MAX7219_CASCADE  4    // 4 cascaded MAX7219 devices (32 columns total)
+#define MAX7219_CASCADE  DISPLAY_DEVICES  // 4 cascaded MAX7219 devices (32 columns total)
 
 // ============================================================================
 // Private State
@@ -33,9 +33,6 @@ static max7219_t s_dev = {0};
 static bool s_initialized = false;
 static esp_event_handler_instance_t s_brightness_handler = NULL;
 
-// Display buffer for 4 cascaded devices (32 columns x 8 rows)
-static uint64_t s_display_buffer[MAX7219_CASCADE] = {0};
-
 // Forward declarations
 static void brightness_changed_handler(void* arg, esp_event_base_t base,
                                       int32_t event_id, void* event_data);
@@ -44,9 +41,9 @@ static void brightness_changed_handler(void* arg, esp_event_base_t base,
 // Private - Display Buffer Management
 // ============================================================================
 
-static void clear_display_buffer(void)
+static void clear_frame(display_frame_t *frame)
 {
-    memset(s_display_buffer, 0, sizeof(s_display_buffer));
+    memset(frame, 0, sizeof(*frame));
 }
 
 static uint64_t transpose_8x8(uint64_t input)
@@ -69,7 +66,7 @@ static uint64_t transpose_8x8(uint64_t input)
     return output;
 }
 
-static void set_column(int col, uint8_t data)
+static void set_column(display_frame_t *frame, int col, uint8_t data)
 {
     if (col < 0 || col >= 32) {
         return;
@@ -80,11 +77,11 @@ static void set_column(int col, uint8_t data)
     int device_col = col % 8;
 
     // Clear the column first
-    s_display_buffer[device] &= ~(0xFFULL << (device_col * 8));
+    frame->devices[device] &= ~(0xFFULL << (device_col * 8));
 
     // Set new data
     uint64_t column_data = (uint64_t)data << (device_col * 8);
-    s_display_buffer[device] |= column_data;
+    frame->devices[device] |= column_data;
 }
 
 static int get_text_width(const char *text, const font_t *font)
@@ -119,7 +116,8 @@ static int get_text_width(const char *text, const font_t *font)
     return width;
 }
 
-static void render_text_at(int x_offset, const char *text, const font_t *font)
+static void render_text_at(display_frame_t *frame, int x_offset, const char *text,
+                           const font_t *font)
 {
     int x = x_offset;
 
@@ -147,7 +145,7 @@ static void render_text_at(int x_offset, const char *text, const font_t *font)
                     break;  // Off screen
                 }
                 if (x + col >= 0) {
-                    set_column(x + col, char_desc->data[col]);
+                    set_column(frame, x + col, char_desc->data[col]);
                 }
             }
             x += char_desc->width;
@@ -157,7 +155,8 @@ static void render_text_at(int x_offset, const char *text, const font_t *font)
     }
 }
 
-static void render_bitmap_at(int x_offset, const uint8_t *bitmap, int width, int height)
+static void render_bitmap_at(display_frame_t *frame, int x_offset, const uint8_t *bitmap,
+                             int width, int height)
 {
     if (bitmap == NULL || width <= 0 || height <= 0) {
         return;
@@ -169,7 +168,7 @@ static void render_bitmap_at(int x_offset, const uint8_t *bitmap, int width, int
             break;  // Off screen
         }
         if (x_offset + col >= 0) {
-            set_column(x_offset + col, bitmap[col]);
+            set_column(frame, x_offset + col, bitmap[col]);
         }
     }
 }
@@ -178,25 +177,21 @@ static void render_bitmap_at(int x_offset, const uint8_t *bitmap, int width, int
 // Private - Scene Rendering Logic
 // ============================================================================
 
-static void render_text_centered(const char *text, const font_t *font)
+static void render_text_centered(display_frame_t *frame, const char *text, const font_t *font)
 {
-    clear_display_buffer();
+    clear_frame(frame);
 
     // Calculate width and center on display (32 columns)
     int text_width = get_text_width(text, font);
     int x_offset = (32 - text_width) / 2;
 
     // Render centered text
-    render_text_at(x_offset, text, font);
+    render_text_at(frame, x_offset, text, font);
 }
 
-static void render_scene(const display_scene_t *scene)
+static void render_scene(display_frame_t *frame, const display_scene_t *scene)
 {
-    if (scene == NULL) {
-        return;
-    }
-
-    clear_display_buffer();
+    clear_frame(frame);
 
     // Calculate total width of all elements
     int total_width = 0;
@@ -222,13 +217,13 @@ static void render_scene(const display_scene_t *scene)
         const scene_element_t *elem = &scene->elements[i];
 
         if (elem->type == SCENE_ELEMENT_TEXT) {
-            render_text_at(x_offset, elem->data.text.str, elem->data.text.font);
+            render_text_at(frame, x_offset, elem->data.text.str, elem->data.text.font);
             x_offset += get_text_width(elem->data.text.str, elem->data.text.font);
         } else if (elem->type == SCENE_ELEMENT_ANIMATION) {
             // Render first frame of animation
             if (elem->data.animation.frames != NULL && elem->data.animation.frame_count > 0) {
-                render_bitmap_at(x_offset, elem->data.animation.frames[0],
-                               elem->data.animation.width, elem->data.animation.height);
+                render_bitmap_at(frame, x_offset, elem->data.animation.frames[0],
+                                 elem->data.animation.width, elem->data.animation.height);
             }
             x_offset += elem->data.animation.width;
         }
@@ -323,20 +318,24 @@ static esp_err_t max7219_driver_init(void)
     return ESP_OK;
 }
 
-static void max7219_driver_render(const display_scene_t *scene)
+static esp_err_t max7219_driver_rasterize(const display_scene_t *scene, display_frame_t *frame)
 {
-    if (!s_initialized || scene == NULL) {
-        return;
-    }
-
-    // Render scene to buffer
     if (scene->element_count > 0 && scene->elements != NULL) {
         // Render full scene with elements
-        render_scene(scene);
+        render_scene(frame, scene);
     } else if (scene->fallback_text != NULL) {
         // Fallback to simple text rendering (use default font)
-        render_text_centered(scene->fallback_text, NULL);
+        render_text_centered(frame, scene->fallback_text, NULL);
     } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+static void max7219_driver_flush(const display_frame_t *frame)
+{
+    if (!s_initialized) {
         return;
     }
 
@@ -345,7 +344,7 @@ static void max7219_driver_render(const display_scene_t *scene)
     // Send in reverse order because SPI cascade: first data sent ends up in last module
     for (int i = 0; i < MAX7219_CASCADE; i++) {
         int buffer_index = MAX7219_CASCADE - 1 - i;
-        uint64_t transposed = transpose_8x8(s_display_buffer[buffer_index]);
+        uint64_t transposed = transpose_8x8(frame->devices[buffer_index]);
         esp_err_t ret = max7219_draw_image_8x8(&s_dev, i * 8, &transposed);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to update device %d: %s", i, esp_err_to_name(ret));
@@ -405,7 +404,8 @@ static void brightness_changed_handler(void* arg, esp_event_base_t base,
 
 const display_driver_t display_max7219_driver = {
     .init = max7219_driver_init,
-    .render = max7219_driver_render,
+    .rasterize = max7219_driver_rasterize,
+    .flush = max7219_driver_flush,
     .deinit = max7219_driver_deinit,
     .name = "max7219"
 };
@@ -0,0 +1,112 @@
+/**
+ * @file transition.c
+ * @brief Frame compositor for panel transitions
+ */
+
+#include "transition.h"
+
+#define FRAME_COLUMNS (DISPLAY_DEVICES * 8)
+
+// Every byte of a frame word is a column, so a row mask repeats per byte
+#define ROW_MASK(rows) ((rows) >= 8 ? ~0ULL : (((1ULL << (rows)) - 1) * 0x0101010101010101ULL))
+
+// 8x8 ordered dither thresholds, [row][column]
+static const uint8_t s_bayer[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+// s_dissolve_masks[n] has the n pixels with the lowest thresholds set
+static uint64_t s_dissolve_masks[65];
+
+// ============================================================================
+// Private
+// ============================================================================
+
+static void blend(const display_frame_t *from, const display_frame_t *to,
+                  uint64_t mask, display_frame_t *out)
+{
+    for (int i = 0; i < DISPLAY_DEVICES; i++) {
+        out->devices[i] = (to->devices[i] & mask) | (from->devices[i] & ~mask);
+    }
+}
+
+/**
+ * @brief Shift the concatenation of from and to left by whole columns
+ *
+ * Column c of the result is column c + columns of from, continuing into to.
+ */
+static void slide_left(const display_frame_t *from, const display_frame_t *to,
+                       uint32_t columns, display_frame_t *out)
+{
+    uint64_t words[DISPLAY_DEVICES * 2 + 1];
+
+    for (int i = 0; i < DISPLAY_DEVICES; i++) {
+        words[i] = from->devices[i];
+        words[DISPLAY_DEVICES + i] = to->devices[i];
+    }
+    words[DISPLAY_DEVICES * 2] = 0;
+
+    uint32_t shift = columns * 8;
+    uint32_t word = shift / 64;
+    uint32_t bits = shift % 64;
+
+    for (int i = 0; i < DISPLAY_DEVICES; i++) {
+        uint64_t lo = words[i + word];
+        uint64_t hi = words[i + word + 1];
+        out->devices[i] = bits ? (lo >> bits) | (hi << (64 - bits)) : lo;
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void transition_init(void)
+{
+    for (int n = 0; n <= 64; n++) {
+        uint64_t mask = 0;
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++) {
+                if (s_bayer[row][col] < n) {
+                    mask |= 1ULL << (col * 8 + row);
+                }
+            }
+        }
+        s_dissolve_masks[n] = mask;
+    }
+}
+
+void transition_compose(display_transition_type_t type,
+                        const display_frame_t *from, const display_frame_t *to,
+                        uint32_t step, uint32_t steps, display_frame_t *out)
+{
+    if (steps == 0 || step >= steps) {
+        *out = *to;
+        return;
+    }
+
+    switch (type) {
+        case DISPLAY_TRANSITION_SLIDE:
+            slide_left(from, to, FRAME_COLUMNS * step / steps, out);
+            break;
+
+        case DISPLAY_TRANSITION_WIPE:
+            blend(from, to, ROW_MASK(8 * step / steps), out);
+            break;
+
+        case DISPLAY_TRANSITION_DISSOLVE:
+            blend(from, to, s_dissolve_masks[64 * step / steps], out);
+            break;
+
+        default:
+            *out = *to;
+            break;
+    }
+}
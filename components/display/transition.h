@@ -0,0 +1,31 @@
+/**
+ * @file transition.h
+ * @brief Frame compositor for panel transitions
+ *
+ * Blends two frames with word-wide bit operations: each step is a few
+ * shifts or mask operations per 8x8 module. Pure C with no ESP-IDF
+ * dependencies so it can be checked on the host.
+ */
+
+#pragma once
+
+#include "display.h"
+
+/**
+ * @brief Build lookup tables, call once before transition_compose()
+ */
+void transition_init(void);
+
+/**
+ * @brief Compose one step of a transition
+ *
+ * @param type  Effect (DISPLAY_TRANSITION_NONE shows the target)
+ * @param from  Outgoing frame
+ * @param to    Incoming frame
+ * @param step  Current step, 0 shows from, steps shows to
+ * @param steps Total number of steps
+ * @param out   Receives the composed frame
+ */
+void transition_compose(display_transition_type_t type,
+                        const display_frame_t *from, const display_frame_t *to,
+                        uint32_t step, uint32_t steps, display_frame_t *out);
@@ -30,11 +30,15 @@ typedef enum {
 typedef enum {
     NTP_SYNCED,           /**< NTP sync completed */
     NETWORK_CONNECTING,   /**< Network connection in progress */
-    NETWORK_CONNECTED,    /**< Network connected successfully */
+    NETWORK_CONNECTED,    /**< Network connected successfully (timemachine_network_connected_t) */
     NETWORK_FAILED,       /**< Network connection failed */
     INPUT_TAP,            /**< Touch input detected (short tap < 200ms) */
-    INPUT_LONG_PRESS,     /**< Touch long press detected (≥ 200ms) */
-    INPUT_RELEASE,        /**< Touch released after long press */
+    INPUT_LONG_PRESS,     /**< Touch long press detected (≥ 200ms by default) */
+    INPUT_RELEASE,        /**< Touch released after long press or tap-hold */
+    INPUT_DOUBLE_TAP,     /**< Two taps within the multi-tap window */
+    INPUT_TRIPLE_TAP,     /**< Three taps within the multi-tap window */
+    INPUT_HOLD,           /**< Touch held for the hold duration (after INPUT_LONG_PRESS) */
+    INPUT_TAP_HOLD,       /**< Tap followed by a long press */
     PANEL_ACTIVATED,      /**< Panel was activated */
     PANEL_DEACTIVATED,    /**< Panel was deactivated */
     PANEL_SKIP_REQUESTED, /**< Panel requests to be skipped (no data available) */
@@ -44,6 +48,8 @@ typedef enum {
     LANGUAGE_CHANGED,        /**< Language setting changed */
     BRIGHTNESS_CHANGED,      /**< Display brightness changed */
     WEATHER_CONFIG_CHANGED,  /**< Weather configuration changed */
+    PLAYLIST_CHANGED,        /**< Panel playlist changed (timemachine_playlist_t) */
+    WEATHER_UPDATED,         /**< Weather fetched (timemachine_weather_cache_t) */
 } timemachine_event_id_t;
 
 /**
@@ -54,6 +60,69 @@ typedef struct {
     time_t timestamp;    /**< Time when sync completed */
 } timemachine_ntp_sync_t;
 
+/**
+ * @brief Last successful WiFi association and DHCP lease
+ *
+ * Lets the next connection skip the channel scan and, optionally, DHCP.
+ * Persisted as a blob, so the layout must stay stable.
+ */
+typedef struct {
+    char ssid[33];          /**< Network the entry belongs to */
+    uint8_t bssid[6];       /**< Access point */
+    uint8_t channel;        /**< Primary channel, 0 = entry unused */
+    uint32_t ip;            /**< Leased address (network byte order) */
+    uint32_t netmask;       /**< Network mask (network byte order) */
+    uint32_t gateway;       /**< Gateway (network byte order) */
+    uint32_t dns;           /**< Main DNS server (network byte order) */
+    int64_t obtained;       /**< Unix time the lease was obtained from DHCP, 0 if unknown */
+} timemachine_wifi_cache_t;
+
+/**
+ * @brief NETWORK_CONNECTED event data
+ */
+typedef struct {
+    timemachine_wifi_cache_t cache;  /**< Association and lease now in use */
+    uint32_t connect_ms;             /**< From the connect request to an IP address */
+    bool targeted;                   /**< Connected with the cached BSSID and channel */
+    bool lease_reused;               /**< Cached lease used instead of DHCP */
+} timemachine_network_connected_t;
+
+/**
+ * @brief Last fetched weather (WEATHER_UPDATED event data)
+ *
+ * Served at the next boot until a new fetch completes. Persisted as a
+ * blob, so the layout must stay stable.
+ */
+typedef struct {
+    char location[64];      /**< Location the entry belongs to */
+    float temperature;      /**< Temperature in Celsius */
+    uint8_t condition;      /**< weather_condition_t */
+    int64_t fetched;        /**< Unix time of the fetch, 0 = entry unused */
+} timemachine_weather_cache_t;
+
+/**
+ * @brief Input event data (INPUT_* events)
+ */
+typedef struct {
+    int64_t edge_us;     /**< esp_timer timestamp of the edge that completed the gesture */
+} timemachine_input_t;
+
+#define TIMEMACHINE_PLAYLIST_MAX 8
+
+/**
+ * @brief Panel playlist (PLAYLIST_CHANGED event data)
+ *
+ * Order in which taps and auto-rotation cycle through panels. Persisted
+ * as a blob, so the layout must stay stable.
+ */
+typedef struct {
+    uint8_t count;                  /**< Entries used, 0 = all panels in registration order */
+    struct {
+        uint8_t panel_id;           /**< panel_id_t */
+        uint16_t dwell_s;           /**< Seconds before advancing, 0 = stay until tapped */
+    } entries[TIMEMACHINE_PLAYLIST_MAX];
+} timemachine_playlist_t;
+
 /**
  * @brief Display event IDs
  */
@@ -0,0 +1,74 @@
+/**
+ * @file input_script.h
+ * @brief Scripted input injector
+ *
+ * Replaces touch_sensor with a task that posts INPUT_* events from a small
+ * text script (see script_parser.h for the syntax), so navigation scenarios
+ * can be replayed against panel_manager, brightness_control and the panels
+ * with repeatable timing. Taps are traced by perf like real touches.
+ *
+ * Example:
+ *
+ *     repeat 1000; tap; wait 5; end
+ *     long 2000             # brightness cycle
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Statistics of the last completed run
+ */
+typedef struct {
+    uint32_t runs;              /**< Completed runs since boot */
+    uint32_t events_posted;     /**< Events posted by the last run */
+    uint32_t events_failed;     /**< Events that could not be posted */
+    uint32_t duration_ms;       /**< Wall time of the last run */
+    uint32_t max_lateness_us;   /**< Worst delay of an event past its scheduled time */
+} input_script_stats_t;
+
+/**
+ * @brief Initialize the injector task
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t input_script_init(void);
+
+/**
+ * @brief Compile a script and start running it
+ *
+ * @param text Script source
+ * @return ESP_OK if started, ESP_ERR_INVALID_ARG on a syntax error,
+ *         ESP_ERR_INVALID_STATE if a script is already running or not initialized
+ */
+esp_err_t input_script_run(const char *text);
+
+/**
+ * @brief Abort the running script after the current step
+ */
+void input_script_stop(void);
+
+/**
+ * @brief Check whether a script is running
+ */
+bool input_script_is_running(void);
+
+/**
+ * @brief Get statistics of the last completed run
+ */
+input_script_stats_t input_script_get_stats(void);
+
+/**
+ * @brief Register the `inject` console command (requires CONFIG_TIMEMACHINE_CONSOLE)
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without console support
+ */
+esp_err_t input_script_register_console_commands(void);
+
+/**
+ * @brief Stop the injector task
+ */
+void input_script_deinit(void);
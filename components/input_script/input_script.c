@@ -0,0 +1,365 @@
+/**
+ * @file input_script.c
+ * @brief Scripted input injector
+ */
+
+#include "input_script.h"
+#include "script_parser.h"
+#include "timemachine_events.h"
+#include "perf.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
+
+static const char *TAG = "input_script";
+
+#define INPUT_SCRIPT_TASK_STACK    3072
+#define INPUT_SCRIPT_TASK_PRIORITY 10   // Same as the touch task it replaces
+
+static struct {
+    TaskHandle_t task;
+    esp_timer_handle_t wait_timer;  // Wakes the task at a step's deadline
+    script_t script;
+    volatile bool running;
+    volatile bool stop_requested;
+    input_script_stats_t stats;
+} s_state = {0};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const struct {
+    int32_t event_id;
+    const char *name;
+} s_op_events[] = {
+    [SCRIPT_OP_TAP]        = { INPUT_TAP,        "INPUT_TAP" },
+    [SCRIPT_OP_DOUBLE_TAP] = { INPUT_DOUBLE_TAP, "INPUT_DOUBLE_TAP" },
+    [SCRIPT_OP_TRIPLE_TAP] = { INPUT_TRIPLE_TAP, "INPUT_TRIPLE_TAP" },
+    [SCRIPT_OP_PRESS]      = { INPUT_LONG_PRESS, "INPUT_LONG_PRESS" },
+    [SCRIPT_OP_HOLD]       = { INPUT_HOLD,       "INPUT_HOLD" },
+    [SCRIPT_OP_RELEASE]    = { INPUT_RELEASE,    "INPUT_RELEASE" },
+};
+
+// ============================================================================
+// Private
+// ============================================================================
+
+static void wait_timer_callback(void *arg)
+{
+    xTaskNotifyGive(s_state.task);
+}
+
+/**
+ * @brief Sleep until an absolute esp_timer deadline
+ *
+ * A one-shot esp_timer wakes the task, so scheduled events are not quantized
+ * to the tick period and the CPU is free while waiting.
+ */
+static void wait_until(int64_t deadline_us)
+{
+    int64_t remaining_us = deadline_us - esp_timer_get_time();
+    if (remaining_us <= 0) {
+        return;
+    }
+
+    if (esp_timer_start_once(s_state.wait_timer, (uint64_t)remaining_us) == ESP_OK) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    } else {
+        // Rounded up to whole ticks
+        vTaskDelay(pdMS_TO_TICKS((remaining_us + 999) / 1000) + 1);
+    }
+}
+
+static void post_input(script_op_t op, int64_t scheduled_us, input_script_stats_t *stats)
+{
+    // The scheduled time stands in for the GPIO edge, so perf's `recognize`
+    // stage reports how late the injector was
+    timemachine_input_t input = {
+        .edge_us = scheduled_us
+    };
+
+    if (op == SCRIPT_OP_TAP) {
+        perf_input_begin(scheduled_us);
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint32_t lateness_us = now > scheduled_us ? (uint32_t)(now - scheduled_us) : 0;
+    if (lateness_us > stats->max_lateness_us) {
+        stats->max_lateness_us = lateness_us;
+    }
+
+    ESP_LOGD(TAG, "Inject: %s", s_op_events[op].name);
+
+    esp_err_t err = esp_event_post(
+        TIMEMACHINE_EVENT,
+        s_op_events[op].event_id,
+        &input,
+        sizeof(input),
+        portMAX_DELAY
+    );
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post %s event: %s", s_op_events[op].name, esp_err_to_name(err));
+        stats->events_failed++;
+        return;
+    }
+    stats->events_posted++;
+}
+
+/**
+ * @brief Index of the END matching the REPEAT at pc
+ */
+static size_t find_end(const script_t *script, size_t pc)
+{
+    for (size_t i = pc + 1; i < script->count; i++) {
+        if (script->steps[i].op == SCRIPT_OP_END && script->steps[i].arg == pc) {
+            return i;
+        }
+    }
+    return script->count;
+}
+
+static void execute(const script_t *script, input_script_stats_t *stats)
+{
+    uint32_t loops[SCRIPT_MAX_DEPTH];
+    size_t depth = 0;
+    size_t pc = 0;
+    int64_t start_us = esp_timer_get_time();
+    int64_t deadline_us = start_us;
+
+    while (pc < script->count && !s_state.stop_requested) {
+        const script_step_t *step = &script->steps[pc];
+
+        switch (step->op) {
+            case SCRIPT_OP_WAIT:
+                deadline_us += (int64_t)step->arg * 1000;
+                pc++;
+                break;
+
+            case SCRIPT_OP_REPEAT:
+                if (step->arg == 0) {
+                    pc = find_end(script, pc) + 1;
+                } else {
+                    loops[depth++] = step->arg;
+                    pc++;
+                }
+                break;
+
+            case SCRIPT_OP_END:
+                if (--loops[depth - 1] > 0) {
+                    pc = step->arg + 1;
+                } else {
+                    depth--;
+                    pc++;
+                }
+                break;
+
+            default:
+                wait_until(deadline_us);
+                post_input(step->op, deadline_us, stats);
+                pc++;
+                break;
+        }
+    }
+
+    // Trailing waits still count towards the run
+    if (!s_state.stop_requested) {
+        wait_until(deadline_us);
+    }
+
+    stats->duration_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+}
+
+static void input_script_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        input_script_stats_t stats = {0};
+        execute(&s_state.script, &stats);
+
+        portENTER_CRITICAL(&s_lock);
+        stats.runs = s_state.stats.runs + 1;
+        s_state.stats = stats;
+        s_state.running = false;
+        portEXIT_CRITICAL(&s_lock);
+
+        ESP_LOGI(TAG, "Script %s: %lu events (%lu failed) in %lu ms, max lateness %lu us",
+                 s_state.stop_requested ? "stopped" : "done",
+                 stats.events_posted, stats.events_failed,
+                 stats.duration_ms, stats.max_lateness_us);
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+esp_err_t input_script_init(void)
+{
+    if (s_state.task != NULL) {
+        ESP_LOGW(TAG, "Already initialized");
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = wait_timer_callback,
+        .name = "input_script"
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_state.wait_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create wait timer");
+        return err;
+    }
+
+    BaseType_t ret = xTaskCreate(input_script_task, "input_script",
+                                 INPUT_SCRIPT_TASK_STACK, NULL,
+                                 INPUT_SCRIPT_TASK_PRIORITY, &s_state.task);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        esp_timer_delete(s_state.wait_timer);
+        s_state.wait_timer = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Input script injector initialized (touch sensor disabled)");
+    return ESP_OK;
+}
+
+esp_err_t input_script_run(const char *text)
+{
+    if (s_state.task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    bool busy = s_state.running;
+    s_state.running = true;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (busy) {
+        ESP_LOGW(TAG, "A script is already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t error_line = 0;
+    if (!script_parse(text, &s_state.script, &error_line)) {
+        ESP_LOGE(TAG, "Syntax error in statement %u", (unsigned)error_line);
+        s_state.running = false;
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGI(TAG, "Running script (%u steps)", (unsigned)s_state.script.count);
+    s_state.stop_requested = false;
+    xTaskNotifyGive(s_state.task);
+    return ESP_OK;
+}
+
+void input_script_stop(void)
+{
+    if (s_state.running) {
+        s_state.stop_requested = true;
+    }
+}
+
+bool input_script_is_running(void)
+{
+    return s_state.running;
+}
+
+input_script_stats_t input_script_get_stats(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    input_script_stats_t stats = s_state.stats;
+    portEXIT_CRITICAL(&s_lock);
+    return stats;
+}
+
+void input_script_deinit(void)
+{
+    if (s_state.task == NULL) {
+        return;
+    }
+
+    // The timer must not notify a deleted task
+    esp_timer_stop(s_state.wait_timer);
+    esp_timer_delete(s_state.wait_timer);
+    s_state.wait_timer = NULL;
+
+    vTaskDelete(s_state.task);
+    s_state.task = NULL;
+    s_state.running = false;
+    s_state.stop_requested = false;
+
+    ESP_LOGI(TAG, "Input script injector deinitialized");
+}
+
+// ============================================================================
+// Console Commands
+// ============================================================================
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+
+static int cmd_inject(int argc, char **argv)
+{
+    if (argc == 1) {
+        input_script_stats_t stats = input_script_get_stats();
+        printf("%s, %lu runs; last: %lu events (%lu failed) in %lu ms, max lateness %lu us\n",
+               input_script_is_running() ? "running" : "idle",
+               stats.runs, stats.events_posted, stats.events_failed,
+               stats.duration_ms, stats.max_lateness_us);
+        return 0;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+        input_script_stop();
+        return 0;
+    }
+
+    // Arguments are joined so unquoted one-liners work too
+    char text[256];
+    size_t len = 0;
+    for (int i = 1; i < argc; i++) {
+        int written = snprintf(text + len, sizeof(text) - len, "%s%s",
+                               i > 1 ? " " : "", argv[i]);
+        if (written < 0 || (size_t)written >= sizeof(text) - len) {
+            printf("Script too long\n");
+            return 1;
+        }
+        len += written;
+    }
+
+    esp_err_t err = input_script_run(text);
+    if (err != ESP_OK) {
+        printf("Cannot run script: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+esp_err_t input_script_register_console_commands(void)
+{
+    const esp_console_cmd_t inject_cmd = {
+        .command = "inject",
+        .help = "Run an input script, e.g. inject \"repeat 100; tap; wait 20; end\" "
+                "('inject stop' to abort, no arguments for the last run's stats)",
+        .hint = "[<script> | stop]",
+        .func = cmd_inject,
+    };
+    return esp_console_cmd_register(&inject_cmd);
+}
+
+#else
+
+esp_err_t input_script_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
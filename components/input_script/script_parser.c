@@ -0,0 +1,187 @@
+/**
+ * @file script_parser.c
+ * @brief Parser for input scripts
+ */
+
+#include "script_parser.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TOKEN_LEN 16
+
+static const struct {
+    const char *name;
+    script_op_t op;
+} s_simple_ops[] = {
+    { "tap",     SCRIPT_OP_TAP },
+    { "double",  SCRIPT_OP_DOUBLE_TAP },
+    { "triple",  SCRIPT_OP_TRIPLE_TAP },
+    { "press",   SCRIPT_OP_PRESS },
+    { "hold",    SCRIPT_OP_HOLD },
+    { "release", SCRIPT_OP_RELEASE },
+};
+
+// ============================================================================
+// Private
+// ============================================================================
+
+static bool add_step(script_t *script, script_op_t op, uint32_t arg)
+{
+    if (script->count >= SCRIPT_MAX_STEPS) {
+        return false;
+    }
+
+    script->steps[script->count].op = op;
+    script->steps[script->count].arg = arg;
+    script->count++;
+    return true;
+}
+
+static const char *skip_blanks(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+static bool is_separator(char c)
+{
+    return c == '\0' || c == '\n' || c == ';' || c == '#';
+}
+
+static const char *read_token(const char *p, char *token)
+{
+    size_t len = 0;
+
+    while (!is_separator(*p) && !isspace((unsigned char)*p)) {
+        if (len < MAX_TOKEN_LEN - 1) {
+            token[len++] = (char)tolower((unsigned char)*p);
+        }
+        p++;
+    }
+    token[len] = '\0';
+    return p;
+}
+
+static bool parse_number(const char *token, uint32_t *value)
+{
+    // strtoul() accepts a sign and wraps negative numbers around
+    if (!isdigit((unsigned char)token[0])) {
+        return false;
+    }
+
+    char *end = NULL;
+    unsigned long parsed = strtoul(token, &end, 10);
+    if (*end != '\0' || parsed > UINT32_MAX) {
+        return false;
+    }
+
+    *value = (uint32_t)parsed;
+    return true;
+}
+
+/**
+ * @brief Compile one statement
+ */
+static bool parse_statement(const char *cmd, const char *arg, script_t *script,
+                            size_t *stack, size_t *depth)
+{
+    for (size_t i = 0; i < sizeof(s_simple_ops) / sizeof(s_simple_ops[0]); i++) {
+        if (strcmp(cmd, s_simple_ops[i].name) == 0) {
+            return arg[0] == '\0' && add_step(script, s_simple_ops[i].op, 0);
+        }
+    }
+
+    uint32_t value = 0;
+
+    if (strcmp(cmd, "wait") == 0) {
+        return parse_number(arg, &value) && add_step(script, SCRIPT_OP_WAIT, value);
+    }
+
+    if (strcmp(cmd, "long") == 0) {
+        return parse_number(arg, &value) &&
+               add_step(script, SCRIPT_OP_PRESS, 0) &&
+               add_step(script, SCRIPT_OP_WAIT, value) &&
+               add_step(script, SCRIPT_OP_RELEASE, 0);
+    }
+
+    if (strcmp(cmd, "repeat") == 0) {
+        if (!parse_number(arg, &value) || *depth >= SCRIPT_MAX_DEPTH) {
+            return false;
+        }
+        stack[(*depth)++] = script->count;
+        return add_step(script, SCRIPT_OP_REPEAT, value);
+    }
+
+    if (strcmp(cmd, "end") == 0) {
+        if (arg[0] != '\0' || *depth == 0) {
+            return false;
+        }
+        return add_step(script, SCRIPT_OP_END, (uint32_t)stack[--(*depth)]);
+    }
+
+    return false;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool script_parse(const char *text, script_t *script, size_t *error_line)
+{
+    size_t stack[SCRIPT_MAX_DEPTH];
+    size_t depth = 0;
+    size_t statement = 0;
+    const char *p = text;
+
+    script->count = 0;
+    *error_line = 0;
+
+    while (*p != '\0') {
+        char cmd[MAX_TOKEN_LEN];
+        char arg[MAX_TOKEN_LEN];
+
+        statement++;
+        p = skip_blanks(p);
+        p = read_token(p, cmd);
+        p = skip_blanks(p);
+        p = read_token(p, arg);
+        p = skip_blanks(p);
+
+        // Skip comments up to the end of the line
+        if (*p == '#') {
+            while (*p != '\0' && *p != '\n') {
+                p++;
+            }
+        }
+
+        if (!is_separator(*p)) {
+            // Trailing tokens
+            *error_line = statement;
+            return false;
+        }
+        if (*p != '\0') {
+            p++;
+        }
+
+        if (cmd[0] == '\0') {
+            // Empty statement
+            continue;
+        }
+
+        if (!parse_statement(cmd, arg, script, stack, &depth)) {
+            *error_line = statement;
+            return false;
+        }
+    }
+
+    if (depth != 0) {
+        // Unterminated repeat
+        *error_line = statement;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file script_parser.h
+ * @brief Parser for input scripts
+ *
+ * Pure C with no ESP-IDF dependencies so scripts can be validated on the host.
+ *
+ * Statements are separated by newlines or ';', '#' starts a comment:
+ *
+ *     tap                 INPUT_TAP
+ *     double / triple     INPUT_DOUBLE_TAP / INPUT_TRIPLE_TAP
+ *     press               INPUT_LONG_PRESS
+ *     hold                INPUT_HOLD
+ *     release             INPUT_RELEASE
+ *     long <ms>           press, wait <ms>, release
+ *     wait <ms>           delay relative to the previous deadline
+ *     repeat <n> ... end  repeat the enclosed statements n times
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCRIPT_MAX_STEPS 128
+#define SCRIPT_MAX_DEPTH 4
+
+/**
+ * @brief Script operations
+ */
+typedef enum {
+    SCRIPT_OP_TAP,
+    SCRIPT_OP_DOUBLE_TAP,
+    SCRIPT_OP_TRIPLE_TAP,
+    SCRIPT_OP_PRESS,
+    SCRIPT_OP_HOLD,
+    SCRIPT_OP_RELEASE,
+    SCRIPT_OP_WAIT,       /**< arg = milliseconds */
+    SCRIPT_OP_REPEAT,     /**< arg = iterations */
+    SCRIPT_OP_END,        /**< arg = index of the matching SCRIPT_OP_REPEAT */
+} script_op_t;
+
+/**
+ * @brief Compiled script step
+ */
+typedef struct {
+    script_op_t op;
+    uint32_t arg;
+} script_step_t;
+
+/**
+ * @brief Compiled script
+ */
+typedef struct {
+    script_step_t steps[SCRIPT_MAX_STEPS];
+    size_t count;
+} script_t;
+
+/**
+ * @brief Compile a script
+ *
+ * @param text       Script source
+ * @param script     Receives the compiled steps
+ * @param error_line Receives the 1-based statement number of the first error
+ * @return true on success
+ */
+bool script_parse(const char *text, script_t *script, size_t *error_line);
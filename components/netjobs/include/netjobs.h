@@ -0,0 +1,153 @@
+/**
+ * @file netjobs.h
+ * @brief Shared worker for periodic network jobs (NTP sync, weather fetch)
+ *
+ * One task runs every job that needs the network. Each job declares a
+ * period and a tolerance, how much earlier it may run. When a job is due,
+ * every other job due within its tolerance runs right after it in the same
+ * wake window, so the radio and the CPU wake once for all of them. The
+ * worker holds the network (network_acquire()) for the whole window; jobs
+ * that found no network run again as soon as it connects.
+ *
+ * Per-job run times and the number of merged runs are shown by the `jobs`
+ * console command.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NETJOBS_MAX_JOBS 4
+
+/**
+ * @brief Job function, runs on the worker task with the network connected
+ *
+ * @param arg The job's arg
+ * @return ESP_OK on success; on failure the job runs again after its retry time
+ */
+typedef esp_err_t (*netjobs_fn_t)(void *arg);
+
+/**
+ * @brief Job handle
+ */
+typedef struct netjobs_job *netjobs_handle_t;
+
+/**
+ * @brief Job description
+ */
+typedef struct {
+    const char *name;       /**< Shown in stats, must stay valid */
+    netjobs_fn_t fn;        /**< Job function */
+    void *arg;              /**< Passed to fn */
+    uint32_t period_s;      /**< Time from one run to the next, 0 = only when triggered */
+    uint32_t tolerance_s;   /**< May run this much early to share a wake window */
+    uint32_t retry_s;       /**< Time to the next run after a failure, 0 = period */
+    uint32_t first_run_s;   /**< Delay before the first run */
+} netjobs_config_t;
+
+/**
+ * @brief Per-job statistics
+ */
+typedef struct {
+    const char *name;           /**< Job name */
+    uint32_t run_count;         /**< Runs since added */
+    uint32_t fail_count;        /**< Runs that failed */
+    uint32_t merged_count;      /**< Runs in a window another job opened */
+    uint32_t no_network_count;  /**< Windows that found no network, job not run */
+    uint32_t last_runtime_ms;   /**< Duration of the last run */
+    uint32_t max_runtime_ms;    /**< Longest run */
+    uint64_t total_runtime_ms;  /**< Sum of all runs */
+    uint32_t period_s;          /**< Current period */
+    int32_t next_run_s;         /**< Seconds to the next run, -1 if only triggered */
+} netjobs_job_stats_t;
+
+/**
+ * @brief Worker statistics
+ */
+typedef struct {
+    uint32_t window_count;      /**< Wake windows (one network acquire each) */
+    uint32_t merged_count;      /**< Runs that shared another job's window */
+    uint32_t job_count;         /**< Jobs registered */
+} netjobs_stats_t;
+
+/**
+ * @brief Start the worker
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t netjobs_init(void);
+
+/**
+ * @brief Stop the worker and drop all jobs
+ */
+void netjobs_deinit(void);
+
+/**
+ * @brief Add a job
+ *
+ * @param config Job description (copied)
+ * @param job    Receives the job handle
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM if NETJOBS_MAX_JOBS are
+ *         added, ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t netjobs_add(const netjobs_config_t *config, netjobs_handle_t *job);
+
+/**
+ * @brief Remove a job, waits if it is running
+ *
+ * @param job Job handle
+ */
+void netjobs_remove(netjobs_handle_t job);
+
+/**
+ * @brief Change the period, tolerance and retry time of a job
+ *
+ * The next run is rescheduled from the start of the last one. Called from
+ * the job function, it applies to the run that follows.
+ *
+ * @param job         Job handle
+ * @param period_s    New period, 0 = only when triggered
+ * @param tolerance_s New tolerance
+ * @param retry_s     New retry time, 0 = period
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if job is NULL
+ */
+esp_err_t netjobs_set_schedule(netjobs_handle_t job, uint32_t period_s,
+                               uint32_t tolerance_s, uint32_t retry_s);
+
+/**
+ * @brief Run a job as soon as possible
+ *
+ * Triggered while it runs (or waits in the current window), the job runs
+ * once more right after the window.
+ *
+ * @param job Job handle
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if job is NULL
+ */
+esp_err_t netjobs_trigger(netjobs_handle_t job);
+
+/**
+ * @brief Get worker statistics
+ *
+ * @param stats Pointer to store statistics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t netjobs_get_stats(netjobs_stats_t *stats);
+
+/**
+ * @brief Get per-job statistics
+ *
+ * @param stats Array receiving one entry per job
+ * @param max   Entries in stats
+ * @return Number of entries filled
+ */
+size_t netjobs_get_job_stats(netjobs_job_stats_t *stats, size_t max);
+
+/**
+ * @brief Register the `jobs` console command
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CONFIG_TIMEMACHINE_CONSOLE
+ */
+esp_err_t netjobs_register_console_commands(void);
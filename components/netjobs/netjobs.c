@@ -0,0 +1,528 @@
+/**
+ * @file netjobs.c
+ * @brief Shared worker for periodic network jobs
+ */
+
+#include "netjobs.h"
+#include "network.h"
+#include "timemachine_events.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
+
+static const char *TAG = "netjobs";
+
+// HTTPS (weather) needs the large stack
+#define WORKER_STACK_SIZE 8192
+#define WORKER_PRIORITY   5
+
+// Wait for the network at the start of a wake window
+#define NETWORK_WAIT_MS   30000
+
+// Longest single sleep, the schedule is checked again after it
+#define MAX_SLEEP_US      (3600 * 1000000LL)
+
+// next_run_us of jobs that only run when triggered
+#define NEVER_US          INT64_MAX
+
+struct netjobs_job {
+    bool used;
+    bool running;             // In the current window
+    bool has_run;
+    bool last_ok;
+    bool missed_network;      // Last window found no network
+    bool trigger_pending;     // Triggered since it was put in a window
+    netjobs_config_t config;
+    int64_t next_run_us;
+    int64_t last_start_us;
+    netjobs_job_stats_t stats;
+};
+
+static bool s_initialized = false;
+static TaskHandle_t s_task_handle = NULL;
+static esp_event_handler_instance_t s_network_connected_handler = NULL;
+
+// Jobs are changed by their owners and run by the worker
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct netjobs_job s_jobs[NETJOBS_MAX_JOBS];
+static bool s_network_up = false;    // Connected since the last window
+static netjobs_stats_t s_stats = {0};
+
+// Forward declarations
+static void reschedule(struct netjobs_job *job);
+static int64_t time_to_window(int64_t now_us);
+static void run_window(void);
+static void worker_task(void *pvParameters);
+static void on_network_connected(void* arg, esp_event_base_t event_base,
+                                 int32_t event_id, void* event_data);
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+esp_err_t netjobs_init(void)
+{
+    if (s_initialized) {
+        ESP_LOGW(TAG, "Already initialized");
+        return ESP_OK;
+    }
+
+    memset(s_jobs, 0, sizeof(s_jobs));
+
+    esp_err_t err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        NETWORK_CONNECTED,
+        on_network_connected,
+        NULL,
+        &s_network_connected_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register NETWORK_CONNECTED handler");
+        return err;
+    }
+
+    BaseType_t ret = xTaskCreate(
+        worker_task,
+        "netjobs",
+        WORKER_STACK_SIZE,
+        NULL,
+        WORKER_PRIORITY,
+        &s_task_handle
+    );
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create worker task");
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            NETWORK_CONNECTED,
+            s_network_connected_handler
+        );
+        s_network_connected_handler = NULL;
+        return ESP_FAIL;
+    }
+
+    s_initialized = true;
+    ESP_LOGI(TAG, "Network job worker started");
+
+    return ESP_OK;
+}
+
+void netjobs_deinit(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    if (s_network_connected_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            NETWORK_CONNECTED,
+            s_network_connected_handler
+        );
+        s_network_connected_handler = NULL;
+    }
+
+    if (s_task_handle != NULL) {
+        vTaskDelete(s_task_handle);
+        s_task_handle = NULL;
+    }
+
+    memset(s_jobs, 0, sizeof(s_jobs));
+    s_initialized = false;
+}
+
+esp_err_t netjobs_add(const netjobs_config_t *config, netjobs_handle_t *job)
+{
+    if (config == NULL || config->fn == NULL || job == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    struct netjobs_job *slot = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < NETJOBS_MAX_JOBS; i++) {
+        if (!s_jobs[i].used) {
+            slot = &s_jobs[i];
+            memset(slot, 0, sizeof(*slot));
+            slot->used = true;
+            slot->config = *config;
+            slot->next_run_us = esp_timer_get_time() + (int64_t)config->first_run_s * 1000000;
+            slot->stats.name = config->name;
+            s_stats.job_count++;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (slot == NULL) {
+        ESP_LOGE(TAG, "No room for job %s", config->name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *job = slot;
+    ESP_LOGI(TAG, "Job %s added (period %lu s, tolerance %lu s, first run in %lu s)",
+             config->name, config->period_s, config->tolerance_s, config->first_run_s);
+    xTaskNotifyGive(s_task_handle);
+
+    return ESP_OK;
+}
+
+void netjobs_remove(netjobs_handle_t job)
+{
+    if (job == NULL) {
+        return;
+    }
+
+    while (1) {
+        portENTER_CRITICAL(&s_lock);
+        bool running = job->running;
+        if (!running) {
+            if (job->used) {
+                s_stats.job_count--;
+            }
+            job->used = false;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (!running) {
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+esp_err_t netjobs_set_schedule(netjobs_handle_t job, uint32_t period_s,
+                               uint32_t tolerance_s, uint32_t retry_s)
+{
+    if (job == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    job->config.period_s = period_s;
+    job->config.tolerance_s = tolerance_s;
+    job->config.retry_s = retry_s;
+    // A running job is rescheduled by the worker when it returns
+    if (job->has_run && !job->running) {
+        reschedule(job);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (s_task_handle != NULL) {
+        xTaskNotifyGive(s_task_handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t netjobs_trigger(netjobs_handle_t job)
+{
+    if (job == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // A job already in a window runs again after it, reschedule() keeps
+    // this for it
+    portENTER_CRITICAL(&s_lock);
+    job->next_run_us = 0;
+    job->trigger_pending = true;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (s_task_handle != NULL) {
+        xTaskNotifyGive(s_task_handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t netjobs_get_stats(netjobs_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+size_t netjobs_get_job_stats(netjobs_job_stats_t *stats, size_t max)
+{
+    size_t count = 0;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < NETJOBS_MAX_JOBS && count < max; i++) {
+        const struct netjobs_job *job = &s_jobs[i];
+        if (!job->used) {
+            continue;
+        }
+
+        stats[count] = job->stats;
+        stats[count].period_s = job->config.period_s;
+        if (job->next_run_us == NEVER_US) {
+            stats[count].next_run_s = -1;
+        } else if (job->next_run_us <= now_us) {
+            stats[count].next_run_s = 0;
+        } else {
+            stats[count].next_run_s = (int32_t)((job->next_run_us - now_us) / 1000000);
+        }
+        count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return count;
+}
+
+// ============================================================================
+// Private - Scheduling
+// ============================================================================
+
+/**
+ * @brief Set the next run from the last start, called with s_lock held
+ */
+static void reschedule(struct netjobs_job *job)
+{
+    if (job->trigger_pending) {
+        job->next_run_us = 0;
+        return;
+    }
+
+    uint32_t delay_s = job->config.period_s;
+    if (!job->last_ok && job->config.retry_s > 0) {
+        delay_s = job->config.retry_s;
+    }
+
+    job->next_run_us = (delay_s == 0) ? NEVER_US :
+                       job->last_start_us + (int64_t)delay_s * 1000000;
+}
+
+static bool due(const struct netjobs_job *job, int64_t now_us, bool network_up)
+{
+    return job->next_run_us <= now_us || (network_up && job->missed_network);
+}
+
+static bool due_soon(const struct netjobs_job *job, int64_t now_us)
+{
+    return job->next_run_us != NEVER_US &&
+           job->next_run_us - (int64_t)job->config.tolerance_s * 1000000 <= now_us;
+}
+
+/**
+ * @brief Time until a window should open, 0 = now
+ */
+static int64_t time_to_window(int64_t now_us)
+{
+    int64_t wait_us = MAX_SLEEP_US;
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < NETJOBS_MAX_JOBS; i++) {
+        const struct netjobs_job *job = &s_jobs[i];
+        if (!job->used) {
+            continue;
+        }
+
+        // Connected anyway: anything due soon can go now
+        if (due(job, now_us, s_network_up) || (s_network_up && due_soon(job, now_us))) {
+            wait_us = 0;
+            break;
+        }
+        if (job->next_run_us - now_us < wait_us) {
+            wait_us = job->next_run_us - now_us;
+        }
+    }
+    s_network_up = false;
+    portEXIT_CRITICAL(&s_lock);
+
+    return wait_us;
+}
+
+/**
+ * @brief Run every job that is due, and those due within their tolerance
+ */
+static void run_window(void)
+{
+    struct netjobs_job *batch[NETJOBS_MAX_JOBS];
+    bool opened[NETJOBS_MAX_JOBS];
+    size_t count = 0;
+    int64_t now_us = esp_timer_get_time();
+    bool network_up = network_is_connected();
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < NETJOBS_MAX_JOBS; i++) {
+        struct netjobs_job *job = &s_jobs[i];
+        if (!job->used) {
+            continue;
+        }
+
+        bool is_due = due(job, now_us, network_up);
+        if (!is_due && !due_soon(job, now_us)) {
+            continue;
+        }
+
+        // Ordered by next run, so the earliest goes first
+        size_t pos = count;
+        while (pos > 0 && batch[pos - 1]->next_run_us > job->next_run_us) {
+            batch[pos] = batch[pos - 1];
+            opened[pos] = opened[pos - 1];
+            pos--;
+        }
+        batch[pos] = job;
+        opened[pos] = is_due;
+        job->running = true;
+        job->trigger_pending = false;   // This run serves earlier triggers
+        count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (count == 0) {
+        return;
+    }
+
+    esp_err_t net_err = network_acquire(NETWORK_WAIT_MS);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.window_count++;
+    portEXIT_CRITICAL(&s_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        struct netjobs_job *job = batch[i];
+        int64_t start_us = esp_timer_get_time();
+
+        if (net_err != ESP_OK) {
+            // Runs when the network is back, or after the retry time
+            portENTER_CRITICAL(&s_lock);
+            job->stats.no_network_count++;
+            job->missed_network = true;
+            job->trigger_pending = false;   // Runs when the network is back
+            job->last_ok = false;
+            job->last_start_us = start_us;
+            job->has_run = true;
+            reschedule(job);
+            job->running = false;
+            portEXIT_CRITICAL(&s_lock);
+            continue;
+        }
+
+        esp_err_t err = job->config.fn(job->config.arg);
+        uint32_t runtime_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+        portENTER_CRITICAL(&s_lock);
+        job->stats.run_count++;
+        if (err != ESP_OK) {
+            job->stats.fail_count++;
+        }
+        if (!opened[i]) {
+            job->stats.merged_count++;
+            s_stats.merged_count++;
+        }
+        job->stats.last_runtime_ms = runtime_ms;
+        job->stats.total_runtime_ms += runtime_ms;
+        if (runtime_ms > job->stats.max_runtime_ms) {
+            job->stats.max_runtime_ms = runtime_ms;
+        }
+        job->missed_network = false;
+        job->last_ok = (err == ESP_OK);
+        job->last_start_us = start_us;
+        job->has_run = true;
+        reschedule(job);
+        job->running = false;
+        portEXIT_CRITICAL(&s_lock);
+
+        ESP_LOGI(TAG, "%s %s in %lu ms%s", job->config.name,
+                 err == ESP_OK ? "done" : "failed", runtime_ms,
+                 opened[i] ? "" : " (merged)");
+    }
+
+    if (net_err != ESP_OK) {
+        ESP_LOGW(TAG, "No network, %u jobs postponed", (unsigned)count);
+    }
+    network_release();
+}
+
+// ============================================================================
+// Private - Worker Task
+// ============================================================================
+
+static void worker_task(void *pvParameters)
+{
+    while (1) {
+        int64_t wait_us = time_to_window(esp_timer_get_time());
+        if (wait_us > 0) {
+            // Woken early by new jobs, triggers and the network coming up
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_us / 1000) + 1);
+            continue;
+        }
+
+        run_window();
+    }
+}
+
+static void on_network_connected(void* arg, esp_event_base_t event_base,
+                                 int32_t event_id, void* event_data)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_network_up = true;
+    portEXIT_CRITICAL(&s_lock);
+
+    xTaskNotifyGive(s_task_handle);
+}
+
+// ============================================================================
+// Console
+// ============================================================================
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+
+static int cmd_jobs(int argc, char **argv)
+{
+    netjobs_stats_t stats;
+    netjobs_job_stats_t jobs[NETJOBS_MAX_JOBS];
+
+    netjobs_get_stats(&stats);
+    size_t count = netjobs_get_job_stats(jobs, NETJOBS_MAX_JOBS);
+
+    printf("Wake windows: %lu, merged runs: %lu\n", stats.window_count, stats.merged_count);
+    printf("%-10s %6s %6s %7s %6s %8s %8s %8s %8s %8s\n",
+           "Job", "Runs", "Fails", "Merged", "NoNet", "Last ms", "Max ms", "Avg ms",
+           "Period", "Next s");
+    for (size_t i = 0; i < count; i++) {
+        const netjobs_job_stats_t *job = &jobs[i];
+        printf("%-10s %6lu %6lu %7lu %6lu %8lu %8lu %8llu %8lu %8ld\n",
+               job->name, job->run_count, job->fail_count, job->merged_count,
+               job->no_network_count, job->last_runtime_ms, job->max_runtime_ms,
+               job->run_count ? job->total_runtime_ms / job->run_count : 0,
+               job->period_s, (long)job->next_run_s);
+    }
+    return 0;
+}
+
+esp_err_t netjobs_register_console_commands(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "jobs",
+        .help = "Show network jobs, their run times and merged wakeups",
+        .hint = NULL,
+        .func = cmd_jobs,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+#else
+
+esp_err_t netjobs_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
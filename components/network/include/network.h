@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 #include "esp_err.h"
+#include "timemachine_events.h"
 
 
 /**
@@ -11,14 +12,70 @@ typedef struct {
     const char *wifi_ssid;        /**< WiFi SSID */
     const char *wifi_password;    /**< WiFi password */
     uint8_t wifi_authmode;        /**< WiFi authentication mode */
-    uint8_t max_retries;          /**< Maximum connection retry attempts */
+    uint8_t max_retries;          /**< Failed attempts before NETWORK_FAILED, retrying continues */
+    timemachine_wifi_cache_t cache; /**< Last association, ignored if channel is 0
+                                         or the SSID differs */
+    bool clock_trusted;           /**< Wall clock carried by the RTC or synced, so the
+                                       lease age can be told (NTP_SYNCED sets it later) */
 } network_config_t;
 
+/**
+ * @brief Connection state
+ */
+typedef enum {
+    NETWORK_STATE_IDLE,           /**< Not started */
+    NETWORK_STATE_CONNECTING,     /**< Associating or waiting for an address */
+    NETWORK_STATE_CONNECTED,      /**< Got an IP address */
+    NETWORK_STATE_BACKOFF,        /**< Waiting before the next attempt */
+    NETWORK_STATE_OFF,            /**< Radio off until network_acquire() (duty cycling) */
+} network_state_t;
+
+/**
+ * @brief Connection statistics
+ */
+typedef struct {
+    uint32_t connect_count;       /**< Connections that got an IP (boot and reconnects) */
+    uint32_t targeted_count;      /**< ...made with the cached BSSID and channel */
+    uint32_t fallback_count;      /**< Cached AP did not answer, scanned instead */
+    uint32_t lease_reuse_count;   /**< ...that reused the cached lease instead of DHCP */
+    uint32_t last_assoc_ms;       /**< Connect request to association, last connection */
+    uint32_t last_connect_ms;     /**< Connect request to IP address, last connection */
+    uint32_t best_connect_ms;     /**< Fastest connect request to IP address */
+    uint32_t worst_connect_ms;    /**< Slowest connect request to IP address */
+    network_state_t state;        /**< Current state */
+    uint32_t attempt_count;       /**< Connect requests sent, including retries */
+    uint32_t disconnect_count;    /**< Connections lost */
+    uint32_t failed_attempts;     /**< Failed attempts since the last connection */
+    uint32_t next_retry_ms;       /**< Backoff of the pending retry, 0 if none */
+    uint32_t radio_off_count;     /**< Backoffs spent with the radio stopped */
+    uint64_t disconnected_ms;     /**< Total time without a connection, current outage included */
+    uint8_t last_reason;          /**< Last wifi_err_reason_t, 0 if none */
+    uint32_t wake_count;          /**< Radio started by network_acquire() (duty cycling) */
+    uint64_t connected_ms;        /**< Total time connected, current connection included */
+    uint8_t users;                /**< Holders of network_acquire() */
+} network_stats_t;
+
 /**
  * @brief Initialize network component and start WiFi connection
  *
  * This function starts the WiFi connection process asynchronously.
- * It will emit NETWORK_EVENT_CONNECTED or NETWORK_EVENT_FAILED when done.
+ * It emits NETWORK_CONNECTING when a connection (or reconnection) starts and
+ * NETWORK_CONNECTED when it has an address. Failed attempts are retried
+ * forever with jittered exponential backoff between
+ * CONFIG_TIMEMACHINE_WIFI_BACKOFF_MIN_MS and CONFIG_TIMEMACHINE_WIFI_BACKOFF_MAX_S;
+ * long waits stop the radio. NETWORK_FAILED is emitted once per outage,
+ * after max_retries failed attempts. With CONFIG_TIMEMACHINE_WIFI_DUTY_CYCLE
+ * the radio is off between network_acquire() calls after the boot connection.
+ *
+ * With a cached association the first attempt goes straight to the cached
+ * BSSID on its channel, without scanning; reconnects after a drop do the
+ * same with the last AP. If that fails the AP is searched on all channels.
+ * With CONFIG_TIMEMACHINE_WIFI_LEASE_REUSE_S the cached address is used
+ * without DHCP while the lease is recent enough, and DHCP takes over once
+ * that time is up. A clock restored from flash lags by the time powered
+ * off, so the lease is only reused once it is trusted (config->clock_trusted
+ * or NTP_SYNCED). NETWORK_CONNECTED carries the association and lease to
+ * cache for the next boot.
  *
  * @param config Network configuration
  * @return ESP_OK on success, error code otherwise
@@ -37,3 +94,41 @@ void network_deinit(void);
  */
 bool network_is_connected(void);
 
+/**
+ * @brief Ask for the network and wait until it is connected
+ *
+ * Every call must be paired with network_release(), whatever it returns.
+ * With CONFIG_TIMEMACHINE_WIFI_DUTY_CYCLE the radio is started if it is
+ * off, without NETWORK_CONNECTING (a background wake); otherwise this only
+ * waits for the connection.
+ *
+ * @param timeout_ms Longest wait for the connection
+ * @return ESP_OK when connected, ESP_ERR_TIMEOUT if not connected in time,
+ *         ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t network_acquire(uint32_t timeout_ms);
+
+/**
+ * @brief Done with the network
+ *
+ * With CONFIG_TIMEMACHINE_WIFI_DUTY_CYCLE the radio is stopped once no one
+ * holds the network for CONFIG_TIMEMACHINE_WIFI_LINGER_S, so jobs that
+ * follow each other closely share one connection.
+ */
+void network_release(void);
+
+/**
+ * @brief Get connection statistics
+ *
+ * @param stats Pointer to store statistics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t network_get_stats(network_stats_t *stats);
+
+/**
+ * @brief Register the `net` console command
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CONFIG_TIMEMACHINE_CONSOLE
+ */
+esp_err_t network_register_console_commands(void);
+
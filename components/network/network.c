@@ -1,29 +1,95 @@
 #include "network.h"
 #include "timemachine_events.h"
+#include "perf.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_mac.h"
 #include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
 
 static const char *TAG = "network";
 
 #define NETWORK_CONNECTED_BIT BIT0
 #define NETWORK_FAIL_BIT      BIT1
 
+// Backoffs at least this long stop the radio until the retry
+#define RADIO_OFF_MIN_MS      30000
+
+// Time for the old connection to go down after a configuration change
+#define RECONFIGURE_DELAY_MS  100
+
+// Wall clock times before this (Jan 1, 2020) mean the time is not set, as
+// NTP_SYNC_MIN_VALID_EPOCH (ntp_sync depends on this component)
+#define MIN_VALID_EPOCH       1577836800
+
 static EventGroupHandle_t s_network_event_group = NULL;
 static network_config_t s_config = {0};
-static int s_retry_num = 0;
 static bool s_initialized = false;
-static bool s_connected = false;
 static esp_event_handler_instance_t s_config_changed_handler = NULL;
+static esp_event_handler_instance_t s_ntp_synced_handler = NULL;
+static esp_netif_t *s_netif = NULL;
+
+// Association and lease to try first, updated on every connection
+static timemachine_wifi_cache_t s_cache = {0};
+static bool s_targeted = false;         // Current attempt uses the cached BSSID/channel
+static bool s_lease_reused = false;     // DHCP stopped, cached address in use
+static bool s_clock_trusted = false;    // Wall clock tells the lease age
+static esp_timer_handle_t s_lease_timer = NULL;
+
+// Reconnect state machine
+static network_state_t s_state = NETWORK_STATE_IDLE;
+static uint32_t s_failed_attempts = 0;  // Since the last connection
+static bool s_failed_reported = false;  // NETWORK_FAILED posted for this outage
+static bool s_radio_off = false;        // WiFi stopped (long backoff or duty cycling)
+static esp_timer_handle_t s_retry_timer = NULL;
+static int64_t s_disconnected_since_us = 0;
+static int64_t s_connected_since_us = 0;
+
+// Duty cycling: holders of network_acquire(), radio stopped after they leave
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_users = 0;
+static esp_timer_handle_t s_linger_timer = NULL;
+// Held across a wake (state change + esp_wifi_start) and a linger stop
+// (state change + esp_wifi_stop), so one never runs inside the other
+static SemaphoreHandle_t s_radio_mutex = NULL;
+
+// Connect-time measurement
+static int64_t s_connect_start_us = 0;
+static int64_t s_assoc_us = 0;
+static network_stats_t s_stats = {0};
 
 // Forward declarations
+static bool cache_usable(void);
+static void start_connect(bool targeted);
+static void reuse_lease(void);
+static void stop_lease_reuse(void);
+static void lease_timer_callback(void *arg);
+static void begin_attempt(void);
+static uint32_t backoff_delay_ms(uint32_t failed_attempts);
+static void schedule_retry(void);
+static void retry_timer_callback(void *arg);
+static void leave_connected(void);
+static void start_linger(void);
+static void linger_timer_callback(void *arg);
+static void on_got_ip(const ip_event_got_ip_t *event);
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data);
 static void on_network_config_changed(void* arg, esp_event_base_t event_base,
                                        int32_t event_id, void* event_data);
+static void on_ntp_synced(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data);
 
 // ============================================================================
 // Public API
@@ -45,6 +111,8 @@ esp_err_t network_init(const network_config_t *config)
 
     // Copy configuration
     s_config = *config;
+    s_cache = config->cache;
+    s_clock_trusted = config->clock_trusted;
 
     // Create event group
     s_network_event_group = xEventGroupCreate();
@@ -53,16 +121,42 @@ esp_err_t network_init(const network_config_t *config)
         return ESP_ERR_NO_MEM;
     }
 
+    s_radio_mutex = xSemaphoreCreateMutex();
+    if (s_radio_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create radio mutex");
+        vEventGroupDelete(s_network_event_group);
+        s_network_event_group = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
     // Initialize network interface
     ESP_ERROR_CHECK(esp_netif_init());
 
     // Create default WiFi station interface
-    esp_netif_create_default_wifi_sta();
+    s_netif = esp_netif_create_default_wifi_sta();
 
     // Initialize WiFi
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = lease_timer_callback,
+        .name = "lease_reuse"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_lease_timer));
+
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = retry_timer_callback,
+        .name = "wifi_retry"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &s_retry_timer));
+
+    const esp_timer_create_args_t linger_timer_args = {
+        .callback = linger_timer_callback,
+        .name = "wifi_linger"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&linger_timer_args, &s_linger_timer));
+
     // Register event handlers
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         WIFI_EVENT,
@@ -88,21 +182,29 @@ esp_err_t network_init(const network_config_t *config)
         &s_config_changed_handler
     ));
 
-    // Configure WiFi station
-    wifi_config_t wifi_config = {
-        .sta = {
-            .threshold.authmode = s_config.wifi_authmode,
-        },
-    };
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        NTP_SYNCED,
+        &on_ntp_synced,
+        NULL,
+        &s_ntp_synced_handler
+    ));
 
-    // Copy SSID and password
-    strncpy((char *)wifi_config.sta.ssid, s_config.wifi_ssid, sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char *)wifi_config.sta.password, s_config.wifi_password, sizeof(wifi_config.sta.password) - 1);
+    if (cache_usable()) {
+        ESP_LOGI(TAG, "Cached AP " MACSTR " on channel %d",
+                 MAC2STR(s_cache.bssid), s_cache.channel);
+        reuse_lease();
+    }
 
+    s_disconnected_since_us = esp_timer_get_time();
+
+    // The station is configured when connecting (WIFI_EVENT_STA_START)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
+    // Modem sleep between beacons while associated
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
     ESP_LOGI(TAG, "WiFi initialization finished, connecting to %s...", s_config.wifi_ssid);
 
     s_initialized = true;
@@ -129,6 +231,33 @@ void network_deinit(void)
         s_config_changed_handler = NULL;
     }
 
+    if (s_ntp_synced_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            NTP_SYNCED,
+            s_ntp_synced_handler
+        );
+        s_ntp_synced_handler = NULL;
+    }
+
+    if (s_lease_timer != NULL) {
+        esp_timer_stop(s_lease_timer);
+        esp_timer_delete(s_lease_timer);
+        s_lease_timer = NULL;
+    }
+
+    if (s_retry_timer != NULL) {
+        esp_timer_stop(s_retry_timer);
+        esp_timer_delete(s_retry_timer);
+        s_retry_timer = NULL;
+    }
+
+    if (s_linger_timer != NULL) {
+        esp_timer_stop(s_linger_timer);
+        esp_timer_delete(s_linger_timer);
+        s_linger_timer = NULL;
+    }
+
     // Stop WiFi
     esp_wifi_stop();
     esp_wifi_deinit();
@@ -139,15 +268,365 @@ void network_deinit(void)
         s_network_event_group = NULL;
     }
 
+    if (s_radio_mutex != NULL) {
+        vSemaphoreDelete(s_radio_mutex);
+        s_radio_mutex = NULL;
+    }
+
     s_initialized = false;
-    s_connected = false;
+    s_state = NETWORK_STATE_IDLE;
+    s_radio_off = false;
 
     ESP_LOGI(TAG, "Network deinitialized");
 }
 
 bool network_is_connected(void)
 {
-    return s_connected;
+    return s_state == NETWORK_STATE_CONNECTED;
+}
+
+esp_err_t network_acquire(uint32_t timeout_ms)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // A linger stop in progress finishes first, its radio is then seen off
+    xSemaphoreTake(s_radio_mutex, portMAX_DELAY);
+
+    bool wake = false;
+    portENTER_CRITICAL(&s_lock);
+    s_users++;
+    if (s_state == NETWORK_STATE_OFF) {
+        // Connecting without NETWORK_CONNECTING, nothing to show for it
+        s_state = NETWORK_STATE_CONNECTING;
+        s_radio_off = false;
+        wake = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    esp_timer_stop(s_linger_timer);
+
+    if (wake) {
+        ESP_LOGI(TAG, "Waking WiFi");
+        s_stats.wake_count++;
+        s_disconnected_since_us = esp_timer_get_time();
+        esp_wifi_start();
+    }
+
+    xSemaphoreGive(s_radio_mutex);
+
+    EventBits_t bits = xEventGroupWaitBits(s_network_event_group, NETWORK_CONNECTED_BIT,
+                                           pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & NETWORK_CONNECTED_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void network_release(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool idle = (s_users > 0 && --s_users == 0);
+    portEXIT_CRITICAL(&s_lock);
+
+    if (idle) {
+        start_linger();
+    }
+}
+
+esp_err_t network_get_stats(network_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = s_stats;
+    stats->state = s_state;
+    stats->failed_attempts = s_failed_attempts;
+    stats->users = s_users;
+
+    int64_t now_us = esp_timer_get_time();
+    if (s_state == NETWORK_STATE_CONNECTED) {
+        stats->connected_ms += (now_us - s_connected_since_us) / 1000;
+    } else if (s_state == NETWORK_STATE_CONNECTING || s_state == NETWORK_STATE_BACKOFF) {
+        stats->disconnected_ms += (now_us - s_disconnected_since_us) / 1000;
+    }
+    return ESP_OK;
+}
+
+// ============================================================================
+// Private - Connection
+// ============================================================================
+
+static bool cache_usable(void)
+{
+    return s_cache.channel != 0 && strcmp(s_cache.ssid, s_config.wifi_ssid) == 0;
+}
+
+/**
+ * @brief Configure the station and connect
+ *
+ * @param targeted Connect to the cached BSSID on its channel instead of scanning
+ */
+static void start_connect(bool targeted)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .threshold.authmode = s_config.wifi_authmode,
+        },
+    };
+
+    // Copy SSID and password
+    strncpy((char *)wifi_config.sta.ssid, s_config.wifi_ssid, sizeof(wifi_config.sta.ssid) - 1);
+    strncpy((char *)wifi_config.sta.password, s_config.wifi_password, sizeof(wifi_config.sta.password) - 1);
+
+    if (targeted) {
+        // Probes only the cached channel, no scan of the others
+        wifi_config.sta.channel = s_cache.channel;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_cache.bssid, sizeof(wifi_config.sta.bssid));
+    }
+
+    s_targeted = targeted;
+    s_stats.attempt_count++;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_connect();
+}
+
+/**
+ * @brief Skip DHCP with the cached lease while it is recent enough
+ */
+static void reuse_lease(void)
+{
+#if CONFIG_TIMEMACHINE_WIFI_LEASE_REUSE_S > 0
+    int64_t now = time(NULL);
+    int64_t age_s = now - s_cache.obtained;
+
+    if (s_cache.ip == 0 || s_cache.obtained == 0) {
+        return;
+    }
+
+    // The last synced time restored from flash lags by the time powered off,
+    // an expired lease would look recent and its address may be taken
+    if (!s_clock_trusted) {
+        ESP_LOGI(TAG, "Clock not synced, lease age unknown, using DHCP");
+        return;
+    }
+
+    if (now < MIN_VALID_EPOCH || age_s < 0 || age_s >= CONFIG_TIMEMACHINE_WIFI_LEASE_REUSE_S) {
+        return;
+    }
+
+    if (esp_netif_dhcpc_stop(s_netif) != ESP_OK) {
+        return;
+    }
+
+    s_lease_reused = true;
+    esp_timer_start_once(s_lease_timer,
+                         (CONFIG_TIMEMACHINE_WIFI_LEASE_REUSE_S - age_s) * 1000000LL);
+    ESP_LOGI(TAG, "Reusing lease " IPSTR " (%lld s old)",
+             IP2STR((esp_ip4_addr_t *)&s_cache.ip), age_s);
+#endif
+}
+
+static void stop_lease_reuse(void)
+{
+    if (!s_lease_reused) {
+        return;
+    }
+
+    s_lease_reused = false;
+    esp_timer_stop(s_lease_timer);
+    esp_netif_dhcpc_start(s_netif);
+}
+
+static void lease_timer_callback(void *arg)
+{
+    ESP_LOGI(TAG, "Cached lease too old, renewing with DHCP");
+    stop_lease_reuse();
+}
+
+/**
+ * @brief Start a connection attempt, to the cached AP if there is one
+ */
+static void begin_attempt(void)
+{
+    s_state = NETWORK_STATE_CONNECTING;
+    s_connect_start_us = esp_timer_get_time();
+    start_connect(cache_usable());
+}
+
+/**
+ * @brief Delay before the next attempt
+ *
+ * Doubles from CONFIG_TIMEMACHINE_WIFI_BACKOFF_MIN_MS with every failed
+ * attempt up to CONFIG_TIMEMACHINE_WIFI_BACKOFF_MAX_S. Half of it is random,
+ * so clocks that lost the same AP do not all retry at once.
+ */
+static uint32_t backoff_delay_ms(uint32_t failed_attempts)
+{
+    const uint32_t max_ms = CONFIG_TIMEMACHINE_WIFI_BACKOFF_MAX_S * 1000;
+    uint32_t delay_ms = CONFIG_TIMEMACHINE_WIFI_BACKOFF_MIN_MS;
+
+    for (uint32_t i = 1; i < failed_attempts && delay_ms < max_ms; i++) {
+        delay_ms *= 2;
+    }
+    if (delay_ms > max_ms) {
+        delay_ms = max_ms;
+    }
+
+    return delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+}
+
+static void schedule_retry(void)
+{
+    uint32_t delay_ms = backoff_delay_ms(s_failed_attempts);
+
+    s_state = NETWORK_STATE_BACKOFF;
+    s_stats.next_retry_ms = delay_ms;
+
+    if (delay_ms >= RADIO_OFF_MIN_MS) {
+        // Nothing to listen for until the retry, WIFI_EVENT_STA_START reconnects
+        s_radio_off = true;
+        s_stats.radio_off_count++;
+        esp_wifi_stop();
+    }
+
+    ESP_LOGI(TAG, "Attempt %lu failed (reason %d), retrying in %lu ms%s",
+             s_failed_attempts, s_stats.last_reason, delay_ms,
+             s_radio_off ? " with the radio off" : "");
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void retry_timer_callback(void *arg)
+{
+    s_stats.next_retry_ms = 0;
+
+    if (s_radio_off) {
+        s_radio_off = false;
+        s_state = NETWORK_STATE_CONNECTING;
+        esp_wifi_start();
+    } else {
+        begin_attempt();
+    }
+}
+
+static void leave_connected(void)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    s_stats.connected_ms += (now_us - s_connected_since_us) / 1000;
+    s_disconnected_since_us = now_us;
+    xEventGroupClearBits(s_network_event_group, NETWORK_CONNECTED_BIT);
+}
+
+/**
+ * @brief Stop the radio after CONFIG_TIMEMACHINE_WIFI_LINGER_S unless acquired again
+ */
+static void start_linger(void)
+{
+#if CONFIG_TIMEMACHINE_WIFI_DUTY_CYCLE
+    esp_timer_stop(s_linger_timer);
+    esp_timer_start_once(s_linger_timer, CONFIG_TIMEMACHINE_WIFI_LINGER_S * 1000000LL);
+#endif
+}
+
+static void linger_timer_callback(void *arg)
+{
+    // The decision and the stop are one step for network_acquire(): a wake
+    // in between would start a radio this then stops, leaving the state
+    // CONNECTING with the radio off for good
+    xSemaphoreTake(s_radio_mutex, portMAX_DELAY);
+
+    portENTER_CRITICAL(&s_lock);
+    network_state_t was = s_state;
+    bool idle = (s_users == 0 && was != NETWORK_STATE_OFF);
+    bool stop = false;
+    if (idle) {
+        s_state = NETWORK_STATE_OFF;
+        stop = !s_radio_off;
+        s_radio_off = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!idle) {
+        xSemaphoreGive(s_radio_mutex);
+        return;
+    }
+
+    esp_timer_stop(s_retry_timer);
+    s_stats.next_retry_ms = 0;
+    if (was == NETWORK_STATE_CONNECTED) {
+        leave_connected();
+    } else {
+        // Gave up on this outage, the next acquire starts afresh
+        s_stats.disconnected_ms += (esp_timer_get_time() - s_disconnected_since_us) / 1000;
+        s_failed_attempts = 0;
+        s_failed_reported = false;
+    }
+
+    if (stop) {
+        esp_wifi_stop();
+    }
+    xSemaphoreGive(s_radio_mutex);
+    ESP_LOGI(TAG, "No network jobs, WiFi off");
+}
+
+static void on_got_ip(const ip_event_got_ip_t *event)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint32_t connect_ms = (uint32_t)((now_us - s_connect_start_us) / 1000);
+
+    s_stats.disconnected_ms += (now_us - s_disconnected_since_us) / 1000;
+    s_connected_since_us = now_us;
+
+    s_stats.connect_count++;
+    if (s_targeted) {
+        s_stats.targeted_count++;
+    }
+    if (s_lease_reused) {
+        s_stats.lease_reuse_count++;
+    }
+    s_stats.last_connect_ms = connect_ms;
+    s_stats.last_assoc_ms = (uint32_t)((s_assoc_us - s_connect_start_us) / 1000);
+    if (s_stats.best_connect_ms == 0 || connect_ms < s_stats.best_connect_ms) {
+        s_stats.best_connect_ms = connect_ms;
+    }
+    if (connect_ms > s_stats.worst_connect_ms) {
+        s_stats.worst_connect_ms = connect_ms;
+    }
+
+    ESP_LOGI(TAG, "Connected in %lu ms (associated at %lu ms, %s, %s)",
+             connect_ms, s_stats.last_assoc_ms,
+             s_targeted ? "cached AP" : "scanned",
+             s_lease_reused ? "cached lease" : "DHCP");
+
+    // Remember this association and lease for reconnects and the next boot
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        strlcpy(s_cache.ssid, s_config.wifi_ssid, sizeof(s_cache.ssid));
+        memcpy(s_cache.bssid, ap.bssid, sizeof(s_cache.bssid));
+        s_cache.channel = ap.primary;
+    }
+    if (!s_lease_reused) {
+        esp_netif_dns_info_t dns = {0};
+        esp_netif_get_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+
+        time_t now = time(NULL);
+        s_cache.ip = event->ip_info.ip.addr;
+        s_cache.netmask = event->ip_info.netmask.addr;
+        s_cache.gateway = event->ip_info.gw.addr;
+        s_cache.dns = dns.ip.u_addr.ip4.addr;
+        s_cache.obtained = (now >= MIN_VALID_EPOCH) ? now : 0;
+    }
+
+    timemachine_network_connected_t connected = {
+        .cache = s_cache,
+        .connect_ms = connect_ms,
+        .targeted = s_targeted,
+        .lease_reused = s_lease_reused
+    };
+
+    // Emit success event
+    esp_event_post(TIMEMACHINE_EVENT, NETWORK_CONNECTED, &connected, sizeof(connected), 0);
 }
 
 // ============================================================================
@@ -158,31 +637,76 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        // Emit connecting event
-        esp_event_post(TIMEMACHINE_EVENT, NETWORK_CONNECTING, NULL, 0, 0);
-        esp_wifi_connect();
+        if (s_state == NETWORK_STATE_IDLE) {
+            // Emit connecting event, retries after a radio-off backoff are silent
+            esp_event_post(TIMEMACHINE_EVENT, NETWORK_CONNECTING, NULL, 0, 0);
+        }
+        begin_attempt();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        perf_boot_mark(PERF_BOOT_WIFI);
+        s_assoc_us = esp_timer_get_time();
+
+        if (s_lease_reused) {
+            // Static address, IP_EVENT_STA_GOT_IP follows without DHCP
+            esp_netif_ip_info_t ip_info = {
+                .ip.addr = s_cache.ip,
+                .netmask.addr = s_cache.netmask,
+                .gw.addr = s_cache.gateway
+            };
+            esp_netif_dns_info_t dns = {
+                .ip.type = ESP_IPADDR_TYPE_V4,
+                .ip.u_addr.ip4.addr = s_cache.dns
+            };
+            esp_netif_set_ip_info(s_netif, &ip_info);
+            esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < s_config.max_retries) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Retrying WiFi connection (%d/%d)", s_retry_num, s_config.max_retries);
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t*) event_data;
+        s_stats.last_reason = event->reason;
+
+        if (s_state == NETWORK_STATE_CONNECTED) {
+            // Dropped: go back to the same AP first
+            s_stats.disconnect_count++;
+            leave_connected();
+            ESP_LOGW(TAG, "Disconnected (reason %d), reconnecting to the last AP", event->reason);
+            esp_event_post(TIMEMACHINE_EVENT, NETWORK_CONNECTING, NULL, 0, 0);
+            begin_attempt();
+        } else if (s_state != NETWORK_STATE_CONNECTING) {
+            // Left over from a stop or a configuration change
+        } else if (s_targeted) {
+            // The cached AP did not answer on its channel, search all of them
+            s_stats.fallback_count++;
+            ESP_LOGW(TAG, "Cached AP not reachable, scanning");
+            stop_lease_reuse();
+            start_connect(false);
         } else {
-            xEventGroupSetBits(s_network_event_group, NETWORK_FAIL_BIT);
-            s_connected = false;
-
-            // Emit failure event
-            esp_event_post(TIMEMACHINE_EVENT, NETWORK_FAILED, NULL, 0, 0);
-            ESP_LOGE(TAG, "WiFi connection failed after %d retries", s_config.max_retries);
+            s_failed_attempts++;
+            if (!s_failed_reported && s_failed_attempts >= s_config.max_retries) {
+                s_failed_reported = true;
+                xEventGroupSetBits(s_network_event_group, NETWORK_FAIL_BIT);
+
+                // Emit failure event, retrying continues
+                esp_event_post(TIMEMACHINE_EVENT, NETWORK_FAILED, NULL, 0, 0);
+                ESP_LOGE(TAG, "WiFi connection failed %lu times, still retrying", s_failed_attempts);
+            }
+            schedule_retry();
         }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        s_connected = true;
+        perf_boot_mark(PERF_BOOT_DHCP);
+        s_state = NETWORK_STATE_CONNECTED;
+        s_failed_attempts = 0;
+        s_failed_reported = false;
+        xEventGroupClearBits(s_network_event_group, NETWORK_FAIL_BIT);
         xEventGroupSetBits(s_network_event_group, NETWORK_CONNECTED_BIT);
 
-        // Emit success event
-        esp_event_post(TIMEMACHINE_EVENT, NETWORK_CONNECTED, NULL, 0, 0);
+        on_got_ip(event);
+
+        if (s_users == 0) {
+            // Boot connection or reconnect with no job waiting
+            start_linger();
+        }
     }
 }
 
@@ -207,27 +731,112 @@ static void on_network_config_changed(void* arg, esp_event_base_t event_base,
     // Update stored configuration
     s_config = *new_config;
 
-    // Reset retry counter
-    s_retry_num = 0;
+    // A new network starts a fresh backoff
+    esp_timer_stop(s_retry_timer);
+    s_failed_attempts = 0;
+    s_failed_reported = false;
+    s_stats.next_retry_ms = 0;
 
+    // The cached AP and lease belong to the old network
+    memset(&s_cache, 0, sizeof(s_cache));
+    stop_lease_reuse();
+
+    if (s_state == NETWORK_STATE_CONNECTED) {
+        leave_connected();
+    } else if (s_state == NETWORK_STATE_OFF) {
+        s_disconnected_since_us = esp_timer_get_time();
+    }
+
+    // Reconnects from the retry timer, once the old connection is down
     ESP_LOGI(TAG, "Disconnecting current WiFi...");
-    // Disconnect current WiFi
+    s_state = NETWORK_STATE_BACKOFF;
     esp_err_t ret = esp_wifi_disconnect();
     ESP_LOGI(TAG, "Disconnect result: %s", esp_err_to_name(ret));
 
-    // Reconfigure WiFi with new credentials
-    wifi_config_t wifi_config = {0};
-    wifi_config.sta.threshold.authmode = s_config.wifi_authmode;
+    ESP_LOGI(TAG, "Attempting to connect to [%s]...", s_config.wifi_ssid);
+    esp_timer_start_once(s_retry_timer, RECONFIGURE_DELAY_MS * 1000);
+}
 
-    strncpy((char *)wifi_config.sta.ssid, s_config.wifi_ssid, sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char *)wifi_config.sta.password, s_config.wifi_password, sizeof(wifi_config.sta.password) - 1);
+static void on_ntp_synced(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data)
+{
+    // Reconnects from now on can judge the lease age
+    s_clock_trusted = true;
+}
 
-    ESP_LOGI(TAG, "Setting new WiFi config...");
-    ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-    ESP_LOGI(TAG, "Set config result: %s", esp_err_to_name(ret));
+// ============================================================================
+// Console
+// ============================================================================
 
-    // Reconnect
-    ESP_LOGI(TAG, "Attempting to connect to [%s]...", s_config.wifi_ssid);
-    ret = esp_wifi_connect();
-    ESP_LOGI(TAG, "Connect result: %s", esp_err_to_name(ret));
+#if CONFIG_TIMEMACHINE_CONSOLE
+
+static const char *state_name(network_state_t state)
+{
+    switch (state) {
+        case NETWORK_STATE_IDLE:       return "idle";
+        case NETWORK_STATE_CONNECTING: return "connecting";
+        case NETWORK_STATE_CONNECTED:  return "connected";
+        case NETWORK_STATE_BACKOFF:    return "waiting to retry";
+        case NETWORK_STATE_OFF:        return "off until needed";
+        default:                       return "unknown";
+    }
 }
+
+static int cmd_net(int argc, char **argv)
+{
+    network_stats_t stats;
+    network_get_stats(&stats);
+
+    printf("Status: %s", state_name(stats.state));
+    if (stats.state == NETWORK_STATE_BACKOFF && stats.next_retry_ms > 0) {
+        printf(" (%lu failed, backoff %lu ms%s)", stats.failed_attempts, stats.next_retry_ms,
+               s_radio_off ? ", radio off" : "");
+    }
+    printf("\n");
+    if (s_cache.channel != 0) {
+        printf("AP: " MACSTR " channel %d, lease " IPSTR "%s\n",
+               MAC2STR(s_cache.bssid), s_cache.channel,
+               IP2STR((esp_ip4_addr_t *)&s_cache.ip),
+               s_lease_reused ? " (cached, no DHCP)" : "");
+    }
+    printf("Connections: %lu (%lu to the cached AP, %lu with the cached lease), "
+           "%lu fallbacks to a scan\n",
+           stats.connect_count, stats.targeted_count, stats.lease_reuse_count,
+           stats.fallback_count);
+    if (stats.connect_count > 0) {
+        printf("Connect time: last %lu ms (associated at %lu ms), best %lu ms, worst %lu ms\n",
+               stats.last_connect_ms, stats.last_assoc_ms,
+               stats.best_connect_ms, stats.worst_connect_ms);
+    }
+    printf("Attempts: %lu, disconnects: %lu, disconnected for %llu s, "
+           "%lu backoffs with the radio off, last reason %d\n",
+           stats.attempt_count, stats.disconnect_count, stats.disconnected_ms / 1000,
+           stats.radio_off_count, stats.last_reason);
+
+    uint64_t uptime_ms = esp_timer_get_time() / 1000;
+    printf("Connected %llu.%llu%% of the uptime, %lu wakes, %d jobs holding the network\n",
+           uptime_ms ? stats.connected_ms * 100 / uptime_ms : 0,
+           uptime_ms ? stats.connected_ms * 1000 / uptime_ms % 10 : 0,
+           stats.wake_count, stats.users);
+    return 0;
+}
+
+esp_err_t network_register_console_commands(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "net",
+        .help = "Show the WiFi connection, cached AP and lease, connect times and retries",
+        .hint = NULL,
+        .func = cmd_net,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+#else
+
+esp_err_t network_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
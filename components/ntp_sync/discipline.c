@@ -0,0 +1,123 @@
+/**
+ * @file discipline.c
+ * @brief Clock discipline: offset filtering, drift estimation, poll interval
+ */
+
+#include "discipline.h"
+#include <stdlib.h>
+
+// Offsets below this count towards a longer poll interval
+#define STABLE_US       25000
+
+// Offsets above this shorten the poll interval
+#define UNSTABLE_US     100000
+
+// Consecutive stable samples before the poll interval is doubled
+#define STABLE_SAMPLES  2
+
+// Once the drift is known, a stepped offset leaving more than this is a
+// phase jump rather than a change in the crystal
+#define STEP_RESIDUAL_PPB 50000
+
+// ============================================================================
+// Private
+// ============================================================================
+
+/**
+ * @brief Fold the offset left since the previous sample into the drift
+ *
+ * The previous offset and the estimated drift were corrected, so whatever
+ * is left is the remaining frequency error. An offset too large for the
+ * crystal over the elapsed time is a phase jump (suspend, manual set) and
+ * leaves the estimate alone.
+ */
+static void update_drift(ntp_discipline_t *d, int64_t offset_us, int64_t mono_us, bool stepped)
+{
+    int64_t elapsed_us = mono_us - d->last_sample_us;
+    if (!d->has_sample || elapsed_us <= 0 ||
+        llabs(offset_us) > elapsed_us / (1000000000LL / NTP_DISCIPLINE_MAX_DRIFT_PPB)) {
+        return;
+    }
+
+    int64_t residual_ppb = offset_us * 1000000000LL / elapsed_us;
+    if (stepped && d->drift_valid && llabs(residual_ppb) > STEP_RESIDUAL_PPB) {
+        return;
+    }
+
+    int64_t drift_ppb = d->drift_valid ? d->drift_ppb + residual_ppb / 2 : residual_ppb;
+    if (drift_ppb > NTP_DISCIPLINE_MAX_DRIFT_PPB) {
+        drift_ppb = NTP_DISCIPLINE_MAX_DRIFT_PPB;
+    } else if (drift_ppb < -NTP_DISCIPLINE_MAX_DRIFT_PPB) {
+        drift_ppb = -NTP_DISCIPLINE_MAX_DRIFT_PPB;
+    }
+    d->drift_ppb = (int32_t)drift_ppb;
+    d->drift_valid = true;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void ntp_discipline_init(ntp_discipline_t *d, uint32_t min_interval_s, uint32_t max_interval_s)
+{
+    *d = (ntp_discipline_t){0};
+    ntp_discipline_set_limits(d, min_interval_s, max_interval_s);
+    d->interval_s = d->min_interval_s;
+}
+
+void ntp_discipline_set_limits(ntp_discipline_t *d, uint32_t min_interval_s, uint32_t max_interval_s)
+{
+    d->min_interval_s = min_interval_s > 0 ? min_interval_s : 1;
+    d->max_interval_s = max_interval_s > d->min_interval_s ? max_interval_s : d->min_interval_s;
+
+    if (d->interval_s < d->min_interval_s) {
+        d->interval_s = d->min_interval_s;
+    } else if (d->interval_s > d->max_interval_s) {
+        d->interval_s = d->max_interval_s;
+    }
+}
+
+ntp_discipline_action_t ntp_discipline_sample(ntp_discipline_t *d, int64_t offset_us, int64_t mono_us)
+{
+    int64_t abs_offset_us = llabs(offset_us);
+    bool step = abs_offset_us > NTP_DISCIPLINE_STEP_US;
+
+    // A drift of 40 ppm over an hour already exceeds the step threshold, so
+    // stepped offsets count towards the estimate too
+    update_drift(d, offset_us, mono_us, step);
+    d->has_sample = true;
+    d->last_sample_us = mono_us;
+
+    if (step) {
+        // Measuring restarts from the corrected phase at the shortest interval
+        d->interval_s = d->min_interval_s;
+        d->good_count = 0;
+        return NTP_DISCIPLINE_STEP;
+    }
+
+    // Poll less often while the clock keeps time, more often when it does not
+    if (abs_offset_us < STABLE_US) {
+        if (++d->good_count >= STABLE_SAMPLES) {
+            d->good_count = 0;
+            d->interval_s = (d->interval_s > d->max_interval_s / 2) ?
+                            d->max_interval_s : d->interval_s * 2;
+        }
+    } else {
+        d->good_count = 0;
+        if (abs_offset_us > UNSTABLE_US) {
+            d->interval_s = (d->interval_s / 2 < d->min_interval_s) ?
+                            d->min_interval_s : d->interval_s / 2;
+        }
+    }
+
+    return NTP_DISCIPLINE_SLEW;
+}
+
+int64_t ntp_discipline_drift_us(const ntp_discipline_t *d, int64_t elapsed_us)
+{
+    if (!d->drift_valid) {
+        return 0;
+    }
+
+    return elapsed_us * d->drift_ppb / 1000000000LL;
+}
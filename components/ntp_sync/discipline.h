@@ -0,0 +1,76 @@
+/**
+ * @file discipline.h
+ * @brief Clock discipline: offset filtering, drift estimation, poll interval
+ *
+ * Fed with the offset measured by every NTP sync, it decides whether to step
+ * or slew the clock, estimates the crystal's frequency error from the offsets
+ * left after the previous correction and lengthens the poll interval while
+ * the clock keeps time. Pure C with no ESP-IDF dependencies so it can be
+ * checked on the host.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Offsets larger than this are stepped, smaller ones slewed */
+#define NTP_DISCIPLINE_STEP_US      128000
+
+/** Frequency errors beyond this are not a crystal, ignore them */
+#define NTP_DISCIPLINE_MAX_DRIFT_PPB 500000
+
+/**
+ * @brief How to apply a measured offset
+ */
+typedef enum {
+    NTP_DISCIPLINE_STEP,    /**< Set the clock (large offset) */
+    NTP_DISCIPLINE_SLEW,    /**< Slew the clock by the offset (adjtime) */
+} ntp_discipline_action_t;
+
+/**
+ * @brief Discipline state
+ */
+typedef struct {
+    uint32_t min_interval_s;    /**< Poll interval after a step or a large offset */
+    uint32_t max_interval_s;    /**< Longest poll interval once stable */
+    uint32_t interval_s;        /**< Current poll interval */
+    int64_t last_sample_us;     /**< Monotonic time of the last sample */
+    int32_t drift_ppb;          /**< Estimated frequency error, positive = clock runs slow */
+    uint8_t good_count;         /**< Consecutive samples within the stable bound */
+    bool has_sample;            /**< A previous sample exists to measure drift against */
+    bool drift_valid;           /**< drift_ppb has been estimated at least once */
+} ntp_discipline_t;
+
+/**
+ * @brief Reset the discipline
+ *
+ * @param min_interval_s Shortest poll interval
+ * @param max_interval_s Longest poll interval, raised to min_interval_s if lower
+ */
+void ntp_discipline_init(ntp_discipline_t *d, uint32_t min_interval_s, uint32_t max_interval_s);
+
+/**
+ * @brief Change the poll interval limits, keeping the drift estimate
+ */
+void ntp_discipline_set_limits(ntp_discipline_t *d, uint32_t min_interval_s, uint32_t max_interval_s);
+
+/**
+ * @brief Feed a measured offset
+ *
+ * Updates the drift estimate and the poll interval. The caller applies the
+ * returned action with the full offset.
+ *
+ * @param offset_us Reference time minus local time
+ * @param mono_us   Monotonic time of the measurement
+ * @return Whether to step or slew
+ */
+ntp_discipline_action_t ntp_discipline_sample(ntp_discipline_t *d, int64_t offset_us, int64_t mono_us);
+
+/**
+ * @brief Correction for the estimated drift over a period
+ *
+ * @param elapsed_us Monotonic time the correction covers
+ * @return Microseconds to slew the clock by, 0 until drift is estimated
+ */
+int64_t ntp_discipline_drift_us(const ntp_discipline_t *d, int64_t elapsed_us);
@@ -1,32 +1,115 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 #include "esp_err.h"
 
+/** Wall clock times before this (Jan 1, 2020) mean the time is not set */
+#define NTP_SYNC_MIN_VALID_EPOCH 1577836800
+
+/** Servers queried at every sync (server1, server2) */
+#define NTP_SYNC_MAX_SERVERS 2
+
 
 /**
  * @brief NTP configuration structure
  */
 typedef struct {
-    const char *server1;        /**< Primary NTP server (e.g., "pool.ntp.org") */
-    const char *server2;        /**< Secondary NTP server (optional) */
+    const char *server1;        /**< Primary NTP server (e.g., "pool.ntp.org", "10.0.0.2:12300") */
+    const char *server2;        /**< Secondary NTP server (optional, same format) */
     const char *timezone;       /**< Timezone string (e.g., "EST5EDT,M3.2.0/2,M11.1.0") */
     uint32_t sync_interval_ms;  /**< Sync interval in milliseconds (default: 3600000 = 1 hour) */
 } ntp_sync_config_t;
 
+/**
+ * @brief Where the current wall clock time comes from
+ */
+typedef enum {
+    NTP_SYNC_SOURCE_NONE,   /**< Wall clock not set */
+    NTP_SYNC_SOURCE_RTC,    /**< Carried across a reset by the RTC, accurate to its drift */
+    NTP_SYNC_SOURCE_NVS,    /**< Last synced time from flash, behind by the time powered off */
+    NTP_SYNC_SOURCE_NTP,    /**< Synchronized since boot */
+} ntp_sync_source_t;
+
+/**
+ * @brief NTP synchronization statistics
+ */
+typedef struct {
+    uint32_t sync_count;       /**< Successful syncs since init */
+    uint32_t step_count;       /**< Syncs that set the clock (offset over 128 ms) */
+    uint32_t slew_count;       /**< Syncs that slewed it */
+    uint32_t rejected_count;   /**< Syncs dropped because the servers disagreed */
+    uint32_t disagree_count;   /**< Syncs that dropped a falseticker and went on */
+    int64_t last_offset_us;    /**< Offset measured by the last sync (0 if the clock was unset) */
+    int32_t drift_ppb;         /**< Estimated frequency error in ppb (1000 = 1 ppm),
+                                    corrected between syncs */
+    uint32_t interval_s;       /**< Current sync interval */
+    time_t last_sync;          /**< Unix time of the last successful sync */
+    time_t next_sync;          /**< Unix time of the next sync */
+} ntp_sync_stats_t;
+
+/**
+ * @brief Per-server results of the last sync
+ */
+typedef struct {
+    const char *server;        /**< Server as configured */
+    uint8_t reach;             /**< Reply history of the last 8 syncs, bit 0 = latest */
+    uint8_t sent;              /**< Queries sent at the last sync */
+    uint8_t replies;           /**< Valid replies to them */
+    bool truechimer;           /**< Agreed with the majority and was used */
+    int64_t offset_us;         /**< Offset of the minimum-delay reply */
+    int64_t delay_us;          /**< Round-trip delay of that reply */
+    int64_t jitter_us;         /**< RMS spread of the other replies' offsets */
+} ntp_sync_server_stats_t;
+
 /**
  * @brief Initialize and start NTP synchronization
  *
  * This will perform an initial sync and then periodically sync in the background.
- * The function blocks until the initial sync completes or times out.
+ * The function blocks until the initial sync completes or times out. A
+ * timed-out initial sync is not an error: the periodic sync job retries it
+ * after 15 s, doubling up to 10 min (or when the network comes back), and
+ * posts NTP_SYNCED once it succeeds. Later failures retry after
+ * config->sync_interval_ms.
+ *
+ * Every sync queries each server CONFIG_TIMEMACHINE_NTP_SAMPLES times and
+ * keeps its minimum-delay reply. Servers that disagree with the majority
+ * are rejected as falsetickers; the others' offsets are combined.
+ *
+ * Offsets up to 128 ms are slewed with adjtime() so the seconds never jump,
+ * larger ones step the clock. The crystal's frequency error is estimated
+ * from successive offsets and corrected every minute between syncs. While
+ * the clock keeps time the interval doubles, from config->sync_interval_ms
+ * up to CONFIG_TIMEMACHINE_NTP_MAX_INTERVAL_S.
  *
  * @param config NTP configuration
  * @param timeout_sec Maximum time to wait for initial sync (seconds)
- * @return ESP_OK on success, error code otherwise
+ * @return ESP_OK on success (also if the initial sync timed out), error
+ *         code otherwise
  */
 esp_err_t ntp_sync_init(const ntp_sync_config_t *config, uint32_t timeout_sec);
 
+/**
+ * @brief Restore the wall clock before the network is up
+ *
+ * Keeps the system time if it survived the reset. Otherwise uses the RTC
+ * anchor saved at the last sync, which stays valid across software, panic
+ * and watchdog resets, and falls back to the last synced epoch (e.g. from
+ * NVS) after a power cycle. The first NTP sync steps the clock afterwards.
+ *
+ * @param timezone          POSIX TZ string, NULL to keep the current one
+ * @param last_synced_epoch Unix time of the last successful sync, 0 if unknown
+ * @return ESP_OK if the wall clock is set, ESP_ERR_NOT_FOUND if no time is known
+ */
+esp_err_t ntp_sync_restore_time(const char *timezone, int64_t last_synced_epoch);
+
+/**
+ * @brief Get where the current wall clock time comes from
+ */
+ntp_sync_source_t ntp_sync_get_source(void);
+
 /**
  * @brief Check if time has been synchronized at least once
  *
@@ -34,6 +117,33 @@ esp_err_t ntp_sync_init(const ntp_sync_config_t *config, uint32_t timeout_sec);
  */
 bool ntp_sync_is_synced(void);
 
+/**
+ * @brief Get synchronization statistics
+ *
+ * The offset is the NTP time minus the system time when the sample arrived,
+ * so it is what the drift correction did not catch since the previous sync.
+ *
+ * @param stats Pointer to store statistics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t ntp_sync_get_stats(ntp_sync_stats_t *stats);
+
+/**
+ * @brief Get the per-server results of the last sync
+ *
+ * @param stats Array to fill
+ * @param max   Size of the array
+ * @return Number of servers written
+ */
+size_t ntp_sync_get_server_stats(ntp_sync_server_stats_t *stats, size_t max);
+
+/**
+ * @brief Register the `ntp` console command
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CONFIG_TIMEMACHINE_CONSOLE
+ */
+esp_err_t ntp_sync_register_console_commands(void);
+
 /**
  * @brief Deinitialize NTP synchronization and stop background task
  */
@@ -1,27 +1,87 @@
 #include "ntp_sync.h"
+#include "discipline.h"
+#include "sampler.h"
 #include "timemachine_events.h"
+#include "network.h"
+#include "netjobs.h"
+#include "perf.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include "esp_log.h"
-#include "esp_sntp.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_rtc_time.h"
+#include "esp_system.h"
+#include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
 
 static const char *TAG = "ntp_sync";
 
-#define TIME_SYNCED_BIT BIT0
+// Wait for each NTP reply
+#define SAMPLE_TIMEOUT_MS  1000
+
+// Pause between failed initial sync rounds
+#define RETRY_DELAY_MS     4000     // NIST allows one query every 4 s
+
+// Job retries until the first sync succeeds, doubled after each failure
+#define UNSYNCED_RETRY_MIN_S  15
+#define UNSYNCED_RETRY_MAX_S  600
+
+// Wait for the network before a sync round
+#define NETWORK_WAIT_MS    30000
+
+// A sync may run this part of its interval early to share a wake window
+#define TOLERANCE_DIVISOR  4
+
+// Period of the drift correction between syncs
+#define DRIFT_TICK_US  (60 * 1000000LL)
+
+#define RTC_ANCHOR_MAGIC 0x4e545041  // "NTPA"
 
 static ntp_sync_config_t s_config = {0};
-static EventGroupHandle_t s_sync_event_group = NULL;
-static TaskHandle_t s_sync_task_handle = NULL;
+static netjobs_handle_t s_job = NULL;
+static esp_timer_handle_t s_drift_timer = NULL;
+static SemaphoreHandle_t s_slew_mutex = NULL;  // Sync job and drift timer both slew
 static bool s_initialized = false;
 static bool s_synced = false;
 static esp_event_handler_instance_t s_config_changed_handler = NULL;
+static ntp_sync_stats_t s_stats = {0};
+static ntp_sync_source_t s_source = NTP_SYNC_SOURCE_NONE;
+
+// Discipline and stats are updated from the job worker, the drift timer and
+// event handlers
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ntp_discipline_t s_discipline;
+static int64_t s_drift_mono_us = 0;  // Drift corrected up to this monotonic time
+static ntp_sync_server_stats_t s_server_stats[NTP_SYNC_MAX_SERVERS];
+static uint32_t s_unsynced_retry_s = UNSYNCED_RETRY_MIN_S;
+
+// Wall clock and RTC time at the last sync. The RTC keeps counting through
+// every reset except power-on and brownout, so this restores the time to
+// within the RTC drift
+static RTC_NOINIT_ATTR struct {
+    uint32_t magic;
+    int64_t wall_us;
+    uint64_t rtc_us;
+} s_rtc_anchor;
 
 // Forward declarations
-static void time_sync_notification_cb(struct timeval *tv);
-static void ntp_sync_task_loop(void *pvParameters);
+static esp_err_t sync_round(void);
+static void apply_offset(int64_t offset_us);
+static void slew_clock(int64_t delta_us);
+static void apply_drift(void);
+static void drift_timer_callback(void *arg);
+static uint32_t retry_delay_s(void);
+static void update_schedule(bool last_ok);
+static esp_err_t sync_job(void *arg);
 static void on_ntp_config_changed(void* arg, esp_event_base_t event_base,
                                    int32_t event_id, void* event_data);
 
@@ -49,12 +109,9 @@ esp_err_t ntp_sync_init(const ntp_sync_config_t *config, uint32_t timeout_sec)
     s_config.timezone = config->timezone;
     s_config.sync_interval_ms = (config->sync_interval_ms > 0) ? config->sync_interval_ms : 3600000;
 
-    // Create event group for sync notification
-    s_sync_event_group = xEventGroupCreate();
-    if (s_sync_event_group == NULL) {
-        ESP_LOGE(TAG, "Failed to create event group");
-        return ESP_ERR_NO_MEM;
-    }
+    // The configured interval is the shortest, it grows while the clock keeps time
+    ntp_discipline_init(&s_discipline, s_config.sync_interval_ms / 1000,
+                        CONFIG_TIMEMACHINE_NTP_MAX_INTERVAL_S);
 
     // Set timezone
     if (s_config.timezone) {
@@ -63,75 +120,114 @@ esp_err_t ntp_sync_init(const ntp_sync_config_t *config, uint32_t timeout_sec)
         ESP_LOGI(TAG, "Timezone set to: %s", s_config.timezone);
     }
 
-    // Configure SNTP
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-
     if (s_config.server1) {
-        esp_sntp_setservername(0, s_config.server1);
         ESP_LOGI(TAG, "Primary NTP server: %s", s_config.server1);
     }
 
     if (s_config.server2) {
-        esp_sntp_setservername(1, s_config.server2);
         ESP_LOGI(TAG, "Secondary NTP server: %s", s_config.server2);
     }
 
-    // Set notification callback
-    sntp_set_time_sync_notification_cb(time_sync_notification_cb);
-
-    // Start SNTP for initial sync with retries
-    ESP_LOGI(TAG, "Starting initial NTP sync...");
-
-    const int MAX_RETRIES = 3;
-    bool sync_success = false;
-
-    for (int retry = 0; retry < MAX_RETRIES && !sync_success; retry++) {
-        if (retry > 0) {
-            ESP_LOGW(TAG, "NTP sync attempt %d/%d...", retry + 1, MAX_RETRIES);
-        }
+    // Everything the periodic syncs need exists before the first attempt,
+    // so a boot without a reachable server still syncs later
+    s_initialized = true;
 
-        // Clear sync bit before starting
-        xEventGroupClearBits(s_sync_event_group, TIME_SYNCED_BIT);
+    // Short ticks keep the accumulated drift far below a display second
+    // without waking the network
+    s_slew_mutex = xSemaphoreCreateMutex();
+    if (s_slew_mutex == NULL) {
+        ntp_sync_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    const esp_timer_create_args_t timer_args = {
+        .callback = drift_timer_callback,
+        .name = "ntp_drift"
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_drift_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(s_drift_timer, DRIFT_TICK_US);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start drift timer");
+        ntp_sync_deinit();
+        return err;
+    }
 
-        // Start SNTP
-        esp_sntp_init();
+    // Register NTP_CONFIG_CHANGED handler
+    err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        NTP_CONFIG_CHANGED,
+        on_ntp_config_changed,
+        NULL,
+        &s_config_changed_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register NTP_CONFIG_CHANGED handler");
+        ntp_sync_deinit();
+        return err;
+    }
 
-        ESP_LOGI(TAG, "Waiting for NTP response (timeout: %lu seconds)...", timeout_sec);
+    // Initial sync, retried until the timeout
+    ESP_LOGI(TAG, "Starting initial NTP sync (timeout: %lu seconds)...", timeout_sec);
 
-        // Wait for initial sync
-        EventBits_t bits = xEventGroupWaitBits(
-            s_sync_event_group,
-            TIME_SYNCED_BIT,
-            pdFALSE,
-            pdFALSE,
-            pdMS_TO_TICKS(timeout_sec * 1000)
-        );
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_sec * 1000000;
+    int attempt = 0;
+    esp_err_t sync_err;
 
-        // Stop SNTP after attempt
-        esp_sntp_stop();
+    // The network is up at boot, holding it keeps a duty-cycled radio on
+    network_acquire(NETWORK_WAIT_MS);
 
-        if (bits & TIME_SYNCED_BIT) {
-            sync_success = true;
-            ESP_LOGI(TAG, "Initial NTP sync completed on attempt %d", retry + 1);
-        } else {
-            ESP_LOGW(TAG, "NTP sync timeout on attempt %d", retry + 1);
+    while (1) {
+        attempt++;
+        sync_err = sync_round();
+        if (sync_err == ESP_OK) {
+            ESP_LOGI(TAG, "Initial NTP sync completed on attempt %d", attempt);
+            break;
+        }
 
-            // Wait a bit before retrying
-            if (retry < MAX_RETRIES - 1) {
-                ESP_LOGI(TAG, "Waiting 2 seconds before retry...");
-                vTaskDelay(pdMS_TO_TICKS(2000));
-            }
+        ESP_LOGW(TAG, "NTP sync attempt %d failed: %s", attempt, esp_err_to_name(sync_err));
+        if (esp_timer_get_time() + RETRY_DELAY_MS * 1000LL >= deadline_us) {
+            break;
         }
+
+        ESP_LOGI(TAG, "Waiting %d seconds before retry...", RETRY_DELAY_MS / 1000);
+        vTaskDelay(pdMS_TO_TICKS(RETRY_DELAY_MS));
+    }
+    network_release();
+
+    // Periodic syncs run on the network job worker. Until a sync succeeds
+    // they retry on a short backoff, then follow the disciplined interval
+    portENTER_CRITICAL(&s_lock);
+    uint32_t interval_s = s_discipline.interval_s;
+    uint32_t retry_s = retry_delay_s();
+    portEXIT_CRITICAL(&s_lock);
+
+    const netjobs_config_t job_config = {
+        .name = "ntp",
+        .fn = sync_job,
+        .period_s = interval_s,
+        .tolerance_s = interval_s / TOLERANCE_DIVISOR,
+        .retry_s = retry_s,
+        .first_run_s = (sync_err == ESP_OK) ? interval_s : retry_s
+    };
+    err = netjobs_add(&job_config, &s_job);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add sync job");
+        ntp_sync_deinit();
+        return err;
     }
+    s_stats.next_sync = time(NULL) + job_config.first_run_s;
 
-    if (!sync_success) {
-        ESP_LOGE(TAG, "Initial NTP sync failed after %d attempts", MAX_RETRIES);
-        vEventGroupDelete(s_sync_event_group);
-        s_sync_event_group = NULL;
-        return ESP_ERR_TIMEOUT;
+    if (sync_err != ESP_OK) {
+        // Not an init failure: NTP_SYNCED, and with it readiness, comes from
+        // the job once a server answers
+        ESP_LOGE(TAG, "Initial NTP sync failed after %d attempts, retrying in %lu s",
+                 attempt, retry_s);
+        return ESP_OK;
     }
 
     ESP_LOGI(TAG, "Initial NTP sync completed");
+    perf_boot_mark(PERF_BOOT_NTP);
 
     // Emit NTP synced event
     timemachine_ntp_sync_t sync_data = {
@@ -146,46 +242,58 @@ esp_err_t ntp_sync_init(const ntp_sync_config_t *config, uint32_t timeout_sec)
         0
     );
 
-    // Stop SNTP temporarily (will be restarted by background task)
-    esp_sntp_stop();
+    ESP_LOGI(TAG, "NTP sync initialized (interval: %lu ms)", s_config.sync_interval_ms);
 
-    // Start background sync task
-    BaseType_t ret = xTaskCreate(
-        ntp_sync_task_loop,
-        "ntp_sync",
-        4096,
-        NULL,
-        4,  // Priority
-        &s_sync_task_handle
-    );
+    return ESP_OK;
+}
 
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create sync task");
-        vEventGroupDelete(s_sync_event_group);
-        s_sync_event_group = NULL;
-        return ESP_FAIL;
+esp_err_t ntp_sync_restore_time(const char *timezone, int64_t last_synced_epoch)
+{
+    if (timezone) {
+        setenv("TZ", timezone, 1);
+        tzset();
     }
 
-    // Register NTP_CONFIG_CHANGED handler
-    esp_err_t err = esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        NTP_CONFIG_CHANGED,
-        on_ntp_config_changed,
-        NULL,
-        &s_config_changed_handler
-    );
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register NTP_CONFIG_CHANGED handler");
-        ntp_sync_deinit();
-        return err;
+    if (time(NULL) >= NTP_SYNC_MIN_VALID_EPOCH) {
+        s_source = NTP_SYNC_SOURCE_RTC;
+        ESP_LOGI(TAG, "System time survived the reset");
+        return ESP_OK;
     }
 
-    s_initialized = true;
-    ESP_LOGI(TAG, "NTP sync initialized (interval: %lu ms)", s_config.sync_interval_ms);
+    esp_reset_reason_t reason = esp_reset_reason();
+    uint64_t rtc_us = esp_rtc_get_time_us();
+    int64_t wall_us = 0;
+
+    if (s_rtc_anchor.magic == RTC_ANCHOR_MAGIC &&
+        reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT &&
+        rtc_us >= s_rtc_anchor.rtc_us) {
+        wall_us = s_rtc_anchor.wall_us + (int64_t)(rtc_us - s_rtc_anchor.rtc_us);
+        s_source = NTP_SYNC_SOURCE_RTC;
+    } else if (last_synced_epoch >= NTP_SYNC_MIN_VALID_EPOCH) {
+        wall_us = last_synced_epoch * 1000000;
+        s_source = NTP_SYNC_SOURCE_NVS;
+    } else {
+        s_rtc_anchor.magic = 0;
+        ESP_LOGI(TAG, "No previous time to restore");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct timeval tv = {
+        .tv_sec = wall_us / 1000000,
+        .tv_usec = wall_us % 1000000
+    };
+    settimeofday(&tv, NULL);
 
+    ESP_LOGI(TAG, "Restored time from %s: %lld",
+             s_source == NTP_SYNC_SOURCE_RTC ? "RTC anchor" : "last sync", (long long)tv.tv_sec);
     return ESP_OK;
 }
 
+ntp_sync_source_t ntp_sync_get_source(void)
+{
+    return s_source;
+}
+
 bool ntp_sync_is_synced(void)
 {
     if (!s_synced) {
@@ -196,7 +304,38 @@ bool ntp_sync_is_synced(void)
     time(&now);
 
     // If time is before 2020, consider it not synced
-    return (now > 1577836800); // Jan 1, 2020
+    return (now > NTP_SYNC_MIN_VALID_EPOCH);
+}
+
+esp_err_t ntp_sync_get_stats(ntp_sync_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+size_t ntp_sync_get_server_stats(ntp_sync_server_stats_t *stats, size_t max)
+{
+    size_t count = 0;
+
+    if (stats == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < NTP_SYNC_MAX_SERVERS && count < max; i++) {
+        if (s_server_stats[i].server != NULL) {
+            stats[count++] = s_server_stats[i];
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return count;
 }
 
 void ntp_sync_deinit(void)
@@ -217,104 +356,246 @@ void ntp_sync_deinit(void)
         s_config_changed_handler = NULL;
     }
 
-    // Stop background task
-    if (s_sync_task_handle != NULL) {
-        vTaskDelete(s_sync_task_handle);
-        s_sync_task_handle = NULL;
+    // Stop periodic syncs and drift correction
+    if (s_job != NULL) {
+        netjobs_remove(s_job);
+        s_job = NULL;
     }
 
-    // Stop SNTP
-    esp_sntp_stop();
+    if (s_drift_timer != NULL) {
+        esp_timer_stop(s_drift_timer);
+        esp_timer_delete(s_drift_timer);
+        s_drift_timer = NULL;
+    }
 
-    // Clean up event group
-    if (s_sync_event_group) {
-        vEventGroupDelete(s_sync_event_group);
-        s_sync_event_group = NULL;
+    if (s_slew_mutex != NULL) {
+        vSemaphoreDelete(s_slew_mutex);
+        s_slew_mutex = NULL;
     }
 
     s_initialized = false;
     s_synced = false;
+    s_unsynced_retry_s = UNSYNCED_RETRY_MIN_S;
 
     ESP_LOGI(TAG, "NTP sync deinitialized");
 }
 
 // ============================================================================
-// Private - Background Sync Task
+// Private - Periodic Sync
 // ============================================================================
-// NOTE: We use a FreeRTOS task instead of a timer because this sync operation
-// blocks for up to 30 seconds waiting for NTP response. Timer callbacks MUST NOT
-// block as they run in the timer daemon task context, which would stall all other
-// timers in the system. A dedicated task allows us to safely block without issues.
 
-static void ntp_sync_task_loop(void *pvParameters)
+/**
+ * @brief Network job: sync, then schedule the next one
+ *
+ * Runs on the netjobs worker, which holds the network and may run it up to
+ * a quarter of the interval early to share a wake with other jobs.
+ */
+static esp_err_t sync_job(void *arg)
 {
-    ESP_LOGI(TAG, "Background NTP sync task started (interval: %lu ms)", s_config.sync_interval_ms);
+    ESP_LOGI(TAG, "Performing periodic NTP sync...");
+
+    esp_err_t err = sync_round();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Periodic NTP sync successful");
+
+        // Publish sync event (optional, for logging/monitoring)
+        timemachine_ntp_sync_t sync_data = {
+            .success = true,
+            .timestamp = time(NULL)
+        };
+        esp_event_post(
+            TIMEMACHINE_EVENT,
+            NTP_SYNCED,
+            &sync_data,
+            sizeof(sync_data),
+            0
+        );
+    } else {
+        ESP_LOGW(TAG, "Periodic NTP sync failed: %s", esp_err_to_name(err));
+        if (!s_synced) {
+            portENTER_CRITICAL(&s_lock);
+            s_unsynced_retry_s *= 2;
+            if (s_unsynced_retry_s > UNSYNCED_RETRY_MAX_S) {
+                s_unsynced_retry_s = UNSYNCED_RETRY_MAX_S;
+            }
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
 
-    while (1) {
-        // Wait for sync interval
-        vTaskDelay(pdMS_TO_TICKS(s_config.sync_interval_ms));
+    update_schedule(err == ESP_OK);
+    return err;
+}
 
-        ESP_LOGI(TAG, "Performing periodic NTP sync...");
+/**
+ * @brief Time to the next sync after a failed one, called with s_lock held
+ *
+ * Until a sync succeeds the clock may be far off, so the retry backs off
+ * from seconds to minutes. After that the configured interval is kept.
+ */
+static uint32_t retry_delay_s(void)
+{
+    return s_synced ? s_discipline.min_interval_s : s_unsynced_retry_s;
+}
 
-        // Clear the sync bit
-        xEventGroupClearBits(s_sync_event_group, TIME_SYNCED_BIT);
+/**
+ * @brief Hand the disciplined interval and the retry time to the job
+ */
+static void update_schedule(bool last_ok)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t interval_s = s_discipline.interval_s;
+    uint32_t retry_s = retry_delay_s();
+    s_stats.next_sync = time(NULL) + (last_ok ? interval_s : retry_s);
+    portEXIT_CRITICAL(&s_lock);
 
-        // Start SNTP sync
-        esp_sntp_init();
+    netjobs_set_schedule(s_job, interval_s, interval_s / TOLERANCE_DIVISOR, retry_s);
+}
 
-        // Wait for sync to complete (with timeout)
-        EventBits_t bits = xEventGroupWaitBits(
-            s_sync_event_group,
-            TIME_SYNCED_BIT,
-            pdFALSE,
-            pdFALSE,
-            pdMS_TO_TICKS(30000)  // 30 second timeout
-        );
+// ============================================================================
+// Private - Sampling
+// ============================================================================
 
-        // Stop SNTP after sync attempt
-        esp_sntp_stop();
-
-        if (bits & TIME_SYNCED_BIT) {
-            ESP_LOGI(TAG, "Periodic NTP sync successful");
-
-            // Publish sync event (optional, for logging/monitoring)
-            timemachine_ntp_sync_t sync_data = {
-                .success = true,
-                .timestamp = time(NULL)
-            };
-            esp_event_post(
-                TIMEMACHINE_EVENT,
-                NTP_SYNCED,
-                &sync_data,
-                sizeof(sync_data),
-                0
-            );
-        } else {
-            ESP_LOGW(TAG, "Periodic NTP sync timeout");
+/**
+ * @brief Query every configured server and apply the combined offset
+ *
+ * @return ESP_OK, ESP_ERR_TIMEOUT if no server replied, ESP_ERR_INVALID_RESPONSE
+ *         if the servers disagree or the time is implausible
+ */
+static esp_err_t sync_round(void)
+{
+    const char *servers[NTP_SYNC_MAX_SERVERS] = { s_config.server1, s_config.server2 };
+    ntp_sampler_peer_t peers[NTP_SYNC_MAX_SERVERS] = {0};
+
+    for (size_t i = 0; i < NTP_SYNC_MAX_SERVERS; i++) {
+        if (servers[i] == NULL || servers[i][0] == '\0') {
+            continue;
+        }
+        if (ntp_sampler_poll(servers[i], CONFIG_TIMEMACHINE_NTP_SAMPLES,
+                             SAMPLE_TIMEOUT_MS, &peers[i]) < 0) {
+            ESP_LOGW(TAG, "Cannot reach %s", servers[i]);
+        }
+        if (peers[i].kiss[0] != '\0') {
+            ESP_LOGW(TAG, "%s sent kiss-o'-death %s, not queried again this sync",
+                     servers[i], peers[i].kiss);
         }
     }
-}
 
-// ============================================================================
-// Private - Callbacks
-// ============================================================================
+    int64_t offset_us = 0;
+    bool local_trusted = (s_source == NTP_SYNC_SOURCE_RTC || s_source == NTP_SYNC_SOURCE_NTP);
+    size_t truechimers = ntp_sampler_select(peers, NTP_SYNC_MAX_SERVERS, local_trusted,
+                                            &offset_us);
+
+    bool replied = false;
+    size_t responding = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < NTP_SYNC_MAX_SERVERS; i++) {
+        ntp_sync_server_stats_t *server = &s_server_stats[i];
+        server->server = servers[i];
+        server->reach = (uint8_t)((server->reach << 1) | (peers[i].replies > 0));
+        server->sent = peers[i].sent;
+        server->replies = peers[i].replies;
+        server->truechimer = peers[i].truechimer;
+        if (peers[i].replies > 0) {
+            server->offset_us = peers[i].offset_us;
+            server->delay_us = peers[i].delay_us;
+            server->jitter_us = peers[i].jitter_us;
+            replied = true;
+            responding++;
+        }
+    }
+    if (replied && truechimers == 0) {
+        s_stats.rejected_count++;
+    } else if (truechimers < responding) {
+        s_stats.disagree_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    for (size_t i = 0; i < NTP_SYNC_MAX_SERVERS; i++) {
+        if (peers[i].replies == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s: %u/%u replies, offset %lld us, delay %lld us, jitter %lld us%s",
+                 servers[i], peers[i].replies, peers[i].sent, peers[i].offset_us,
+                 peers[i].delay_us, peers[i].jitter_us,
+                 peers[i].truechimer ? "" : " (falseticker)");
+    }
 
-static void time_sync_notification_cb(struct timeval *tv)
+    if (!replied) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (truechimers == 0) {
+        ESP_LOGW(TAG, "NTP servers disagree, keeping the current time");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (truechimers < responding) {
+        ESP_LOGW(TAG, "NTP servers disagree, using the one %s",
+                 local_trusted ? "closer to the local clock" : "with the lower delay");
+    }
+
+    // Validate timestamp - reject if before Jan 1, 2020
+    struct timeval local;
+    gettimeofday(&local, NULL);
+    if (local.tv_sec + offset_us / 1000000 < NTP_SYNC_MIN_VALID_EPOCH) {
+        ESP_LOGW(TAG, "Rejected invalid NTP time (too old)");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    apply_offset(offset_us);
+    return ESP_OK;
+}
+
+static void apply_offset(int64_t offset_us)
 {
-    // Validate timestamp - reject if before Jan 1, 2020 (1577836800)
-    if (tv->tv_sec < 1577836800) {
-        ESP_LOGW(TAG, "Rejected invalid NTP timestamp: %ld (too old)", tv->tv_sec);
-        return;
+    struct timeval local;
+    gettimeofday(&local, NULL);
+    int64_t mono_us = esp_timer_get_time();
+    int64_t wall_us = (int64_t)local.tv_sec * 1000000 + local.tv_usec + offset_us;
+    bool had_time = (s_source != NTP_SYNC_SOURCE_NONE);
+
+    portENTER_CRITICAL(&s_lock);
+    ntp_discipline_action_t action = ntp_discipline_sample(&s_discipline, offset_us, mono_us);
+    s_drift_mono_us = mono_us;
+    // An offset against an unset clock says nothing about the clock
+    s_stats.last_offset_us = had_time ? offset_us : 0;
+    s_stats.drift_ppb = s_discipline.drift_ppb;
+    s_stats.interval_s = s_discipline.interval_s;
+    s_stats.sync_count++;
+    if (action == NTP_DISCIPLINE_STEP) {
+        s_stats.step_count++;
+    } else {
+        s_stats.slew_count++;
+    }
+    s_stats.last_sync = wall_us / 1000000;
+    int32_t drift_ppb = s_discipline.drift_ppb;
+    uint32_t interval_s = s_discipline.interval_s;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (action == NTP_DISCIPLINE_STEP) {
+        struct timeval tv = {
+            .tv_sec = wall_us / 1000000,
+            .tv_usec = wall_us % 1000000
+        };
+        settimeofday(&tv, NULL);
+        ESP_LOGI(TAG, "Time synchronized! Unix time: %lld (stepped by %lld ms)",
+                 (long long)tv.tv_sec, offset_us / 1000);
+    } else {
+        slew_clock(offset_us);
+        ESP_LOGI(TAG, "Time synchronized! Slewing by %lld us, drift %ld ppb, next sync in %lu s",
+                 offset_us, (long)drift_ppb, interval_s);
     }
 
-    ESP_LOGI(TAG, "Time synchronized! Unix time: %ld", tv->tv_sec);
     s_synced = true;
+    s_source = NTP_SYNC_SOURCE_NTP;
 
-    if (s_sync_event_group) {
-        xEventGroupSetBits(s_sync_event_group, TIME_SYNCED_BIT);
-    }
+    s_rtc_anchor.wall_us = wall_us;
+    s_rtc_anchor.rtc_us = esp_rtc_get_time_us();
+    s_rtc_anchor.magic = RTC_ANCHOR_MAGIC;
 }
 
+// ============================================================================
+// Private - Callbacks
+// ============================================================================
+
 static void on_ntp_config_changed(void* arg, esp_event_base_t event_base,
                                    int32_t event_id, void* event_data)
 {
@@ -329,6 +610,11 @@ static void on_ntp_config_changed(void* arg, esp_event_base_t event_base,
     s_config.sync_interval_ms = (new_config->sync_interval_ms > 0) ?
                                  new_config->sync_interval_ms : 3600000;
 
+    portENTER_CRITICAL(&s_lock);
+    ntp_discipline_set_limits(&s_discipline, s_config.sync_interval_ms / 1000,
+                              CONFIG_TIMEMACHINE_NTP_MAX_INTERVAL_S);
+    portEXIT_CRITICAL(&s_lock);
+
     // Update timezone
     if (s_config.timezone) {
         setenv("TZ", s_config.timezone, 1);
@@ -336,19 +622,139 @@ static void on_ntp_config_changed(void* arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "Timezone updated to: %s", s_config.timezone);
     }
 
-    // Reconfigure SNTP servers
-    esp_sntp_stop();
+    // New servers are queried at the next sync, forget the old ones' history
+    portENTER_CRITICAL(&s_lock);
+    memset(s_server_stats, 0, sizeof(s_server_stats));
+    portEXIT_CRITICAL(&s_lock);
 
     if (s_config.server1) {
-        esp_sntp_setservername(0, s_config.server1);
         ESP_LOGI(TAG, "Primary NTP server updated: %s", s_config.server1);
     }
 
     if (s_config.server2) {
-        esp_sntp_setservername(1, s_config.server2);
         ESP_LOGI(TAG, "Secondary NTP server updated: %s", s_config.server2);
     }
 
-    // Note: sync_interval_ms will be picked up by the background task on next iteration
+    // The job's period follows the new limits from now on
+    update_schedule(true);
     ESP_LOGI(TAG, "NTP sync interval updated to: %lu ms", s_config.sync_interval_ms);
 }
+
+// ============================================================================
+// Private - Clock Discipline
+// ============================================================================
+
+static void slew_clock(int64_t delta_us)
+{
+    if (s_slew_mutex != NULL) {
+        xSemaphoreTake(s_slew_mutex, portMAX_DELAY);
+    }
+
+    // A new adjtime() replaces the one in progress, keep what is left of it
+    struct timeval pending = {0};
+    adjtime(NULL, &pending);
+    delta_us += (int64_t)pending.tv_sec * 1000000 + pending.tv_usec;
+
+    struct timeval delta = {
+        .tv_sec = delta_us / 1000000,
+        .tv_usec = delta_us % 1000000
+    };
+    if (adjtime(&delta, NULL) != 0) {
+        ESP_LOGW(TAG, "Failed to slew clock by %lld us", delta_us);
+    }
+
+    if (s_slew_mutex != NULL) {
+        xSemaphoreGive(s_slew_mutex);
+    }
+}
+
+static void apply_drift(void)
+{
+    int64_t mono_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    int64_t correction_us = ntp_discipline_drift_us(&s_discipline, mono_us - s_drift_mono_us);
+    s_drift_mono_us = mono_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (correction_us != 0) {
+        slew_clock(correction_us);
+    }
+}
+
+static void drift_timer_callback(void *arg)
+{
+    apply_drift();
+}
+
+// ============================================================================
+// Console
+// ============================================================================
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+
+static int cmd_ntp(int argc, char **argv)
+{
+    static const char *const source_names[] = { "none", "RTC", "NVS", "NTP" };
+    ntp_sync_stats_t stats;
+    ntp_sync_get_stats(&stats);
+
+    printf("Time source: %s%s\n", source_names[s_source], s_synced ? "" : " (not synced)");
+    printf("Syncs: %lu (%lu stepped, %lu slewed)\n",
+           stats.sync_count, stats.step_count, stats.slew_count);
+    if (stats.sync_count == 0) {
+        return 0;
+    }
+
+    time_t now = time(NULL);
+    long long offset_us = llabs(stats.last_offset_us);
+    long drift_ppb = labs(stats.drift_ppb);
+    printf("Last sync: %lld s ago, offset %c%lld.%03lld ms\n",
+           (long long)(now - stats.last_sync), stats.last_offset_us < 0 ? '-' : '+',
+           offset_us / 1000, offset_us % 1000);
+    printf("Drift: %c%ld.%03ld ppm\n",
+           stats.drift_ppb < 0 ? '-' : '+', drift_ppb / 1000, drift_ppb % 1000);
+    printf("Interval: %lu s, next sync in %lld s\n",
+           stats.interval_s, (long long)(stats.next_sync - now));
+    if (stats.rejected_count > 0) {
+        printf("Rejected: %lu syncs without a majority\n", stats.rejected_count);
+    }
+    if (stats.disagree_count > 0) {
+        printf("Disagreed: %lu syncs with a falseticker\n", stats.disagree_count);
+    }
+
+    ntp_sync_server_stats_t servers[NTP_SYNC_MAX_SERVERS];
+    size_t count = ntp_sync_get_server_stats(servers, NTP_SYNC_MAX_SERVERS);
+
+    printf("\n%-24s %5s %7s %12s %10s %10s\n",
+           "server", "reach", "replies", "offset_us", "delay_us", "jitter_us");
+    for (size_t i = 0; i < count; i++) {
+        const ntp_sync_server_stats_t *server = &servers[i];
+        printf("%c%-23s %5o %4u/%-2u %12lld %10lld %10lld\n",
+               server->truechimer ? '*' : (server->replies > 0 ? 'x' : ' '),
+               server->server, server->reach, server->replies, server->sent,
+               server->offset_us, server->delay_us, server->jitter_us);
+    }
+    printf("* = selected, x = falseticker\n");
+    return 0;
+}
+
+esp_err_t ntp_sync_register_console_commands(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "ntp",
+        .help = "Show the time source, offset, drift, next sync and per-server offset/delay/jitter",
+        .hint = NULL,
+        .func = cmd_ntp,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+#else
+
+esp_err_t ntp_sync_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
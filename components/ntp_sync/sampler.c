@@ -0,0 +1,367 @@
+/**
+ * @file sampler.c
+ * @brief NTP client sampling: burst queries, clock filter, falseticker rejection
+ */
+
+#include "sampler.h"
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define NTP_PACKET_SIZE   48
+#define NTP_UNIX_OFFSET   2208988800ULL  // Seconds from 1900 to 1970
+#define NTP_VERSION       4
+#define NTP_MODE_CLIENT   3
+#define NTP_MODE_SERVER   4
+#define NTP_LI_ALARM      3              // Leap indicator: server not synchronized
+
+// Packet field offsets
+#define NTP_REFERENCE_ID  12
+#define NTP_ORIGINATE_TS  24
+#define NTP_RECEIVE_TS    32
+#define NTP_TRANSMIT_TS   40
+
+// Pause between the queries of a burst. NIST allows one query every 4 s
+// (time.nist.gov is a default server), others rate-limit faster bursts
+#define SAMPLE_SPACING_US 4000000
+
+// Smallest interval half-width, so precise servers a few hundred us apart agree
+#define MIN_DISTANCE_US   1000
+
+#define MAX_HOST_LEN      64
+
+typedef struct {
+    int64_t offset_us;
+    int64_t delay_us;
+} sample_t;
+
+typedef enum {
+    QUERY_OK,
+    QUERY_FAILED,       // Timeout or unusable reply
+    QUERY_KISS,         // Kiss-o'-death, the server wants no more queries
+} query_result_t;
+
+// ============================================================================
+// Private - Timestamps
+// ============================================================================
+
+static int64_t local_time_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void put_timestamp(uint8_t *p, int64_t unix_us)
+{
+    // Truncation to 32 bits wraps into NTP era 1 in 2036
+    uint32_t sec = (uint32_t)(unix_us / 1000000 + NTP_UNIX_OFFSET);
+    uint32_t frac = (uint32_t)(((uint64_t)(unix_us % 1000000) << 32) / 1000000);
+
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(sec >> (24 - 8 * i));
+        p[4 + i] = (uint8_t)(frac >> (24 - 8 * i));
+    }
+}
+
+static int64_t get_timestamp(const uint8_t *p)
+{
+    uint32_t sec = 0;
+    uint32_t frac = 0;
+
+    for (int i = 0; i < 4; i++) {
+        sec = (sec << 8) | p[i];
+        frac = (frac << 8) | p[4 + i];
+    }
+
+    // Era 0 covers 1968-2036, smaller second counts belong to era 1
+    uint64_t secs = sec;
+    if (sec < 0x80000000u) {
+        secs += 1ULL << 32;
+    }
+
+    return (int64_t)(secs - NTP_UNIX_OFFSET) * 1000000 + (int64_t)(((uint64_t)frac * 1000000) >> 32);
+}
+
+// ============================================================================
+// Private - Queries
+// ============================================================================
+
+/**
+ * @brief Send one query and wait for its reply
+ *
+ * @param kiss Receives the kiss code on QUERY_KISS
+ * @return QUERY_OK with a sample
+ */
+static query_result_t query_once(int sock, uint32_t timeout_ms, sample_t *out, char kiss[5])
+{
+    uint8_t pkt[NTP_PACKET_SIZE] = {0};
+    pkt[0] = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+
+    // The server echoes our transmit time as originate, matching the reply
+    int64_t t1 = local_time_us();
+    put_timestamp(&pkt[NTP_TRANSMIT_TS], t1);
+    uint8_t sent_ts[8];
+    memcpy(sent_ts, &pkt[NTP_TRANSMIT_TS], sizeof(sent_ts));
+
+    if (send(sock, pkt, sizeof(pkt), 0) != sizeof(pkt)) {
+        return QUERY_FAILED;
+    }
+
+    int64_t deadline_us = t1 + (int64_t)timeout_ms * 1000;
+
+    while (1) {
+        ssize_t len = recv(sock, pkt, sizeof(pkt), 0);
+        int64_t t4 = local_time_us();
+        if (len < 0 || t4 > deadline_us) {
+            return QUERY_FAILED;
+        }
+
+        // Late replies to an earlier query of the burst are skipped
+        if (len < NTP_PACKET_SIZE || memcmp(&pkt[NTP_ORIGINATE_TS], sent_ts, sizeof(sent_ts)) != 0) {
+            continue;
+        }
+
+        uint8_t li = pkt[0] >> 6;
+        uint8_t mode = pkt[0] & 0x07;
+        uint8_t stratum = pkt[1];
+        if (mode == NTP_MODE_SERVER && stratum == 0) {
+            // Kiss-o'-death, the code (RATE, DENY, ...) is in the reference ID
+            memcpy(kiss, &pkt[NTP_REFERENCE_ID], 4);
+            kiss[4] = '\0';
+            return QUERY_KISS;
+        }
+        if (mode != NTP_MODE_SERVER || li == NTP_LI_ALARM || stratum > 15) {
+            // Unsynchronized server
+            return QUERY_FAILED;
+        }
+
+        int64_t t2 = get_timestamp(&pkt[NTP_RECEIVE_TS]);
+        int64_t t3 = get_timestamp(&pkt[NTP_TRANSMIT_TS]);
+
+        out->offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+        out->delay_us = (t4 - t1) - (t3 - t2);
+        if (out->delay_us < 0) {
+            out->delay_us = 0;
+        }
+        return QUERY_OK;
+    }
+}
+
+static int open_socket(const char *server, uint32_t timeout_ms)
+{
+    char host[MAX_HOST_LEN];
+    const char *port = "123";
+
+    // "host:port", a single colon so IPv6 literals are left alone
+    const char *colon = strchr(server, ':');
+    size_t host_len = strlen(server);
+    if (colon != NULL && strchr(colon + 1, ':') == NULL) {
+        host_len = (size_t)(colon - server);
+        port = colon + 1;
+    }
+    if (host_len == 0 || host_len >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, server, host_len);
+    host[host_len] = '\0';
+
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, port, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock >= 0) {
+        struct timeval tv = {
+            .tv_sec = timeout_ms / 1000,
+            .tv_usec = (timeout_ms % 1000) * 1000
+        };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        // Connected, so only the server's datagrams are received
+        if (connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+    return sock;
+}
+
+static int64_t isqrt(uint64_t value)
+{
+    uint64_t x = value;
+    uint64_t y = (x + 1) / 2;
+
+    while (y < x) {
+        x = y;
+        y = (x + value / x) / 2;
+    }
+    return (int64_t)x;
+}
+
+// Half-width of the interval the server's true offset lies in
+static int64_t distance_us(const ntp_sampler_peer_t *peer)
+{
+    int64_t distance = peer->delay_us / 2 + peer->jitter_us;
+    return distance < MIN_DISTANCE_US ? MIN_DISTANCE_US : distance;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+int ntp_sampler_poll(const char *server, uint8_t samples, uint32_t timeout_ms,
+                     ntp_sampler_peer_t *peer)
+{
+    sample_t buf[NTP_SAMPLER_MAX_SAMPLES];
+
+    *peer = (ntp_sampler_peer_t){0};
+    if (samples == 0) {
+        samples = 1;
+    } else if (samples > NTP_SAMPLER_MAX_SAMPLES) {
+        samples = NTP_SAMPLER_MAX_SAMPLES;
+    }
+
+    int sock = open_socket(server, timeout_ms);
+    if (sock < 0) {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < samples; i++) {
+        if (i > 0) {
+            usleep(SAMPLE_SPACING_US);
+        }
+        peer->sent++;
+        query_result_t result = query_once(sock, timeout_ms, &buf[peer->replies], peer->kiss);
+        if (result == QUERY_OK) {
+            peer->replies++;
+        } else if (result == QUERY_KISS) {
+            break;      // Not queried again this round, the replies so far still count
+        }
+    }
+    close(sock);
+
+    if (peer->replies == 0) {
+        return 0;
+    }
+
+    // Clock filter: the shortest round trip has the least queueing asymmetry
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < peer->replies; i++) {
+        if (buf[i].delay_us < buf[best].delay_us) {
+            best = i;
+        }
+    }
+    peer->offset_us = buf[best].offset_us;
+    peer->delay_us = buf[best].delay_us;
+
+    if (peer->replies > 1) {
+        uint64_t sum_sq = 0;
+        for (uint8_t i = 0; i < peer->replies; i++) {
+            int64_t diff = buf[i].offset_us - peer->offset_us;
+            sum_sq += (uint64_t)(diff * diff);
+        }
+        peer->jitter_us = isqrt(sum_sq / (peer->replies - 1));
+    }
+
+    return peer->replies;
+}
+
+size_t ntp_sampler_select(ntp_sampler_peer_t *peers, size_t count, bool local_trusted,
+                          int64_t *offset_us)
+{
+    size_t responding = 0;
+    size_t best_count = 0;
+    int64_t best_point = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        peers[i].truechimer = false;
+        if (peers[i].replies > 0) {
+            responding++;
+        }
+    }
+    if (responding == 0) {
+        return 0;
+    }
+
+    // The intersection of a set of intervals starts at one of their lower
+    // ends, so it is enough to count the intervals containing each of those
+    for (size_t i = 0; i < count; i++) {
+        if (peers[i].replies == 0) {
+            continue;
+        }
+
+        int64_t point = peers[i].offset_us - distance_us(&peers[i]);
+        size_t containing = 0;
+        for (size_t j = 0; j < count; j++) {
+            if (peers[j].replies > 0 &&
+                llabs(peers[j].offset_us - point) <= distance_us(&peers[j])) {
+                containing++;
+            }
+        }
+        if (containing > best_count) {
+            best_count = containing;
+            best_point = point;
+        }
+    }
+
+    if (best_count * 2 <= responding && responding == 2) {
+        // Two servers that disagree have no majority. Rather than never
+        // syncing, trust the one closer to a trusted local clock, or else
+        // the one with the narrower interval
+        ntp_sampler_peer_t *pick = NULL;
+        for (size_t i = 0; i < count; i++) {
+            if (peers[i].replies == 0) {
+                continue;
+            }
+            if (pick == NULL ||
+                (local_trusted ? llabs(peers[i].offset_us) < llabs(pick->offset_us)
+                               : distance_us(&peers[i]) < distance_us(pick))) {
+                pick = &peers[i];
+            }
+        }
+        pick->truechimer = true;
+        *offset_us = pick->offset_us;
+        return 1;
+    }
+    if (best_count * 2 <= responding) {
+        return 0;
+    }
+
+    // Weighted around the first truechimer, the differences stay small even
+    // when the local clock is decades off
+    int64_t ref_us = 0;
+    int64_t weighted_sum = 0;
+    int64_t weight_total = 0;
+    bool have_ref = false;
+
+    for (size_t i = 0; i < count; i++) {
+        if (peers[i].replies == 0 ||
+            llabs(peers[i].offset_us - best_point) > distance_us(&peers[i])) {
+            continue;
+        }
+
+        peers[i].truechimer = true;
+        if (!have_ref) {
+            ref_us = peers[i].offset_us;
+            have_ref = true;
+        }
+
+        int64_t weight = 1000000000LL / distance_us(&peers[i]);
+        weighted_sum += (peers[i].offset_us - ref_us) * weight;
+        weight_total += weight;
+    }
+
+    *offset_us = ref_us + weighted_sum / weight_total;
+    return best_count;
+}
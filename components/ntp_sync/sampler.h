@@ -0,0 +1,71 @@
+/**
+ * @file sampler.h
+ * @brief NTP client sampling: burst queries, clock filter, falseticker rejection
+ *
+ * Each server is queried several times and only its minimum-delay sample is
+ * kept, as the reply with the shortest round trip has the least asymmetric
+ * queueing. Servers whose correctness intervals do not overlap the majority
+ * are rejected as falsetickers (Marzullo's algorithm). Plain POSIX sockets
+ * with no ESP-IDF dependencies, so it also runs on the host against
+ * tools/ntp_standin.py.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NTP_SAMPLER_DEFAULT_PORT 123
+#define NTP_SAMPLER_MAX_SAMPLES  8
+
+/**
+ * @brief Filtered result for one server
+ */
+typedef struct {
+    uint8_t sent;           /**< Queries sent */
+    uint8_t replies;        /**< Valid replies received */
+    int64_t offset_us;      /**< Offset of the minimum-delay sample, reference minus local */
+    int64_t delay_us;       /**< Round-trip delay of that sample */
+    int64_t jitter_us;      /**< RMS difference of the other samples' offsets to it */
+    char kiss[5];           /**< Kiss-o'-death code that ended the burst (e.g. "RATE"), "" if none */
+    bool truechimer;        /**< Agrees with the majority, set by ntp_sampler_select() */
+} ntp_sampler_peer_t;
+
+/**
+ * @brief Query a server and filter its replies
+ *
+ * Queries are 4 s apart, the most NIST allows, so a burst blocks for up
+ * to samples * (timeout_ms + 4 s) plus name resolution. A kiss-o'-death
+ * ends the burst.
+ *
+ * @param server     "host" or "host:port" (e.g. "192.168.1.10:12300")
+ * @param samples    Queries to send, 1..NTP_SAMPLER_MAX_SAMPLES
+ * @param timeout_ms Wait for each reply
+ * @param peer       Receives the filtered result (replies = 0 if none)
+ * @return Number of valid replies, -1 if the server could not be resolved
+ *         or no socket was available
+ */
+int ntp_sampler_poll(const char *server, uint8_t samples, uint32_t timeout_ms,
+                     ntp_sampler_peer_t *peer);
+
+/**
+ * @brief Select the truechimers and combine their offsets
+ *
+ * Each server with replies stands for the interval offset +- (delay / 2 +
+ * jitter). The largest set of servers whose intervals intersect wins if it
+ * is a majority of the servers that replied; their offsets are averaged
+ * weighted by the inverse of the interval width.
+ *
+ * Two servers that disagree have no majority. The one closer to the local
+ * clock is used if that is trusted, otherwise the one with the narrower
+ * interval, so fewer truechimers than responding servers are returned.
+ *
+ * @param peers         Results of ntp_sampler_poll(), truechimer is set on return
+ * @param count         Number of peers
+ * @param local_trusted The local clock is known good (RTC anchor or synced)
+ * @param offset_us     Receives the combined offset
+ * @return Number of truechimers, 0 if no server replied or there is no majority
+ */
+size_t ntp_sampler_select(ntp_sampler_peer_t *peers, size_t count, bool local_trusted,
+                          int64_t *offset_us);
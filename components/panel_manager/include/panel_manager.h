@@ -2,6 +2,7 @@
 
 #include "esp_err.h"
 #include "timemachine_events.h"
+#include "display.h"
 
 
 /**
@@ -10,14 +11,53 @@
 typedef struct {
     panel_id_t default_panel;      /**< Default panel to show (typically PANEL_CLOCK) */
     uint16_t inactivity_timeout_s; /**< Seconds of inactivity before returning to default panel */
+    display_transition_t transition; /**< Effect used when switching panels */
+    timemachine_playlist_t playlist; /**< Cycle order and dwell times, empty = all panels */
 } panel_manager_config_t;
 
+/**
+ * @brief Panel interface
+ *
+ * Called directly by the panel manager. PANEL_ACTIVATED/PANEL_DEACTIVATED
+ * are still posted for other listeners.
+ */
+typedef struct {
+    /**
+     * Start periodic updates. The manager has already shown the frame
+     * from render_into_buffer(), so the panel should not render here.
+     */
+    esp_err_t (*activate)(void);
+
+    /** Stop periodic updates */
+    void (*deactivate)(void);
+
+    /**
+     * Rasterize the panel's current content. Called from any task, also
+     * while the panel is inactive to prerender it.
+     *
+     * @return ESP_OK, or ESP_ERR_NOT_FOUND if the panel has nothing to show
+     *         and should be skipped
+     */
+    esp_err_t (*render_into_buffer)(display_frame_t *frame);
+
+    /**
+     * esp_timer time (us) at which a frame rendered now becomes stale,
+     * INT64_MAX if the content only changes on external events (also
+     * assumed when NULL). The manager renders the active and prerendered
+     * panels again on NTP_SYNCED (which follows clock steps),
+     * CLOCK_CONFIG_CHANGED, LANGUAGE_CHANGED and WEATHER_UPDATED.
+     */
+    int64_t (*next_wakeup)(void);
+
+    const char *name;
+} panel_ops_t;
+
 /**
  * @brief Panel registration data
  */
 typedef struct {
-    panel_id_t id;          /**< Unique panel ID */
-    const char *name;       /**< Panel name for debugging */
+    panel_id_t id;            /**< Unique panel ID */
+    const panel_ops_t *ops;   /**< Panel implementation */
 } panel_info_t;
 
 /**
@@ -26,6 +66,12 @@ typedef struct {
  * The panel manager coordinates which panel is currently active.
  * On initialization, it activates the default panel.
  *
+ * Taps advance through the playlist. Entries with a dwell time advance on
+ * their own; entries without one stay until tapped and return to the
+ * default panel after the inactivity timeout. All deadlines share a single
+ * one-shot timer, so an idle display does not wake up every second.
+ * PLAYLIST_CHANGED replaces the playlist at runtime.
+ *
  * @param config Configuration parameters
  * @return ESP_OK on success, error code otherwise
  */
@@ -39,8 +85,11 @@ void panel_manager_deinit(void);
 /**
  * @brief Register a panel with the manager
  *
- * Panels must register themselves during initialization.
+ * Panels must register themselves during initialization. Safe to call from
+ * any task; the panel joins the cycle in the default event loop task.
  * If the registered panel is the default panel, it will be activated automatically.
+ * The panel that follows the active one in the cycle is kept prerendered so
+ * a tap only has to flush it.
  *
  * @param panel Panel information
  * @return ESP_OK on success, error code otherwise
@@ -54,3 +103,9 @@ esp_err_t panel_manager_register_panel(const panel_info_t *panel);
  */
 panel_id_t panel_manager_get_active(void);
 
+/**
+ * @brief Register the `playlist` console command
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CONFIG_TIMEMACHINE_CONSOLE
+ */
+esp_err_t panel_manager_register_console_commands(void);
@@ -1,36 +1,98 @@
 #include "panel_manager.h"
+#include "perf.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/timers.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
+
 static const char *TAG = "panel_manager";
 
 // Maximum number of panels that can be registered
 #define MAX_PANELS 8
 
+// Retry delay when the deadline event cannot be queued
+#define DEADLINE_RETRY_US 10000
+
+// Panel switching only ever runs in the default event loop task. The
+// deadline timer and registrations from other tasks post these events
+// instead of touching the display themselves.
+ESP_EVENT_DEFINE_BASE(PANEL_MANAGER_EVENT);
+
+enum {
+    PANEL_MANAGER_DEADLINE,     /**< The deadline timer expired */
+    PANEL_MANAGER_REFRESH,      /**< A panel was registered */
+    PANEL_MANAGER_CONTENT,      /**< Time, language, clock format or weather changed */
+};
+
+// Events that change what panels show without them going stale by time.
+// NTP_SYNCED also follows every clock step
+static const int32_t s_content_events[] = {
+    NTP_SYNCED,
+    CLOCK_CONFIG_CHANGED,
+    LANGUAGE_CHANGED,
+    WEATHER_UPDATED,
+};
+#define CONTENT_EVENT_COUNT (sizeof(s_content_events) / sizeof(s_content_events[0]))
+
 static struct {
     bool initialized;
     panel_manager_config_t config;
     panel_info_t panels[MAX_PANELS];
     uint8_t panel_count;
     uint8_t active_panel_idx;
-    uint16_t inactivity_counter;
-    TimerHandle_t inactivity_timer;
+    bool panel_shown;
+    int64_t shown_us;           /**< When the active panel was shown or last tapped */
+    struct {
+        uint8_t panel_idx[MAX_PANELS];
+        uint16_t dwell_s[MAX_PANELS];
+        uint8_t count;
+        bool rotating;          /**< At least one entry advances on its own */
+    } order;
+    esp_timer_handle_t deadline_timer;
+    uint32_t content_gen;       /**< Bumped by every content event */
+    struct {
+        bool valid;
+        uint8_t panel_idx;
+        int64_t stale_us;       /**< Frame must be rendered again after this time */
+        uint32_t content_gen;   /**< content_gen when it was rendered */
+        display_frame_t frame;
+    } prerender;
     esp_event_handler_instance_t input_touch_handler;
     esp_event_handler_instance_t panel_skip_handler;
+    esp_event_handler_instance_t playlist_handler;
+    esp_event_handler_instance_t content_handlers[CONTENT_EVENT_COUNT];
+    esp_event_handler_instance_t internal_handler;
 } s_state = {0};
 
+// Guards registration, which may happen from any task
+static portMUX_TYPE s_register_lock = portMUX_INITIALIZER_UNLOCKED;
+
 // Forward declarations
-static esp_err_t activate_panel(panel_id_t panel_id);
-static esp_err_t deactivate_panel(panel_id_t panel_id);
+static esp_err_t activate_panel(uint8_t idx);
+static esp_err_t deactivate_panel(uint8_t idx);
+static esp_err_t show_panel(uint8_t idx);
 static esp_err_t next_panel(void);
-static void inactivity_timer_callback(TimerHandle_t xTimer);
+static void rebuild_order(void);
+static void prerender_next(void);
+static void reschedule(void);
+static void deadline_timer_callback(void *arg);
 static void input_touch_handler(void* arg, esp_event_base_t base,
                                 int32_t event_id, void* event_data);
 static void panel_skip_handler(void* arg, esp_event_base_t base,
                                int32_t event_id, void* event_data);
+static void playlist_handler(void* arg, esp_event_base_t base,
+                             int32_t event_id, void* event_data);
+static void content_handler(void* arg, esp_event_base_t base,
+                            int32_t event_id, void* event_data);
+static void internal_handler(void* arg, esp_event_base_t base,
+                             int32_t event_id, void* event_data);
 
 // ============================================================================
 // Public API
@@ -50,33 +112,37 @@ esp_err_t panel_manager_init(const panel_manager_config_t *config)
 
     memset(&s_state, 0, sizeof(s_state));
     s_state.config = *config;
-    s_state.panel_count = 0;
-    s_state.active_panel_idx = 0;
-    s_state.inactivity_counter = 0;
-
-    // Create inactivity timer (1 second period)
-    s_state.inactivity_timer = xTimerCreate(
-        "inactivity",
-        pdMS_TO_TICKS(1000),  // 1 second period
-        pdTRUE,               // Auto-reload
-        NULL,
-        inactivity_timer_callback
-    );
-    if (s_state.inactivity_timer == NULL) {
-        ESP_LOGE(TAG, "Failed to create inactivity timer");
-        return ESP_ERR_NO_MEM;
+    if (s_state.config.playlist.count > TIMEMACHINE_PLAYLIST_MAX) {
+        s_state.config.playlist.count = 0;
+    }
+
+    // One-shot timer armed for the nearest of: dwell expiry, inactivity
+    // timeout and prerendered frame going stale
+    const esp_timer_create_args_t deadline_timer_args = {
+        .callback = deadline_timer_callback,
+        .name = "panel_deadline"
+    };
+    esp_err_t err = esp_timer_create(&deadline_timer_args, &s_state.deadline_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create deadline timer");
+        return err;
     }
 
-    // Start inactivity timer
-    if (xTimerStart(s_state.inactivity_timer, 0) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to start inactivity timer");
-        xTimerDelete(s_state.inactivity_timer, 0);
-        s_state.inactivity_timer = NULL;
-        return ESP_FAIL;
+    err = esp_event_handler_instance_register(
+        PANEL_MANAGER_EVENT,
+        ESP_EVENT_ANY_ID,
+        internal_handler,
+        NULL,
+        &s_state.internal_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register internal handler");
+        panel_manager_deinit();
+        return err;
     }
 
     // Register INPUT_TAP handler for panel navigation
-    esp_err_t err = esp_event_handler_instance_register(
+    err = esp_event_handler_instance_register(
         TIMEMACHINE_EVENT,
         INPUT_TAP,
         input_touch_handler,
@@ -103,27 +169,70 @@ esp_err_t panel_manager_init(const panel_manager_config_t *config)
         return err;
     }
 
+    err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        PLAYLIST_CHANGED,
+        playlist_handler,
+        NULL,
+        &s_state.playlist_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register PLAYLIST_CHANGED handler");
+        panel_manager_deinit();
+        return err;
+    }
+
+    for (size_t i = 0; i < CONTENT_EVENT_COUNT; i++) {
+        err = esp_event_handler_instance_register(
+            TIMEMACHINE_EVENT,
+            s_content_events[i],
+            content_handler,
+            NULL,
+            &s_state.content_handlers[i]
+        );
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register content event handler");
+            panel_manager_deinit();
+            return err;
+        }
+    }
+
     s_state.initialized = true;
-    ESP_LOGI(TAG, "Panel manager initialized (default: %d, timeout: %ds)",
-             config->default_panel, config->inactivity_timeout_s);
+    ESP_LOGI(TAG, "Panel manager initialized (default: %d, timeout: %ds, playlist: %d entries)",
+             config->default_panel, config->inactivity_timeout_s, s_state.config.playlist.count);
 
     return ESP_OK;
 }
 
 void panel_manager_deinit(void)
 {
-    if (!s_state.initialized) {
-        return;
+    if (s_state.deadline_timer != NULL) {
+        esp_timer_stop(s_state.deadline_timer);
+        esp_timer_delete(s_state.deadline_timer);
+        s_state.deadline_timer = NULL;
+    }
+
+    // Unregister event handlers
+    for (size_t i = 0; i < CONTENT_EVENT_COUNT; i++) {
+        if (s_state.content_handlers[i] != NULL) {
+            esp_event_handler_instance_unregister(
+                TIMEMACHINE_EVENT,
+                s_content_events[i],
+                s_state.content_handlers[i]
+            );
+            s_state.content_handlers[i] = NULL;
+        }
     }
 
-    // Stop and delete timer
-    if (s_state.inactivity_timer != NULL) {
-        xTimerStop(s_state.inactivity_timer, 0);
-        xTimerDelete(s_state.inactivity_timer, 0);
-        s_state.inactivity_timer = NULL;
+    if (s_state.playlist_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            PLAYLIST_CHANGED,
+            s_state.playlist_handler
+        );
+        s_state.playlist_handler = NULL;
     }
 
-    // Unregister event handlers
     if (s_state.panel_skip_handler != NULL) {
         esp_event_handler_instance_unregister(
             TIMEMACHINE_EVENT,
@@ -141,8 +250,20 @@ void panel_manager_deinit(void)
         );
         s_state.input_touch_handler = NULL;
     }
-    s_state.initialized = false;
-    ESP_LOGI(TAG, "Panel manager deinitialized");
+
+    if (s_state.internal_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            PANEL_MANAGER_EVENT,
+            ESP_EVENT_ANY_ID,
+            s_state.internal_handler
+        );
+        s_state.internal_handler = NULL;
+    }
+
+    if (s_state.initialized) {
+        s_state.initialized = false;
+        ESP_LOGI(TAG, "Panel manager deinitialized");
+    }
 }
 
 esp_err_t panel_manager_register_panel(const panel_info_t *panel)
@@ -152,42 +273,47 @@ esp_err_t panel_manager_register_panel(const panel_info_t *panel)
         return ESP_ERR_INVALID_STATE;
     }
 
-    if (panel == NULL) {
+    if (panel == NULL || panel->ops == NULL || panel->ops->render_into_buffer == NULL) {
         ESP_LOGE(TAG, "Invalid panel");
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (s_state.panel_count >= MAX_PANELS) {
-        ESP_LOGE(TAG, "Maximum number of panels reached");
-        return ESP_ERR_NO_MEM;
-    }
+    bool duplicate = false;
+    bool full = false;
 
-    // Check if panel already registered
+    portENTER_CRITICAL(&s_register_lock);
     for (uint8_t i = 0; i < s_state.panel_count; i++) {
         if (s_state.panels[i].id == panel->id) {
-            ESP_LOGW(TAG, "Panel %d already registered", panel->id);
-            return ESP_OK;
+            duplicate = true;
+            break;
         }
     }
+    full = !duplicate && s_state.panel_count >= MAX_PANELS;
+    if (!duplicate && !full) {
+        // The entry is complete before the count makes it visible
+        s_state.panels[s_state.panel_count] = *panel;
+        s_state.panel_count++;
+    }
+    portEXIT_CRITICAL(&s_register_lock);
 
-    s_state.panels[s_state.panel_count] = *panel;
-    s_state.panel_count++;
+    if (duplicate) {
+        ESP_LOGW(TAG, "Panel %d already registered", panel->id);
+        return ESP_OK;
+    }
+    if (full) {
+        ESP_LOGE(TAG, "Maximum number of panels reached");
+        return ESP_ERR_NO_MEM;
+    }
 
-    ESP_LOGI(TAG, "Registered panel: %s (id=%d)", panel->name, panel->id);
+    ESP_LOGI(TAG, "Registered panel: %s (id=%d)", panel->ops->name, panel->id);
 
-    // If this is the default panel, activate it
-    if (panel->id == s_state.config.default_panel) {
-        // Find index of this panel
-        for (uint8_t i = 0; i < s_state.panel_count; i++) {
-            if (s_state.panels[i].id == panel->id) {
-                s_state.active_panel_idx = i;
-                activate_panel(panel->id);
-                break;
-            }
-        }
+    // Showing the default panel and prerendering happen in the event loop
+    esp_err_t err = esp_event_post(PANEL_MANAGER_EVENT, PANEL_MANAGER_REFRESH, NULL, 0, portMAX_DELAY);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to post refresh event");
     }
 
-    return ESP_OK;
+    return err;
 }
 
 panel_id_t panel_manager_get_active(void)
@@ -202,17 +328,111 @@ panel_id_t panel_manager_get_active(void)
 // Private Functions
 // ============================================================================
 
-static esp_err_t activate_panel(panel_id_t panel_id)
+static int find_panel(panel_id_t id)
+{
+    for (uint8_t i = 0; i < s_state.panel_count; i++) {
+        if (s_state.panels[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int order_position(uint8_t idx)
 {
-    ESP_LOGI(TAG, "Activating panel %d", panel_id);
+    for (uint8_t pos = 0; pos < s_state.order.count; pos++) {
+        if (s_state.order.panel_idx[pos] == idx) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Resolve the playlist against the registered panels
+ *
+ * Entries for panels that are not registered (yet) are left out. An empty
+ * playlist cycles through all panels in registration order.
+ */
+static void rebuild_order(void)
+{
+    const timemachine_playlist_t *playlist = &s_state.config.playlist;
+
+    s_state.order.count = 0;
+    s_state.order.rotating = false;
+
+    if (playlist->count == 0) {
+        for (uint8_t i = 0; i < s_state.panel_count; i++) {
+            s_state.order.panel_idx[i] = i;
+            s_state.order.dwell_s[i] = 0;
+        }
+        s_state.order.count = s_state.panel_count;
+        return;
+    }
 
-    s_state.inactivity_counter = 0;
+    for (uint8_t i = 0; i < playlist->count && s_state.order.count < MAX_PANELS; i++) {
+        int idx = find_panel(playlist->entries[i].panel_id);
+        if (idx < 0) {
+            continue;
+        }
+        s_state.order.panel_idx[s_state.order.count] = idx;
+        s_state.order.dwell_s[s_state.order.count] = playlist->entries[i].dwell_s;
+        s_state.order.count++;
 
-    // Emit PANEL_ACTIVATED event
+        if (playlist->entries[i].dwell_s > 0) {
+            s_state.order.rotating = true;
+        }
+    }
+}
+
+/**
+ * @brief Panel index at a number of steps after the active panel in the cycle
+ *
+ * A panel outside the playlist is followed by the first entry.
+ */
+static uint8_t order_after_active(uint8_t step)
+{
+    int pos = order_position(s_state.active_panel_idx);
+    return s_state.order.panel_idx[(pos + step) % s_state.order.count];
+}
+
+/**
+ * @brief How long the active panel stays up before advancing, 0 = until tapped
+ *
+ * While the playlist rotates, a panel outside it (e.g. the default panel
+ * when it is not listed) hands over after the inactivity timeout.
+ */
+static int64_t active_dwell_us(void)
+{
+    int pos = order_position(s_state.active_panel_idx);
+    if (pos >= 0) {
+        return (int64_t)s_state.order.dwell_s[pos] * 1000000;
+    }
+    if (s_state.order.rotating) {
+        return (int64_t)s_state.config.inactivity_timeout_s * 1000000;
+    }
+    return 0;
+}
+
+static esp_err_t activate_panel(uint8_t idx)
+{
+    const panel_info_t *panel = &s_state.panels[idx];
+
+    ESP_LOGI(TAG, "Activating panel %s", panel->ops->name);
+
+    if (panel->ops->activate != NULL) {
+        esp_err_t err = panel->ops->activate();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Panel %s failed to activate: %s",
+                     panel->ops->name, esp_err_to_name(err));
+        }
+    }
+
+    // Emit PANEL_ACTIVATED event for other listeners
     esp_err_t err = esp_event_post(
         TIMEMACHINE_EVENT,
         PANEL_ACTIVATED,
-        &panel_id,
+        &panel->id,
         sizeof(panel_id_t),
         portMAX_DELAY
     );
@@ -225,15 +445,21 @@ static esp_err_t activate_panel(panel_id_t panel_id)
     return ESP_OK;
 }
 
-static esp_err_t deactivate_panel(panel_id_t panel_id)
+static esp_err_t deactivate_panel(uint8_t idx)
 {
-    ESP_LOGI(TAG, "Deactivating panel %d", panel_id);
+    const panel_info_t *panel = &s_state.panels[idx];
+
+    ESP_LOGI(TAG, "Deactivating panel %s", panel->ops->name);
+
+    if (panel->ops->deactivate != NULL) {
+        panel->ops->deactivate();
+    }
 
     // Emit PANEL_DEACTIVATED event
     esp_err_t err = esp_event_post(
         TIMEMACHINE_EVENT,
         PANEL_DEACTIVATED,
-        &panel_id,
+        &panel->id,
         sizeof(panel_id_t),
         portMAX_DELAY
     );
@@ -246,37 +472,285 @@ static esp_err_t deactivate_panel(panel_id_t panel_id)
     return ESP_OK;
 }
 
+/**
+ * @brief Copy the prerendered frame of a panel if it is still fresh
+ *
+ * A frame rendered before the last content event is not, even if the
+ * event has not been acted on yet.
+ */
+static bool take_prerendered(uint8_t idx, display_frame_t *frame)
+{
+    if (s_state.prerender.valid && s_state.prerender.panel_idx == idx &&
+        s_state.prerender.content_gen == s_state.content_gen &&
+        esp_timer_get_time() < s_state.prerender.stale_us) {
+        *frame = s_state.prerender.frame;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Rasterize the panel that follows the active one
+ *
+ * Panels with nothing to show are skipped, like next_panel() does.
+ */
+static void prerender_next(void)
+{
+    s_state.prerender.valid = false;
+
+    for (uint8_t step = 1; step <= s_state.order.count; step++) {
+        uint8_t idx = order_after_active(step);
+        if (idx == s_state.active_panel_idx) {
+            continue;
+        }
+
+        const panel_ops_t *ops = s_state.panels[idx].ops;
+        if (ops->render_into_buffer(&s_state.prerender.frame) != ESP_OK) {
+            continue;
+        }
+
+        s_state.prerender.valid = true;
+        s_state.prerender.panel_idx = idx;
+        s_state.prerender.content_gen = s_state.content_gen;
+        // Without next_wakeup the content only changes on external events
+        s_state.prerender.stale_us = ops->next_wakeup ? ops->next_wakeup() : INT64_MAX;
+
+        ESP_LOGD(TAG, "Prerendered panel %s", ops->name);
+        return;
+    }
+}
+
+/**
+ * @brief Arm the deadline timer for the nearest pending deadline
+ */
+static void reschedule(void)
+{
+    int64_t deadline_us = INT64_MAX;
+
+    if (s_state.panel_shown) {
+        int64_t dwell_us = active_dwell_us();
+        panel_id_t active_id = s_state.panels[s_state.active_panel_idx].id;
+
+        if (dwell_us > 0) {
+            deadline_us = s_state.shown_us + dwell_us;
+        } else if (active_id != s_state.config.default_panel &&
+                   s_state.config.inactivity_timeout_s > 0) {
+            deadline_us = s_state.shown_us +
+                          (int64_t)s_state.config.inactivity_timeout_s * 1000000;
+        }
+    }
+
+    if (s_state.prerender.valid && s_state.prerender.stale_us < deadline_us) {
+        deadline_us = s_state.prerender.stale_us;
+    }
+
+    esp_timer_stop(s_state.deadline_timer);
+
+    if (deadline_us != INT64_MAX) {
+        int64_t delay_us = deadline_us - esp_timer_get_time();
+        esp_timer_start_once(s_state.deadline_timer, delay_us > 0 ? delay_us : 0);
+    }
+}
+
+/**
+ * @brief Switch the display to a panel
+ *
+ * Uses the prerendered frame when it is fresh, otherwise renders the panel
+ * now. The active panel is left untouched if the new one has nothing to show.
+ *
+ * @return ESP_OK, or the error from render_into_buffer()
+ */
+static esp_err_t show_panel(uint8_t idx)
+{
+    const panel_info_t *panel = &s_state.panels[idx];
+    display_frame_t frame;
+
+    bool prerendered = take_prerendered(idx, &frame);
+    if (!prerendered) {
+        esp_err_t err = panel->ops->render_into_buffer(&frame);
+        if (err != ESP_OK) {
+            ESP_LOGI(TAG, "Panel %s has nothing to show: %s",
+                     panel->ops->name, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    bool was_shown = s_state.panel_shown;
+    if (was_shown) {
+        deactivate_panel(s_state.active_panel_idx);
+    }
+
+    s_state.active_panel_idx = idx;
+    s_state.panel_shown = true;
+    s_state.shown_us = esp_timer_get_time();
+
+    perf_input_mark(PERF_INPUT_PANEL_SWITCHED);
+    if (was_shown) {
+        display_present_transition(&frame, &s_state.config.transition);
+    } else {
+        display_present(&frame);
+    }
+    ESP_LOGI(TAG, "Showing panel %s (%s)", panel->ops->name,
+             prerendered ? "prerendered" : "rendered on demand");
+
+    activate_panel(idx);
+
+    // Off the tap-to-pixel path: the frame is already on the display
+    prerender_next();
+    reschedule();
+
+    return ESP_OK;
+}
+
 static esp_err_t next_panel(void)
 {
-    if (s_state.panel_count == 0) {
+    if (s_state.order.count == 0) {
         ESP_LOGW(TAG, "No panels registered");
         return ESP_ERR_INVALID_STATE;
     }
 
-    ESP_LOGI(TAG, "Cycling panels: current=%d, total=%d", s_state.active_panel_idx, s_state.panel_count);
+    ESP_LOGD(TAG, "Cycling panels: current=%d, total=%d",
+             s_state.active_panel_idx, s_state.order.count);
 
-    panel_id_t current_panel_id = s_state.panels[s_state.active_panel_idx].id;
+    // Try the following panels in order, skipping those without content
+    for (uint8_t step = 1; step <= s_state.order.count; step++) {
+        uint8_t idx = order_after_active(step);
+        if (idx == s_state.active_panel_idx) {
+            continue;
+        }
+        if (show_panel(idx) == ESP_OK) {
+            return ESP_OK;
+        }
+    }
 
-    // Deactivate current panel
-    deactivate_panel(current_panel_id);
+    ESP_LOGI(TAG, "No other panel has content to show");
+    return ESP_ERR_NOT_FOUND;
+}
 
-    // Calculate next panel index (circular)
-    s_state.active_panel_idx = (s_state.active_panel_idx + 1) % s_state.panel_count;
-    panel_id_t next_panel_id = s_state.panels[s_state.active_panel_idx].id;
+/**
+ * @brief Act on every deadline that has passed, then arm the next one
+ */
+static void on_deadline(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (s_state.panel_shown) {
+        int64_t dwell_us = active_dwell_us();
+        panel_id_t active_id = s_state.panels[s_state.active_panel_idx].id;
+        int64_t timeout_us = (int64_t)s_state.config.inactivity_timeout_s * 1000000;
+
+        if (dwell_us > 0 && now >= s_state.shown_us + dwell_us) {
+            ESP_LOGD(TAG, "Dwell time over - advancing playlist");
+            if (next_panel() != ESP_OK) {
+                // Nothing else to show, try again after another dwell
+                s_state.shown_us = now;
+            }
+        } else if (dwell_us == 0 && active_id != s_state.config.default_panel &&
+                   timeout_us > 0 && now >= s_state.shown_us + timeout_us) {
+            ESP_LOGI(TAG, "Inactivity timeout - returning to default panel");
+            int idx = find_panel(s_state.config.default_panel);
+            if (idx < 0 || show_panel(idx) != ESP_OK) {
+                s_state.shown_us = now;
+            }
+        }
+    }
 
-    ESP_LOGI(TAG, "Next panel: index=%d, id=%d", s_state.active_panel_idx, next_panel_id);
+    if (s_state.prerender.valid && now >= s_state.prerender.stale_us) {
+        prerender_next();
+    }
 
-    // Activate next panel
-    activate_panel(next_panel_id);
+    reschedule();
+}
 
-    return ESP_OK;
+/**
+ * @brief Render the active panel and the prerendered one again
+ *
+ * Their frames may show the time from before a clock step, or the old
+ * language, clock format or weather. Panels without an update timer of
+ * their own (the date) would keep showing it until their next wakeup.
+ */
+static void on_content_changed(void)
+{
+    display_frame_t frame;
+
+    if (s_state.panel_shown) {
+        const panel_info_t *panel = &s_state.panels[s_state.active_panel_idx];
+        if (panel->ops->render_into_buffer(&frame) == ESP_OK) {
+            display_present(&frame);
+        }
+    }
+
+    prerender_next();
+    reschedule();
+}
+
+static void deadline_timer_callback(void *arg)
+{
+    // Runs in the esp_timer task: hand over to the event loop
+    if (esp_event_post(PANEL_MANAGER_EVENT, PANEL_MANAGER_DEADLINE, NULL, 0, 0) != ESP_OK) {
+        esp_timer_start_once(s_state.deadline_timer, DEADLINE_RETRY_US);
+    }
+}
+
+static void internal_handler(void* arg, esp_event_base_t base,
+                             int32_t event_id, void* event_data)
+{
+    if (!s_state.initialized) {
+        return;
+    }
+
+    switch (event_id) {
+        case PANEL_MANAGER_DEADLINE:
+            on_deadline();
+            break;
+
+        case PANEL_MANAGER_REFRESH:
+            rebuild_order();
+            if (!s_state.panel_shown) {
+                // Show the default panel as soon as it exists
+                int idx = find_panel(s_state.config.default_panel);
+                if (idx >= 0) {
+                    show_panel(idx);
+                }
+            } else {
+                // The new panel may be next in the cycle
+                prerender_next();
+                reschedule();
+            }
+            break;
+
+        case PANEL_MANAGER_CONTENT:
+            on_content_changed();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void content_handler(void* arg, esp_event_base_t base,
+                            int32_t event_id, void* event_data)
+{
+    // The prerendered frame is refused from now on. Rendering is left to
+    // after the other handlers of this event (i18n, clock_panel) have
+    // applied it
+    s_state.content_gen++;
+    if (esp_event_post(PANEL_MANAGER_EVENT, PANEL_MANAGER_CONTENT, NULL, 0, 0) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post content event, frames refreshed on demand");
+    }
 }
 
 static void input_touch_handler(void* arg, esp_event_base_t base,
                                 int32_t event_id, void* event_data)
 {
+    perf_input_mark(PERF_INPUT_HANDLED);
     ESP_LOGI(TAG, "Touch detected - switching to next panel");
-    next_panel();
+
+    if (next_panel() != ESP_OK && s_state.panel_shown) {
+        // Still counts as activity for the dwell and inactivity deadlines
+        s_state.shown_us = esp_timer_get_time();
+        reschedule();
+    }
 }
 
 static void panel_skip_handler(void* arg, esp_event_base_t base,
@@ -286,39 +760,127 @@ static void panel_skip_handler(void* arg, esp_event_base_t base,
     next_panel();
 }
 
-static void inactivity_timer_callback(TimerHandle_t xTimer)
+static void playlist_handler(void* arg, esp_event_base_t base,
+                             int32_t event_id, void* event_data)
 {
-    if (!s_state.initialized) {
+    const timemachine_playlist_t *playlist = (const timemachine_playlist_t*)event_data;
+
+    if (playlist->count > TIMEMACHINE_PLAYLIST_MAX) {
+        ESP_LOGW(TAG, "Ignoring invalid playlist (%d entries)", playlist->count);
         return;
     }
 
-    // Increment inactivity counter
-    s_state.inactivity_counter++;
+    s_state.config.playlist = *playlist;
+    rebuild_order();
+    ESP_LOGI(TAG, "Playlist updated: %d of %d entries registered%s",
+             s_state.order.count, playlist->count,
+             s_state.order.rotating ? ", rotating" : "");
+
+    // Restart the dwell of the active panel under the new rules
+    s_state.shown_us = esp_timer_get_time();
+    prerender_next();
+    reschedule();
+}
+
+// ============================================================================
+// Console Commands
+// ============================================================================
+
+#if CONFIG_TIMEMACHINE_CONSOLE
 
-    // Check if we need to return to default panel
-    if (s_state.inactivity_counter >= s_state.config.inactivity_timeout_s) {
-        if (s_state.panel_count == 0) {
-            s_state.inactivity_counter = 0;
-            return;
+static void print_playlist(void)
+{
+    const timemachine_playlist_t *playlist = &s_state.config.playlist;
+
+    if (playlist->count == 0) {
+        printf("All panels in registration order, advancing on tap\n");
+        return;
+    }
+
+    for (uint8_t i = 0; i < playlist->count; i++) {
+        int idx = find_panel(playlist->entries[i].panel_id);
+        const char *name = idx >= 0 ? s_state.panels[idx].ops->name : "(not registered)";
+        if (playlist->entries[i].dwell_s > 0) {
+            printf("%u. %s for %us\n", i + 1, name, playlist->entries[i].dwell_s);
+        } else {
+            printf("%u. %s until tapped\n", i + 1, name);
         }
+    }
+}
 
-        panel_id_t current_panel_id = s_state.panels[s_state.active_panel_idx].id;
+static int cmd_playlist(int argc, char **argv)
+{
+    if (argc == 1) {
+        print_playlist();
+        return 0;
+    }
 
-        if (current_panel_id != s_state.config.default_panel) {
-            ESP_LOGI(TAG, "Inactivity timeout - returning to default panel");
+    timemachine_playlist_t playlist = {0};
 
-            // Find default panel index
-            for (uint8_t i = 0; i < s_state.panel_count; i++) {
-                if (s_state.panels[i].id == s_state.config.default_panel) {
-                    deactivate_panel(current_panel_id);
-                    s_state.active_panel_idx = i;
-                    activate_panel(s_state.config.default_panel);
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        // Empty playlist: every panel, advancing on tap
+    } else {
+        if (argc - 1 > TIMEMACHINE_PLAYLIST_MAX) {
+            printf("At most %d entries\n", TIMEMACHINE_PLAYLIST_MAX);
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            char *colon = strchr(argv[i], ':');
+            size_t name_len = colon ? (size_t)(colon - argv[i]) : strlen(argv[i]);
+            int idx = -1;
+
+            for (uint8_t p = 0; p < s_state.panel_count; p++) {
+                const char *name = s_state.panels[p].ops->name;
+                if (strlen(name) == name_len && strncmp(name, argv[i], name_len) == 0) {
+                    idx = p;
                     break;
                 }
             }
+            if (idx < 0) {
+                printf("Unknown panel: %.*s\n", (int)name_len, argv[i]);
+                return 1;
+            }
+
+            long dwell_s = colon ? strtol(colon + 1, NULL, 10) : 0;
+            if (dwell_s < 0 || dwell_s > UINT16_MAX) {
+                printf("Invalid dwell time: %s\n", colon + 1);
+                return 1;
+            }
+
+            playlist.entries[playlist.count].panel_id = s_state.panels[idx].id;
+            playlist.entries[playlist.count].dwell_s = (uint16_t)dwell_s;
+            playlist.count++;
         }
+    }
 
-        // Reset counter
-        s_state.inactivity_counter = 0;
+    // Applied by the panel manager and persisted by settings
+    esp_err_t err = esp_event_post(TIMEMACHINE_EVENT, PLAYLIST_CHANGED,
+                                   &playlist, sizeof(playlist), portMAX_DELAY);
+    if (err != ESP_OK) {
+        printf("Failed to post PLAYLIST_CHANGED: %s\n", esp_err_to_name(err));
+        return 1;
     }
+    return 0;
 }
+
+esp_err_t panel_manager_register_console_commands(void)
+{
+    const esp_console_cmd_t playlist_cmd = {
+        .command = "playlist",
+        .help = "Show or set the panel playlist, e.g. playlist clock:20 date:5 weather:10 "
+                "(seconds per panel, 0 or no time = until tapped; 'playlist reset' for all panels)",
+        .hint = "[<panel>[:<seconds>]... | reset]",
+        .func = cmd_playlist,
+    };
+    return esp_console_cmd_register(&playlist_cmd);
+}
+
+#else
+
+esp_err_t panel_manager_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
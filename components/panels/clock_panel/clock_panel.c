@@ -18,15 +18,21 @@
 
 #include "clock_panel.h"
 #include "timemachine_events.h"
+#include "panel_manager.h"
+#include "display.h"
 #include "fonts/font.h"
 #include "i18n.h"
+#include "ntp_sync.h"
+#include "perf.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <sys/time.h>
 
 static const char *TAG = "clock_panel";
 
@@ -37,20 +43,34 @@ static clock_config_t s_config = {
 
 static bool s_initialized = false;
 static bool s_active = false;
+static bool s_registered = false;
 static TimerHandle_t s_update_timer = NULL;
-static esp_event_handler_instance_t s_panel_activated_handler = NULL;
-static esp_event_handler_instance_t s_panel_deactivated_handler = NULL;
 static esp_event_handler_instance_t s_config_changed_handler = NULL;
+static esp_event_handler_instance_t s_ntp_synced_handler = NULL;
+
+/**
+ * @brief Storage for a clock scene, the scene points into it
+ */
+typedef struct {
+    char dow_str[4];       // "DDD\0" = max 4 chars
+    char time_str[16];
+    char fallback_str[20];
+    scene_element_t elements[2];
+    display_scene_t scene;
+} clock_scene_t;
 
 // Forward declarations
 static void update_timer_callback(TimerHandle_t xTimer);
 static void render_time(void);
-static void panel_activated_handler(void* arg, esp_event_base_t base,
-                                    int32_t event_id, void* event_data);
-static void panel_deactivated_handler(void* arg, esp_event_base_t base,
-                                      int32_t event_id, void* event_data);
+static esp_err_t build_scene(clock_scene_t *out);
+static bool time_is_valid(void);
+static esp_err_t register_panel(void);
+static void time_valid_callback(void *arg1, uint32_t arg2);
+static const panel_ops_t s_panel_ops;
 static void on_clock_config_changed(void* arg, esp_event_base_t event_base,
                                      int32_t event_id, void* event_data);
+static void on_ntp_synced(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data);
 
 // ============================================================================
 // Public API - Lifecycle
@@ -84,49 +104,47 @@ esp_err_t clock_panel_init(const clock_config_t *config)
         return ESP_ERR_NO_MEM;
     }
 
-    // Register PANEL_ACTIVATED handler
+    // Register CLOCK_CONFIG_CHANGED handler
     esp_err_t err = esp_event_handler_instance_register(
         TIMEMACHINE_EVENT,
-        PANEL_ACTIVATED,
-        panel_activated_handler,
+        CLOCK_CONFIG_CHANGED,
+        on_clock_config_changed,
         NULL,
-        &s_panel_activated_handler
+        &s_config_changed_handler
     );
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register PANEL_ACTIVATED handler");
+        ESP_LOGE(TAG, "Failed to register CLOCK_CONFIG_CHANGED handler");
         clock_panel_deinit();
         return err;
     }
 
-    // Register PANEL_DEACTIVATED handler
+    // Register NTP_SYNCED handler (shows the panel once the time is known)
     err = esp_event_handler_instance_register(
         TIMEMACHINE_EVENT,
-        PANEL_DEACTIVATED,
-        panel_deactivated_handler,
+        NTP_SYNCED,
+        on_ntp_synced,
         NULL,
-        &s_panel_deactivated_handler
+        &s_ntp_synced_handler
     );
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register PANEL_DEACTIVATED handler");
+        ESP_LOGE(TAG, "Failed to register NTP_SYNCED handler");
         clock_panel_deinit();
         return err;
     }
 
-    // Register CLOCK_CONFIG_CHANGED handler
-    err = esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        CLOCK_CONFIG_CHANGED,
-        on_clock_config_changed,
-        NULL,
-        &s_config_changed_handler
-    );
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register CLOCK_CONFIG_CHANGED handler");
-        clock_panel_deinit();
-        return err;
+    s_initialized = true;
+
+    // Without a restored time there is nothing to show until NTP syncs
+    if (time_is_valid()) {
+        err = register_panel();
+        if (err != ESP_OK) {
+            clock_panel_deinit();
+            return err;
+        }
+    } else {
+        ESP_LOGI(TAG, "Time unknown, waiting for NTP sync");
     }
 
-    s_initialized = true;
     ESP_LOGI(TAG, "Clock initialized");
 
     return ESP_OK;
@@ -155,22 +173,13 @@ void clock_panel_deinit(void)
         s_config_changed_handler = NULL;
     }
 
-    if (s_panel_deactivated_handler != NULL) {
-        esp_event_handler_instance_unregister(
-            TIMEMACHINE_EVENT,
-            PANEL_DEACTIVATED,
-            s_panel_deactivated_handler
-        );
-        s_panel_deactivated_handler = NULL;
-    }
-
-    if (s_panel_activated_handler != NULL) {
+    if (s_ntp_synced_handler != NULL) {
         esp_event_handler_instance_unregister(
             TIMEMACHINE_EVENT,
-            PANEL_ACTIVATED,
-            s_panel_activated_handler
+            NTP_SYNCED,
+            s_ntp_synced_handler
         );
-        s_panel_activated_handler = NULL;
+        s_ntp_synced_handler = NULL;
     }
 
     s_initialized = false;
@@ -178,66 +187,112 @@ void clock_panel_deinit(void)
 }
 
 // ============================================================================
-// Private - Event Handlers
+// Private - Panel Interface
 // ============================================================================
 
-static void panel_activated_handler(void* arg, esp_event_base_t base,
-                                   int32_t event_id, void* event_data)
+static bool time_is_valid(void)
 {
-    panel_id_t *panel_id = (panel_id_t *)event_data;
+    return time(NULL) > NTP_SYNC_MIN_VALID_EPOCH;
+}
 
-    if (*panel_id == PANEL_CLOCK) {
-        s_active = true;
-        ESP_LOGI(TAG, "Clock panel activated");
+static esp_err_t register_panel(void)
+{
+    // Register panel with manager (shown right away as the default panel)
+    panel_info_t panel_info = {
+        .id = PANEL_CLOCK,
+        .ops = &s_panel_ops
+    };
+    esp_err_t err = panel_manager_register_panel(&panel_info);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register panel");
+        return err;
+    }
 
-        // Start update timer
-        if (s_update_timer != NULL) {
-            render_time();  // Render immediately
-            xTimerStart(s_update_timer, 0);
-        }
+    s_registered = true;
+    return ESP_OK;
+}
+
+static esp_err_t clock_activate(void)
+{
+    s_active = true;
+    ESP_LOGI(TAG, "Clock panel activated");
+    perf_boot_mark(PERF_BOOT_CLOCK_FRAME);
+
+    // The manager already showed the current time, keep it updated
+    if (s_update_timer != NULL) {
+        xTimerStart(s_update_timer, 0);
     }
+
+    return ESP_OK;
 }
 
-static void panel_deactivated_handler(void* arg, esp_event_base_t base,
-                                     int32_t event_id, void* event_data)
+static void clock_deactivate(void)
 {
-    panel_id_t *panel_id = (panel_id_t *)event_data;
+    s_active = false;
+    ESP_LOGI(TAG, "Clock panel deactivated");
+
+    // Stop update timer
+    if (s_update_timer != NULL) {
+        xTimerStop(s_update_timer, 0);
+    }
+}
 
-    if (*panel_id == PANEL_CLOCK) {
-        s_active = false;
-        ESP_LOGI(TAG, "Clock panel deactivated");
+static esp_err_t clock_render_into_buffer(display_frame_t *frame)
+{
+    clock_scene_t scene;
 
-        // Stop update timer
-        if (s_update_timer != NULL) {
-            xTimerStop(s_update_timer, 0);
-        }
+    esp_err_t err = build_scene(&scene);
+    if (err != ESP_OK) {
+        return err;
     }
+
+    return display_rasterize(&scene.scene, frame);
 }
 
+static int64_t clock_next_wakeup(void)
+{
+    // Content changes every second (blinking colon)
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return esp_timer_get_time() + (1000000 - tv.tv_usec);
+}
+
+static const panel_ops_t s_panel_ops = {
+    .activate = clock_activate,
+    .deactivate = clock_deactivate,
+    .render_into_buffer = clock_render_into_buffer,
+    .next_wakeup = clock_next_wakeup,
+    .name = "clock"
+};
+
+// ============================================================================
+// Private - Rendering
+// ============================================================================
+
 static void update_timer_callback(TimerHandle_t xTimer)
 {
     render_time();
 }
 
-static void render_time(void)
+static esp_err_t build_scene(clock_scene_t *out)
 {
     // Get current time from system
     time_t now = time(NULL);
-    if (now <= 0) {
-        return;  // Invalid time (not synced yet)
+    if (now <= NTP_SYNC_MIN_VALID_EPOCH) {
+        return ESP_ERR_NOT_FOUND;  // Invalid time (not restored nor synced yet)
     }
+    bool synced = ntp_sync_is_synced();
 
     struct tm timeinfo;
     localtime_r(&now, &timeinfo);
     struct tm *time = &timeinfo;
 
     // Get day of week (localized)
-    static char dow_str[4];  // "DDD\0" = max 4 chars
     const char *day = i18n_get_day_name(time->tm_wday);
-    snprintf(dow_str, sizeof(dow_str), "%s", day);
+    snprintf(out->dow_str, sizeof(out->dow_str), "%s", day);
 
     // Format time string based on configuration
-    static char time_str[16];  // Static to persist after function returns
     int hour = time->tm_hour;
     int min = time->tm_min;
     int sec = time->tm_sec;
@@ -250,43 +305,74 @@ static void render_time(void)
         }
     }
 
-    // Blink colon: show on even seconds, hide on odd seconds
-    char separator = (sec % 2) == 0 ? ':' : ' ';
+    // Blink colon: show on even seconds, hide on odd seconds.
+    // A steady dot marks a restored time that NTP has not confirmed yet.
+    char separator;
+    if (!synced) {
+        separator = '.';
+    } else {
+        separator = (sec % 2) == 0 ? ':' : ' ';
+    }
 
     // Format time as "HH:MM" or "H:MM" (or with space instead of colon)
     if (hour < 10) {
-        snprintf(time_str, sizeof(time_str), "%d%c%02d", hour, separator, min);
+        snprintf(out->time_str, sizeof(out->time_str), "%d%c%02d", hour, separator, min);
     } else {
-        snprintf(time_str, sizeof(time_str), "%02d%c%02d", hour, separator, min);
+        snprintf(out->time_str, sizeof(out->time_str), "%02d%c%02d", hour, separator, min);
     }
 
     // Build scene with two text elements: day of week (dotmatrix) + time (default)
-    static scene_element_t time_elements[2];
 
     // Day of week with small dotmatrix font (for the techito)
-    time_elements[0].type = SCENE_ELEMENT_TEXT;
-    time_elements[0].data.text.str = dow_str;
-    time_elements[0].data.text.font = &font_dotmatrix_small;
+    out->elements[0].type = SCENE_ELEMENT_TEXT;
+    out->elements[0].data.text.str = out->dow_str;
+    out->elements[0].data.text.font = &font_dotmatrix_small;
 
     // Time with default font
-    time_elements[1].type = SCENE_ELEMENT_TEXT;
-    time_elements[1].data.text.str = time_str;
-    time_elements[1].data.text.font = &font_default;
+    out->elements[1].type = SCENE_ELEMENT_TEXT;
+    out->elements[1].data.text.str = out->time_str;
+    out->elements[1].data.text.font = &font_default;
 
-    static display_scene_t time_scene;
-    time_scene.element_count = 2;
-    time_scene.elements = time_elements;
+    out->scene.element_count = 2;
+    out->scene.elements = out->elements;
 
     // Fallback text for simple displays
-    static char fallback_str[20];
-    snprintf(fallback_str, sizeof(fallback_str), "%s %s", dow_str, time_str);
-    time_scene.fallback_text = fallback_str;
+    snprintf(out->fallback_str, sizeof(out->fallback_str), "%s %s%s",
+             out->dow_str, out->time_str, synced ? "" : "?");
+    out->scene.fallback_text = out->fallback_str;
+
+    return ESP_OK;
+}
+
+static void time_valid_callback(void *arg1, uint32_t arg2)
+{
+    // Runs in the timer task, serialized with update_timer_callback()
+    if (!s_initialized) {
+        return;
+    }
+
+    if (!s_registered) {
+        register_panel();
+    } else if (s_active) {
+        // Replace the unsynced indicator without waiting for the next tick
+        render_time();
+    }
+}
+
+static void render_time(void)
+{
+    // Static so the strings outlive the posted event
+    static clock_scene_t s_scene;
+
+    if (build_scene(&s_scene) != ESP_OK) {
+        return;
+    }
 
     // Emit RENDER_SCENE
     esp_err_t err = esp_event_post(
         DISPLAY_EVENT,
         RENDER_SCENE,
-        &time_scene,
+        &s_scene.scene,
         sizeof(display_scene_t),
         portMAX_DELAY
     );
@@ -332,3 +418,17 @@ static void on_clock_config_changed(void* arg, esp_event_base_t event_base,
 
     // Display will update on next timer tick with new format
 }
+
+static void on_ntp_synced(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data)
+{
+    timemachine_ntp_sync_t *sync = (timemachine_ntp_sync_t*)event_data;
+
+    if (!sync->success) {
+        return;
+    }
+
+    if (xTimerPendFunctionCall(time_valid_callback, NULL, 0, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to defer NTP sync update");
+    }
+}
@@ -23,9 +23,13 @@ typedef struct {
 /**
  * @brief Initialize clock component
  *
- * Creates internal timer and registers event handlers for panel
- * activation/deactivation. Timer updates display every second when
- * the clock panel is active.
+ * Creates internal timer and registers the clock panel with the panel
+ * manager, which shows it right away as the default panel. Timer updates
+ * display every second when the clock panel is active.
+ *
+ * If the wall clock is not set yet, the panel is registered on the first
+ * NTP_SYNCED instead. A restored time that NTP has not confirmed is shown
+ * with a steady '.' instead of the blinking ':'.
  *
  * @param config Clock configuration
  * @return ESP_OK on success, error code otherwise
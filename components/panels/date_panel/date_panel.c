@@ -5,22 +5,28 @@
 #include "fonts/font.h"
 #include "i18n.h"
 #include "esp_log.h"
-#include "esp_event.h"
+#include "esp_timer.h"
 #include <stdio.h>
 #include <time.h>
 
 static const char *TAG = "date_panel";
 
 static bool s_initialized = false;
-static esp_event_handler_instance_t s_panel_activated_handler = NULL;
-static esp_event_handler_instance_t s_panel_deactivated_handler = NULL;
+
+/**
+ * @brief Storage for a date scene, the scene points into it
+ */
+typedef struct {
+    char month_str[4];  // "MMM\0" = max 4 chars
+    char day_str[3];    // "DD\0" = max 3 chars
+    char fallback_str[8];
+    scene_element_t elements[2];
+    display_scene_t scene;
+} date_scene_t;
 
 // Forward declarations
-static void render_date(void);
-static void panel_activated_handler(void* arg, esp_event_base_t base,
-                                   int32_t event_id, void* event_data);
-static void panel_deactivated_handler(void* arg, esp_event_base_t base,
-                                     int32_t event_id, void* event_data);
+static esp_err_t build_scene(date_scene_t *out);
+static const panel_ops_t s_panel_ops;
 
 // ============================================================================
 // Public API
@@ -35,43 +41,14 @@ esp_err_t date_panel_init(void)
 
     ESP_LOGI(TAG, "Initializing date panel...");
 
-    // Register PANEL_ACTIVATED handler
-    esp_err_t err = esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        PANEL_ACTIVATED,
-        panel_activated_handler,
-        NULL,
-        &s_panel_activated_handler
-    );
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register PANEL_ACTIVATED handler");
-        date_panel_deinit();
-        return err;
-    }
-
-    // Register PANEL_DEACTIVATED handler
-    err = esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        PANEL_DEACTIVATED,
-        panel_deactivated_handler,
-        NULL,
-        &s_panel_deactivated_handler
-    );
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register PANEL_DEACTIVATED handler");
-        date_panel_deinit();
-        return err;
-    }
-
     // Register panel with panel manager
     panel_info_t panel_info = {
         .id = PANEL_DATE,
-        .name = "Date"
+        .ops = &s_panel_ops
     };
-    err = panel_manager_register_panel(&panel_info);
+    esp_err_t err = panel_manager_register_panel(&panel_info);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register panel");
-        date_panel_deinit();
         return err;
     }
 
@@ -89,71 +66,71 @@ void date_panel_deinit(void)
 
     ESP_LOGI(TAG, "Deinitializing date panel...");
 
-    // Unregister all event handlers
-    if (s_panel_deactivated_handler != NULL) {
-        esp_event_handler_instance_unregister(
-            TIMEMACHINE_EVENT,
-            PANEL_DEACTIVATED,
-            s_panel_deactivated_handler
-        );
-        s_panel_deactivated_handler = NULL;
-    }
-
-    if (s_panel_activated_handler != NULL) {
-        esp_event_handler_instance_unregister(
-            TIMEMACHINE_EVENT,
-            PANEL_ACTIVATED,
-            s_panel_activated_handler
-        );
-        s_panel_activated_handler = NULL;
-    }
-
     s_initialized = false;
     ESP_LOGI(TAG, "Date panel deinitialized");
 }
 
 // ============================================================================
-// Private - Event Handlers
+// Private - Panel Interface
 // ============================================================================
 
-static void panel_activated_handler(void* arg, esp_event_base_t base,
-                                   int32_t event_id, void* event_data)
+static esp_err_t date_activate(void)
 {
-    panel_id_t *panel_id = (panel_id_t *)event_data;
+    ESP_LOGI(TAG, "Date panel activated");
+    return ESP_OK;
+}
 
-    if (*panel_id == PANEL_DATE) {
-        ESP_LOGI(TAG, "Date panel activated");
-        render_date();
-    }
+static void date_deactivate(void)
+{
+    ESP_LOGI(TAG, "Date panel deactivated");
 }
 
-static void panel_deactivated_handler(void* arg, esp_event_base_t base,
-                                     int32_t event_id, void* event_data)
+static esp_err_t date_render_into_buffer(display_frame_t *frame)
 {
-    panel_id_t *panel_id = (panel_id_t *)event_data;
+    date_scene_t scene;
 
-    if (*panel_id == PANEL_DATE) {
-        ESP_LOGI(TAG, "Date panel deactivated");
+    esp_err_t err = build_scene(&scene);
+    if (err != ESP_OK) {
+        return err;
     }
+
+    return display_rasterize(&scene.scene, frame);
+}
+
+static int64_t date_next_wakeup(void)
+{
+    // Content changes at local midnight
+    time_t now = time(NULL);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+
+    int64_t seconds_left = 24 * 3600 -
+        (timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec);
+
+    return esp_timer_get_time() + seconds_left * 1000000;
 }
 
-static void render_date(void)
+static const panel_ops_t s_panel_ops = {
+    .activate = date_activate,
+    .deactivate = date_deactivate,
+    .render_into_buffer = date_render_into_buffer,
+    .next_wakeup = date_next_wakeup,
+    .name = "date"
+};
+
+// ============================================================================
+// Private - Rendering
+// ============================================================================
+
+static esp_err_t build_scene(date_scene_t *out)
 {
     // Get current time from system
     time_t now = time(NULL);
 
     // If time is before 2020, consider it not synced (same as ntp_sync_is_synced)
     if (now < 1577836800) {  // Jan 1, 2020
-        ESP_LOGW(TAG, "No time data available (time=%ld), requesting panel skip", now);
-        // Request to skip this panel
-        esp_event_post(
-            TIMEMACHINE_EVENT,
-            PANEL_SKIP_REQUESTED,
-            NULL,
-            0,
-            0
-        );
-        return;  // Invalid time (not synced yet)
+        ESP_LOGD(TAG, "No time data available (time=%ld)", now);
+        return ESP_ERR_NOT_FOUND;  // Invalid time (not synced yet), panel is skipped
     }
 
     struct tm timeinfo;
@@ -161,47 +138,30 @@ static void render_date(void)
     struct tm *time = &timeinfo;
 
     // Format date as separate month and day strings
-    static char month_str[4];  // "MMM\0" = max 4 chars
-    static char day_str[3];    // "DD\0" = max 3 chars
-
     const char *month = i18n_get_month_name(time->tm_mon);
     int day = time->tm_mday;
 
-    snprintf(month_str, sizeof(month_str), "%s", month);
-    snprintf(day_str, sizeof(day_str), "%d", day);
+    snprintf(out->month_str, sizeof(out->month_str), "%s", month);
+    snprintf(out->day_str, sizeof(out->day_str), "%d", day);
 
     // Build scene with two text elements: month (dotmatrix) + day (default)
-    static scene_element_t date_elements[2];
 
     // Month with dotmatrix font (for the techito)
-    date_elements[0].type = SCENE_ELEMENT_TEXT;
-    date_elements[0].data.text.str = month_str;
-    date_elements[0].data.text.font = &font_dotmatrix;
+    out->elements[0].type = SCENE_ELEMENT_TEXT;
+    out->elements[0].data.text.str = out->month_str;
+    out->elements[0].data.text.font = &font_dotmatrix;
 
     // Day with default font (numbers don't have techito)
-    date_elements[1].type = SCENE_ELEMENT_TEXT;
-    date_elements[1].data.text.str = day_str;
-    date_elements[1].data.text.font = &font_default;
+    out->elements[1].type = SCENE_ELEMENT_TEXT;
+    out->elements[1].data.text.str = out->day_str;
+    out->elements[1].data.text.font = &font_default;
 
-    static display_scene_t date_scene;
-    date_scene.element_count = 2;
-    date_scene.elements = date_elements;
+    out->scene.element_count = 2;
+    out->scene.elements = out->elements;
 
     // Fallback text for simple displays
-    static char fallback_str[8];
-    snprintf(fallback_str, sizeof(fallback_str), "%s %d", month, day);
-    date_scene.fallback_text = fallback_str;
-
-    // Emit RENDER_SCENE
-    esp_err_t err = esp_event_post(
-        DISPLAY_EVENT,
-        RENDER_SCENE,
-        &date_scene,
-        sizeof(display_scene_t),
-        portMAX_DELAY
-    );
+    snprintf(out->fallback_str, sizeof(out->fallback_str), "%s %d", month, day);
+    out->scene.fallback_text = out->fallback_str;
 
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to post display event: %s", esp_err_to_name(err));
-    }
+    return ESP_OK;
 }
@@ -12,9 +12,8 @@
 /**
  * @brief Initialize date panel
  *
- * Registers with panel manager and sets up event handlers
- * for panel activation/deactivation. Date is rendered when
- * the panel is activated.
+ * Registers with panel manager, which renders the date when the
+ * panel is shown (or prerendered) and skips it until time is synced.
  *
  * @return ESP_OK on success, error code otherwise
  */
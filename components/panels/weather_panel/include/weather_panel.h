@@ -3,7 +3,8 @@
  * @brief Weather display panel
  *
  * Displays current temperature and weather icon on MAX7219 display.
- * Shows temperature in Celsius with weather condition icon.
+ * Shows temperature in Celsius with weather condition icon, then pages
+ * through the upcoming forecast steps while shown.
  */
 
 #pragma once
@@ -13,8 +14,8 @@
 /**
  * @brief Initialize weather panel
  *
- * Registers the weather panel with the panel manager and sets up
- * event handlers for panel activation/deactivation.
+ * Registers the weather panel with the panel manager. The panel is
+ * skipped while no weather data is available.
  *
  * @return ESP_OK on success, error code otherwise
  */
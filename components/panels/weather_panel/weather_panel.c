@@ -7,29 +7,53 @@
 #include "weather.h"
 #include "timemachine_events.h"
 #include "panel_manager.h"
+#include "display.h"
 #include "fonts/font.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 static const char *TAG = "weather_panel";
 
+#define UPDATE_INTERVAL_MS 10000  // 10 second refresh
+
+// Upcoming forecast steps paged through after the current weather
+#if defined(CONFIG_TIMEMACHINE_WEATHER_FORECAST_PAGES) && CONFIG_TIMEMACHINE_WEATHER_FORECAST_PAGES > 0
+#define FORECAST_PAGES CONFIG_TIMEMACHINE_WEATHER_FORECAST_PAGES
+#define PAGE_INTERVAL_MS (CONFIG_TIMEMACHINE_WEATHER_PAGE_S * 1000)
+#else
+#define FORECAST_PAGES 0
+#define PAGE_INTERVAL_MS UPDATE_INTERVAL_MS
+#endif
+
 static bool s_initialized = false;
 static bool s_active = false;
 static TimerHandle_t s_update_timer = NULL;
-static esp_event_handler_instance_t s_panel_activated_handler = NULL;
-static esp_event_handler_instance_t s_panel_deactivated_handler = NULL;
+static uint8_t s_page = 0;                  // 0 = current weather, n = forecast step n - 1
+static uint32_t s_period_ms = UPDATE_INTERVAL_MS;
+
+/**
+ * @brief Storage for a weather scene, the scene points into it
+ */
+typedef struct {
+    char temp_str[16];
+    char hour_str[8];
+    char fallback_str[24];
+    scene_element_t elements[2];
+    display_scene_t scene;
+} weather_scene_t;
 
 // Forward declarations
 static void update_timer_callback(TimerHandle_t xTimer);
 static void render_weather(void);
-static void panel_activated_handler(void* arg, esp_event_base_t base,
-                                    int32_t event_id, void* event_data);
-static void panel_deactivated_handler(void* arg, esp_event_base_t base,
-                                      int32_t event_id, void* event_data);
+static size_t forecast_pages(weather_forecast_t *forecast);
+static esp_err_t build_scene(weather_scene_t *out, uint8_t page);
+static const panel_ops_t s_panel_ops;
 
 // ============================================================================
 // Public API - Lifecycle
@@ -47,7 +71,7 @@ esp_err_t weather_panel_init(void)
     // Create update timer (10 second refresh)
     s_update_timer = xTimerCreate(
         "weather_update",
-        pdMS_TO_TICKS(10000),  // 10 second period
+        pdMS_TO_TICKS(UPDATE_INTERVAL_MS),
         pdTRUE,                // Auto-reload
         NULL,
         update_timer_callback
@@ -57,40 +81,12 @@ esp_err_t weather_panel_init(void)
         return ESP_ERR_NO_MEM;
     }
 
-    // Register PANEL_ACTIVATED handler
-    esp_err_t err = esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        PANEL_ACTIVATED,
-        panel_activated_handler,
-        NULL,
-        &s_panel_activated_handler
-    );
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register PANEL_ACTIVATED handler");
-        weather_panel_deinit();
-        return err;
-    }
-
-    // Register PANEL_DEACTIVATED handler
-    err = esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        PANEL_DEACTIVATED,
-        panel_deactivated_handler,
-        NULL,
-        &s_panel_deactivated_handler
-    );
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register PANEL_DEACTIVATED handler");
-        weather_panel_deinit();
-        return err;
-    }
-
     // Register panel with manager
     panel_info_t panel_info = {
         .id = PANEL_WEATHER,
-        .name = "Weather"
+        .ops = &s_panel_ops
     };
-    err = panel_manager_register_panel(&panel_info);
+    esp_err_t err = panel_manager_register_panel(&panel_info);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register panel");
         weather_panel_deinit();
@@ -116,122 +112,205 @@ void weather_panel_deinit(void)
         s_update_timer = NULL;
     }
 
-    // Unregister all event handlers
-    if (s_panel_deactivated_handler != NULL) {
-        esp_event_handler_instance_unregister(
-            TIMEMACHINE_EVENT,
-            PANEL_DEACTIVATED,
-            s_panel_deactivated_handler
-        );
-        s_panel_deactivated_handler = NULL;
-    }
-
-    if (s_panel_activated_handler != NULL) {
-        esp_event_handler_instance_unregister(
-            TIMEMACHINE_EVENT,
-            PANEL_ACTIVATED,
-            s_panel_activated_handler
-        );
-        s_panel_activated_handler = NULL;
-    }
-
     s_initialized = false;
     ESP_LOGI(TAG, "Weather panel deinitialized");
 }
 
 // ============================================================================
-// Private - Event Handlers
+// Private - Panel Interface
 // ============================================================================
 
-static void panel_activated_handler(void* arg, esp_event_base_t base,
-                                   int32_t event_id, void* event_data)
+static esp_err_t weather_activate(void)
 {
-    panel_id_t *panel_id = (panel_id_t *)event_data;
+    s_active = true;
+    s_page = 0;
+    ESP_LOGI(TAG, "Weather panel activated");
+
+    // The manager already showed the current weather, keep it updated, or
+    // page through the forecast when there is one
+    weather_forecast_t forecast;
+    s_period_ms = forecast_pages(&forecast) > 0 ? PAGE_INTERVAL_MS : UPDATE_INTERVAL_MS;
+    if (s_update_timer != NULL) {
+        xTimerChangePeriod(s_update_timer, pdMS_TO_TICKS(s_period_ms), 0);  // Also starts it
+    }
 
-    if (*panel_id == PANEL_WEATHER) {
-        s_active = true;
-        ESP_LOGI(TAG, "Weather panel activated");
+    return ESP_OK;
+}
+
+static void weather_deactivate(void)
+{
+    s_active = false;
+    ESP_LOGI(TAG, "Weather panel deactivated");
 
-        // Start update timer
-        if (s_update_timer != NULL) {
-            render_weather();  // Render immediately
-            xTimerStart(s_update_timer, 0);
-        }
+    // Stop update timer
+    if (s_update_timer != NULL) {
+        xTimerStop(s_update_timer, 0);
     }
+    s_page = 0;
 }
 
-static void panel_deactivated_handler(void* arg, esp_event_base_t base,
-                                     int32_t event_id, void* event_data)
+static esp_err_t weather_render_into_buffer(display_frame_t *frame)
 {
-    panel_id_t *panel_id = (panel_id_t *)event_data;
-
-    if (*panel_id == PANEL_WEATHER) {
-        s_active = false;
-        ESP_LOGI(TAG, "Weather panel deactivated");
+    weather_scene_t scene;
 
-        // Stop update timer
-        if (s_update_timer != NULL) {
-            xTimerStop(s_update_timer, 0);
-        }
+    esp_err_t err = build_scene(&scene, s_page);
+    if (err != ESP_OK) {
+        return err;
     }
+
+    return display_rasterize(&scene.scene, frame);
 }
 
+static int64_t weather_next_wakeup(void)
+{
+    // Weather data is picked up, or the next page shown, on the timer period
+    return esp_timer_get_time() + (int64_t)s_period_ms * 1000;
+}
+
+static const panel_ops_t s_panel_ops = {
+    .activate = weather_activate,
+    .deactivate = weather_deactivate,
+    .render_into_buffer = weather_render_into_buffer,
+    .next_wakeup = weather_next_wakeup,
+    .name = "weather"
+};
+
+// ============================================================================
+// Private - Rendering
+// ============================================================================
+
 static void update_timer_callback(TimerHandle_t xTimer)
 {
+    // Next page, back to the current weather after the last one
+    weather_forecast_t forecast;
+    size_t pages = forecast_pages(&forecast);
+    s_page = s_page < pages ? s_page + 1 : 0;
+
     render_weather();
 }
 
-static void render_weather(void)
+/**
+ * @brief Forecast pages available after the current weather
+ */
+static size_t forecast_pages(weather_forecast_t *forecast)
+{
+    if (FORECAST_PAGES == 0 || weather_get_forecast(forecast) != ESP_OK) {
+        return 0;
+    }
+    return forecast->count < FORECAST_PAGES ? forecast->count : FORECAST_PAGES;
+}
+
+/**
+ * @brief Append the degree symbol (0xB0) and an optional suffix to a number
+ */
+static void append_degrees(char *str, size_t size, int len, const char *suffix)
+{
+    if (len <= 0 || (size_t)len + 2 + strlen(suffix) > size) {
+        return;
+    }
+    str[len++] = 0xB0;                  // Degree symbol
+    strcpy(&str[len], suffix);
+}
+
+static esp_err_t build_forecast_scene(weather_scene_t *out, uint8_t page)
 {
+    weather_forecast_t forecast;
+    if (page > forecast_pages(&forecast)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Local hour of the step (e.g., "18h") and its temperature (e.g., "12°")
+    time_t t = (time_t)weather_forecast_time(&forecast, page - 1);
+    struct tm timeinfo;
+    localtime_r(&t, &timeinfo);
+    snprintf(out->hour_str, sizeof(out->hour_str), "%dh", timeinfo.tm_hour);
+
+    int16_t deci = weather_forecast_temp_deci(&forecast, page - 1);
+    int temp_int = (deci + (deci < 0 ? -5 : 5)) / 10;  // Round to nearest
+    int len = snprintf(out->temp_str, sizeof(out->temp_str), "%d", temp_int);
+    append_degrees(out->temp_str, sizeof(out->temp_str), len, "");
+
+    // Hour small so both fit, temperature with default font
+    out->elements[0].type = SCENE_ELEMENT_TEXT;
+    out->elements[0].data.text.str = out->hour_str;
+    out->elements[0].data.text.font = &font_dotmatrix_small;
+
+    out->elements[1].type = SCENE_ELEMENT_TEXT;
+    out->elements[1].data.text.str = out->temp_str;
+    out->elements[1].data.text.font = &font_default;
+
+    out->scene.element_count = 2;
+    out->scene.elements = out->elements;
+
+    // Fallback text (e.g., "18h 12°C")
+    snprintf(out->fallback_str, sizeof(out->fallback_str), "%s %sC", out->hour_str, out->temp_str);
+    out->scene.fallback_text = out->fallback_str;
+
+    return ESP_OK;
+}
+
+static esp_err_t build_scene(weather_scene_t *out, uint8_t page)
+{
+    if (page > 0 && build_forecast_scene(out, page) == ESP_OK) {
+        return ESP_OK;
+    }
+
     // Get current weather data
     weather_data_t weather_data;
     esp_err_t err = weather_get_data(&weather_data);
 
     if (err != ESP_OK || !weather_data.valid) {
-        ESP_LOGW(TAG, "No weather data available, requesting panel skip");
-        // Request to skip this panel
-        esp_event_post(
-            TIMEMACHINE_EVENT,
-            PANEL_SKIP_REQUESTED,
-            NULL,
-            0,
-            0
-        );
-        return;
+        return ESP_ERR_NOT_FOUND;
     }
 
     // Format temperature string (e.g., "23°C")
     // Convert temperature to integer to avoid float formatting (which uses malloc)
     int temp_int = (int)(weather_data.temperature + 0.5f);  // Round to nearest
-    static char temp_str[16];
-    int len = snprintf(temp_str, sizeof(temp_str), "%d", temp_int);
-    // Manually append degree symbol (0xB0) and 'C'
-    if (len > 0 && len < sizeof(temp_str) - 2) {
-        temp_str[len] = 0xB0;      // Degree symbol
-        temp_str[len + 1] = 'C';   // C
-        temp_str[len + 2] = '\0';  // Null terminator
-    }
+    int len = snprintf(out->temp_str, sizeof(out->temp_str), "%d", temp_int);
+    // Manually append degree symbol and 'C'.
+    // A trailing dot marks stale data a fetch has not replaced yet, like the
+    // clock's steady dot for an unconfirmed time.
+    append_degrees(out->temp_str, sizeof(out->temp_str), len, weather_data.stale ? "C." : "C");
 
     // Build scene with just temperature text
-    static scene_element_t weather_elements[1];
 
     // Temperature with dotmatrix font
-    weather_elements[0].type = SCENE_ELEMENT_TEXT;
-    weather_elements[0].data.text.str = temp_str;
-    weather_elements[0].data.text.font = &font_dotmatrix;
+    out->elements[0].type = SCENE_ELEMENT_TEXT;
+    out->elements[0].data.text.str = out->temp_str;
+    out->elements[0].data.text.font = &font_dotmatrix;
 
-    static display_scene_t weather_scene;
-    weather_scene.element_count = 1;
-    weather_scene.elements = weather_elements;
+    out->scene.element_count = 1;
+    out->scene.elements = out->elements;
 
     // Fallback text
-    weather_scene.fallback_text = temp_str;
+    out->scene.fallback_text = out->temp_str;
+
+    return ESP_OK;
+}
+
+static void render_weather(void)
+{
+    // Static so the strings outlive the posted event
+    static weather_scene_t s_scene;
+
+    if (build_scene(&s_scene, s_page) != ESP_OK) {
+        ESP_LOGW(TAG, "No weather data available, requesting panel skip");
+        // Request to skip this panel
+        esp_event_post(
+            TIMEMACHINE_EVENT,
+            PANEL_SKIP_REQUESTED,
+            NULL,
+            0,
+            0
+        );
+        return;
+    }
 
     // Emit RENDER_SCENE
-    err = esp_event_post(
+    esp_err_t err = esp_event_post(
         DISPLAY_EVENT,
         RENDER_SCENE,
-        &weather_scene,
+        &s_scene.scene,
         sizeof(display_scene_t),
         portMAX_DELAY
     );
@@ -0,0 +1,149 @@
+/**
+ * @file perf.h
+ * @brief Performance instrumentation
+ *
+ * Input latency: traces a touch from the GPIO edge through gesture
+ * recognition, INPUT_TAP dispatch, getting the new panel's frame (usually
+ * prerendered) and the driver flush. Each stage is accumulated in a
+ * log2 histogram that can be printed on the console (`latency`).
+ *
+ * Boot: timestamps milestones from reset to the first clock frame and keeps
+ * the last PERF_BOOT_HISTORY boots in RTC memory, which survives software
+ * resets, panics and watchdog resets but not power cycles (`boot`).
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define PERF_HIST_BUCKETS 24   /**< Bucket i holds [2^i, 2^(i+1)) us, bucket 0 also holds 0 */
+#define PERF_BOOT_HISTORY 8    /**< Boots kept in RTC memory */
+
+/**
+ * @brief Points on the input-to-pixel path, in order
+ */
+typedef enum {
+    PERF_INPUT_POSTED,          /**< touch_sensor posted the input event */
+    PERF_INPUT_HANDLED,         /**< panel_manager received the input event */
+    PERF_INPUT_PANEL_SWITCHED,  /**< panel_manager has the new panel's frame */
+    PERF_INPUT_RENDER_STARTED,  /**< display started flushing the frame */
+    PERF_INPUT_FLUSHED,         /**< Driver finished writing the frame */
+    PERF_INPUT_MARK_COUNT,
+} perf_input_mark_t;
+
+/**
+ * @brief Boot milestones, roughly in the order they are reached
+ */
+typedef enum {
+    PERF_BOOT_APP_MAIN,         /**< app_main entered (ROM, bootloader, IDF startup) */
+    PERF_BOOT_NVS,              /**< NVS flash initialized */
+    PERF_BOOT_SETTINGS,         /**< settings loaded */
+    PERF_BOOT_BLE,              /**< ble_config initialized */
+    PERF_BOOT_DISPLAY,          /**< Display driver initialized */
+    PERF_BOOT_FIRST_PIXEL,      /**< First frame flushed to the display */
+    PERF_BOOT_WIFI,             /**< Associated with the access point */
+    PERF_BOOT_DHCP,             /**< Got an IP address */
+    PERF_BOOT_NTP,              /**< First NTP sync */
+    PERF_BOOT_CLOCK_FRAME,      /**< Clock panel shown (restored or synced time) */
+    PERF_BOOT_MILESTONE_COUNT,
+} perf_boot_milestone_t;
+
+/**
+ * @brief One boot in the RTC history
+ */
+typedef struct {
+    uint32_t ms[PERF_BOOT_MILESTONE_COUNT];    /**< ms since reset, 0 = not reached */
+    uint8_t reset_reason;                       /**< esp_reset_reason_t */
+} perf_boot_record_t;
+
+/**
+ * @brief Latency histogram
+ */
+typedef struct {
+    uint32_t buckets[PERF_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} perf_hist_t;
+
+/**
+ * @brief Start an input trace
+ *
+ * Call right before posting the input event. Replaces any trace in flight.
+ *
+ * @param edge_us esp_timer timestamp of the GPIO edge that completed the gesture
+ */
+void perf_input_begin(int64_t edge_us);
+
+/**
+ * @brief Record a point on the input path
+ *
+ * Ignored when no trace is in flight or the previous point was not reached,
+ * so it is cheap to call on every render. PERF_INPUT_FLUSHED completes the
+ * trace and adds every stage to its histogram.
+ */
+void perf_input_mark(perf_input_mark_t mark);
+
+/**
+ * @brief Add a sample to a histogram
+ */
+void perf_hist_add(perf_hist_t *hist, uint32_t value_us);
+
+/**
+ * @brief Approximate percentile from a histogram (upper bound of the bucket)
+ *
+ * @param percent 0-100
+ */
+uint32_t perf_hist_percentile(const perf_hist_t *hist, uint8_t percent);
+
+/**
+ * @brief Print input latency histograms to stdout
+ */
+void perf_input_print(void);
+
+/**
+ * @brief Clear input latency histograms
+ */
+void perf_input_reset(void);
+
+/**
+ * @brief Start recording this boot
+ *
+ * Call first thing in app_main. Marks PERF_BOOT_APP_MAIN and claims the
+ * next slot of the RTC history.
+ */
+void perf_boot_init(void);
+
+/**
+ * @brief Record a boot milestone
+ *
+ * Only the first call per milestone counts, so it is cheap to call on
+ * every occurrence (e.g. every flush). Reaching PERF_BOOT_FIRST_PIXEL later
+ * than CONFIG_TIMEMACHINE_FIRST_PIXEL_BUDGET_MS logs an error, reaching
+ * PERF_BOOT_CLOCK_FRAME prints the boot waterfall.
+ */
+void perf_boot_mark(perf_boot_milestone_t milestone);
+
+/**
+ * @brief Copy the boot history, newest (this boot) first
+ *
+ * @param records Receives up to max records
+ * @param max     Capacity of records
+ * @return Number of records copied
+ */
+size_t perf_boot_get_history(perf_boot_record_t *records, size_t max);
+
+/**
+ * @brief Print this boot's waterfall and the boot history to stdout
+ */
+void perf_boot_print(void);
+
+/**
+ * @brief Register perf console commands (requires CONFIG_TIMEMACHINE_CONSOLE)
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without console support
+ */
+esp_err_t perf_register_console_commands(void);
@@ -0,0 +1,422 @@
+/**
+ * @file perf.c
+ * @brief Performance instrumentation
+ */
+
+#include "perf.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
+
+static const char *TAG = "perf";
+
+// Traces that do not reach the display within this time are dropped
+#define INPUT_TRACE_TIMEOUT_US (2 * 1000 * 1000)
+
+// Stage i ends at mark i and starts at mark i-1 (the edge for stage 0),
+// the last entry is the end-to-end total
+#define INPUT_STAGE_COUNT (PERF_INPUT_MARK_COUNT + 1)
+
+static const char *s_input_stage_names[INPUT_STAGE_COUNT] = {
+    "recognize",    // Edge -> input posted (debounce, gesture windows)
+    "input_queue",  // Input posted -> handled by panel_manager
+    "panel_switch", // Handled -> new panel's frame ready (prerendered or rendered)
+    "scene",        // Frame ready -> flush started
+    "render",       // Flush started -> driver flush complete
+    "total",
+};
+
+static struct {
+    bool active;
+    int64_t edge_us;
+    int64_t marks_us[PERF_INPUT_MARK_COUNT];
+    int next_mark;
+    perf_hist_t hist[INPUT_STAGE_COUNT];
+    uint32_t dropped;
+} s_input = {0};
+
+static const char *s_boot_milestone_names[PERF_BOOT_MILESTONE_COUNT] = {
+    "app_main",
+    "nvs",
+    "settings",
+    "ble",
+    "display",
+    "first_pixel",
+    "wifi",
+    "dhcp",
+    "ntp",
+    "clock_frame",
+};
+
+#define BOOT_HISTORY_MAGIC 0x424f4f54  // "BOOT"
+#define BOOT_WATERFALL_WIDTH 40
+
+// Survives software resets; validated by the magic after a power cycle
+static RTC_NOINIT_ATTR struct {
+    uint32_t magic;
+    uint32_t next;
+    perf_boot_record_t records[PERF_BOOT_HISTORY];
+} s_boot_history;
+
+static perf_boot_record_t *s_boot = NULL;   // This boot's record in s_boot_history
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================================
+// Public API - Histograms
+// ============================================================================
+
+void perf_hist_add(perf_hist_t *hist, uint32_t value_us)
+{
+    int bucket = 0;
+    while (bucket < PERF_HIST_BUCKETS - 1 && (value_us >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+
+    hist->buckets[bucket]++;
+    if (hist->count == 0 || value_us < hist->min_us) {
+        hist->min_us = value_us;
+    }
+    if (value_us > hist->max_us) {
+        hist->max_us = value_us;
+    }
+    hist->sum_us += value_us;
+    hist->count++;
+}
+
+uint32_t perf_hist_percentile(const perf_hist_t *hist, uint8_t percent)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    uint32_t target = ((uint64_t)hist->count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < PERF_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target && seen > 0) {
+            uint32_t upper = (i + 1 < 32) ? (1u << (i + 1)) - 1 : UINT32_MAX;
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+
+    return hist->max_us;
+}
+
+// ============================================================================
+// Public API - Input Latency
+// ============================================================================
+
+void perf_input_begin(int64_t edge_us)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_input.active) {
+        s_input.dropped++;
+    }
+    s_input.active = true;
+    s_input.edge_us = edge_us;
+    s_input.marks_us[PERF_INPUT_POSTED] = now;
+    s_input.next_mark = PERF_INPUT_POSTED + 1;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void perf_input_mark(perf_input_mark_t mark)
+{
+    if (!s_input.active) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool complete = false;
+    int64_t marks[PERF_INPUT_MARK_COUNT];
+    int64_t edge_us = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_input.active && (int)mark == s_input.next_mark) {
+        if (now - s_input.edge_us > INPUT_TRACE_TIMEOUT_US) {
+            s_input.active = false;
+            s_input.dropped++;
+        } else {
+            s_input.marks_us[mark] = now;
+            s_input.next_mark++;
+            if (mark == PERF_INPUT_FLUSHED) {
+                s_input.active = false;
+                complete = true;
+                memcpy(marks, s_input.marks_us, sizeof(marks));
+                edge_us = s_input.edge_us;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!complete) {
+        return;
+    }
+
+    // Histograms are only touched here, from the task that completed the trace
+    int64_t prev = edge_us;
+    for (int i = 0; i < PERF_INPUT_MARK_COUNT; i++) {
+        perf_hist_add(&s_input.hist[i], (uint32_t)(marks[i] - prev));
+        prev = marks[i];
+    }
+    perf_hist_add(&s_input.hist[INPUT_STAGE_COUNT - 1],
+                  (uint32_t)(marks[PERF_INPUT_FLUSHED] - edge_us));
+
+    ESP_LOGD(TAG, "Input latency: %lld us", marks[PERF_INPUT_FLUSHED] - edge_us);
+}
+
+void perf_input_print(void)
+{
+    printf("Input latency (us), %lu dropped traces\n", s_input.dropped);
+    printf("%-13s %6s %8s %8s %8s %8s %8s\n",
+           "stage", "count", "min", "p50", "p90", "max", "mean");
+
+    for (int i = 0; i < INPUT_STAGE_COUNT; i++) {
+        const perf_hist_t *hist = &s_input.hist[i];
+        printf("%-13s %6lu %8lu %8lu %8lu %8lu %8lu\n",
+               s_input_stage_names[i],
+               hist->count,
+               hist->min_us,
+               perf_hist_percentile(hist, 50),
+               perf_hist_percentile(hist, 90),
+               hist->max_us,
+               hist->count ? (uint32_t)(hist->sum_us / hist->count) : 0);
+    }
+
+    // Distribution of the end-to-end total
+    const perf_hist_t *total = &s_input.hist[INPUT_STAGE_COUNT - 1];
+    if (total->count == 0) {
+        return;
+    }
+
+    printf("\ntotal distribution:\n");
+    for (int i = 0; i < PERF_HIST_BUCKETS; i++) {
+        if (total->buckets[i] == 0) {
+            continue;
+        }
+        int bar = (int)((uint64_t)total->buckets[i] * 40 / total->count);
+        printf("  <%8lu us %6lu |%.*s\n", (1ul << (i + 1)), total->buckets[i], bar,
+               "########################################");
+    }
+}
+
+void perf_input_reset(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_input, 0, sizeof(s_input));
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// ============================================================================
+// Public API - Boot Profile
+// ============================================================================
+
+void perf_boot_init(void)
+{
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    if (s_boot_history.magic != BOOT_HISTORY_MAGIC || s_boot_history.next >= PERF_BOOT_HISTORY) {
+        memset(&s_boot_history, 0, sizeof(s_boot_history));
+        s_boot_history.magic = BOOT_HISTORY_MAGIC;
+    }
+
+    s_boot = &s_boot_history.records[s_boot_history.next];
+    s_boot_history.next = (s_boot_history.next + 1) % PERF_BOOT_HISTORY;
+
+    memset(s_boot, 0, sizeof(*s_boot));
+    s_boot->reset_reason = (uint8_t)esp_reset_reason();
+
+    // esp_timer counts from reset, so this covers ROM, bootloader and startup
+    s_boot->ms[PERF_BOOT_APP_MAIN] = now_ms > 0 ? now_ms : 1;
+}
+
+void perf_boot_mark(perf_boot_milestone_t milestone)
+{
+    if (s_boot == NULL || milestone >= PERF_BOOT_MILESTONE_COUNT ||
+        s_boot->ms[milestone] != 0) {
+        return;
+    }
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool first = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_boot->ms[milestone] == 0) {
+        s_boot->ms[milestone] = now_ms;
+        first = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!first) {
+        return;
+    }
+
+    ESP_LOGD(TAG, "Boot milestone %s at %lu ms", s_boot_milestone_names[milestone], now_ms);
+
+    if (milestone == PERF_BOOT_FIRST_PIXEL && CONFIG_TIMEMACHINE_FIRST_PIXEL_BUDGET_MS > 0 &&
+        now_ms > CONFIG_TIMEMACHINE_FIRST_PIXEL_BUDGET_MS) {
+        ESP_LOGE(TAG, "First pixel at %lu ms, over the %d ms budget",
+                 now_ms, CONFIG_TIMEMACHINE_FIRST_PIXEL_BUDGET_MS);
+    }
+
+    if (milestone == PERF_BOOT_CLOCK_FRAME) {
+        ESP_LOGI(TAG, "Boot complete: first pixel at %lu ms, clock at %lu ms",
+                 s_boot->ms[PERF_BOOT_FIRST_PIXEL], now_ms);
+        perf_boot_print();
+    }
+}
+
+size_t perf_boot_get_history(perf_boot_record_t *records, size_t max)
+{
+    size_t count = 0;
+
+    if (s_boot == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    uint32_t slot = (uint32_t)(s_boot - s_boot_history.records);
+    for (size_t i = 0; i < PERF_BOOT_HISTORY && count < max; i++) {
+        const perf_boot_record_t *record =
+            &s_boot_history.records[(slot + PERF_BOOT_HISTORY - i) % PERF_BOOT_HISTORY];
+        if (record->ms[PERF_BOOT_APP_MAIN] == 0) {
+            break;
+        }
+        records[count++] = *record;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return count;
+}
+
+void perf_boot_print(void)
+{
+    perf_boot_record_t history[PERF_BOOT_HISTORY];
+    size_t count = perf_boot_get_history(history, PERF_BOOT_HISTORY);
+
+    if (count == 0) {
+        printf("No boot profile recorded\n");
+        return;
+    }
+
+    // Waterfall of this boot: each bar spans from the previous milestone
+    const perf_boot_record_t *boot = &history[0];
+    uint32_t last_ms = 0;
+    for (int i = 0; i < PERF_BOOT_MILESTONE_COUNT; i++) {
+        if (boot->ms[i] > last_ms) {
+            last_ms = boot->ms[i];
+        }
+    }
+
+    printf("Boot profile (ms since reset, reset reason %u, first pixel budget %d ms)\n",
+           boot->reset_reason, CONFIG_TIMEMACHINE_FIRST_PIXEL_BUDGET_MS);
+    printf("%-12s %7s %7s\n", "milestone", "at", "delta");
+
+    uint32_t prev_ms = 0;
+    for (int i = 0; i < PERF_BOOT_MILESTONE_COUNT; i++) {
+        if (boot->ms[i] == 0) {
+            printf("%-12s %7s %7s\n", s_boot_milestone_names[i], "-", "-");
+            continue;
+        }
+
+        uint32_t delta = boot->ms[i] > prev_ms ? boot->ms[i] - prev_ms : 0;
+        int from = (int)((uint64_t)prev_ms * BOOT_WATERFALL_WIDTH / last_ms);
+        int to = (int)((uint64_t)boot->ms[i] * BOOT_WATERFALL_WIDTH / last_ms);
+        int bar = to > from ? to - from : 1;
+
+        printf("%-12s %7lu %7lu |%*s%.*s%s\n", s_boot_milestone_names[i], boot->ms[i], delta,
+               from, "", bar, "########################################",
+               (i == PERF_BOOT_FIRST_PIXEL && CONFIG_TIMEMACHINE_FIRST_PIXEL_BUDGET_MS > 0 &&
+                boot->ms[i] > CONFIG_TIMEMACHINE_FIRST_PIXEL_BUDGET_MS) ? " OVER BUDGET" : "");
+        if (boot->ms[i] > prev_ms) {
+            prev_ms = boot->ms[i];
+        }
+    }
+
+    // Previous boots, one row each
+    printf("\nLast %u boots (ms since reset, newest first)\n", (unsigned)count);
+    printf("%5s", "reset");
+    for (int i = 0; i < PERF_BOOT_MILESTONE_COUNT; i++) {
+        printf(" %11s", s_boot_milestone_names[i]);
+    }
+    printf("\n");
+
+    for (size_t b = 0; b < count; b++) {
+        printf("%5u", history[b].reset_reason);
+        for (int i = 0; i < PERF_BOOT_MILESTONE_COUNT; i++) {
+            if (history[b].ms[i] == 0) {
+                printf(" %11s", "-");
+            } else {
+                printf(" %11lu", history[b].ms[i]);
+            }
+        }
+        printf("\n");
+    }
+}
+
+// ============================================================================
+// Console Commands
+// ============================================================================
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+
+static int cmd_latency(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        perf_input_reset();
+        printf("Input latency histograms cleared\n");
+        return 0;
+    }
+
+    perf_input_print();
+    return 0;
+}
+
+static int cmd_boot(int argc, char **argv)
+{
+    perf_boot_print();
+    return 0;
+}
+
+esp_err_t perf_register_console_commands(void)
+{
+    const esp_console_cmd_t latency_cmd = {
+        .command = "latency",
+        .help = "Show input-to-pixel latency per stage ('latency reset' to clear)",
+        .hint = "[reset]",
+        .func = cmd_latency,
+    };
+    esp_err_t err = esp_console_cmd_register(&latency_cmd);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const esp_console_cmd_t boot_cmd = {
+        .command = "boot",
+        .help = "Show the boot milestone waterfall and the last boots kept in RTC memory",
+        .hint = NULL,
+        .func = cmd_boot,
+    };
+    return esp_console_cmd_register(&boot_cmd);
+}
+
+#else
+
+esp_err_t perf_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -15,6 +15,7 @@
 #include "ntp_sync.h"
 #include "i18n.h"
 #include "weather.h"
+#include "timemachine_events.h"
 
 /**
  * @brief Initialize settings component
@@ -68,6 +69,22 @@ uint8_t settings_get_brightness(void);
  */
 weather_config_t settings_get_weather(void);
 
+/**
+ * @brief Get current panel playlist
+ *
+ * @return Current playlist (from NVS or Kconfig dwell times)
+ */
+timemachine_playlist_t settings_get_playlist(void);
+
+/**
+ * @brief Get the Unix time of the last NTP sync
+ *
+ * Saved on every NTP_SYNCED, used to restore the clock at boot.
+ *
+ * @return Unix time, 0 if the time was never synced
+ */
+int64_t settings_get_last_epoch(void);
+
 /**
  * @brief Deinitialize settings component
  */
@@ -32,6 +32,10 @@ static const char *TAG = "settings";
 #define KEY_WEATHER_API_KEY  "weather_api"
 #define KEY_WEATHER_LOCATION "weather_loc"
 #define KEY_WEATHER_INTERVAL "weather_int"
+#define KEY_PLAYLIST       "playlist"
+#define KEY_LAST_EPOCH     "last_epoch"
+#define KEY_WIFI_CACHE     "wifi_cache"
+#define KEY_WEATHER_CACHE  "weather_cache"
 
 #define DEFAULT_BRIGHTNESS 8  // Medium brightness
 
@@ -45,6 +49,13 @@ static esp_event_handler_instance_t s_ntp_config_handler = NULL;
 static esp_event_handler_instance_t s_language_handler = NULL;
 static esp_event_handler_instance_t s_brightness_handler = NULL;
 static esp_event_handler_instance_t s_weather_config_handler = NULL;
+static esp_event_handler_instance_t s_playlist_handler = NULL;
+static esp_event_handler_instance_t s_ntp_synced_handler = NULL;
+static esp_event_handler_instance_t s_network_connected_handler = NULL;
+static esp_event_handler_instance_t s_weather_updated_handler = NULL;
+
+// Last saved WiFi cache, so unchanged reconnects do not wear the flash
+static timemachine_wifi_cache_t s_wifi_cache = {0};
 
 // Forward declarations
 static void on_network_config_changed(void* arg, esp_event_base_t base,
@@ -59,6 +70,14 @@ static void on_brightness_changed(void* arg, esp_event_base_t base,
                                   int32_t event_id, void* event_data);
 static void on_weather_config_changed(void* arg, esp_event_base_t base,
                                       int32_t event_id, void* event_data);
+static void on_playlist_changed(void* arg, esp_event_base_t base,
+                                int32_t event_id, void* event_data);
+static void on_ntp_synced(void* arg, esp_event_base_t base,
+                          int32_t event_id, void* event_data);
+static void on_network_connected(void* arg, esp_event_base_t base,
+                                 int32_t event_id, void* event_data);
+static void on_weather_updated(void* arg, esp_event_base_t base,
+                               int32_t event_id, void* event_data);
 
 // ============================================================================
 // Public API
@@ -159,6 +178,58 @@ esp_err_t settings_init(void)
         return err;
     }
 
+    err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        PLAYLIST_CHANGED,
+        on_playlist_changed,
+        NULL,
+        &s_playlist_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register PLAYLIST_CHANGED handler");
+        settings_deinit();
+        return err;
+    }
+
+    err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        NTP_SYNCED,
+        on_ntp_synced,
+        NULL,
+        &s_ntp_synced_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register NTP_SYNCED handler");
+        settings_deinit();
+        return err;
+    }
+
+    err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        NETWORK_CONNECTED,
+        on_network_connected,
+        NULL,
+        &s_network_connected_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register NETWORK_CONNECTED handler");
+        settings_deinit();
+        return err;
+    }
+
+    err = esp_event_handler_instance_register(
+        TIMEMACHINE_EVENT,
+        WEATHER_UPDATED,
+        on_weather_updated,
+        NULL,
+        &s_weather_updated_handler
+    );
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register WEATHER_UPDATED handler");
+        settings_deinit();
+        return err;
+    }
+
     s_initialized = true;
     ESP_LOGI(TAG, "Settings initialized");
 
@@ -198,6 +269,14 @@ network_config_t settings_get_network(void)
     config.wifi_authmode = wifi_auth;
     config.max_retries = wifi_retries;
 
+    size_t cache_size = sizeof(s_wifi_cache);
+    err = nvs_get_blob(s_nvs_handle, KEY_WIFI_CACHE, &s_wifi_cache, &cache_size);
+    if (err != ESP_OK || cache_size != sizeof(s_wifi_cache)) {
+        memset(&s_wifi_cache, 0, sizeof(s_wifi_cache));
+    }
+    s_wifi_cache.ssid[sizeof(s_wifi_cache.ssid) - 1] = '\0';
+    config.cache = s_wifi_cache;
+
     return config;
 }
 
@@ -353,9 +432,60 @@ weather_config_t settings_get_weather(void)
     strlcpy(config.location, location, sizeof(config.location));
     config.update_interval = interval;
 
+    // Last fetched weather, shown until the first fetch of this boot
+    size_t cache_size = sizeof(config.cache);
+    err = nvs_get_blob(s_nvs_handle, KEY_WEATHER_CACHE, &config.cache, &cache_size);
+    if (err != ESP_OK || cache_size != sizeof(config.cache)) {
+        memset(&config.cache, 0, sizeof(config.cache));
+    }
+    config.cache.location[sizeof(config.cache.location) - 1] = '\0';
+
     return config;
 }
 
+timemachine_playlist_t settings_get_playlist(void)
+{
+    timemachine_playlist_t playlist = {0};
+    size_t size = sizeof(playlist);
+
+    esp_err_t err = nvs_get_blob(s_nvs_handle, KEY_PLAYLIST, &playlist, &size);
+    if (err == ESP_OK && size == sizeof(playlist) && playlist.count <= TIMEMACHINE_PLAYLIST_MAX) {
+        ESP_LOGI(TAG, "Loaded playlist from NVS: %d entries", playlist.count);
+        return playlist;
+    }
+
+    // Use Kconfig defaults: every panel in order, with its dwell time
+    memset(&playlist, 0, sizeof(playlist));
+    const uint16_t dwell_s[] = {
+        [PANEL_CLOCK]   = CONFIG_TIMEMACHINE_PLAYLIST_CLOCK_DWELL_S,
+        [PANEL_DATE]    = CONFIG_TIMEMACHINE_PLAYLIST_DATE_DWELL_S,
+        [PANEL_WEATHER] = CONFIG_TIMEMACHINE_PLAYLIST_WEATHER_DWELL_S,
+    };
+    for (uint8_t id = 0; id < sizeof(dwell_s) / sizeof(dwell_s[0]); id++) {
+        playlist.entries[playlist.count].panel_id = id;
+        playlist.entries[playlist.count].dwell_s = dwell_s[id];
+        playlist.count++;
+    }
+    ESP_LOGI(TAG, "Using default playlist: %d entries", playlist.count);
+
+    return playlist;
+}
+
+int64_t settings_get_last_epoch(void)
+{
+    int64_t epoch = 0;
+
+    esp_err_t err = nvs_get_i64(s_nvs_handle, KEY_LAST_EPOCH, &epoch);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded last synced time from NVS: %lld", epoch);
+    } else {
+        epoch = 0;
+        ESP_LOGI(TAG, "No synced time in NVS");
+    }
+
+    return epoch;
+}
+
 void settings_deinit(void)
 {
     if (!s_initialized) {
@@ -365,6 +495,42 @@ void settings_deinit(void)
     ESP_LOGI(TAG, "Deinitializing settings...");
 
     // Unregister event handlers
+    if (s_weather_updated_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            WEATHER_UPDATED,
+            s_weather_updated_handler
+        );
+        s_weather_updated_handler = NULL;
+    }
+
+    if (s_network_connected_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            NETWORK_CONNECTED,
+            s_network_connected_handler
+        );
+        s_network_connected_handler = NULL;
+    }
+
+    if (s_ntp_synced_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            NTP_SYNCED,
+            s_ntp_synced_handler
+        );
+        s_ntp_synced_handler = NULL;
+    }
+
+    if (s_playlist_handler != NULL) {
+        esp_event_handler_instance_unregister(
+            TIMEMACHINE_EVENT,
+            PLAYLIST_CHANGED,
+            s_playlist_handler
+        );
+        s_playlist_handler = NULL;
+    }
+
     if (s_brightness_handler != NULL) {
         esp_event_handler_instance_unregister(
             TIMEMACHINE_EVENT,
@@ -507,3 +673,62 @@ static void on_weather_config_changed(void* arg, esp_event_base_t base,
     nvs_commit(s_nvs_handle);
     ESP_LOGI(TAG, "Weather config saved");
 }
+
+static void on_playlist_changed(void* arg, esp_event_base_t base,
+                                int32_t event_id, void* event_data)
+{
+    timemachine_playlist_t *playlist = (timemachine_playlist_t*)event_data;
+
+    ESP_LOGI(TAG, "Saving playlist to NVS: %d entries", playlist->count);
+
+    nvs_set_blob(s_nvs_handle, KEY_PLAYLIST, playlist, sizeof(*playlist));
+
+    nvs_commit(s_nvs_handle);
+    ESP_LOGI(TAG, "Playlist saved");
+}
+
+static void on_ntp_synced(void* arg, esp_event_base_t base,
+                          int32_t event_id, void* event_data)
+{
+    timemachine_ntp_sync_t *sync = (timemachine_ntp_sync_t*)event_data;
+
+    if (!sync->success) {
+        return;
+    }
+
+    // Restored at the next boot if the RTC lost the time (power cycle)
+    nvs_set_i64(s_nvs_handle, KEY_LAST_EPOCH, (int64_t)sync->timestamp);
+
+    nvs_commit(s_nvs_handle);
+    ESP_LOGD(TAG, "Last synced time saved");
+}
+
+static void on_network_connected(void* arg, esp_event_base_t base,
+                                 int32_t event_id, void* event_data)
+{
+    timemachine_network_connected_t *connected = (timemachine_network_connected_t*)event_data;
+
+    // Reconnects to the same AP with the same lease change nothing
+    if (memcmp(&connected->cache, &s_wifi_cache, sizeof(s_wifi_cache)) == 0) {
+        return;
+    }
+    s_wifi_cache = connected->cache;
+
+    // Tried first at the next boot
+    nvs_set_blob(s_nvs_handle, KEY_WIFI_CACHE, &s_wifi_cache, sizeof(s_wifi_cache));
+
+    nvs_commit(s_nvs_handle);
+    ESP_LOGD(TAG, "WiFi cache saved");
+}
+
+static void on_weather_updated(void* arg, esp_event_base_t base,
+                               int32_t event_id, void* event_data)
+{
+    timemachine_weather_cache_t *cache = (timemachine_weather_cache_t*)event_data;
+
+    // One small blob per fetch (every update interval)
+    nvs_set_blob(s_nvs_handle, KEY_WEATHER_CACHE, cache, sizeof(*cache));
+
+    nvs_commit(s_nvs_handle);
+    ESP_LOGD(TAG, "Weather cache saved");
+}
@@ -0,0 +1,79 @@
+/**
+ * @file startup.h
+ * @brief Dependency-ordered component startup
+ *
+ * Components are described as nodes of a graph: each names the nodes it
+ * depends on and, optionally, the TIMEMACHINE_EVENT that marks it ready
+ * (e.g. the network is only usable once NETWORK_CONNECTED is posted).
+ * A node is initialized as soon as all its dependencies are ready, each in
+ * its own short-lived task, so independent components start in parallel.
+ * A failing init is logged and only skips its dependents.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define STARTUP_MAX_NODES 24
+#define STARTUP_MAX_DEPS  4
+#define STARTUP_NO_EVENT  (-1)
+
+/**
+ * @brief Startup graph node
+ */
+typedef struct {
+    const char *name;                       /**< Unique node name */
+    esp_err_t (*init)(void);                /**< Initialization, runs in a startup task */
+    const char *deps[STARTUP_MAX_DEPS];     /**< Nodes that must be ready first (unused = NULL) */
+    int32_t ready_event;                    /**< TIMEMACHINE_EVENT that marks the node ready
+                                                 after init, STARTUP_NO_EVENT = when init returns */
+} startup_node_t;
+
+/**
+ * @brief Node state
+ */
+typedef enum {
+    STARTUP_PENDING,    /**< Waiting for dependencies */
+    STARTUP_RUNNING,    /**< init() in progress */
+    STARTUP_WAITING,    /**< Initialized, waiting for the ready event */
+    STARTUP_READY,      /**< Ready, dependents may start */
+    STARTUP_FAILED,     /**< init() returned an error */
+    STARTUP_SKIPPED,    /**< A dependency failed */
+} startup_state_t;
+
+/**
+ * @brief Start the graph
+ *
+ * Validates the graph and starts every node without dependencies. Returns
+ * right away; the rest of the graph runs from startup tasks and the event
+ * loop. Requires the default event loop. The timeline is printed once
+ * every node is ready, failed or skipped.
+ *
+ * @param nodes Graph, must stay valid (typically a static const array)
+ * @param count Number of nodes
+ * @return ESP_OK, ESP_ERR_NOT_FOUND for an unknown dependency,
+ *         ESP_ERR_INVALID_ARG for a cycle or invalid node
+ */
+esp_err_t startup_run(const startup_node_t *nodes, size_t count);
+
+/**
+ * @brief Get the state of a node
+ *
+ * @param name Node name
+ * @return Node state, STARTUP_SKIPPED if there is no such node
+ */
+startup_state_t startup_get_state(const char *name);
+
+/**
+ * @brief Print the boot timeline: per node start, init duration and ready time
+ */
+void startup_print_timeline(void);
+
+/**
+ * @brief Register the `startup` console command
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CONFIG_TIMEMACHINE_CONSOLE
+ */
+esp_err_t startup_register_console_commands(void);
@@ -0,0 +1,441 @@
+/**
+ * @file startup.c
+ * @brief Dependency-ordered component startup
+ */
+
+#include "startup.h"
+#include "timemachine_events.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
+
+static const char *TAG = "startup";
+
+#define STARTUP_TASK_STACK    4096
+#define STARTUP_TASK_PRIORITY 5
+
+static const char *s_state_names[] = {
+    [STARTUP_PENDING] = "pending",
+    [STARTUP_RUNNING] = "running",
+    [STARTUP_WAITING] = "waiting",
+    [STARTUP_READY]   = "ready",
+    [STARTUP_FAILED]  = "failed",
+    [STARTUP_SKIPPED] = "skipped",
+};
+
+typedef struct {
+    startup_state_t state;
+    int8_t deps[STARTUP_MAX_DEPS];      /**< Node indices, -1 = unused */
+    int64_t start_us;
+    int64_t init_done_us;
+    int64_t ready_us;
+    esp_err_t err;
+} node_runtime_t;
+
+static struct {
+    const startup_node_t *nodes;
+    size_t count;
+    node_runtime_t rt[STARTUP_MAX_NODES];
+    uint8_t running;
+    bool settled;
+    uint64_t events_seen;               /**< Bit per TIMEMACHINE_EVENT id */
+    SemaphoreHandle_t mutex;
+    esp_event_handler_instance_t handlers[STARTUP_MAX_NODES];
+    int32_t handler_events[STARTUP_MAX_NODES];
+    uint8_t handler_count;
+} s_state = {0};
+
+// Forward declarations
+static void node_task(void *arg);
+static void ready_event_handler(void* arg, esp_event_base_t base,
+                                int32_t event_id, void* event_data);
+
+// ============================================================================
+// Private
+// ============================================================================
+
+static int find_node(const char *name)
+{
+    for (size_t i = 0; i < s_state.count; i++) {
+        if (strcmp(s_state.nodes[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static uint32_t us_to_ms(int64_t us)
+{
+    return (uint32_t)(us / 1000);
+}
+
+/**
+ * @brief Reject graphs where some node can never start (Kahn's algorithm)
+ */
+static bool has_cycle(void)
+{
+    bool done[STARTUP_MAX_NODES] = {0};
+    size_t done_count = 0;
+    bool progress = true;
+
+    while (progress) {
+        progress = false;
+        for (size_t i = 0; i < s_state.count; i++) {
+            if (done[i]) {
+                continue;
+            }
+            bool deps_done = true;
+            for (int d = 0; d < STARTUP_MAX_DEPS; d++) {
+                int dep = s_state.rt[i].deps[d];
+                if (dep >= 0 && !done[dep]) {
+                    deps_done = false;
+                    break;
+                }
+            }
+            if (deps_done) {
+                done[i] = true;
+                done_count++;
+                progress = true;
+            }
+        }
+    }
+
+    return done_count != s_state.count;
+}
+
+/**
+ * @brief Start or skip every pending node whose dependencies are settled
+ *
+ * Called with the mutex held.
+ *
+ * @return true if the whole graph just settled
+ */
+static bool dispatch_locked(void)
+{
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (size_t i = 0; i < s_state.count; i++) {
+            if (s_state.rt[i].state != STARTUP_PENDING) {
+                continue;
+            }
+
+            bool deps_ready = true;
+            bool deps_failed = false;
+            for (int d = 0; d < STARTUP_MAX_DEPS; d++) {
+                int dep = s_state.rt[i].deps[d];
+                if (dep < 0) {
+                    continue;
+                }
+                startup_state_t dep_state = s_state.rt[dep].state;
+                if (dep_state == STARTUP_FAILED || dep_state == STARTUP_SKIPPED) {
+                    deps_failed = true;
+                }
+                if (dep_state != STARTUP_READY) {
+                    deps_ready = false;
+                }
+            }
+
+            if (deps_failed) {
+                ESP_LOGW(TAG, "Skipping %s: a dependency failed", s_state.nodes[i].name);
+                s_state.rt[i].state = STARTUP_SKIPPED;
+                changed = true;
+                continue;
+            }
+
+            if (!deps_ready || s_state.running >= CONFIG_TIMEMACHINE_STARTUP_PARALLEL) {
+                continue;
+            }
+
+            s_state.rt[i].state = STARTUP_RUNNING;
+            s_state.rt[i].start_us = esp_timer_get_time();
+            s_state.running++;
+
+            BaseType_t ret = xTaskCreate(node_task, s_state.nodes[i].name,
+                                         STARTUP_TASK_STACK, (void *)i,
+                                         STARTUP_TASK_PRIORITY, NULL);
+            if (ret != pdPASS) {
+                ESP_LOGE(TAG, "Failed to create task for %s", s_state.nodes[i].name);
+                s_state.rt[i].state = STARTUP_FAILED;
+                s_state.rt[i].err = ESP_ERR_NO_MEM;
+                s_state.running--;
+                changed = true;
+            }
+        }
+    }
+
+    if (s_state.settled) {
+        return false;
+    }
+
+    for (size_t i = 0; i < s_state.count; i++) {
+        startup_state_t state = s_state.rt[i].state;
+        if (state != STARTUP_READY && state != STARTUP_FAILED && state != STARTUP_SKIPPED) {
+            return false;
+        }
+    }
+
+    s_state.settled = true;
+    return true;
+}
+
+static void on_settled(void)
+{
+    // Ready events are no longer needed
+    for (uint8_t i = 0; i < s_state.handler_count; i++) {
+        esp_event_handler_instance_unregister(TIMEMACHINE_EVENT, s_state.handler_events[i],
+                                              s_state.handlers[i]);
+    }
+    s_state.handler_count = 0;
+
+    ESP_LOGI(TAG, "Startup complete after %lu ms", us_to_ms(esp_timer_get_time()));
+    startup_print_timeline();
+}
+
+static void node_task(void *arg)
+{
+    size_t idx = (size_t)arg;
+    const startup_node_t *node = &s_state.nodes[idx];
+
+    esp_err_t err = node->init();
+    int64_t done_us = esp_timer_get_time();
+
+    xSemaphoreTake(s_state.mutex, portMAX_DELAY);
+    s_state.rt[idx].init_done_us = done_us;
+    s_state.rt[idx].err = err;
+    if (err != ESP_OK) {
+        s_state.rt[idx].state = STARTUP_FAILED;
+    } else if (node->ready_event != STARTUP_NO_EVENT &&
+               !(s_state.events_seen & (1ULL << node->ready_event))) {
+        s_state.rt[idx].state = STARTUP_WAITING;
+    } else {
+        s_state.rt[idx].state = STARTUP_READY;
+        s_state.rt[idx].ready_us = done_us;
+    }
+    s_state.running--;
+    bool settled = dispatch_locked();
+    uint32_t init_ms = us_to_ms(done_us - s_state.rt[idx].start_us);
+    xSemaphoreGive(s_state.mutex);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s failed after %lu ms: %s", node->name, init_ms, esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "%s initialized in %lu ms", node->name, init_ms);
+    }
+
+    if (settled) {
+        on_settled();
+    }
+
+    vTaskDelete(NULL);
+}
+
+static void ready_event_handler(void* arg, esp_event_base_t base,
+                                int32_t event_id, void* event_data)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(s_state.mutex, portMAX_DELAY);
+    s_state.events_seen |= 1ULL << event_id;
+    for (size_t i = 0; i < s_state.count; i++) {
+        if (s_state.rt[i].state == STARTUP_WAITING && s_state.nodes[i].ready_event == event_id) {
+            s_state.rt[i].state = STARTUP_READY;
+            s_state.rt[i].ready_us = now;
+            ESP_LOGI(TAG, "%s ready at %lu ms", s_state.nodes[i].name, us_to_ms(now));
+        }
+    }
+    bool settled = dispatch_locked();
+    xSemaphoreGive(s_state.mutex);
+
+    if (settled) {
+        on_settled();
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+esp_err_t startup_run(const startup_node_t *nodes, size_t count)
+{
+    if (nodes == NULL || count == 0 || count > STARTUP_MAX_NODES) {
+        ESP_LOGE(TAG, "Invalid graph");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_state.nodes != NULL) {
+        ESP_LOGW(TAG, "Already started");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_state.nodes = nodes;
+    s_state.count = count;
+
+    // Resolve dependency names
+    for (size_t i = 0; i < count; i++) {
+        if (nodes[i].name == NULL || nodes[i].init == NULL ||
+            nodes[i].ready_event >= 64) {
+            ESP_LOGE(TAG, "Invalid node %u", (unsigned)i);
+            s_state.nodes = NULL;
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        s_state.rt[i].state = STARTUP_PENDING;
+        for (int d = 0; d < STARTUP_MAX_DEPS; d++) {
+            s_state.rt[i].deps[d] = -1;
+            if (nodes[i].deps[d] == NULL) {
+                continue;
+            }
+            int dep = find_node(nodes[i].deps[d]);
+            if (dep < 0) {
+                ESP_LOGE(TAG, "%s depends on unknown node %s", nodes[i].name, nodes[i].deps[d]);
+                s_state.nodes = NULL;
+                return ESP_ERR_NOT_FOUND;
+            }
+            s_state.rt[i].deps[d] = dep;
+        }
+    }
+
+    if (has_cycle()) {
+        ESP_LOGE(TAG, "Dependency cycle in startup graph");
+        s_state.nodes = NULL;
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_state.mutex = xSemaphoreCreateMutex();
+    if (s_state.mutex == NULL) {
+        s_state.nodes = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    // One handler per distinct ready event
+    for (size_t i = 0; i < count; i++) {
+        int32_t event_id = nodes[i].ready_event;
+        if (event_id == STARTUP_NO_EVENT) {
+            continue;
+        }
+
+        bool registered = false;
+        for (uint8_t h = 0; h < s_state.handler_count; h++) {
+            if (s_state.handler_events[h] == event_id) {
+                registered = true;
+            }
+        }
+        if (registered) {
+            continue;
+        }
+
+        esp_err_t err = esp_event_handler_instance_register(
+            TIMEMACHINE_EVENT,
+            event_id,
+            ready_event_handler,
+            NULL,
+            &s_state.handlers[s_state.handler_count]
+        );
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register ready event handler");
+            return err;
+        }
+        s_state.handler_events[s_state.handler_count++] = event_id;
+    }
+
+    ESP_LOGI(TAG, "Starting %u components, up to %d in parallel",
+             (unsigned)count, CONFIG_TIMEMACHINE_STARTUP_PARALLEL);
+
+    xSemaphoreTake(s_state.mutex, portMAX_DELAY);
+    bool settled = dispatch_locked();
+    xSemaphoreGive(s_state.mutex);
+
+    if (settled) {
+        on_settled();
+    }
+
+    return ESP_OK;
+}
+
+startup_state_t startup_get_state(const char *name)
+{
+    int idx = s_state.nodes != NULL ? find_node(name) : -1;
+    return idx >= 0 ? s_state.rt[idx].state : STARTUP_SKIPPED;
+}
+
+void startup_print_timeline(void)
+{
+    if (s_state.nodes == NULL) {
+        printf("Startup not run\n");
+        return;
+    }
+
+    printf("Startup timeline (ms since boot)\n");
+    printf("%-16s %7s %7s %7s  %s\n", "component", "start", "init", "ready", "state");
+
+    xSemaphoreTake(s_state.mutex, portMAX_DELAY);
+    for (size_t i = 0; i < s_state.count; i++) {
+        const node_runtime_t *rt = &s_state.rt[i];
+        char start[12] = "-";
+        char init[12] = "-";
+        char ready[12] = "-";
+
+        if (rt->state != STARTUP_PENDING && rt->state != STARTUP_SKIPPED) {
+            snprintf(start, sizeof(start), "%lu", us_to_ms(rt->start_us));
+        }
+        if (rt->state >= STARTUP_WAITING && rt->state != STARTUP_SKIPPED) {
+            snprintf(init, sizeof(init), "%lu", us_to_ms(rt->init_done_us - rt->start_us));
+        }
+        if (rt->state == STARTUP_READY) {
+            snprintf(ready, sizeof(ready), "%lu", us_to_ms(rt->ready_us));
+        }
+
+        printf("%-16s %7s %7s %7s  %s", s_state.nodes[i].name, start, init, ready,
+               s_state_names[rt->state]);
+        if (rt->state == STARTUP_FAILED) {
+            printf(" (%s)", esp_err_to_name(rt->err));
+        }
+        printf("\n");
+    }
+    xSemaphoreGive(s_state.mutex);
+}
+
+// ============================================================================
+// Console Commands
+// ============================================================================
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+
+static int cmd_startup(int argc, char **argv)
+{
+    startup_print_timeline();
+    return 0;
+}
+
+esp_err_t startup_register_console_commands(void)
+{
+    const esp_console_cmd_t startup_cmd = {
+        .command = "startup",
+        .help = "Show the boot timeline: start, init duration and ready time per component",
+        .hint = NULL,
+        .func = cmd_startup,
+    };
+    return esp_console_cmd_register(&startup_cmd);
+}
+
+#else
+
+esp_err_t startup_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
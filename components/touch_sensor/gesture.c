@@ -0,0 +1,191 @@
+/**
+ * @file gesture.c
+ * @brief Timestamp-driven touch gesture recognizer
+ */
+
+#include "gesture.h"
+#include <string.h>
+
+// ============================================================================
+// Private
+// ============================================================================
+
+static int64_t ms_to_us(uint32_t ms)
+{
+    return (int64_t)ms * 1000;
+}
+
+static bool is_enabled(const gesture_recognizer_t *rec, uint32_t mask)
+{
+    return (rec->enabled_mask & mask) != 0;
+}
+
+/**
+ * @brief Whether another press could still turn the pending taps into a
+ *        different gesture
+ */
+static bool waits_for_more(const gesture_recognizer_t *rec)
+{
+    switch (rec->tap_count) {
+    case 1:
+        return is_enabled(rec, GESTURE_MASK_DOUBLE_TAP | GESTURE_MASK_TRIPLE_TAP |
+                               GESTURE_MASK_TAP_HOLD);
+    case 2:
+        return is_enabled(rec, GESTURE_MASK_TRIPLE_TAP | GESTURE_MASK_TAP_HOLD);
+    default:
+        return false;
+    }
+}
+
+static size_t flush_taps(gesture_recognizer_t *rec, gesture_t *out)
+{
+    size_t count = 0;
+
+    if (rec->tap_count == 3 && is_enabled(rec, GESTURE_MASK_TRIPLE_TAP)) {
+        out[count++] = GESTURE_TRIPLE_TAP;
+    } else if (rec->tap_count == 2 && is_enabled(rec, GESTURE_MASK_DOUBLE_TAP)) {
+        out[count++] = GESTURE_DOUBLE_TAP;
+    } else {
+        // No matching multi-tap gesture, report the taps individually
+        while (count < rec->tap_count && count < GESTURE_MAX_OUTPUT) {
+            out[count++] = GESTURE_TAP;
+        }
+    }
+
+    rec->tap_count = 0;
+    return count;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void gesture_init(gesture_recognizer_t *rec, const gesture_config_t *config)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->config = *config;
+}
+
+void gesture_set_enabled(gesture_recognizer_t *rec, uint32_t mask)
+{
+    rec->enabled_mask = mask;
+}
+
+size_t gesture_on_edge(gesture_recognizer_t *rec, bool active, int64_t time_us,
+                       gesture_t *out)
+{
+    // Deadlines that passed before this edge are resolved first
+    size_t count = gesture_on_time(rec, time_us, out);
+
+    if (active && !rec->pressed) {
+        rec->pressed = true;
+        rec->long_press = false;
+        rec->hold = false;
+        rec->press_us = time_us;
+    } else if (!active && rec->pressed) {
+        rec->pressed = false;
+        rec->release_us = time_us;
+
+        if (rec->long_press) {
+            rec->long_press = false;
+            rec->hold = false;
+            out[count++] = GESTURE_RELEASE;
+        } else {
+            rec->tap_count++;
+            if (!waits_for_more(rec)) {
+                count += flush_taps(rec, out + count);
+            }
+        }
+    }
+
+    return count;
+}
+
+size_t gesture_on_time(gesture_recognizer_t *rec, int64_t now_us, gesture_t *out)
+{
+    size_t count = 0;
+
+    if (rec->pressed) {
+        int64_t held_us = now_us - rec->press_us;
+
+        if (!rec->long_press && held_us >= ms_to_us(rec->config.long_press_ms)) {
+            rec->long_press = true;
+            if (rec->tap_count > 0) {
+                // Pending taps followed by a hold
+                rec->tap_count = 0;
+                rec->hold = true;
+                out[count++] = GESTURE_TAP_HOLD;
+            } else {
+                out[count++] = GESTURE_LONG_PRESS;
+            }
+        }
+
+        if (rec->long_press && !rec->hold && held_us >= ms_to_us(rec->config.hold_ms)) {
+            rec->hold = true;
+            out[count++] = GESTURE_HOLD;
+        }
+    } else if (rec->tap_count > 0 &&
+               now_us - rec->release_us >= ms_to_us(rec->config.multi_tap_ms)) {
+        // Multi-tap window closed without another press
+        count += flush_taps(rec, out + count);
+    }
+
+    return count;
+}
+
+int64_t gesture_next_deadline(const gesture_recognizer_t *rec)
+{
+    if (rec->pressed) {
+        if (!rec->long_press) {
+            return rec->press_us + ms_to_us(rec->config.long_press_ms);
+        }
+        if (!rec->hold) {
+            return rec->press_us + ms_to_us(rec->config.hold_ms);
+        }
+        return INT64_MAX;
+    }
+
+    if (rec->tap_count > 0) {
+        return rec->release_us + ms_to_us(rec->config.multi_tap_ms);
+    }
+
+    return INT64_MAX;
+}
+
+void gesture_debounce_init(gesture_debounce_t *deb, uint32_t debounce_ms)
+{
+    memset(deb, 0, sizeof(*deb));
+    deb->window_us = ms_to_us(debounce_ms);
+    deb->last_edge_us = INT64_MIN / 2;
+}
+
+bool gesture_debounce_edge(gesture_debounce_t *deb, int64_t time_us)
+{
+    if (time_us - deb->last_edge_us < deb->window_us) {
+        deb->bounce_us = time_us;
+        deb->settle_pending = true;
+        return false;
+    }
+
+    deb->last_edge_us = time_us;
+    return true;
+}
+
+int64_t gesture_debounce_deadline(const gesture_debounce_t *deb)
+{
+    return deb->settle_pending ? deb->last_edge_us + deb->window_us : INT64_MAX;
+}
+
+bool gesture_debounce_settle(gesture_debounce_t *deb, int64_t now_us, int64_t *edge_us)
+{
+    if (now_us < gesture_debounce_deadline(deb)) {
+        return false;
+    }
+
+    // The level changed at the last bounce, not now: a tap released within
+    // the window would otherwise last until the long-press deadline
+    deb->settle_pending = false;
+    deb->last_edge_us = deb->bounce_us;
+    *edge_us = deb->bounce_us;
+    return true;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file gesture.h
+ * @brief Timestamp-driven touch gesture recognizer
+ *
+ * Turns a timeline of debounced press/release edges into gestures, with
+ * the debounce filter in front of it. Pure C with no ESP-IDF dependencies,
+ * so recorded edge timelines can be replayed through them on the host
+ * (tools/gesture/).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Recognized gestures
+ */
+typedef enum {
+    GESTURE_TAP,          /**< Single short press */
+    GESTURE_DOUBLE_TAP,   /**< Two taps within the multi-tap window */
+    GESTURE_TRIPLE_TAP,   /**< Three taps within the multi-tap window */
+    GESTURE_LONG_PRESS,   /**< Press held for long_press_ms */
+    GESTURE_HOLD,         /**< Press held for hold_ms (follows GESTURE_LONG_PRESS) */
+    GESTURE_TAP_HOLD,     /**< Tap followed by a press held for long_press_ms */
+    GESTURE_RELEASE,      /**< Release after GESTURE_LONG_PRESS or GESTURE_TAP_HOLD */
+} gesture_t;
+
+/**
+ * @brief Gestures the recognizer waits for before reporting a tap
+ *
+ * Multi-tap and tap-then-hold gestures delay single taps by the multi-tap
+ * window. Only enable the ones somebody listens to.
+ */
+#define GESTURE_MASK_DOUBLE_TAP  (1 << GESTURE_DOUBLE_TAP)
+#define GESTURE_MASK_TRIPLE_TAP  (1 << GESTURE_TRIPLE_TAP)
+#define GESTURE_MASK_TAP_HOLD    (1 << GESTURE_TAP_HOLD)
+
+/**
+ * @brief Recognizer thresholds
+ */
+typedef struct {
+    uint32_t long_press_ms;   /**< Press duration that makes a long press */
+    uint32_t multi_tap_ms;    /**< Max gap between release and next press of a multi-tap */
+    uint32_t hold_ms;         /**< Press duration that makes a hold */
+} gesture_config_t;
+
+/**
+ * @brief Recognizer state
+ */
+typedef struct {
+    gesture_config_t config;
+    uint32_t enabled_mask;    /**< GESTURE_MASK_* */
+    bool pressed;
+    bool long_press;          /**< Current press reported as long press or tap-hold */
+    bool hold;                /**< Current press reported as hold */
+    uint8_t tap_count;        /**< Taps waiting for the multi-tap window */
+    int64_t press_us;
+    int64_t release_us;
+} gesture_recognizer_t;
+
+/**
+ * @brief Debounce filter state
+ */
+typedef struct {
+    int64_t window_us;
+    int64_t last_edge_us;     /**< Last accepted edge */
+    int64_t bounce_us;        /**< Last filtered edge */
+    bool settle_pending;      /**< Edges were filtered, level to be sampled again */
+} gesture_debounce_t;
+
+/**
+ * @brief Maximum gestures produced by a single call
+ */
+#define GESTURE_MAX_OUTPUT 3
+
+/**
+ * @brief Initialize a recognizer
+ */
+void gesture_init(gesture_recognizer_t *rec, const gesture_config_t *config);
+
+/**
+ * @brief Set which delaying gestures are recognized (GESTURE_MASK_*)
+ */
+void gesture_set_enabled(gesture_recognizer_t *rec, uint32_t mask);
+
+/**
+ * @brief Feed a debounced edge
+ *
+ * @param active  Touch active after the edge
+ * @param time_us Edge timestamp
+ * @param out     Receives up to GESTURE_MAX_OUTPUT gestures
+ * @return Number of gestures written to out
+ */
+size_t gesture_on_edge(gesture_recognizer_t *rec, bool active, int64_t time_us,
+                       gesture_t *out);
+
+/**
+ * @brief Advance time without an edge
+ *
+ * Call when the deadline from gesture_next_deadline() has passed.
+ *
+ * @return Number of gestures written to out
+ */
+size_t gesture_on_time(gesture_recognizer_t *rec, int64_t now_us, gesture_t *out);
+
+/**
+ * @brief Time at which gesture_on_time() may produce a gesture
+ *
+ * @return Deadline in microseconds, INT64_MAX if nothing is pending
+ */
+int64_t gesture_next_deadline(const gesture_recognizer_t *rec);
+
+/**
+ * @brief Initialize a debounce filter
+ *
+ * Edges within debounce_ms of the last accepted one are bounces. Once the
+ * window has passed the level is sampled again and fed to the recognizer
+ * at the time of the last bounce, when it last changed. debounce_ms must
+ * be below the long press, or a tap released within the window would be
+ * a long press by then.
+ */
+void gesture_debounce_init(gesture_debounce_t *deb, uint32_t debounce_ms);
+
+/**
+ * @brief Filter a raw edge
+ *
+ * @return true if the edge is accepted and goes to gesture_on_edge(),
+ *         false if it is a bounce
+ */
+bool gesture_debounce_edge(gesture_debounce_t *deb, int64_t time_us);
+
+/**
+ * @brief Time at which the level is to be sampled again
+ *
+ * @return Deadline in microseconds, INT64_MAX if no edge was filtered
+ */
+int64_t gesture_debounce_deadline(const gesture_debounce_t *deb);
+
+/**
+ * @brief Whether the level is to be sampled again now
+ *
+ * @param edge_us Receives the time to feed the sampled level at
+ * @return true once, when the deadline has passed
+ */
+bool gesture_debounce_settle(gesture_debounce_t *deb, int64_t now_us, int64_t *edge_us);
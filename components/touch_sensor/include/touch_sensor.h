@@ -10,21 +10,45 @@
 typedef struct {
     gpio_num_t gpio;           /**< GPIO pin for TTP223 sensor */
     bool active_high;          /**< true if touch = HIGH, false if touch = LOW */
-    uint32_t debounce_ms;      /**< Debounce time in milliseconds */
+    uint32_t debounce_ms;      /**< Debounce time in milliseconds, below long_press_ms */
+    uint32_t long_press_ms;    /**< Press duration for INPUT_LONG_PRESS (0 = 200) */
+    uint32_t multi_tap_ms;     /**< Max gap between taps of a multi-tap (0 = 300) */
+    uint32_t hold_ms;          /**< Press duration for INPUT_HOLD (0 = 3000) */
 } touch_sensor_config_t;
 
+/**
+ * @brief Gestures that delay tap reporting, for touch_sensor_enable_gestures()
+ */
+#define TOUCH_GESTURE_DOUBLE_TAP  (1 << 1)
+#define TOUCH_GESTURE_TRIPLE_TAP  (1 << 2)
+#define TOUCH_GESTURE_TAP_HOLD    (1 << 5)
+
 /**
  * @brief Initialize touch sensor
  *
  * Configures GPIO and sets up interrupt handler to detect touches.
- * Emits INPUT_PRESS when touched, INPUT_RELEASE when released,
- * and INPUT_TAP for short taps (press + quick release).
+ * The ISR only timestamps edges; a dedicated task debounces them and
+ * feeds a gesture recognizer that emits INPUT_TAP, INPUT_LONG_PRESS,
+ * INPUT_HOLD and INPUT_RELEASE, plus INPUT_DOUBLE_TAP, INPUT_TRIPLE_TAP
+ * and INPUT_TAP_HOLD once enabled with touch_sensor_enable_gestures().
  *
  * @param config Touch sensor configuration
- * @return ESP_OK on success, error code otherwise
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the debounce time is
+ *         not shorter than the long press, error code otherwise
  */
 esp_err_t touch_sensor_init(const touch_sensor_config_t *config);
 
+/**
+ * @brief Enable gestures that need to wait for a following tap
+ *
+ * Until a multi-tap or tap-then-hold gesture is enabled, INPUT_TAP is
+ * emitted as soon as the touch is released. Call this from components
+ * that register handlers for those events. Masks accumulate.
+ *
+ * @param mask TOUCH_GESTURE_* flags
+ */
+void touch_sensor_enable_gestures(uint32_t mask);
+
 /**
  * @brief Deinitialize touch sensor
  */
@@ -1,110 +1,198 @@
 #include "touch_sensor.h"
+#include "gesture.h"
 #include "timemachine_events.h"
+#include "perf.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/timers.h"
+#include "freertos/queue.h"
 
 static const char *TAG = "touch_sensor";
 
-#define LONG_PRESS_MS 200  // Time to wait before emitting INPUT_LONG_PRESS
+#define DEFAULT_LONG_PRESS_MS 200
+#define DEFAULT_MULTI_TAP_MS  300
+#define DEFAULT_HOLD_MS       3000
+#define EDGE_QUEUE_LEN 16
+
+_Static_assert(TOUCH_GESTURE_DOUBLE_TAP == GESTURE_MASK_DOUBLE_TAP &&
+               TOUCH_GESTURE_TRIPLE_TAP == GESTURE_MASK_TRIPLE_TAP &&
+               TOUCH_GESTURE_TAP_HOLD == GESTURE_MASK_TAP_HOLD,
+               "Public gesture flags must match the recognizer masks");
+
+/**
+ * @brief Edge captured in the ISR
+ */
+typedef struct {
+    int64_t time_us;   /**< esp_timer timestamp of the edge */
+    bool active;       /**< Touch active after the edge */
+} touch_edge_t;
 
 static struct {
     bool initialized;
     touch_sensor_config_t config;
-    TickType_t last_touch_time;
-    TimerHandle_t release_timer;
-    bool is_pressed;
-    bool long_press_detected;
+    QueueHandle_t edge_queue;
+    TaskHandle_t task_handle;
+    gesture_recognizer_t recognizer;
+    gesture_debounce_t debounce;
+    volatile uint32_t gesture_mask;
+    int64_t last_edge_us;       // Last edge fed to the recognizer
     // Debug counters
     uint32_t press_count;
     uint32_t release_count;
     uint32_t debounce_skip_count;
+    uint32_t dropped_edge_count;
 } s_state = {0};
 
 // Forward declarations
 static void gpio_isr_handler(void* arg);
-static void release_timer_callback(TimerHandle_t timer);
+static void touch_task(void *pvParameters);
 
 // ============================================================================
-// Private - Timer Callback
+// Private - Gesture Handling
 // ============================================================================
 
-static void release_timer_callback(TimerHandle_t timer)
+static void post_gestures(const gesture_t *gestures, size_t count, int64_t edge_us)
 {
-    // Check if button is still pressed
-    int level = gpio_get_level(s_state.config.gpio);
-    bool is_touch_active = (level == 1) == s_state.config.active_high;
-
-    if (!is_touch_active) {
-        // Button was released
-        if (s_state.long_press_detected) {
-            // Long press was active, now released
-            ESP_LOGI(TAG, "Long press released (polling detected)");
-            s_state.is_pressed = false;
-            s_state.long_press_detected = false;
-
-            // Reset timer to original long press period for next press
-            xTimerChangePeriod(timer, pdMS_TO_TICKS(LONG_PRESS_MS), 0);
-
-            // Post INPUT_RELEASE event
-            esp_err_t err = esp_event_post(
-                TIMEMACHINE_EVENT,
-                INPUT_RELEASE,
-                NULL,
-                0,
-                portMAX_DELAY
-            );
-
-            if (err != ESP_OK) {
-                ESP_LOGW(TAG, "Failed to post INPUT_RELEASE event: %s", esp_err_to_name(err));
-            }
-        } else if (s_state.is_pressed) {
-            // Timer expired and button already released - this was a tap
-            ESP_LOGI(TAG, "Tap detected (button released before long press)");
-            s_state.is_pressed = false;
-
-            // Post INPUT_TAP event
-            esp_err_t err = esp_event_post(
-                TIMEMACHINE_EVENT,
-                INPUT_TAP,
-                NULL,
-                0,
-                portMAX_DELAY
-            );
-
-            if (err != ESP_OK) {
-                ESP_LOGW(TAG, "Failed to post INPUT_TAP event: %s", esp_err_to_name(err));
-            }
-        }
-        return;
-    }
+    static const struct {
+        int32_t event_id;
+        const char *name;
+    } s_gesture_events[] = {
+        [GESTURE_TAP]        = { INPUT_TAP,        "INPUT_TAP" },
+        [GESTURE_DOUBLE_TAP] = { INPUT_DOUBLE_TAP, "INPUT_DOUBLE_TAP" },
+        [GESTURE_TRIPLE_TAP] = { INPUT_TRIPLE_TAP, "INPUT_TRIPLE_TAP" },
+        [GESTURE_LONG_PRESS] = { INPUT_LONG_PRESS, "INPUT_LONG_PRESS" },
+        [GESTURE_HOLD]       = { INPUT_HOLD,       "INPUT_HOLD" },
+        [GESTURE_TAP_HOLD]   = { INPUT_TAP_HOLD,   "INPUT_TAP_HOLD" },
+        [GESTURE_RELEASE]    = { INPUT_RELEASE,    "INPUT_RELEASE" },
+    };
+
+    timemachine_input_t input = {
+        .edge_us = edge_us
+    };
 
-    if (!s_state.long_press_detected) {
-        // First time timer expired - button still pressed, this is a long press
-        s_state.long_press_detected = true;
-        ESP_LOGI(TAG, "Long press detected (level=%d), starting polling", level);
+    for (size_t i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "Gesture: %s", s_gesture_events[gestures[i]].name);
+
+        // Taps switch panels, trace them through to the display
+        if (gestures[i] == GESTURE_TAP) {
+            perf_input_begin(edge_us);
+        }
 
-        // Post INPUT_LONG_PRESS event
         esp_err_t err = esp_event_post(
             TIMEMACHINE_EVENT,
-            INPUT_LONG_PRESS,
-            NULL,
-            0,
+            s_gesture_events[gestures[i]].event_id,
+            &input,
+            sizeof(input),
             portMAX_DELAY
         );
 
         if (err != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to post INPUT_LONG_PRESS event: %s", esp_err_to_name(err));
+            ESP_LOGW(TAG, "Failed to post %s event: %s",
+                     s_gesture_events[gestures[i]].name, esp_err_to_name(err));
         }
+    }
+}
 
-        // Start polling for release - restart timer with shorter period
-        xTimerChangePeriod(timer, pdMS_TO_TICKS(50), 0);  // Poll every 50ms
-        xTimerStart(timer, 0);  // Restart the one-shot timer
+static void handle_level(bool active, int64_t time_us)
+{
+    gesture_t gestures[GESTURE_MAX_OUTPUT];
+
+    if (active == s_state.recognizer.pressed) {
+        return;
+    }
+
+    s_state.last_edge_us = time_us;
+    if (active) {
+        s_state.press_count++;
     } else {
-        // Already in long press mode, keep polling by restarting timer
-        xTimerStart(timer, 0);  // Restart the one-shot timer for next poll
+        s_state.release_count++;
+    }
+
+    size_t count = gesture_on_edge(&s_state.recognizer, active, time_us, gestures);
+    post_gestures(gestures, count, time_us);
+}
+
+static void handle_timeout(int64_t now_us)
+{
+    gesture_t gestures[GESTURE_MAX_OUTPUT];
+    int64_t edge_us;
+
+    // Picked up here and on edges, so the recognizer is only touched by this task
+    gesture_set_enabled(&s_state.recognizer, s_state.gesture_mask);
+
+    // Edges were filtered by the debounce window, sample the settled level
+    if (gesture_debounce_settle(&s_state.debounce, now_us, &edge_us)) {
+        int level = gpio_get_level(s_state.config.gpio);
+        handle_level((level == 1) == s_state.config.active_high, edge_us);
+    }
+
+    // Deadline gestures are attributed to the edge that started the wait
+    size_t count = gesture_on_time(&s_state.recognizer, now_us, gestures);
+    post_gestures(gestures, count, s_state.last_edge_us);
+}
+
+static TickType_t next_timeout(int64_t now_us)
+{
+    int64_t deadline_us = gesture_next_deadline(&s_state.recognizer);
+    int64_t settle_us = gesture_debounce_deadline(&s_state.debounce);
+
+    if (settle_us < deadline_us) {
+        deadline_us = settle_us;
+    }
+
+    if (deadline_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    if (deadline_us <= now_us) {
+        return 0;
+    }
+
+    // Round up so the deadline has passed when the wait times out
+    TickType_t ticks = pdMS_TO_TICKS((deadline_us - now_us + 999) / 1000);
+    return ticks > 0 ? ticks : 1;
+}
+
+// ============================================================================
+// Private - Touch Task
+// ============================================================================
+
+static void touch_task(void *pvParameters)
+{
+    touch_edge_t edge;
+
+    while (1) {
+        TickType_t timeout = next_timeout(esp_timer_get_time());
+
+        if (xQueueReceive(s_state.edge_queue, &edge, timeout) != pdTRUE) {
+            handle_timeout(esp_timer_get_time());
+            continue;
+        }
+
+        // Debounce: edges too close to the last accepted one are bounces,
+        // the level is re-sampled once the window has passed
+        if (!gesture_debounce_edge(&s_state.debounce, edge.time_us)) {
+            s_state.debounce_skip_count++;
+            continue;
+        }
+
+        gesture_set_enabled(&s_state.recognizer, s_state.gesture_mask);
+        handle_level(edge.active, edge.time_us);
+    }
+}
+
+static void release_resources(void)
+{
+    // Stop task and delete queue
+    if (s_state.task_handle != NULL) {
+        vTaskDelete(s_state.task_handle);
+        s_state.task_handle = NULL;
+    }
+
+    if (s_state.edge_queue != NULL) {
+        vQueueDelete(s_state.edge_queue);
+        s_state.edge_queue = NULL;
     }
 }
 
@@ -124,22 +212,46 @@ esp_err_t touch_sensor_init(const touch_sensor_config_t *config)
         return ESP_OK;
     }
 
+    gesture_config_t gesture_config = {
+        .long_press_ms = config->long_press_ms ? config->long_press_ms : DEFAULT_LONG_PRESS_MS,
+        .multi_tap_ms = config->multi_tap_ms ? config->multi_tap_ms : DEFAULT_MULTI_TAP_MS,
+        .hold_ms = config->hold_ms ? config->hold_ms : DEFAULT_HOLD_MS,
+    };
+
+    // A release is only known once the debounce window has passed, which
+    // must be before the press could turn into a long press
+    if (config->debounce_ms >= gesture_config.long_press_ms) {
+        ESP_LOGE(TAG, "Debounce %lums must be shorter than the long press %lums",
+                 config->debounce_ms, gesture_config.long_press_ms);
+        return ESP_ERR_INVALID_ARG;
+    }
+
     s_state.config = *config;
-    s_state.last_touch_time = 0;
-    s_state.is_pressed = false;
-    s_state.long_press_detected = false;
-
-    // Create timer for detecting long press
-    s_state.release_timer = xTimerCreate(
-        "touch_release",
-        pdMS_TO_TICKS(LONG_PRESS_MS),
-        pdFALSE,  // One-shot timer
+    gesture_init(&s_state.recognizer, &gesture_config);
+    gesture_set_enabled(&s_state.recognizer, s_state.gesture_mask);
+    gesture_debounce_init(&s_state.debounce, config->debounce_ms);
+    s_state.last_edge_us = INT64_MIN / 2;
+
+    // Queue of timestamped edges from the ISR
+    s_state.edge_queue = xQueueCreate(EDGE_QUEUE_LEN, sizeof(touch_edge_t));
+    if (s_state.edge_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create edge queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Runs the press/long-press/release state machine, blocked on the queue
+    BaseType_t ret = xTaskCreate(
+        touch_task,
+        "touch",
+        3072,
         NULL,
-        release_timer_callback
+        10,  // Above other application tasks for low input latency
+        &s_state.task_handle
     );
 
-    if (s_state.release_timer == NULL) {
-        ESP_LOGE(TAG, "Failed to create release timer");
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create touch task");
+        release_resources();
         return ESP_ERR_NO_MEM;
     }
 
@@ -155,7 +267,7 @@ esp_err_t touch_sensor_init(const touch_sensor_config_t *config)
     esp_err_t err = gpio_config(&io_conf);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure GPIO");
-        xTimerDelete(s_state.release_timer, 0);
+        release_resources();
         return err;
     }
 
@@ -164,7 +276,7 @@ esp_err_t touch_sensor_init(const touch_sensor_config_t *config)
     if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
         // ESP_ERR_INVALID_STATE means service already installed, which is OK
         ESP_LOGE(TAG, "Failed to install ISR service");
-        xTimerDelete(s_state.release_timer, 0);
+        release_resources();
         return err;
     }
 
@@ -172,15 +284,19 @@ esp_err_t touch_sensor_init(const touch_sensor_config_t *config)
     err = gpio_isr_handler_add(config->gpio, gpio_isr_handler, NULL);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to add ISR handler");
-        xTimerDelete(s_state.release_timer, 0);
+        release_resources();
         return err;
     }
 
     s_state.initialized = true;
-    ESP_LOGI(TAG, "Touch sensor initialized (GPIO %d, active_%s, debounce %lums)",
+    ESP_LOGI(TAG, "Touch sensor initialized (GPIO %d, active_%s, debounce %lums, "
+             "long press %lums, multi-tap %lums, hold %lums)",
              config->gpio,
              config->active_high ? "high" : "low",
-             config->debounce_ms);
+             config->debounce_ms,
+             gesture_config.long_press_ms,
+             gesture_config.multi_tap_ms,
+             gesture_config.hold_ms);
 
     return ESP_OK;
 }
@@ -191,21 +307,25 @@ void touch_sensor_deinit(void)
         return;
     }
 
-    // Stop and delete timer
-    if (s_state.release_timer != NULL) {
-        xTimerStop(s_state.release_timer, 0);
-        xTimerDelete(s_state.release_timer, 0);
-        s_state.release_timer = NULL;
-    }
-
     // Remove ISR handler
     gpio_isr_handler_remove(s_state.config.gpio);
 
     // Reset GPIO
     gpio_reset_pin(s_state.config.gpio);
 
+    release_resources();
+
     s_state.initialized = false;
-    ESP_LOGI(TAG, "Touch sensor deinitialized");
+    ESP_LOGI(TAG, "Touch sensor deinitialized (presses: %lu, releases: %lu, "
+             "debounced: %lu, dropped: %lu)",
+             s_state.press_count, s_state.release_count,
+             s_state.debounce_skip_count, s_state.dropped_edge_count);
+}
+
+void touch_sensor_enable_gestures(uint32_t mask)
+{
+    s_state.gesture_mask |= mask;
+    ESP_LOGI(TAG, "Gesture mask: 0x%02lx", s_state.gesture_mask);
 }
 
 // ============================================================================
@@ -214,56 +334,16 @@ void touch_sensor_deinit(void)
 
 static void IRAM_ATTR gpio_isr_handler(void* arg)
 {
-    TickType_t now = xTaskGetTickCountFromISR();
-    TickType_t debounce_ticks = pdMS_TO_TICKS(s_state.config.debounce_ms);
-
-    // Debounce: ignore if event happened too recently
-    if ((now - s_state.last_touch_time) < debounce_ticks) {
-        return;
-    }
-
-    s_state.last_touch_time = now;
-
-    // Read current GPIO state
-    int level = gpio_get_level(s_state.config.gpio);
-    bool is_touch_active = (level == 1) == s_state.config.active_high;
+    // Timestamp and level only, all decisions are made in the touch task
+    touch_edge_t edge = {
+        .time_us = esp_timer_get_time(),
+        .active = (gpio_get_level(s_state.config.gpio) == 1) == s_state.config.active_high,
+    };
 
     BaseType_t high_priority_task_woken = pdFALSE;
 
-    if (is_touch_active && !s_state.is_pressed) {
-        // Touch PRESSED
-        s_state.is_pressed = true;
-        s_state.long_press_detected = false;
-
-        // Start timer to detect if this becomes a long press
-        xTimerStartFromISR(s_state.release_timer, &high_priority_task_woken);
-    }
-    else if (!is_touch_active && s_state.is_pressed) {
-        // Touch RELEASED
-        s_state.is_pressed = false;
-
-        // Stop the timer
-        xTimerStopFromISR(s_state.release_timer, &high_priority_task_woken);
-
-        if (s_state.long_press_detected) {
-            // Long press was detected - emit INPUT_RELEASE to signal end of long press
-            esp_event_isr_post(
-                TIMEMACHINE_EVENT,
-                INPUT_RELEASE,
-                NULL,
-                0,
-                &high_priority_task_woken
-            );
-        } else {
-            // Short press - emit INPUT_TAP
-            esp_event_isr_post(
-                TIMEMACHINE_EVENT,
-                INPUT_TAP,
-                NULL,
-                0,
-                &high_priority_task_woken
-            );
-        }
+    if (xQueueSendFromISR(s_state.edge_queue, &edge, &high_priority_task_woken) != pdTRUE) {
+        s_state.dropped_edge_count++;
     }
 
     if (high_priority_task_woken) {
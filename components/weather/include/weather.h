@@ -1,14 +1,17 @@
 /**
  * @file weather.h
- * @brief Weather data fetching from OpenWeather API
+ * @brief Weather data fetching from OpenWeather or Open-Meteo
  *
- * Fetches current weather data including temperature and conditions
- * from OpenWeather API. Requires WiFi connection and API key configuration.
+ * Fetches current weather data including temperature and conditions, and a
+ * forecast, from the configured provider. Requires WiFi connection, and
+ * an API key for OpenWeather.
  */
 
 #pragma once
 
 #include "esp_err.h"
+#include "timemachine_events.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -31,22 +34,139 @@ typedef struct {
     float temperature;              /**< Temperature in Celsius */
     weather_condition_t condition;  /**< Weather condition */
     bool valid;                     /**< Data is valid */
+    bool stale;                     /**< Older than CONFIG_TIMEMACHINE_WEATHER_FRESH_S,
+                                         a refresh is pending */
+    uint32_t age_s;                 /**< Seconds since the data was fetched */
 } weather_data_t;
 
+#define WEATHER_FORECAST_MAX 40     /**< Forecast steps kept (5 days of 3-hour steps) */
+
+/**
+ * @brief Forecast, a ring of steps stored as parallel arrays
+ *
+ * Step i (0 = next) is at ring slot (head + i) % WEATHER_FORECAST_MAX;
+ * use the weather_forecast_*() accessors. Temperatures are deci-degrees
+ * and conditions 4 bits each, so all steps take under 200 bytes. Steps
+ * that are past are dropped from the head as time goes by.
+ */
+typedef struct {
+    int64_t base;                                   /**< Unix time the offsets count from */
+    uint16_t offset_min[WEATHER_FORECAST_MAX];      /**< Step time, minutes after base */
+    int16_t temp_deci[WEATHER_FORECAST_MAX];        /**< Temperature, 0.1 Celsius */
+    uint8_t conditions[WEATHER_FORECAST_MAX / 2];   /**< weather_condition_t, low nibble = even slot */
+    uint8_t head;                                   /**< Slot of the next step */
+    uint8_t count;                                  /**< Steps in the ring */
+} weather_forecast_t;
+
+/**
+ * @brief One forecast day, summarized from its steps
+ */
+typedef struct {
+    int64_t first;                  /**< Unix time of the day's first step */
+    int16_t min_deci;               /**< Lowest temperature, 0.1 Celsius */
+    int16_t max_deci;               /**< Highest temperature, 0.1 Celsius */
+    weather_condition_t condition;  /**< Most severe condition of the day */
+} weather_day_t;
+
+static inline size_t weather_forecast_slot(const weather_forecast_t *forecast, size_t step)
+{
+    return (forecast->head + step) % WEATHER_FORECAST_MAX;
+}
+
+/**
+ * @brief Unix time of a step
+ */
+static inline int64_t weather_forecast_time(const weather_forecast_t *forecast, size_t step)
+{
+    return forecast->base + (int64_t)forecast->offset_min[weather_forecast_slot(forecast, step)] * 60;
+}
+
+/**
+ * @brief Temperature of a step in 0.1 Celsius
+ */
+static inline int16_t weather_forecast_temp_deci(const weather_forecast_t *forecast, size_t step)
+{
+    return forecast->temp_deci[weather_forecast_slot(forecast, step)];
+}
+
+/**
+ * @brief Condition of a step
+ */
+static inline weather_condition_t weather_forecast_condition(const weather_forecast_t *forecast,
+                                                             size_t step)
+{
+    size_t slot = weather_forecast_slot(forecast, step);
+    uint8_t packed = forecast->conditions[slot / 2];
+    return (weather_condition_t)((slot & 1) ? packed >> 4 : packed & 0x0f);
+}
+
 /**
  * @brief Weather configuration
  */
 typedef struct {
-    char api_key[64];          /**< OpenWeather API key */
+    char api_key[64];          /**< OpenWeather API key (Open-Meteo needs none) */
     char location[64];         /**< City name or coordinates (lat,lon) */
     uint32_t update_interval;  /**< Update interval in seconds */
+    timemachine_weather_cache_t cache; /**< Last fetch, ignored if unused, for another
+                                            location or too old */
 } weather_config_t;
 
+/**
+ * @brief Weather fetch statistics
+ */
+typedef struct {
+    uint32_t fetch_count;       /**< Fetch attempts since init */
+    uint32_t fail_count;        /**< Failed fetches since init */
+    uint32_t last_duration_ms;  /**< Duration of the last fetch (connect + transfer + parse) */
+    int last_http_status;       /**< HTTP status of the last fetch (0 if no response) */
+    esp_err_t last_err;         /**< Result of the last fetch */
+    uint32_t last_response_len; /**< Body bytes of the last fetch */
+    uint32_t last_parse_us;     /**< Time spent parsing the last body */
+    uint32_t truncated_count;   /**< Bodies that ended early (connection or mid-document) */
+    uint32_t oversize_count;    /**< Bodies over CONFIG_TIMEMACHINE_WEATHER_MAX_RESPONSE_KB, abandoned */
+    uint32_t handshake_count;   /**< New connections (TCP + TLS handshake) */
+    uint32_t reuse_count;       /**< Requests sent on an already open connection */
+    uint32_t last_handshake_ms; /**< Connect and handshake time of the last new connection */
+    uint64_t total_rx_bytes;    /**< Body bytes received since init */
+    uint32_t last_heap_peak;    /**< Heap used at the peak of the last fetch, bytes */
+    uint32_t max_heap_peak;     /**< Largest heap peak of any fetch */
+    uint32_t fresh_hits;        /**< weather_get_data() calls served fresh data */
+    uint32_t stale_hits;        /**< ...served stale data */
+    uint32_t misses;            /**< ...with no data, or only expired data */
+    bool from_cache;            /**< Current data was restored from NVS */
+    uint32_t forecast_count;    /**< Forecasts fetched */
+    uint32_t forecast_fail_count; /**< Forecast fetches that failed, the last forecast is kept */
+} weather_stats_t;
+
+#define WEATHER_PROVIDER_MAX 2      /**< Providers built in */
+
+/**
+ * @brief Per-provider statistics, one update = all requests of one fetch
+ */
+typedef struct {
+    const char *name;           /**< Provider name, as given to weather_set_provider() */
+    bool active;                /**< Provider in use */
+    uint32_t update_count;      /**< Updates fetched from this provider */
+    uint32_t fail_count;        /**< Updates without current weather */
+    uint32_t request_count;     /**< HTTP requests of all updates */
+    uint32_t last_duration_ms;  /**< Duration of the last update, all requests */
+    uint32_t max_duration_ms;   /**< Longest update */
+    uint64_t total_duration_ms; /**< Sum of all updates */
+    uint32_t last_rx_bytes;     /**< Body bytes of the last update */
+    uint64_t total_rx_bytes;    /**< Body bytes of all updates */
+} weather_provider_stats_t;
+
 /**
  * @brief Initialize weather component
  *
- * Starts periodic weather updates from OpenWeather API.
- * Requires network connection to function.
+ * Starts periodic weather updates on the network job worker, from the
+ * provider chosen by CONFIG_TIMEMACHINE_WEATHER_PROVIDER. The fetch
+ * cached in config->cache (last boot) is served right away; while it is
+ * younger than the update interval the first fetch waits until it is
+ * due. Its age is only trusted from a clock carried by the RTC or synced
+ * (ntp_sync_get_source()), otherwise it is served as stale and fetched
+ * again right away. Each successful fetch emits WEATHER_UPDATED with the
+ * entry to cache.
  *
  * @param config Weather configuration
  * @return ESP_OK on success, error code otherwise
@@ -61,11 +181,38 @@ void weather_deinit(void);
 /**
  * @brief Get current weather data
  *
+ * Data is served until CONFIG_TIMEMACHINE_WEATHER_MAX_AGE_S, including the
+ * cached data from before a reboot; past CONFIG_TIMEMACHINE_WEATHER_FRESH_S
+ * it is marked stale while fetches go on in the background. Older data
+ * reads as not valid.
+ *
  * @param data Pointer to store weather data
  * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized
  */
 esp_err_t weather_get_data(weather_data_t *data);
 
+/**
+ * @brief Get the upcoming forecast steps
+ *
+ * Fetched with the current weather when CONFIG_TIMEMACHINE_WEATHER_FORECAST_STEPS
+ * is set; steps already past are left out.
+ *
+ * @param forecast Pointer to store the forecast (count 0 if none)
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized,
+ *         ESP_ERR_INVALID_ARG if forecast is NULL
+ */
+esp_err_t weather_get_forecast(weather_forecast_t *forecast);
+
+/**
+ * @brief Summarize forecast steps per local day
+ *
+ * @param forecast Forecast from weather_get_forecast()
+ * @param days     Array receiving one entry per day, earliest first
+ * @param max      Entries in days
+ * @return Number of entries filled
+ */
+size_t weather_forecast_daily(const weather_forecast_t *forecast, weather_day_t *days, size_t max);
+
 /**
  * @brief Update weather configuration
  *
@@ -80,3 +227,39 @@ esp_err_t weather_update_config(const weather_config_t *config);
  * @return ESP_OK if update started, error code otherwise
  */
 esp_err_t weather_force_update(void);
+
+/**
+ * @brief Get fetch statistics
+ *
+ * @param stats Pointer to store statistics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t weather_get_stats(weather_stats_t *stats);
+
+/**
+ * @brief Get per-provider statistics
+ *
+ * @param stats Array receiving one entry per provider
+ * @param max   Entries in stats
+ * @return Number of entries filled
+ */
+size_t weather_get_provider_stats(weather_provider_stats_t *stats, size_t max);
+
+/**
+ * @brief Switch provider until the next reboot, and fetch from it
+ *
+ * Meant for comparing providers on one device; the data already fetched
+ * is kept until the new provider replaces it.
+ *
+ * @param name Provider name ("openweather", "openmeteo")
+ * @return ESP_OK, ESP_ERR_NOT_FOUND for an unknown name,
+ *         ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t weather_set_provider(const char *name);
+
+/**
+ * @brief Register the `weather` console command
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CONFIG_TIMEMACHINE_CONSOLE
+ */
+esp_err_t weather_register_console_commands(void);
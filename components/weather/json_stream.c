@@ -0,0 +1,518 @@
+/**
+ * @file json_stream.c
+ * @brief Streaming JSON value extractor: byte-at-a-time parser, path matching
+ */
+
+#include "json_stream.h"
+#include <string.h>
+
+enum {
+    S_VALUE,            // Value expected
+    S_VALUE_OR_END,     // After '[': value or ']'
+    S_KEY_OR_END,       // After '{': key or '}'
+    S_KEY,              // After ',' in an object: key
+    S_COLON,            // After a key
+    S_AFTER,            // After a value: ',' or the closing bracket
+    S_STRING,
+    S_ESCAPE,           // After '\' in a string
+    S_UNICODE,          // In the hex digits of \u
+    S_NUMBER,
+    S_LITERAL,          // In true, false or null
+    S_DONE,             // Document complete, only whitespace may follow
+    S_ERROR,
+};
+
+// Number grammar, in json_stream_t.number
+enum {
+    N_MINUS,            // After '-', digit expected
+    N_ZERO,             // Leading 0, no more integer digits
+    N_INT,
+    N_DOT,              // After '.', digit expected
+    N_FRAC,
+    N_E,                // After 'e', sign or digit expected
+    N_E_SIGN,           // After the exponent sign, digit expected
+    N_EXP,
+};
+
+static const char *const LITERALS[] = {
+    [JSON_STREAM_TRUE] = "true",
+    [JSON_STREAM_FALSE] = "false",
+    [JSON_STREAM_NULL] = "null",
+};
+
+// ============================================================================
+// Private - Path matching
+// ============================================================================
+
+/**
+ * @brief Does path name the value at the current position?
+ *
+ * @param index Receives the element index matched by the last [*]
+ */
+static bool path_matches(const json_stream_t *js, const char *path, int *index)
+{
+    const char *p = path;
+
+    *index = -1;
+    if (js->depth > JSON_STREAM_MAX_DEPTH) {
+        return false;
+    }
+    for (uint8_t level = 0; level < js->depth; level++) {
+        const json_stream_frame_t *frame = &js->frames[level];
+
+        if (js->array_bits & (1u << level)) {
+            if (*p++ != '[') {
+                return false;
+            }
+            if (*p == '*') {
+                p++;
+                *index = frame->index;
+            } else {
+                if (*p < '0' || *p > '9') {
+                    return false;
+                }
+                int n = 0;
+                while (*p >= '0' && *p <= '9' && n <= INT16_MAX) {
+                    n = n * 10 + (*p++ - '0');
+                }
+                if (n != frame->index) {
+                    return false;
+                }
+            }
+            if (*p++ != ']') {
+                return false;
+            }
+        } else {
+            if (p != path && *p++ != '.') {
+                return false;
+            }
+            size_t len = strcspn(p, ".[");
+            if (frame->key_len == 0xff || len != frame->key_len ||
+                memcmp(p, frame->key, len) != 0) {
+                return false;
+            }
+            p += len;
+        }
+    }
+    return *p == '\0';
+}
+
+static void emit(json_stream_t *js, json_stream_type_t type)
+{
+    js->value[js->value_len] = '\0';
+    for (size_t i = 0; i < js->path_count; i++) {
+        int index;
+        if (path_matches(js, js->paths[i], &index)) {
+            js->cb(js->ctx, i, index, type, js->value);
+        }
+    }
+}
+
+// ============================================================================
+// Private - Parser
+// ============================================================================
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void end_value(json_stream_t *js)
+{
+    js->state = js->depth == 0 ? S_DONE : S_AFTER;
+}
+
+static void append(json_stream_t *js, char c)
+{
+    if (js->in_key) {
+        if (js->depth > JSON_STREAM_MAX_DEPTH) {
+            return;
+        }
+        json_stream_frame_t *frame = &js->frames[js->depth - 1];
+        if (frame->key_len < JSON_STREAM_KEY_MAX - 1) {
+            frame->key[frame->key_len++] = c;
+        } else {
+            frame->key_len = 0xff;
+        }
+    } else if (js->value_len < JSON_STREAM_VALUE_MAX - 1) {
+        js->value[js->value_len++] = c;
+    }
+}
+
+// Code points are written as UTF-8; surrogate halves are written one by one
+static void append_unicode(json_stream_t *js, uint16_t u)
+{
+    if (u < 0x80) {
+        append(js, (char)u);
+    } else if (u < 0x800) {
+        append(js, (char)(0xc0 | (u >> 6)));
+        append(js, (char)(0x80 | (u & 0x3f)));
+    } else {
+        append(js, (char)(0xe0 | (u >> 12)));
+        append(js, (char)(0x80 | ((u >> 6) & 0x3f)));
+        append(js, (char)(0x80 | (u & 0x3f)));
+    }
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool open_container(json_stream_t *js, bool array)
+{
+    if (js->depth >= JSON_STREAM_MAX_NEST) {
+        return false;
+    }
+    if (array) {
+        js->array_bits |= 1u << js->depth;
+    } else {
+        js->array_bits &= ~(1u << js->depth);
+    }
+    if (js->depth < JSON_STREAM_MAX_DEPTH) {
+        js->frames[js->depth].index = 0;
+        js->frames[js->depth].key_len = 0;
+    }
+    js->depth++;
+    js->state = array ? S_VALUE_OR_END : S_KEY_OR_END;
+    return true;
+}
+
+static bool close_container(json_stream_t *js, bool array)
+{
+    if (js->depth == 0 || !(js->array_bits & (1u << (js->depth - 1))) != !array) {
+        return false;
+    }
+    js->depth--;
+    end_value(js);
+    return true;
+}
+
+static void start_key(json_stream_t *js)
+{
+    js->in_key = true;
+    if (js->depth <= JSON_STREAM_MAX_DEPTH) {
+        js->frames[js->depth - 1].key_len = 0;
+    }
+    js->state = S_STRING;
+}
+
+/**
+ * @brief Start the value beginning with c
+ *
+ * @return false if no value starts with c
+ */
+static bool start_value(json_stream_t *js, char c)
+{
+    js->value_len = 0;
+    js->in_key = false;
+
+    switch (c) {
+    case '{':
+        return open_container(js, false);
+    case '[':
+        return open_container(js, true);
+    case '"':
+        js->state = S_STRING;
+        return true;
+    case 't':
+        js->value_type = JSON_STREAM_TRUE;
+        break;
+    case 'f':
+        js->value_type = JSON_STREAM_FALSE;
+        break;
+    case 'n':
+        js->value_type = JSON_STREAM_NULL;
+        break;
+    case '-':
+        js->number = N_MINUS;
+        js->state = S_NUMBER;
+        append(js, c);
+        return true;
+    default:
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        js->number = c == '0' ? N_ZERO : N_INT;
+        js->state = S_NUMBER;
+        append(js, c);
+        return true;
+    }
+
+    // Literal, its text is matched in S_LITERAL
+    js->state = S_LITERAL;
+    append(js, c);
+    return true;
+}
+
+/**
+ * @brief Next character of a number
+ *
+ * @return false if c ends the number (c not consumed)
+ */
+static bool number_char(json_stream_t *js, char c)
+{
+    bool digit = c >= '0' && c <= '9';
+    uint8_t *n = &js->number;
+
+    switch (*n) {
+    case N_MINUS:
+        if (!digit) {
+            return false;
+        }
+        *n = c == '0' ? N_ZERO : N_INT;
+        break;
+    case N_ZERO:
+    case N_INT:
+        if (digit && *n == N_INT) {
+            break;
+        }
+        if (c == '.') {
+            *n = N_DOT;
+        } else if (c == 'e' || c == 'E') {
+            *n = N_E;
+        } else {
+            return false;
+        }
+        break;
+    case N_DOT:
+    case N_FRAC:
+        if (digit) {
+            *n = N_FRAC;
+        } else if (*n == N_FRAC && (c == 'e' || c == 'E')) {
+            *n = N_E;
+        } else {
+            return false;
+        }
+        break;
+    case N_E:
+        if (c == '+' || c == '-') {
+            *n = N_E_SIGN;
+            break;
+        }
+        // fall through
+    case N_E_SIGN:
+    case N_EXP:
+        if (!digit) {
+            return false;
+        }
+        *n = N_EXP;
+        break;
+    }
+    append(js, c);
+    return true;
+}
+
+/**
+ * @brief End of a number, emit it if complete
+ */
+static bool end_number(json_stream_t *js)
+{
+    uint8_t n = js->number;
+
+    if (n != N_ZERO && n != N_INT && n != N_FRAC && n != N_EXP) {
+        return false;
+    }
+    emit(js, JSON_STREAM_NUMBER);
+    end_value(js);
+    return true;
+}
+
+/**
+ * @brief Consume one character
+ *
+ * @return 1 if consumed, 0 if it must be fed again in the new state, -1 if malformed
+ */
+static int step(json_stream_t *js, char c)
+{
+    switch (js->state) {
+    case S_VALUE:
+    case S_VALUE_OR_END:
+        if (is_space(c)) {
+            return 1;
+        }
+        if (c == ']' && js->state == S_VALUE_OR_END) {
+            return close_container(js, true) ? 1 : -1;
+        }
+        return start_value(js, c) ? 1 : -1;
+
+    case S_KEY_OR_END:
+    case S_KEY:
+        if (is_space(c)) {
+            return 1;
+        }
+        if (c == '}' && js->state == S_KEY_OR_END) {
+            return close_container(js, false) ? 1 : -1;
+        }
+        if (c != '"') {
+            return -1;
+        }
+        start_key(js);
+        return 1;
+
+    case S_COLON:
+        if (is_space(c)) {
+            return 1;
+        }
+        if (c != ':') {
+            return -1;
+        }
+        js->state = S_VALUE;
+        return 1;
+
+    case S_AFTER: {
+        bool array = js->array_bits & (1u << (js->depth - 1));
+        if (is_space(c)) {
+            return 1;
+        }
+        if (c == ',') {
+            if (array) {
+                if (js->depth <= JSON_STREAM_MAX_DEPTH &&
+                    js->frames[js->depth - 1].index < INT16_MAX) {
+                    js->frames[js->depth - 1].index++;
+                }
+                js->state = S_VALUE;
+            } else {
+                js->state = S_KEY;
+            }
+            return 1;
+        }
+        if (c == (array ? ']' : '}')) {
+            return close_container(js, array) ? 1 : -1;
+        }
+        return -1;
+    }
+
+    case S_STRING:
+        if (c == '"') {
+            if (js->in_key) {
+                js->in_key = false;
+                js->state = S_COLON;
+            } else {
+                emit(js, JSON_STREAM_STRING);
+                end_value(js);
+            }
+            return 1;
+        }
+        if (c == '\\') {
+            js->state = S_ESCAPE;
+            return 1;
+        }
+        if ((unsigned char)c < 0x20) {
+            return -1;
+        }
+        append(js, c);
+        return 1;
+
+    case S_ESCAPE: {
+        static const char from[] = "\"\\/bfnrt";
+        static const char to[] = "\"\\/\b\f\n\r\t";
+        const char *e = c != '\0' ? strchr(from, c) : NULL;
+
+        if (c == 'u') {
+            js->unicode = 0;
+            js->unicode_left = 4;
+            js->state = S_UNICODE;
+            return 1;
+        }
+        if (e == NULL) {
+            return -1;
+        }
+        append(js, to[e - from]);
+        js->state = S_STRING;
+        return 1;
+    }
+
+    case S_UNICODE: {
+        int h = hex_value(c);
+        if (h < 0) {
+            return -1;
+        }
+        js->unicode = (uint16_t)(js->unicode << 4 | h);
+        if (--js->unicode_left == 0) {
+            append_unicode(js, js->unicode);
+            js->state = S_STRING;
+        }
+        return 1;
+    }
+
+    case S_NUMBER:
+        if (number_char(js, c)) {
+            return 1;
+        }
+        return end_number(js) ? 0 : -1;
+
+    case S_LITERAL: {
+        const char *literal = LITERALS[js->value_type];
+        if (c != literal[js->value_len]) {
+            return -1;
+        }
+        append(js, c);
+        if (literal[js->value_len] == '\0') {
+            emit(js, js->value_type);
+            end_value(js);
+        }
+        return 1;
+    }
+
+    case S_DONE:
+        return is_space(c) ? 1 : -1;
+
+    default:
+        return -1;
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void json_stream_init(json_stream_t *js, const char *const *paths, size_t path_count,
+                      json_stream_cb_t cb, void *ctx)
+{
+    memset(js, 0, sizeof(*js));
+    js->paths = paths;
+    js->path_count = path_count;
+    js->cb = cb;
+    js->ctx = ctx;
+    js->state = S_VALUE;
+}
+
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len && js->state != S_ERROR) {
+        int r = step(js, data[i]);
+        if (r < 0) {
+            js->state = S_ERROR;
+            break;
+        }
+        i += r;
+    }
+    js->offset += i;
+    return js->state != S_ERROR;
+}
+
+bool json_stream_finish(json_stream_t *js)
+{
+    // A top-level number only ends with the input
+    if (js->state == S_NUMBER && js->depth == 0 && !end_number(js)) {
+        js->state = S_ERROR;
+    }
+    return js->state == S_DONE;
+}
+
+size_t json_stream_offset(const json_stream_t *js)
+{
+    return js->offset;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file json_stream.h
+ * @brief Streaming JSON value extractor
+ *
+ * Pulls the scalar values at a few paths out of a JSON document fed in
+ * arbitrary chunks (e.g. straight from HTTP_EVENT_ON_DATA), without building
+ * a tree and without any heap allocation: the whole state is the
+ * json_stream_t. The document is checked for well-formedness on the way.
+ * Pure C with no ESP-IDF dependencies, so it can be checked on the host.
+ *
+ * Paths name object keys separated by dots and array elements by [index],
+ * with [*] matching every element: "main.temp", "weather[0].id",
+ * "list[*].main.temp".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_STREAM_MAX_DEPTH  8    /**< Levels whose keys/indices are tracked, deeper values never match */
+#define JSON_STREAM_MAX_NEST   32   /**< Nesting allowed at all */
+#define JSON_STREAM_KEY_MAX    16   /**< Longest key that can match, including the terminator */
+#define JSON_STREAM_VALUE_MAX  48   /**< Longest value passed in full, including the terminator */
+
+/**
+ * @brief Type of an extracted value
+ */
+typedef enum {
+    JSON_STREAM_STRING,
+    JSON_STREAM_NUMBER,
+    JSON_STREAM_TRUE,
+    JSON_STREAM_FALSE,
+    JSON_STREAM_NULL,
+} json_stream_type_t;
+
+/**
+ * @brief Called for every scalar value at a requested path
+ *
+ * @param ctx       Context given to json_stream_init()
+ * @param path      Index of the matching path
+ * @param index     Element index matched by [*], -1 without wildcard
+ * @param type      Value type
+ * @param value     Value text, strings unescaped and unquoted, NUL-terminated
+ *                  and cut to JSON_STREAM_VALUE_MAX - 1 characters
+ */
+typedef void (*json_stream_cb_t)(void *ctx, size_t path, int index,
+                                 json_stream_type_t type, const char *value);
+
+/**
+ * @brief One open container
+ */
+typedef struct {
+    int16_t index;                  // Current element (arrays)
+    uint8_t key_len;                // Current key (objects), 0xff = too long
+    char key[JSON_STREAM_KEY_MAX];
+} json_stream_frame_t;
+
+/**
+ * @brief Parser state, treat as opaque
+ */
+typedef struct {
+    const char *const *paths;
+    size_t path_count;
+    json_stream_cb_t cb;
+    void *ctx;
+
+    uint8_t state;
+    uint8_t depth;                  // Open containers
+    uint32_t array_bits;            // Bit n set: container at level n is an array
+    json_stream_frame_t frames[JSON_STREAM_MAX_DEPTH];
+
+    bool in_key;                    // The string being read is a key
+    uint8_t unicode_left;           // Hex digits left in a \u escape
+    uint16_t unicode;
+    uint8_t number;                 // Position in the number grammar
+    json_stream_type_t value_type;
+    uint8_t value_len;
+    char value[JSON_STREAM_VALUE_MAX];
+
+    size_t offset;                  // Bytes consumed, for error reports
+} json_stream_t;
+
+/**
+ * @brief Start a document
+ *
+ * @param js         Parser state
+ * @param paths      Paths to extract, must stay valid while parsing
+ * @param path_count Number of paths
+ * @param cb         Called for each value found
+ * @param ctx        Passed to cb
+ */
+void json_stream_init(json_stream_t *js, const char *const *paths, size_t path_count,
+                      json_stream_cb_t cb, void *ctx);
+
+/**
+ * @brief Feed the next chunk
+ *
+ * @return false once the document is malformed (further input is ignored)
+ */
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len);
+
+/**
+ * @brief End of input
+ *
+ * @return true if a complete, well-formed document was read
+ */
+bool json_stream_finish(json_stream_t *js);
+
+/**
+ * @brief Offset of the first malformed byte, or of the end if none
+ */
+size_t json_stream_offset(const json_stream_t *js);
@@ -0,0 +1,126 @@
+/**
+ * @file provider_openmeteo.c
+ * @brief Open-Meteo provider (api.open-meteo.com, no API key)
+ *
+ * Current weather and the forecast in 1-hour steps come in one request.
+ * There is no geocoding on the forecast endpoint, so the location must be
+ * given as coordinates ("lat,lon").
+ */
+
+#include "weather_provider.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *const s_paths[] = {
+    "current.temperature_2m",
+    "current.weather_code",
+    "hourly.time[*]",
+    "hourly.temperature_2m[*]",
+    "hourly.weather_code[*]",
+};
+static const uint8_t s_fields[] = {
+    WEATHER_FIELD_TEMP,
+    WEATHER_FIELD_CODE,
+    WEATHER_FIELD_STEP_TIME,
+    WEATHER_FIELD_STEP_TEMP,
+    WEATHER_FIELD_STEP_CODE,
+};
+
+static const weather_request_t s_requests[] = {
+    {
+        .paths = s_paths,
+        .fields = s_fields,
+        .path_count = sizeof(s_paths) / sizeof(s_paths[0]),
+        .current = true,
+        .forecast = true,
+    },
+};
+
+/**
+ * @brief Copy one coordinate of "lat,lon" up to end, without spaces
+ *
+ * @return false if it is empty or not a decimal number
+ */
+static bool copy_coordinate(char *out, size_t size, const char *start, const char *end)
+{
+    while (start < end && *start == ' ') {
+        start++;
+    }
+    while (end > start && end[-1] == ' ') {
+        end--;
+    }
+
+    size_t len = end - start;
+    if (len == 0 || len >= size) {
+        return false;
+    }
+    for (const char *p = start; p < end; p++) {
+        if ((*p < '0' || *p > '9') && *p != '.' && *p != '-' && *p != '+') {
+            return false;
+        }
+    }
+
+    memcpy(out, start, len);
+    out[len] = '\0';
+    return true;
+}
+
+static esp_err_t build_url(char *url, size_t size, const char *server, size_t request,
+                           const weather_config_t *config, int steps)
+{
+    char lat[16];
+    char lon[16];
+    const char *comma = strchr(config->location, ',');
+
+    if (comma == NULL ||
+        !copy_coordinate(lat, sizeof(lat), config->location, comma) ||
+        !copy_coordinate(lon, sizeof(lon), comma + 1, comma + strlen(comma))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int len = snprintf(url, size,
+                       "%s/v1/forecast?latitude=%s&longitude=%s"
+                       "&current=temperature_2m,weather_code&timeformat=unixtime",
+                       server, lat, lon);
+    if (len > 0 && steps > 0 && (size_t)len < size) {
+        len += snprintf(url + len, size - len,
+                        "&hourly=temperature_2m,weather_code&forecast_hours=%d", steps);
+    }
+
+    return len > 0 && (size_t)len < size ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+static weather_condition_t map_condition(int wmo_code)
+{
+    // WMO weather interpretation codes:
+    // 0-1 = Clear, mainly clear
+    // 2-3 = Partly cloudy, overcast
+    // 45-48 = Fog (treat as clouds)
+    // 51-67, 80-82 = Drizzle, rain, showers
+    // 71-77, 85-86 = Snow, snow showers
+    // 95-99 = Thunderstorm
+
+    if (wmo_code == 0 || wmo_code == 1) {
+        return WEATHER_CLEAR;
+    } else if (wmo_code == 2 || wmo_code == 3 || wmo_code == 45 || wmo_code == 48) {
+        return WEATHER_CLOUDS;
+    } else if ((wmo_code >= 51 && wmo_code <= 67) || (wmo_code >= 80 && wmo_code <= 82)) {
+        return WEATHER_RAIN;
+    } else if ((wmo_code >= 71 && wmo_code <= 77) || wmo_code == 85 || wmo_code == 86) {
+        return WEATHER_SNOW;
+    } else if (wmo_code >= 95 && wmo_code <= 99) {
+        return WEATHER_THUNDERSTORM;
+    }
+
+    return WEATHER_UNKNOWN;
+}
+
+const weather_provider_t weather_provider_openmeteo = {
+    .name = "openmeteo",
+    .server = "https://api.open-meteo.com",
+    .needs_key = false,
+    .requests = s_requests,
+    .request_count = sizeof(s_requests) / sizeof(s_requests[0]),
+    .build_url = build_url,
+    .map_condition = map_condition,
+};
@@ -0,0 +1,108 @@
+/**
+ * @file provider_openweather.c
+ * @brief OpenWeather provider (api.openweathermap.org, needs an API key)
+ *
+ * Current weather from /weather, the forecast in 3-hour steps from
+ * /forecast, two requests on the same connection.
+ */
+
+#include "weather_provider.h"
+#include <stdio.h>
+
+enum { REQUEST_CURRENT, REQUEST_FORECAST };
+
+static const char *const s_current_paths[] = {
+    "main.temp",
+    "weather[0].id",
+};
+static const uint8_t s_current_fields[] = {
+    WEATHER_FIELD_TEMP,
+    WEATHER_FIELD_CODE,
+};
+
+static const char *const s_forecast_paths[] = {
+    "list[*].dt",
+    "list[*].main.temp",
+    "list[*].weather[0].id",
+};
+static const uint8_t s_forecast_fields[] = {
+    WEATHER_FIELD_STEP_TIME,
+    WEATHER_FIELD_STEP_TEMP,
+    WEATHER_FIELD_STEP_CODE,
+};
+
+static const weather_request_t s_requests[] = {
+    [REQUEST_CURRENT] = {
+        .paths = s_current_paths,
+        .fields = s_current_fields,
+        .path_count = sizeof(s_current_paths) / sizeof(s_current_paths[0]),
+        .current = true,
+    },
+    [REQUEST_FORECAST] = {
+        .paths = s_forecast_paths,
+        .fields = s_forecast_fields,
+        .path_count = sizeof(s_forecast_paths) / sizeof(s_forecast_paths[0]),
+        .forecast = true,
+    },
+};
+
+static esp_err_t build_url(char *url, size_t size, const char *server, size_t request,
+                           const weather_config_t *config, int steps)
+{
+    // Check if location is numeric (city ID) or text (city name)
+    bool is_numeric = true;
+    for (const char *p = config->location; *p; p++) {
+        if (*p < '0' || *p > '9') {
+            is_numeric = false;
+            break;
+        }
+    }
+
+    // Use 'id' parameter for numeric IDs, 'q' for city names
+    int len;
+    if (request == REQUEST_CURRENT) {
+        len = snprintf(url, size, "%s/data/2.5/weather?%s=%s&appid=%s&units=metric",
+                       server, is_numeric ? "id" : "q", config->location, config->api_key);
+    } else {
+        len = snprintf(url, size, "%s/data/2.5/forecast?%s=%s&appid=%s&units=metric&cnt=%d",
+                       server, is_numeric ? "id" : "q", config->location, config->api_key, steps);
+    }
+
+    return len > 0 && (size_t)len < size ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+static weather_condition_t map_condition(int owm_code)
+{
+    // OpenWeather condition codes:
+    // 2xx = Thunderstorm
+    // 3xx = Drizzle (treat as rain)
+    // 5xx = Rain
+    // 6xx = Snow
+    // 7xx = Atmosphere (fog, etc - treat as clouds)
+    // 800 = Clear
+    // 80x = Clouds
+
+    if (owm_code >= 200 && owm_code < 300) {
+        return WEATHER_THUNDERSTORM;
+    } else if (owm_code >= 300 && owm_code < 600) {
+        return WEATHER_RAIN;
+    } else if (owm_code >= 600 && owm_code < 700) {
+        return WEATHER_SNOW;
+    } else if (owm_code == 800) {
+        return WEATHER_CLEAR;
+    } else if (owm_code >= 801 && owm_code < 900) {
+        return WEATHER_CLOUDS;
+    }
+
+    return WEATHER_UNKNOWN;
+}
+
+const weather_provider_t weather_provider_openweather = {
+    .name = "openweather",
+    .server = "https://api.openweathermap.org",
+    .needs_key = true,
+    .requests = s_requests,
+    .request_count = sizeof(s_requests) / sizeof(s_requests[0]),
+    .build_url = build_url,
+    .map_condition = map_condition,
+};
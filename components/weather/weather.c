@@ -5,43 +5,115 @@
 
 #include "weather.h"
 #include "timemachine_events.h"
+#include "netjobs.h"
+#include "ntp_sync.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
-#include "cJSON.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "json_stream.h"
+#include "weather_provider.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/timers.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
 
 static const char *TAG = "weather";
 
-#define OPENWEATHER_API_URL "https://api.openweathermap.org/data/2.5/weather"
-#define HTTP_RESPONSE_BUFFER_SIZE 2048
+#define FORECAST_STEPS      CONFIG_TIMEMACHINE_WEATHER_FORECAST_STEPS
+
+// Replaces the provider's server when set, e.g. by tools/weather_standin.py
+#define SERVER_OVERRIDE     CONFIG_TIMEMACHINE_WEATHER_SERVER
+
+// Switchable with `weather use`, stats are kept for each
+static const weather_provider_t *const s_providers[] = {
+    &weather_provider_openweather,
+    &weather_provider_openmeteo,
+};
+#define PROVIDER_COUNT (sizeof(s_providers) / sizeof(s_providers[0]))
+_Static_assert(PROVIDER_COUNT <= WEATHER_PROVIDER_MAX, "raise WEATHER_PROVIDER_MAX");
+
+#if CONFIG_TIMEMACHINE_WEATHER_PROVIDER_OPENMETEO
+#define DEFAULT_PROVIDER 1
+#else
+#define DEFAULT_PROVIDER 0
+#endif
+
+// Body read and parsed in pieces of this size, never held in full
+#define RESPONSE_CHUNK_SIZE 512
+#define MAX_RESPONSE_BYTES  (CONFIG_TIMEMACHINE_WEATHER_MAX_RESPONSE_KB * 1024)
+
+// A fetch may run this part of the update interval early to share a wake window
+#define TOLERANCE_DIVISOR 4
+
+#define FRESH_S           CONFIG_TIMEMACHINE_WEATHER_FRESH_S
+#define MAX_AGE_S         CONFIG_TIMEMACHINE_WEATHER_MAX_AGE_S
+
+// Earlier system times are unset clocks, cache ages cannot be told from them
+#define MIN_VALID_EPOCH   1577836800  // 2020-01-01
 
 static struct {
     bool initialized;
     weather_config_t config;
-    weather_data_t current_data;
-    TimerHandle_t update_timer;
-    char response_buffer[HTTP_RESPONSE_BUFFER_SIZE];
+    weather_data_t current_data;    // valid = have data, stale and age_s unused
+    int64_t fetched_us;             // esp_timer time of the fetch (negative if before boot)
+    weather_forecast_t forecast;    // Steps may be past, trimmed when read
+    json_stream_t parser;           // Fed chunk by chunk by read_response()
+    bool parse_ok;
+    bool have_temp;
+    bool have_code;
+    float temp;
+    int code;                       // Provider condition code
+    weather_forecast_t forecast_next;           // Being parsed
+    uint8_t forecast_fields[WEATHER_FORECAST_MAX];  // Step fields found per step
     size_t response_len;
-    esp_event_handler_instance_t network_connected_handler;
-    TaskHandle_t fetch_task_handle;
-    bool fetch_requested;
+    int64_t parse_us;
+    esp_http_client_handle_t client;    // Kept between fetches for its TLS session
+    bool connected;                     // Client holds an open connection
+    char origin[96];                    // Scheme, host and port of that connection
+    netjobs_handle_t job;
+    size_t provider;                    // Index into s_providers
+    const weather_provider_t *fetching; // Provider of the response being parsed
+    weather_stats_t stats;
+    weather_provider_stats_t provider_stats[PROVIDER_COUNT];
 } s_state = {0};
 
+// Current data, forecast and their counters, read by the panel while the worker fetches
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Counters of one fetch, added to s_state.stats under s_lock when it ends
+typedef struct {
+    uint32_t handshakes;
+    uint32_t handshake_ms;      // Of the last new connection, if handshakes
+    uint32_t reuses;
+    uint32_t truncated;
+    uint32_t oversize;
+} fetch_counts_t;
+
 // Forward declarations
-static void update_timer_callback(TimerHandle_t timer);
-static esp_err_t fetch_weather_data(void);
-static esp_err_t parse_weather_response(const char *json_str);
-static weather_condition_t map_weather_condition(int owm_code);
-static void network_connected_handler(void* arg, esp_event_base_t base,
-                                       int32_t event_id, void* event_data);
-static esp_err_t http_event_handler(esp_http_client_event_t *evt);
-static void fetch_task(void *pvParameters);
+static esp_err_t fetch_job(void *arg);
+static uint32_t restore_cache(const timemachine_weather_cache_t *cache);
+static void save_cache(void);
+static esp_err_t fetch_request(const weather_provider_t *provider, size_t index);
+static esp_err_t fetch_json(const char *url, const weather_request_t *request);
+static esp_err_t parse_finish(fetch_counts_t *counts);
+static void parse_value(void *ctx, size_t path, int index,
+                        json_stream_type_t type, const char *value);
+static esp_err_t apply_current(const weather_provider_t *provider);
+static void apply_forecast(esp_err_t err);
+static void trim_forecast(weather_forecast_t *forecast, int64_t now);
+static esp_err_t open_request(const char *url, int64_t *content_length,
+                               fetch_counts_t *counts);
+static void close_connection(void);
+static esp_err_t read_response(esp_http_client_handle_t client, fetch_counts_t *counts);
 
 // ============================================================================
 // Public API
@@ -60,75 +132,42 @@ esp_err_t weather_init(const weather_config_t *config)
     }
 
     // Validate config
-    if (strlen(config->api_key) == 0 || strlen(config->location) == 0) {
-        ESP_LOGE(TAG, "API key and location are required");
+    const weather_provider_t *provider = s_providers[DEFAULT_PROVIDER];
+    if ((provider->needs_key && strlen(config->api_key) == 0) || strlen(config->location) == 0) {
+        ESP_LOGE(TAG, "%s needs a location%s", provider->name,
+                 provider->needs_key ? " and an API key" : "");
         return ESP_ERR_INVALID_ARG;
     }
 
     s_state.config = *config;
+    s_state.provider = DEFAULT_PROVIDER;
+    for (size_t i = 0; i < PROVIDER_COUNT; i++) {
+        s_state.provider_stats[i].name = s_providers[i]->name;
+    }
     s_state.current_data.valid = false;
-    s_state.response_len = 0;
 
-    // Create update timer
-    s_state.update_timer = xTimerCreate(
-        "weather_update",
-        pdMS_TO_TICKS(config->update_interval * 1000),
-        pdTRUE,  // Auto-reload
-        NULL,
-        update_timer_callback
-    );
-
-    if (s_state.update_timer == NULL) {
-        ESP_LOGE(TAG, "Failed to create update timer");
-        return ESP_ERR_NO_MEM;
-    }
-
-    // Register for network connected events to trigger first update
-    esp_err_t err = esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        NETWORK_CONNECTED,
-        network_connected_handler,
-        NULL,
-        &s_state.network_connected_handler
-    );
+    // The last fetch shows right away; fetched less than an interval ago it
+    // also stands in for the boot fetch
+    uint32_t first_run_s = restore_cache(&config->cache);
+
+    // Fetched on the network job worker: at boot, then every update interval.
+    // Missed fetches run as soon as the network is back
+    const netjobs_config_t job_config = {
+        .name = "weather",
+        .fn = fetch_job,
+        .period_s = config->update_interval,
+        .tolerance_s = config->update_interval / TOLERANCE_DIVISOR,
+        .first_run_s = first_run_s
+    };
+    esp_err_t err = netjobs_add(&job_config, &s_state.job);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register network handler");
-        xTimerDelete(s_state.update_timer, 0);
+        ESP_LOGE(TAG, "Failed to add fetch job");
         return err;
     }
 
-    // Create fetch task with large stack for HTTPS/TLS
-    BaseType_t ret = xTaskCreate(
-        fetch_task,
-        "weather_fetch",
-        8192,  // Large stack for HTTPS
-        NULL,
-        5,     // Priority
-        &s_state.fetch_task_handle
-    );
-
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create fetch task");
-        xTimerDelete(s_state.update_timer, 0);
-        esp_event_handler_instance_unregister(
-            TIMEMACHINE_EVENT,
-            NETWORK_CONNECTED,
-            s_state.network_connected_handler
-        );
-        return ESP_FAIL;
-    }
-
     s_state.initialized = true;
-    ESP_LOGI(TAG, "Weather initialized (location: %s, interval: %lus)",
-             config->location, config->update_interval);
-
-    // Start timer to begin periodic updates
-    xTimerStart(s_state.update_timer, 0);
-
-    // Trigger immediate first fetch
-    ESP_LOGI(TAG, "Triggering initial weather fetch");
-    s_state.fetch_requested = true;
-    xTaskNotifyGive(s_state.fetch_task_handle);
+    ESP_LOGI(TAG, "Weather initialized (%s, location: %s, interval: %lus)",
+             provider->name, config->location, config->update_interval);
 
     return ESP_OK;
 }
@@ -139,25 +178,15 @@ void weather_deinit(void)
         return;
     }
 
-    // Delete fetch task
-    if (s_state.fetch_task_handle != NULL) {
-        vTaskDelete(s_state.fetch_task_handle);
-        s_state.fetch_task_handle = NULL;
-    }
-
-    if (s_state.update_timer != NULL) {
-        xTimerStop(s_state.update_timer, 0);
-        xTimerDelete(s_state.update_timer, 0);
-        s_state.update_timer = NULL;
+    if (s_state.job != NULL) {
+        netjobs_remove(s_state.job);
+        s_state.job = NULL;
     }
 
-    if (s_state.network_connected_handler != NULL) {
-        esp_event_handler_instance_unregister(
-            TIMEMACHINE_EVENT,
-            NETWORK_CONNECTED,
-            s_state.network_connected_handler
-        );
-        s_state.network_connected_handler = NULL;
+    if (s_state.client != NULL) {
+        close_connection();
+        esp_http_client_cleanup(s_state.client);
+        s_state.client = NULL;
     }
 
     s_state.initialized = false;
@@ -174,10 +203,93 @@ esp_err_t weather_get_data(weather_data_t *data)
         return ESP_ERR_INVALID_ARG;
     }
 
+    portENTER_CRITICAL(&s_lock);
     *data = s_state.current_data;
+    int64_t age_s = (esp_timer_get_time() - s_state.fetched_us) / 1000000;
+    data->age_s = data->valid ? (uint32_t)age_s : 0;
+    data->stale = data->valid && age_s > FRESH_S;
+    if (data->valid && age_s > MAX_AGE_S) {
+        // Too old to show, the panel is skipped until a fetch succeeds
+        data->valid = false;
+    }
+
+    if (!data->valid) {
+        s_state.stats.misses++;
+    } else if (data->stale) {
+        s_state.stats.stale_hits++;
+    } else {
+        s_state.stats.fresh_hits++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t weather_get_forecast(weather_forecast_t *forecast)
+{
+    if (!s_state.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (forecast == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    time_t now = time(NULL);
+
+    portENTER_CRITICAL(&s_lock);
+    if (now >= MIN_VALID_EPOCH) {
+        trim_forecast(&s_state.forecast, now);
+    }
+    *forecast = s_state.forecast;
+    portEXIT_CRITICAL(&s_lock);
+
     return ESP_OK;
 }
 
+size_t weather_forecast_daily(const weather_forecast_t *forecast, weather_day_t *days, size_t max)
+{
+    size_t count = 0;
+    int last_yday = -1;
+
+    for (size_t i = 0; i < forecast->count; i++) {
+        time_t t = (time_t)weather_forecast_time(forecast, i);
+        int16_t temp = weather_forecast_temp_deci(forecast, i);
+        weather_condition_t condition = weather_forecast_condition(forecast, i);
+        struct tm tm;
+
+        localtime_r(&t, &tm);
+        if (tm.tm_yday != last_yday) {
+            if (count == max) {
+                break;
+            }
+            last_yday = tm.tm_yday;
+            days[count++] = (weather_day_t){
+                .first = t,
+                .min_deci = temp,
+                .max_deci = temp,
+                .condition = condition,
+            };
+            continue;
+        }
+
+        weather_day_t *day = &days[count - 1];
+        if (temp < day->min_deci) {
+            day->min_deci = temp;
+        }
+        if (temp > day->max_deci) {
+            day->max_deci = temp;
+        }
+        // Conditions are ordered clear < clouds < rain < snow < thunderstorm
+        if (condition != WEATHER_UNKNOWN &&
+            (day->condition == WEATHER_UNKNOWN || condition > day->condition)) {
+            day->condition = condition;
+        }
+    }
+
+    return count;
+}
+
 esp_err_t weather_update_config(const weather_config_t *config)
 {
     if (!s_state.initialized) {
@@ -188,239 +300,765 @@ esp_err_t weather_update_config(const weather_config_t *config)
         return ESP_ERR_INVALID_ARG;
     }
 
+    if (strcmp(config->location, s_state.config.location) != 0) {
+        // Data of the old location would show until the update below
+        portENTER_CRITICAL(&s_lock);
+        s_state.current_data.valid = false;
+        s_state.forecast.count = 0;
+        portEXIT_CRITICAL(&s_lock);
+    }
+
     s_state.config = *config;
 
-    // Restart timer with new interval
-    xTimerChangePeriod(s_state.update_timer,
-                       pdMS_TO_TICKS(config->update_interval * 1000),
-                       0);
+    // New interval, counted from the update below
+    netjobs_set_schedule(s_state.job, config->update_interval,
+                         config->update_interval / TOLERANCE_DIVISOR, 0);
 
     // Trigger immediate update
     return weather_force_update();
 }
 
+esp_err_t weather_get_stats(weather_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_state.stats;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+size_t weather_get_provider_stats(weather_provider_stats_t *stats, size_t max)
+{
+    size_t count = max < PROVIDER_COUNT ? max : PROVIDER_COUNT;
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < count; i++) {
+        stats[i] = s_state.provider_stats[i];
+        stats[i].active = i == s_state.provider;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+esp_err_t weather_set_provider(const char *name)
+{
+    if (!s_state.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < PROVIDER_COUNT; i++) {
+        if (strcmp(s_providers[i]->name, name) == 0) {
+            portENTER_CRITICAL(&s_lock);
+            s_state.provider = i;
+            portEXIT_CRITICAL(&s_lock);
+            ESP_LOGI(TAG, "Provider: %s", name);
+            return weather_force_update();
+        }
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
 esp_err_t weather_force_update(void)
 {
     if (!s_state.initialized) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    return fetch_weather_data();
+    // Fetched by the job worker, waiting for the network may take a while
+    return netjobs_trigger(s_state.job);
 }
 
 // ============================================================================
 // Private - HTTP and API
 // ============================================================================
 
-static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+/**
+ * @brief Read the body chunk by chunk into the parser
+ *
+ * Memory use does not depend on the body size: bodies over
+ * MAX_RESPONSE_BYTES are abandoned, and bodies cut short by the server or
+ * the connection are counted as truncated.
+ */
+static esp_err_t read_response(esp_http_client_handle_t client, fetch_counts_t *counts)
 {
-    switch (evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            // Accumulate response data
-            if (s_state.response_len + evt->data_len < HTTP_RESPONSE_BUFFER_SIZE) {
-                memcpy(s_state.response_buffer + s_state.response_len,
-                       evt->data, evt->data_len);
-                s_state.response_len += evt->data_len;
-                s_state.response_buffer[s_state.response_len] = '\0';
-            } else {
-                ESP_LOGW(TAG, "Response buffer overflow");
-            }
-            break;
+    char chunk[RESPONSE_CHUNK_SIZE];
+    int len;
+
+    while ((len = esp_http_client_read(client, chunk, sizeof(chunk))) > 0) {
+        if (s_state.response_len + len > MAX_RESPONSE_BYTES) {
+            counts->oversize++;
+            ESP_LOGE(TAG, "Response over %d bytes, abandoned", MAX_RESPONSE_BYTES);
+            return ESP_ERR_INVALID_SIZE;
+        }
 
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE(TAG, "HTTP error");
-            break;
+        int64_t start = esp_timer_get_time();
+        if (s_state.parse_ok) {
+            s_state.parse_ok = json_stream_feed(&s_state.parser, chunk, len);
+        }
+        s_state.parse_us += esp_timer_get_time() - start;
+        s_state.response_len += len;
+    }
 
-        default:
-            break;
+    if (len < 0 || !esp_http_client_is_complete_data_received(client)) {
+        counts->truncated++;
+        ESP_LOGE(TAG, "Response truncated after %u bytes", (unsigned)s_state.response_len);
+        return ESP_ERR_INVALID_RESPONSE;
     }
-    return ESP_OK;
+
+    return parse_finish(counts);
 }
 
-static esp_err_t fetch_weather_data(void)
+/**
+ * @brief Build the URL of a provider request and fetch it
+ *
+ * @param provider Provider
+ * @param index    Index into provider->requests
+ * @return ESP_OK once a complete, well-formed response was parsed
+ */
+static esp_err_t fetch_request(const weather_provider_t *provider, size_t index)
 {
-    // Build API URL
+    const weather_request_t *request = &provider->requests[index];
+    const char *server = SERVER_OVERRIDE[0] != '\0' ? SERVER_OVERRIDE : provider->server;
     char url[256];
 
-    // Check if location is numeric (city ID) or text (city name)
-    bool is_numeric = true;
-    for (const char *p = s_state.config.location; *p; p++) {
-        if (*p < '0' || *p > '9') {
-            is_numeric = false;
-            break;
-        }
+    if (provider->needs_key && s_state.config.api_key[0] == '\0') {
+        ESP_LOGE(TAG, "%s needs an API key", provider->name);
+        return ESP_ERR_INVALID_STATE;
     }
 
-    // Use 'id' parameter for numeric IDs, 'q' for city names
-    if (is_numeric) {
-        snprintf(url, sizeof(url),
-                 "%s?id=%s&appid=%s&units=metric",
-                 OPENWEATHER_API_URL,
-                 s_state.config.location,
-                 s_state.config.api_key);
-    } else {
-        snprintf(url, sizeof(url),
-                 "%s?q=%s&appid=%s&units=metric",
-                 OPENWEATHER_API_URL,
-                 s_state.config.location,
-                 s_state.config.api_key);
+    esp_err_t err = provider->build_url(url, sizeof(url), server, index,
+                                        &s_state.config, FORECAST_STEPS);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: no request for location \"%s\": %s", provider->name,
+                 s_state.config.location, esp_err_to_name(err));
+        return err;
+    }
+
+    // Values of this response only
+    s_state.fetching = provider;
+    if (request->current) {
+        s_state.have_temp = false;
+        s_state.have_code = false;
+    }
+    if (request->forecast) {
+        memset(&s_state.forecast_next, 0, sizeof(s_state.forecast_next));
+        memset(s_state.forecast_fields, 0, sizeof(s_state.forecast_fields));
     }
 
-    ESP_LOGI(TAG, "Fetching weather data...");
+    ESP_LOGI(TAG, "Fetching from %s (request %u)...", provider->name, (unsigned)index);
+    return fetch_json(url, request);
+}
 
-    // Reset response buffer
+/**
+ * @brief GET a URL and stream its JSON response into parse_value()
+ *
+ * @param url     URL, may hold the API key so it is not logged
+ * @param request Paths to extract and what they hold
+ * @return ESP_OK once a complete, well-formed response was parsed
+ */
+static esp_err_t fetch_json(const char *url, const weather_request_t *request)
+{
+    int64_t start = esp_timer_get_time();
+    int status = 0;
+    size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+
+    // Lowest free heap during the fetch, for its peak use
+    heap_caps_monitor_local_minimum_free_size_start();
+    json_stream_init(&s_state.parser, request->paths, request->path_count,
+                     parse_value, (void *)request);
+    s_state.parse_ok = true;
     s_state.response_len = 0;
-    memset(s_state.response_buffer, 0, HTTP_RESPONSE_BUFFER_SIZE);
-
-    // Configure HTTP client
-    esp_http_client_config_t http_config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
-        .transport_type = HTTP_TRANSPORT_OVER_SSL,
-        .crt_bundle_attach = esp_crt_bundle_attach,  // Use certificate bundle
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&http_config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return ESP_FAIL;
-    }
+    s_state.parse_us = 0;
 
-    esp_err_t err = esp_http_client_perform(client);
+    fetch_counts_t counts = {0};
+    int64_t content_length = -1;
+    esp_err_t err = open_request(url, &content_length, &counts);
 
     if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP Status = %d, content_length = %d",
-                 status, (int)s_state.response_len);
+        status = esp_http_client_get_status_code(s_state.client);
+        ESP_LOGI(TAG, "HTTP Status = %d, content_length = %lld",
+                 status, content_length);
 
-        if (status == 200) {
-            err = parse_weather_response(s_state.response_buffer);
-        } else {
+        if (status != 200) {
             ESP_LOGW(TAG, "HTTP request failed with status %d", status);
             err = ESP_FAIL;
+        } else if (content_length > MAX_RESPONSE_BYTES) {
+            // Known too big from the headers, not downloaded at all
+            counts.oversize++;
+            ESP_LOGE(TAG, "Response of %lld bytes over %d, not read",
+                     content_length, MAX_RESPONSE_BYTES);
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            err = read_response(s_state.client, &counts);
         }
     } else {
         ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
     }
 
-    esp_http_client_cleanup(client);
+    // Only a fully read response leaves the connection usable
+    if (s_state.connected && !esp_http_client_is_complete_data_received(s_state.client)) {
+        close_connection();
+    }
+
+    size_t heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_stop();
+    uint32_t heap_peak = heap_before > heap_min ? (uint32_t)(heap_before - heap_min) : 0;
+
+    uint32_t duration_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    // weather_get_stats() copies them from another task
+    portENTER_CRITICAL(&s_lock);
+    weather_stats_t *stats = &s_state.stats;
+    stats->fetch_count++;
+    if (err != ESP_OK) {
+        stats->fail_count++;
+    }
+    stats->last_duration_ms = duration_ms;
+    stats->last_http_status = status;
+    stats->last_err = err;
+    stats->last_response_len = (uint32_t)s_state.response_len;
+    stats->total_rx_bytes += s_state.response_len;
+    stats->last_parse_us = (uint32_t)s_state.parse_us;
+    stats->last_heap_peak = heap_peak;
+    if (heap_peak > stats->max_heap_peak) {
+        stats->max_heap_peak = heap_peak;
+    }
+    stats->truncated_count += counts.truncated;
+    stats->oversize_count += counts.oversize;
+    stats->handshake_count += counts.handshakes;
+    stats->reuse_count += counts.reuses;
+    if (counts.handshakes > 0) {
+        stats->last_handshake_ms = counts.handshake_ms;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "Fetch took %lu ms, %u bytes parsed in %lld us, heap peak %lu bytes",
+             duration_ms, (unsigned)s_state.response_len, s_state.parse_us, heap_peak);
+
     return err;
 }
 
-static esp_err_t parse_weather_response(const char *json_str)
+/**
+ * @brief Length of the scheme, host and port part of a URL
+ */
+static size_t origin_length(const char *url)
 {
-    cJSON *root = cJSON_Parse(json_str);
-    if (root == NULL) {
-        ESP_LOGE(TAG, "Failed to parse JSON response");
-        return ESP_FAIL;
+    const char *host = strstr(url, "://");
+    host = host != NULL ? host + 3 : url;
+    return (size_t)(host - url) + strcspn(host, "/?");
+}
+
+/**
+ * @brief Send the GET and read the response headers
+ *
+ * Reuses the open connection if there is one, and otherwise connects
+ * with the saved TLS session for an abbreviated handshake. A reused
+ * connection the server has closed meanwhile is replaced by a new one.
+ */
+static esp_err_t open_request(const char *url, int64_t *content_length,
+                               fetch_counts_t *counts)
+{
+    size_t origin_len = origin_length(url);
+
+    if (s_state.client == NULL) {
+        esp_http_client_config_t http_config = {
+            .url = url,
+            .timeout_ms = 10000,
+            .transport_type = HTTP_TRANSPORT_OVER_SSL,
+            .crt_bundle_attach = esp_crt_bundle_attach,  // Use certificate bundle
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+            .save_client_session = true,
+#endif
+        };
+
+        s_state.client = esp_http_client_init(&http_config);
+        if (s_state.client == NULL) {
+            ESP_LOGE(TAG, "Failed to initialize HTTP client");
+            return ESP_FAIL;
+        }
+    } else {
+        // Same host keeps the connection. set_url() closes it for another
+        // one without telling, so close it here to count the new handshake
+        if (s_state.connected && (origin_len != strlen(s_state.origin) ||
+                                  strncmp(url, s_state.origin, origin_len) != 0)) {
+            close_connection();
+        }
+        esp_err_t err = esp_http_client_set_url(s_state.client, url);
+        if (err != ESP_OK) {
+            return err;
+        }
     }
+    snprintf(s_state.origin, sizeof(s_state.origin), "%.*s", (int)origin_len, url);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = s_state.connected;
+        int64_t start = esp_timer_get_time();
+
+        esp_err_t err = esp_http_client_open(s_state.client, 0);
+        if (err == ESP_OK) {
+            if (!reused) {
+                // Connect and TLS handshake, the request write is negligible
+                counts->handshakes++;
+                counts->handshake_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+            }
+            s_state.connected = true;
+            *content_length = esp_http_client_fetch_headers(s_state.client);
+            if (*content_length >= 0) {
+                if (reused) {
+                    counts->reuses++;
+                }
+                return ESP_OK;
+            }
+            err = ESP_FAIL;
+        }
 
-    // Extract temperature from main.temp
-    cJSON *main = cJSON_GetObjectItem(root, "main");
-    cJSON *temp = cJSON_GetObjectItem(main, "temp");
+        close_connection();
+        if (!reused) {
+            return err;
+        }
+        ESP_LOGD(TAG, "Kept connection was closed, reconnecting");
+    }
+    return ESP_FAIL;
+}
 
-    if (!cJSON_IsNumber(temp)) {
-        ESP_LOGE(TAG, "Temperature not found in response");
-        cJSON_Delete(root);
-        return ESP_FAIL;
+static void close_connection(void)
+{
+    if (s_state.client != NULL && s_state.connected) {
+        esp_http_client_close(s_state.client);
     }
+    s_state.connected = false;
+}
 
-    // Extract weather condition from weather[0].id
-    cJSON *weather_array = cJSON_GetObjectItem(root, "weather");
-    if (!cJSON_IsArray(weather_array) || cJSON_GetArraySize(weather_array) == 0) {
-        ESP_LOGE(TAG, "Weather array not found in response");
-        cJSON_Delete(root);
+static esp_err_t parse_finish(fetch_counts_t *counts)
+{
+    // Values are only used from a complete, well-formed response. A body
+    // without errors that stops mid-document was cut by the server
+    bool complete = json_stream_finish(&s_state.parser);
+    if (s_state.parse_ok && !complete) {
+        counts->truncated++;
+        ESP_LOGE(TAG, "Response ends mid-document after %u bytes",
+                 (unsigned)s_state.response_len);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (!complete) {
+        ESP_LOGE(TAG, "Failed to parse JSON response (at byte %u)",
+                 (unsigned)json_stream_offset(&s_state.parser));
         return ESP_FAIL;
     }
+    return ESP_OK;
+}
+
+// ============================================================================
+// Private - Values
+// ============================================================================
+
+// Step fields, bit (field - WEATHER_FIELD_STEP_TIME) of forecast_fields
+#define STEP_FIELDS_ALL 0x07
+
+static void set_condition(weather_forecast_t *forecast, size_t slot, weather_condition_t condition)
+{
+    uint8_t *packed = &forecast->conditions[slot / 2];
+    if (slot & 1) {
+        *packed = (uint8_t)((*packed & 0x0f) | (condition << 4));
+    } else {
+        *packed = (uint8_t)((*packed & 0xf0) | condition);
+    }
+}
+
+/**
+ * @brief Store one value of step index straight into the next ring
+ */
+static void step_value(weather_field_t field, int index, const char *value)
+{
+    weather_forecast_t *next = &s_state.forecast_next;
+
+    if (index < 0 || index >= WEATHER_FORECAST_MAX) {
+        return;
+    }
+
+    switch (field) {
+        case WEATHER_FIELD_STEP_TIME: {
+            // Steps come in time order, the first one is the base
+            int64_t t = strtoll(value, NULL, 10);
+            if (index == 0) {
+                next->base = t;
+            } else if (!(s_state.forecast_fields[0] & 1)) {
+                return;
+            }
+            int64_t offset_min = (t - next->base) / 60;
+            if (offset_min < 0 || offset_min > UINT16_MAX) {
+                return;
+            }
+            next->offset_min[index] = (uint16_t)offset_min;
+            break;
+        }
+        case WEATHER_FIELD_STEP_TEMP: {
+            float deci = strtof(value, NULL) * 10.0f;
+            if (deci < INT16_MIN || deci > INT16_MAX) {
+                return;
+            }
+            next->temp_deci[index] = (int16_t)(deci < 0 ? deci - 0.5f : deci + 0.5f);
+            break;
+        }
+        case WEATHER_FIELD_STEP_CODE:
+            set_condition(next, index,
+                          s_state.fetching->map_condition((int)strtol(value, NULL, 10)));
+            break;
+        default:
+            return;
+    }
+    s_state.forecast_fields[index] |= 1 << (field - WEATHER_FIELD_STEP_TIME);
+}
+
+static void parse_value(void *ctx, size_t path, int index,
+                        json_stream_type_t type, const char *value)
+{
+    const weather_request_t *request = ctx;
 
-    cJSON *weather = cJSON_GetArrayItem(weather_array, 0);
-    cJSON *weather_id = cJSON_GetObjectItem(weather, "id");
+    if (type != JSON_STREAM_NUMBER) {
+        return;
+    }
 
-    if (!cJSON_IsNumber(weather_id)) {
-        ESP_LOGE(TAG, "Weather ID not found in response");
-        cJSON_Delete(root);
+    switch (request->fields[path]) {
+        case WEATHER_FIELD_TEMP:
+            s_state.temp = strtof(value, NULL);
+            s_state.have_temp = true;
+            break;
+        case WEATHER_FIELD_CODE:
+            s_state.code = (int)strtol(value, NULL, 10);
+            s_state.have_code = true;
+            break;
+        default:
+            step_value(request->fields[path], index, value);
+            break;
+    }
+}
+
+/**
+ * @brief Make the current weather of a parsed response the current data
+ */
+static esp_err_t apply_current(const weather_provider_t *provider)
+{
+    if (!s_state.have_temp) {
+        ESP_LOGE(TAG, "Temperature not found in response");
+        return ESP_FAIL;
+    }
+
+    if (!s_state.have_code) {
+        ESP_LOGE(TAG, "Weather code not found in response");
         return ESP_FAIL;
     }
 
     // Update current data
-    s_state.current_data.temperature = (float)temp->valuedouble;
-    s_state.current_data.condition = map_weather_condition(weather_id->valueint);
+    portENTER_CRITICAL(&s_lock);
+    s_state.current_data.temperature = s_state.temp;
+    s_state.current_data.condition = provider->map_condition(s_state.code);
     s_state.current_data.valid = true;
+    s_state.fetched_us = esp_timer_get_time();
+    s_state.stats.from_cache = false;
+    portEXIT_CRITICAL(&s_lock);
+    save_cache();
 
     ESP_LOGI(TAG, "Weather updated: %.1f°C, condition: %d",
              s_state.current_data.temperature,
              s_state.current_data.condition);
 
-    cJSON_Delete(root);
     return ESP_OK;
 }
 
-static weather_condition_t map_weather_condition(int owm_code)
+/**
+ * @brief Make the forecast of a parsed response the forecast
+ *
+ * @param err Result of the request, a failure keeps the last forecast
+ */
+static void apply_forecast(esp_err_t err)
 {
-    // OpenWeather condition codes:
-    // 2xx = Thunderstorm
-    // 3xx = Drizzle (treat as rain)
-    // 5xx = Rain
-    // 6xx = Snow
-    // 7xx = Atmosphere (fog, etc - treat as clouds)
-    // 800 = Clear
-    // 80x = Clouds
-
-    if (owm_code >= 200 && owm_code < 300) {
-        return WEATHER_THUNDERSTORM;
-    } else if (owm_code >= 300 && owm_code < 600) {
-        return WEATHER_RAIN;
-    } else if (owm_code >= 600 && owm_code < 700) {
-        return WEATHER_SNOW;
-    } else if (owm_code == 800) {
-        return WEATHER_CLEAR;
-    } else if (owm_code >= 801 && owm_code < 900) {
-        return WEATHER_CLOUDS;
-    }
-
-    return WEATHER_UNKNOWN;
+    // Steps up to the first incomplete one
+    uint8_t count = 0;
+    while (count < WEATHER_FORECAST_MAX && s_state.forecast_fields[count] == STEP_FIELDS_ALL) {
+        count++;
+    }
+    if (err == ESP_OK && count == 0) {
+        ESP_LOGE(TAG, "No forecast steps in response");
+        err = ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (err == ESP_OK) {
+        s_state.forecast_next.count = count;
+        s_state.forecast = s_state.forecast_next;
+        s_state.stats.forecast_count++;
+    } else {
+        s_state.stats.forecast_fail_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Forecast updated: %u steps", count);
+    }
+}
+
+/**
+ * @brief Drop the steps that are past, called with s_lock held
+ */
+static void trim_forecast(weather_forecast_t *forecast, int64_t now)
+{
+    while (forecast->count > 0 && weather_forecast_time(forecast, 0) <= now) {
+        forecast->head = (forecast->head + 1) % WEATHER_FORECAST_MAX;
+        forecast->count--;
+    }
 }
 
 // ============================================================================
-// Private - Event Handlers
+// Private - Fetch Job
 // ============================================================================
 
-static void update_timer_callback(TimerHandle_t timer)
+static esp_err_t fetch_job(void *arg)
 {
-    // Request fetch from dedicated task
-    s_state.fetch_requested = true;
-    if (s_state.fetch_task_handle != NULL) {
-        xTaskNotifyGive(s_state.fetch_task_handle);
+    portENTER_CRITICAL(&s_lock);
+    size_t index = s_state.provider;
+    uint64_t rx_before = s_state.stats.total_rx_bytes;
+    portEXIT_CRITICAL(&s_lock);
+
+    const weather_provider_t *provider = s_providers[index];
+    int64_t start = esp_timer_get_time();
+    uint32_t request_count = 0;
+    esp_err_t err = ESP_FAIL;
+
+    // All requests on the same connection. A failed forecast keeps the last
+    // one and does not fail the job, the current weather is what the panel
+    // needs
+    for (size_t i = 0; i < provider->request_count; i++) {
+        const weather_request_t *request = &provider->requests[i];
+        if (!request->current && FORECAST_STEPS == 0) {
+            continue;   // Forecast only, turned off
+        }
+
+        esp_err_t request_err = fetch_request(provider, i);
+        request_count++;
+        if (request->current) {
+            err = request_err == ESP_OK ? apply_current(provider) : request_err;
+        }
+        if (request->forecast && FORECAST_STEPS > 0) {
+            apply_forecast(request_err);
+        }
     }
+
+    // Requests of one wake window share the connection. Kept open until the
+    // next window it would hold the TLS context's heap for nothing and the
+    // server would drop it anyway; the saved session shortens the next
+    // handshake instead
+    close_connection();
+
+    // Whole update, all its requests: what choosing this provider costs
+    uint32_t duration_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    weather_provider_stats_t *stats = &s_state.provider_stats[index];
+
+    portENTER_CRITICAL(&s_lock);
+    uint32_t rx_bytes = (uint32_t)(s_state.stats.total_rx_bytes - rx_before);
+    stats->update_count++;
+    if (err != ESP_OK) {
+        stats->fail_count++;
+    }
+    stats->request_count += request_count;
+    stats->last_duration_ms = duration_ms;
+    if (duration_ms > stats->max_duration_ms) {
+        stats->max_duration_ms = duration_ms;
+    }
+    stats->total_duration_ms += duration_ms;
+    stats->last_rx_bytes = rx_bytes;
+    stats->total_rx_bytes += rx_bytes;
+    portEXIT_CRITICAL(&s_lock);
+
+    return err;
 }
 
-static void network_connected_handler(void* arg, esp_event_base_t base,
-                                       int32_t event_id, void* event_data)
+// ============================================================================
+// Private - Cache
+// ============================================================================
+
+/**
+ * @brief Serve the fetch cached before the reboot, if still usable
+ *
+ * Its age is only known when the clock ran through the reset (RTC) or is
+ * synced. After a power cycle the clock is the last synced time restored
+ * from flash, behind by the time powered off: the fetch is then served as
+ * stale and a new one made right away.
+ *
+ * @return Seconds until the first fetch is due
+ */
+static uint32_t restore_cache(const timemachine_weather_cache_t *cache)
 {
-    ESP_LOGI(TAG, "Network connected, triggering weather update");
-    // Request fetch from dedicated task
-    s_state.fetch_requested = true;
-    if (s_state.fetch_task_handle != NULL) {
-        xTaskNotifyGive(s_state.fetch_task_handle);
+    time_t now = time(NULL);
+    ntp_sync_source_t source = ntp_sync_get_source();
+    bool trusted = source == NTP_SYNC_SOURCE_RTC || source == NTP_SYNC_SOURCE_NTP;
+
+    if (cache->fetched == 0 || strcmp(cache->location, s_state.config.location) != 0) {
+        return 0;
+    }
+    if (now < MIN_VALID_EPOCH || (trusted && now < cache->fetched)) {
+        ESP_LOGI(TAG, "Cached weather of unknown age, not used");
+        return 0;
+    }
+
+    // A clock that is behind still gives the least the age can be
+    int64_t age_s = now > cache->fetched ? now - cache->fetched : 0;
+    if (age_s > MAX_AGE_S) {
+        ESP_LOGI(TAG, "Cached weather expired (%lld s old)", age_s);
+        return 0;
     }
+    if (!trusted && age_s <= FRESH_S) {
+        age_s = FRESH_S + 1;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_state.current_data.temperature = cache->temperature;
+    s_state.current_data.condition = cache->condition < WEATHER_UNKNOWN ?
+                                     (weather_condition_t)cache->condition : WEATHER_UNKNOWN;
+    s_state.current_data.valid = true;
+    s_state.fetched_us = esp_timer_get_time() - age_s * 1000000;
+    s_state.stats.from_cache = true;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!trusted) {
+        ESP_LOGI(TAG, "Cached weather restored: %.1f°C, age unknown (stale)",
+                 cache->temperature);
+        return 0;
+    }
+
+    ESP_LOGI(TAG, "Cached weather restored: %.1f°C, %lld s old%s",
+             cache->temperature, age_s, age_s > FRESH_S ? " (stale)" : "");
+
+    return age_s < s_state.config.update_interval ?
+           s_state.config.update_interval - (uint32_t)age_s : 0;
+}
+
+/**
+ * @brief Have the fetch just made persisted (by settings)
+ */
+static void save_cache(void)
+{
+    timemachine_weather_cache_t cache = {0};
+    time_t now = time(NULL);
+
+    // Without the time its age could not be told after a reboot
+    if (now < MIN_VALID_EPOCH) {
+        return;
+    }
+
+    strlcpy(cache.location, s_state.config.location, sizeof(cache.location));
+    cache.temperature = s_state.current_data.temperature;
+    cache.condition = (uint8_t)s_state.current_data.condition;
+    cache.fetched = now;
+    esp_event_post(TIMEMACHINE_EVENT, WEATHER_UPDATED, &cache, sizeof(cache), 0);
 }
 
 // ============================================================================
-// Private - Fetch Task
+// Console
 // ============================================================================
 
-static void fetch_task(void *pvParameters)
+#if CONFIG_TIMEMACHINE_CONSOLE
+
+static int cmd_weather(int argc, char **argv)
 {
-    ESP_LOGI(TAG, "Weather fetch task started");
+    if (argc == 3 && strcmp(argv[1], "use") == 0) {
+        esp_err_t err = weather_set_provider(argv[2]);
+        if (err != ESP_OK) {
+            printf("Cannot use %s: %s\n", argv[2], esp_err_to_name(err));
+            return 1;
+        }
+        printf("Using %s, fetching\n", argv[2]);
+        return 0;
+    }
 
-    while (1) {
-        // Wait for notification
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    weather_stats_t stats;
+    weather_data_t data;
+    weather_get_data(&data);
+    weather_get_stats(&stats);
 
-        if (s_state.fetch_requested) {
-            s_state.fetch_requested = false;
-            fetch_weather_data();
-        }
+    if (data.valid) {
+        printf("Current: %.1f C, condition %d, %lu s old%s%s\n",
+               data.temperature, data.condition, data.age_s,
+               data.stale ? ", stale" : "", stats.from_cache ? ", from cache" : "");
+    } else {
+        printf("Current: no data\n");
     }
+    printf("Served: %lu fresh, %lu stale, %lu misses\n",
+           stats.fresh_hits, stats.stale_hits, stats.misses);
+
+    weather_forecast_t forecast;
+    weather_day_t days[6];
+    weather_get_forecast(&forecast);
+    size_t day_count = weather_forecast_daily(&forecast, days, sizeof(days) / sizeof(days[0]));
+    printf("Forecast: %u steps (%u bytes), %lu fetched, %lu failed\n",
+           forecast.count, (unsigned)sizeof(forecast),
+           stats.forecast_count, stats.forecast_fail_count);
+    for (size_t i = 0; i < forecast.count; i++) {
+        time_t t = (time_t)weather_forecast_time(&forecast, i);
+        struct tm tm;
+        localtime_r(&t, &tm);
+        int16_t temp = weather_forecast_temp_deci(&forecast, i);
+        printf("  %02d.%02d %02d:%02d %5.1f C condition %d\n",
+               tm.tm_mday, tm.tm_mon + 1, tm.tm_hour, tm.tm_min,
+               temp / 10.0f, weather_forecast_condition(&forecast, i));
+    }
+    for (size_t i = 0; i < day_count; i++) {
+        time_t t = (time_t)days[i].first;
+        struct tm tm;
+        localtime_r(&t, &tm);
+        printf("  day %02d.%02d %5.1f..%5.1f C condition %d\n",
+               tm.tm_mday, tm.tm_mon + 1,
+               days[i].min_deci / 10.0f, days[i].max_deci / 10.0f, days[i].condition);
+    }
+    printf("Fetches: %lu, failed: %lu, last: %lu ms, HTTP %d, %s\n",
+           stats.fetch_count, stats.fail_count, stats.last_duration_ms,
+           stats.last_http_status, esp_err_to_name(stats.last_err));
+    printf("Connections: %lu handshakes (last %lu ms), %lu reused\n",
+           stats.handshake_count, stats.last_handshake_ms, stats.reuse_count);
+    printf("Body: last %lu bytes parsed in %lu us, total %llu bytes\n",
+           stats.last_response_len, stats.last_parse_us, stats.total_rx_bytes);
+    printf("Truncated: %lu, oversize: %lu\n", stats.truncated_count, stats.oversize_count);
+    printf("Heap peak: last %lu bytes, max %lu bytes\n",
+           stats.last_heap_peak, stats.max_heap_peak);
+
+    weather_provider_stats_t providers[WEATHER_PROVIDER_MAX];
+    size_t provider_count = weather_get_provider_stats(providers, WEATHER_PROVIDER_MAX);
+    printf("Provider     Updates  Failed  Requests  Last ms  Avg ms  Max ms  Last bytes  Avg bytes\n");
+    for (size_t i = 0; i < provider_count; i++) {
+        const weather_provider_stats_t *p = &providers[i];
+        uint32_t n = p->update_count > 0 ? p->update_count : 1;
+        printf("%c%-11s %7lu %7lu %9lu %8lu %7lu %7lu %11lu %10lu\n",
+               p->active ? '*' : ' ', p->name, p->update_count, p->fail_count,
+               p->request_count, p->last_duration_ms, (uint32_t)(p->total_duration_ms / n),
+               p->max_duration_ms, p->last_rx_bytes, (uint32_t)(p->total_rx_bytes / n));
+    }
+    return 0;
+}
+
+esp_err_t weather_register_console_commands(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "weather",
+        .help = "Show weather data and fetch statistics, 'use <provider>' to switch provider",
+        .hint = "[use openweather|openmeteo]",
+        .func = cmd_weather,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+#else
+
+esp_err_t weather_register_console_commands(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
 }
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file weather_provider.h
+ * @brief Weather API providers
+ *
+ * A provider turns the configuration into request URLs and names the JSON
+ * paths of the values weather.c needs, tagged with what they are. The
+ * responses are parsed by the shared streaming extractor and stored by
+ * weather.c, so a provider is a URL builder, path tables and a condition
+ * code map.
+ */
+
+#pragma once
+
+#include "weather.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief What a JSON path holds
+ */
+typedef enum {
+    WEATHER_FIELD_TEMP,         // Current temperature, Celsius
+    WEATHER_FIELD_CODE,         // Current condition, provider code
+    WEATHER_FIELD_STEP_TIME,    // Forecast step time, Unix seconds; [*] is the step
+    WEATHER_FIELD_STEP_TEMP,    // Forecast step temperature, Celsius
+    WEATHER_FIELD_STEP_CODE,    // Forecast step condition, provider code
+} weather_field_t;
+
+/**
+ * @brief One HTTP request of an update
+ */
+typedef struct {
+    const char *const *paths;   // JSON paths to extract
+    const uint8_t *fields;      // weather_field_t of each path
+    size_t path_count;
+    bool current;               // Carries the current weather
+    bool forecast;              // Carries forecast steps
+} weather_request_t;
+
+/**
+ * @brief Provider description
+ */
+typedef struct {
+    const char *name;           // Shown in stats and used by `weather use`
+    const char *server;         // Scheme and host, replaced by CONFIG_TIMEMACHINE_WEATHER_SERVER
+    bool needs_key;             // Requests fail without config->api_key
+    const weather_request_t *requests;
+    size_t request_count;
+
+    /**
+     * @brief Build the URL of a request
+     *
+     * @param url     Receives the URL
+     * @param size    Size of url
+     * @param server  Scheme and host to use
+     * @param request Index into requests
+     * @param config  Location and key
+     * @param steps   Forecast steps wanted, 0 for none
+     * @return ESP_OK, ESP_ERR_INVALID_ARG if the location does not suit the
+     *         provider, ESP_ERR_INVALID_SIZE if url is too small
+     */
+    esp_err_t (*build_url)(char *url, size_t size, const char *server, size_t request,
+                           const weather_config_t *config, int steps);
+
+    /**
+     * @brief Map a provider condition code
+     */
+    weather_condition_t (*map_condition)(int code);
+} weather_provider_t;
+
+extern const weather_provider_t weather_provider_openweather;
+extern const weather_provider_t weather_provider_openmeteo;
@@ -7,7 +7,10 @@
  * @brief Initialize WiFi animation component
  *
  * This component listens for network events and displays an animated
- * WiFi connection indicator while connecting.
+ * WiFi connection indicator while connecting. The animation starts right
+ * away, as the network is initialized next, so the display is not blank
+ * until NETWORK_CONNECTING. Nothing is shown while the wall clock is set
+ * (e.g. restored at boot), as the clock panel has the display then.
  *
  * @return ESP_OK on success, error code otherwise
  */
@@ -3,10 +3,12 @@
 #include "timemachine_events.h"
 #include "display.h"
 #include "fonts/font.h"
+#include "ntp_sync.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_timer.h"
 #include <stdio.h>
+#include <time.h>
 
 static const char *TAG = "wifi_animation";
 
@@ -104,6 +106,12 @@ esp_err_t wifi_animation_init(void)
     s_initialized = true;
     ESP_LOGI(TAG, "WiFi animation initialized");
 
+#if !CONFIG_TIMEMACHINE_SKIP_NETWORK
+    // The network is brought up next; animate from now on instead of
+    // leaving the matrix blank until WIFI_EVENT_STA_START
+    start_animation();
+#endif
+
     return ESP_OK;
 }
 
@@ -237,6 +245,13 @@ static void start_animation(void)
         return;
     }
 
+    // Once the time is known (restored at boot or synced) the clock keeps
+    // the display while connecting
+    if (time(NULL) > NTP_SYNC_MIN_VALID_EPOCH) {
+        ESP_LOGD(TAG, "Time known, not animating");
+        return;
+    }
+
     s_current_frame = 0;
     s_animating = true;
 
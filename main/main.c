@@ -35,6 +35,7 @@
 #include "ble_config.h"
 #include "brightness_control.h"
 #include "network.h"
+#include "netjobs.h"
 #include "ntp_sync.h"
 #include "display.h"
 #include "panel_manager.h"
@@ -45,16 +46,81 @@
 #include "weather.h"
 #include "i18n.h"
 #include "wifi_animation.h"
+#include "perf.h"
+#include "startup.h"
+
+#if CONFIG_TIMEMACHINE_INPUT_SCRIPT
+#include "input_script.h"
+#endif
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+#include "esp_console.h"
+#endif
 
 static const char *TAG = "timemachine";
 
 // Forward declarations
-static void on_network_connected(void* arg, esp_event_base_t event_base,
-                                  int32_t event_id, void* event_data);
+static esp_err_t start_settings(void);
+static esp_err_t start_time_restore(void);
+static esp_err_t start_i18n(void);
+static esp_err_t start_ble_config(void);
+static esp_err_t start_display(void);
+static esp_err_t start_brightness(void);
+static esp_err_t start_panel_manager(void);
+static esp_err_t start_wifi_animation(void);
+static esp_err_t start_input(void);
+static esp_err_t start_network(void);
+static esp_err_t start_netjobs(void);
+static esp_err_t start_ntp(void);
+static esp_err_t start_clock(void);
+static esp_err_t start_date_panel(void);
+static esp_err_t start_weather(void);
+static esp_err_t start_weather_panel(void);
+#if CONFIG_TIMEMACHINE_INPUT_SCRIPT
+static esp_err_t start_boot_script(void);
+#endif
 static void on_network_failed(void* arg, esp_event_base_t event_base,
                                int32_t event_id, void* event_data);
-static void on_ntp_synced(void* arg, esp_event_base_t event_base,
-                          int32_t event_id, void* event_data);
+#if CONFIG_TIMEMACHINE_CONSOLE
+static void start_console(void);
+#endif
+
+// Components start as soon as their dependencies are ready; a failure only
+// skips the components that depend on it
+static const startup_node_t s_startup_graph[] = {
+    { .name = "settings",      .init = start_settings,       .ready_event = STARTUP_NO_EVENT },
+    { .name = "time_restore",  .init = start_time_restore,   .ready_event = STARTUP_NO_EVENT,
+      .deps = { "settings" } },
+    { .name = "i18n",          .init = start_i18n,           .ready_event = STARTUP_NO_EVENT,
+      .deps = { "settings" } },
+    { .name = "ble_config",    .init = start_ble_config,     .ready_event = STARTUP_NO_EVENT,
+      .deps = { "settings" } },
+    { .name = "display",       .init = start_display,        .ready_event = STARTUP_NO_EVENT },
+    { .name = "brightness",    .init = start_brightness,     .ready_event = STARTUP_NO_EVENT,
+      .deps = { "settings", "display" } },
+    { .name = "panel_manager", .init = start_panel_manager,  .ready_event = STARTUP_NO_EVENT,
+      .deps = { "settings", "display" } },
+    { .name = "wifi_animation", .init = start_wifi_animation, .ready_event = STARTUP_NO_EVENT,
+      .deps = { "display", "time_restore" } },
+    { .name = "input",         .init = start_input,          .ready_event = STARTUP_NO_EVENT },
+    { .name = "network",       .init = start_network,        .ready_event = NETWORK_CONNECTED,
+      .deps = { "settings", "time_restore", "wifi_animation" } },
+    { .name = "netjobs",       .init = start_netjobs,        .ready_event = STARTUP_NO_EVENT },
+    { .name = "ntp_sync",      .init = start_ntp,            .ready_event = NTP_SYNCED,
+      .deps = { "network", "netjobs" } },
+    { .name = "clock_panel",   .init = start_clock,          .ready_event = STARTUP_NO_EVENT,
+      .deps = { "time_restore", "panel_manager" } },
+    { .name = "date_panel",    .init = start_date_panel,     .ready_event = STARTUP_NO_EVENT,
+      .deps = { "i18n", "time_restore", "panel_manager" } },
+    { .name = "weather",       .init = start_weather,        .ready_event = STARTUP_NO_EVENT,
+      .deps = { "settings", "time_restore", "netjobs" } },
+    { .name = "weather_panel", .init = start_weather_panel,  .ready_event = STARTUP_NO_EVENT,
+      .deps = { "panel_manager" } },
+#if CONFIG_TIMEMACHINE_INPUT_SCRIPT
+    { .name = "boot_script",   .init = start_boot_script,    .ready_event = STARTUP_NO_EVENT,
+      .deps = { "input", "clock_panel", "date_panel", "weather_panel" } },
+#endif
+};
 
 // ============================================================================
 // Main Entry Point
@@ -62,6 +128,7 @@ static void on_ntp_synced(void* arg, esp_event_base_t event_base,
 
 void app_main(void)
 {
+    perf_boot_init();
     ESP_LOGI(TAG, "Time Machine starting...");
 
     // Initialize NVS
@@ -71,40 +138,12 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    perf_boot_mark(PERF_BOOT_NVS);
     ESP_LOGI(TAG, "NVS initialized");
 
-    // Create default event loop
+    // Create default event loop (the startup graph runs on its events)
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-    // Initialize settings component (must be before other components)
-    ESP_ERROR_CHECK(settings_init());
-
-    // Get settings for initialization
-    language_t language = settings_get_language();
-    network_config_t network_config = settings_get_network();
-
-    // Initialize i18n with configured language
-    ESP_ERROR_CHECK(i18n_init(language));
-
-    // Initialize BLE configuration service
-    ESP_ERROR_CHECK(ble_config_init());
-
-    // Initialize brightness control
-    uint8_t brightness = settings_get_brightness();
-    brightness_control_config_t brightness_config = {
-        .initial_brightness = brightness,
-        .cycle_interval_ms = 300  // 300ms between brightness changes
-    };
-    ESP_ERROR_CHECK(brightness_control_init(&brightness_config));
-
-    // Register event handlers
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        NETWORK_CONNECTED,
-        &on_network_connected,
-        NULL,
-        NULL
-    ));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         TIMEMACHINE_EVENT,
         NETWORK_FAILED,
@@ -112,90 +151,217 @@ void app_main(void)
         NULL,
         NULL
     ));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(
-        TIMEMACHINE_EVENT,
-        NTP_SYNCED,
-        &on_ntp_synced,
-        NULL,
-        NULL
-    ));
 
-    // Initialize display
-    ESP_ERROR_CHECK(display_init());
+    ESP_ERROR_CHECK(startup_run(s_startup_graph,
+                                sizeof(s_startup_graph) / sizeof(s_startup_graph[0])));
+
+#if CONFIG_TIMEMACHINE_CONSOLE
+    start_console();
+#endif
+
+    ESP_LOGI(TAG, "Startup graph running, system is event-driven");
+}
+
+// ============================================================================
+// Startup Graph Nodes
+// ============================================================================
+
+static esp_err_t start_settings(void)
+{
+    // Must be up before anything posts *_CHANGED events
+    esp_err_t err = settings_init();
+    if (err == ESP_OK) {
+        perf_boot_mark(PERF_BOOT_SETTINGS);
+    }
+    return err;
+}
+
+static esp_err_t start_time_restore(void)
+{
+    // Lets the clock start before WiFi and NTP, NTP corrects it later
+    ntp_sync_config_t ntp_config = settings_get_ntp();
+    esp_err_t err = ntp_sync_restore_time(ntp_config.timezone, settings_get_last_epoch());
+    if (err != ESP_OK) {
+        ESP_LOGI(TAG, "No time to restore, clock starts after NTP sync");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t start_i18n(void)
+{
+    return i18n_init(settings_get_language());
+}
+
+static esp_err_t start_ble_config(void)
+{
+    esp_err_t err = ble_config_init();
+    if (err == ESP_OK) {
+        perf_boot_mark(PERF_BOOT_BLE);
+    }
+    return err;
+}
+
+static esp_err_t start_display(void)
+{
+    esp_err_t err = display_init();
+    if (err == ESP_OK) {
+        perf_boot_mark(PERF_BOOT_DISPLAY);
+    }
+    return err;
+}
+
+static esp_err_t start_brightness(void)
+{
+    brightness_control_config_t brightness_config = {
+        .initial_brightness = settings_get_brightness(),
+        .cycle_interval_ms = 300  // 300ms between brightness changes
+    };
+    return brightness_control_init(&brightness_config);
+}
 
-    // Initialize panel manager
+static esp_err_t start_panel_manager(void)
+{
     panel_manager_config_t panel_config = {
         .default_panel = PANEL_CLOCK,
-        .inactivity_timeout_s = CONFIG_TIMEMACHINE_PANEL_TIMEOUT_S
+        .inactivity_timeout_s = CONFIG_TIMEMACHINE_PANEL_TIMEOUT_S,
+        .transition = {
+            .type = CONFIG_TIMEMACHINE_PANEL_TRANSITION,
+            .duration_ms = CONFIG_TIMEMACHINE_PANEL_TRANSITION_MS,
+            .frame_ms = CONFIG_TIMEMACHINE_PANEL_TRANSITION_FRAME_MS
+        },
+        .playlist = settings_get_playlist()
     };
-    ESP_ERROR_CHECK(panel_manager_init(&panel_config));
+    return panel_manager_init(&panel_config);
+}
 
-    // Initialize WiFi animation (must be before network init)
-    ESP_ERROR_CHECK(wifi_animation_init());
+static esp_err_t start_wifi_animation(void)
+{
+    // Must be before network init to see NETWORK_CONNECTING
+    return wifi_animation_init();
+}
 
-    // Initialize touch sensor
+static esp_err_t start_input(void)
+{
+#if CONFIG_TIMEMACHINE_INPUT_SCRIPT
+    // Scripted input replaces the touch sensor
+    return input_script_init();
+#else
     touch_sensor_config_t touch_config = {
         .gpio = CONFIG_TIMEMACHINE_TOUCH_GPIO,
         .active_high = true,
-        .debounce_ms = CONFIG_TIMEMACHINE_TOUCH_DEBOUNCE_MS
+        .debounce_ms = CONFIG_TIMEMACHINE_TOUCH_DEBOUNCE_MS,
+        .long_press_ms = CONFIG_TIMEMACHINE_TOUCH_LONG_PRESS_MS,
+        .multi_tap_ms = CONFIG_TIMEMACHINE_TOUCH_MULTI_TAP_MS,
+        .hold_ms = CONFIG_TIMEMACHINE_TOUCH_HOLD_MS
     };
-    ESP_ERROR_CHECK(touch_sensor_init(&touch_config));
-
-    // Initialize network with settings (async, emits events when ready)
-    ESP_ERROR_CHECK(network_init(&network_config));
-
-    ESP_LOGI(TAG, "Initialization complete, system is event-driven");
+    return touch_sensor_init(&touch_config);
+#endif
 }
 
-// ============================================================================
-// Event Handlers
-// ============================================================================
+static esp_err_t start_network(void)
+{
+    // Async, ready once NETWORK_CONNECTED is posted
+    network_config_t network_config = settings_get_network();
+    ntp_sync_source_t source = ntp_sync_get_source();
+    network_config.clock_trusted = source == NTP_SYNC_SOURCE_RTC ||
+                                   source == NTP_SYNC_SOURCE_NTP;
+    return network_init(&network_config);
+}
 
-static void on_network_connected(void* arg, esp_event_base_t event_base,
-                                  int32_t event_id, void* event_data)
+static esp_err_t start_netjobs(void)
 {
-    ESP_LOGI(TAG, "Network connected, starting NTP sync...");
+    // Runs the periodic NTP syncs and weather fetches. Needs no connection
+    // to start: jobs that find none run when NETWORK_CONNECTED comes
+    return netjobs_init();
+}
 
-    // Get NTP config from settings
+static esp_err_t start_ntp(void)
+{
+    // Ready on NTP_SYNCED; after a failed initial sync that comes later,
+    // from the periodic job
     ntp_sync_config_t ntp_config = settings_get_ntp();
+    return ntp_sync_init(&ntp_config, 30);  // 30 second timeout
+}
 
-    esp_err_t ret = ntp_sync_init(&ntp_config, 30);  // 30 second timeout
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize NTP sync");
-    }
+static esp_err_t start_clock(void)
+{
+    clock_config_t clock_config = settings_get_clock();
+    return clock_panel_init(&clock_config);
 }
 
-static void on_network_failed(void* arg, esp_event_base_t event_base,
-                               int32_t event_id, void* event_data)
+static esp_err_t start_date_panel(void)
 {
-    ESP_LOGE(TAG, "Network connection failed");
+    // Skipped by the panel manager until the time is set
+    return date_panel_init();
 }
 
-static void on_ntp_synced(void* arg, esp_event_base_t event_base,
-                          int32_t event_id, void* event_data)
+static esp_err_t start_weather(void)
 {
-    ESP_LOGI(TAG, "NTP synced, starting clock...");
+    weather_config_t weather_config = settings_get_weather();
+    return weather_init(&weather_config);
+}
 
-    // Get clock config from settings
-    clock_config_t clock_config = settings_get_clock();
-    ESP_ERROR_CHECK(clock_panel_init(&clock_config));
+static esp_err_t start_weather_panel(void)
+{
+    // Skipped by the panel manager until weather data is available
+    return weather_panel_init();
+}
 
-    // Register clock panel with panel manager
-    panel_info_t clock_panel = {
-        .id = PANEL_CLOCK,
-        .name = "clock"
-    };
-    ESP_ERROR_CHECK(panel_manager_register_panel(&clock_panel));
+#if CONFIG_TIMEMACHINE_INPUT_SCRIPT
+static esp_err_t start_boot_script(void)
+{
+    if (strlen(CONFIG_TIMEMACHINE_INPUT_SCRIPT_BOOT) == 0) {
+        return ESP_OK;
+    }
+    return input_script_run(CONFIG_TIMEMACHINE_INPUT_SCRIPT_BOOT);
+}
+#endif
+
+// ============================================================================
+// Event Handlers
+// ============================================================================
 
-    // Initialize date panel
-    ESP_ERROR_CHECK(date_panel_init());
+static void on_network_failed(void* arg, esp_event_base_t event_base,
+                               int32_t event_id, void* event_data)
+{
+    ESP_LOGE(TAG, "Network connection failed");
+}
 
-    // Initialize weather component with settings
-    weather_config_t weather_config = settings_get_weather();
-    ESP_ERROR_CHECK(weather_init(&weather_config));
+// ============================================================================
+// Console
+// ============================================================================
 
-    // Initialize weather panel
-    ESP_ERROR_CHECK(weather_panel_init());
+#if CONFIG_TIMEMACHINE_CONSOLE
+static void start_console(void)
+{
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "timemachine>";
+
+    esp_console_register_help_command();
+    ESP_ERROR_CHECK(perf_register_console_commands());
+    ESP_ERROR_CHECK(startup_register_console_commands());
+    ESP_ERROR_CHECK(panel_manager_register_console_commands());
+    ESP_ERROR_CHECK(network_register_console_commands());
+    ESP_ERROR_CHECK(netjobs_register_console_commands());
+    ESP_ERROR_CHECK(ntp_sync_register_console_commands());
+    ESP_ERROR_CHECK(weather_register_console_commands());
+#if CONFIG_TIMEMACHINE_INPUT_SCRIPT
+    ESP_ERROR_CHECK(input_script_register_console_commands());
+#endif
+
+#if defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    esp_err_t err = esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl);
+#else
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    esp_err_t err = esp_console_new_repl_uart(&hw_config, &repl_config, &repl);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create console: %s", esp_err_to_name(err));
+        return;
+    }
 
-    ESP_LOGI(TAG, "Time Machine ready!");
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
 }
+#endif
@@ -0,0 +1,267 @@
+/**
+ * @file driver.c
+ * @brief Host replay of touch edge timelines through the gesture recognizer
+ *
+ * Usage: driver <timeline>...
+ *
+ * Replays each timeline's raw edges through the debounce filter and the
+ * recognizer the way the touch task does, sampling the level when the
+ * debounce window ends and advancing time to every deadline. Prints the
+ * gestures with the time they are posted, compares them with the
+ * timeline's expect lines and exits non-zero on any mismatch.
+ *
+ * Timeline lines, '#' starts a comment:
+ *
+ *     config debounce=100 long_press=200 multi_tap=300 hold=3000
+ *     enable double triple tap_hold
+ *     <ms> press | release        raw edge, touch active after it
+ *     expect <ms> <gesture>       gesture posted at that time
+ *
+ * config defaults to the Kconfig defaults, enable to no delaying gestures.
+ */
+
+#include "gesture.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ITEMS 256
+
+static const char *const s_names[] = {
+    [GESTURE_TAP]        = "tap",
+    [GESTURE_DOUBLE_TAP] = "double",
+    [GESTURE_TRIPLE_TAP] = "triple",
+    [GESTURE_LONG_PRESS] = "long_press",
+    [GESTURE_HOLD]       = "hold",
+    [GESTURE_TAP_HOLD]   = "tap_hold",
+    [GESTURE_RELEASE]    = "release",
+};
+
+typedef struct {
+    int64_t time_us;
+    int value;          // Level for edges, gesture_t for gestures
+} item_t;
+
+typedef struct {
+    gesture_config_t config;
+    uint32_t debounce_ms;
+    uint32_t mask;
+    item_t edges[MAX_ITEMS];
+    size_t edge_count;
+    item_t expected[MAX_ITEMS];
+    size_t expected_count;
+} timeline_t;
+
+typedef struct {
+    gesture_recognizer_t rec;
+    gesture_debounce_t debounce;
+    bool level;         // Level after the last raw edge, what the GPIO reads
+    item_t got[MAX_ITEMS];
+    size_t got_count;
+} sim_t;
+
+static int64_t parse_ms(const char *s)
+{
+    return llround(strtod(s, NULL) * 1000);
+}
+
+static int parse_gesture(const char *name)
+{
+    for (size_t i = 0; i < sizeof(s_names) / sizeof(s_names[0]); i++) {
+        if (strcmp(name, s_names[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool load(const char *path, timeline_t *tl)
+{
+    char line[256];
+    int line_no = 0;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    *tl = (timeline_t){
+        .config = { .long_press_ms = 200, .multi_tap_ms = 300, .hold_ms = 3000 },
+        .debounce_ms = 100,
+    };
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *words[8];
+        size_t n = 0;
+
+        line_no++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        for (char *w = strtok(line, " \t"); w != NULL && n < 8; w = strtok(NULL, " \t")) {
+            words[n++] = w;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        bool ok = true;
+        if (strcmp(words[0], "config") == 0) {
+            for (size_t i = 1; i < n; i++) {
+                char *eq = strchr(words[i], '=');
+                uint32_t value = eq != NULL ? (uint32_t)strtoul(eq + 1, NULL, 10) : 0;
+                if (eq == NULL) {
+                    ok = false;
+                } else if (strncmp(words[i], "debounce=", 9) == 0) {
+                    tl->debounce_ms = value;
+                } else if (strncmp(words[i], "long_press=", 11) == 0) {
+                    tl->config.long_press_ms = value;
+                } else if (strncmp(words[i], "multi_tap=", 10) == 0) {
+                    tl->config.multi_tap_ms = value;
+                } else if (strncmp(words[i], "hold=", 5) == 0) {
+                    tl->config.hold_ms = value;
+                } else {
+                    ok = false;
+                }
+            }
+        } else if (strcmp(words[0], "enable") == 0) {
+            for (size_t i = 1; i < n; i++) {
+                int g = parse_gesture(words[i]);
+                ok = ok && (g == GESTURE_DOUBLE_TAP || g == GESTURE_TRIPLE_TAP ||
+                            g == GESTURE_TAP_HOLD);
+                tl->mask |= g >= 0 ? 1u << g : 0;
+            }
+        } else if (strcmp(words[0], "expect") == 0 && n == 3 &&
+                   tl->expected_count < MAX_ITEMS) {
+            int g = parse_gesture(words[2]);
+            ok = g >= 0;
+            tl->expected[tl->expected_count++] = (item_t){ parse_ms(words[1]), g };
+        } else if (n == 2 && tl->edge_count < MAX_ITEMS &&
+                   (strcmp(words[1], "press") == 0 || strcmp(words[1], "release") == 0)) {
+            tl->edges[tl->edge_count++] =
+                (item_t){ parse_ms(words[0]), strcmp(words[1], "press") == 0 };
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "%s:%d: bad line\n", path, line_no);
+            fclose(f);
+            return false;
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+static void record(sim_t *sim, const gesture_t *gestures, size_t count, int64_t now_us)
+{
+    for (size_t i = 0; i < count && sim->got_count < MAX_ITEMS; i++) {
+        sim->got[sim->got_count++] = (item_t){ now_us, gestures[i] };
+    }
+}
+
+// handle_level() of touch_sensor.c
+static void feed(sim_t *sim, bool active, int64_t edge_us, int64_t now_us)
+{
+    gesture_t gestures[GESTURE_MAX_OUTPUT];
+
+    if (active != sim->rec.pressed) {
+        record(sim, gestures, gesture_on_edge(&sim->rec, active, edge_us, gestures), now_us);
+    }
+}
+
+// handle_timeout() of touch_sensor.c
+static void timeout(sim_t *sim, int64_t now_us)
+{
+    gesture_t gestures[GESTURE_MAX_OUTPUT];
+    int64_t edge_us;
+
+    if (gesture_debounce_settle(&sim->debounce, now_us, &edge_us)) {
+        feed(sim, sim->level, edge_us, now_us);
+    }
+    record(sim, gestures, gesture_on_time(&sim->rec, now_us, gestures), now_us);
+}
+
+// Wake at every deadline up to until_us, as the touch task's queue timeout
+static void advance(sim_t *sim, int64_t until_us)
+{
+    while (1) {
+        int64_t deadline_us = gesture_next_deadline(&sim->rec);
+        int64_t settle_us = gesture_debounce_deadline(&sim->debounce);
+        if (settle_us < deadline_us) {
+            deadline_us = settle_us;
+        }
+        if (deadline_us == INT64_MAX || deadline_us > until_us) {
+            return;
+        }
+        timeout(sim, deadline_us);
+    }
+}
+
+static bool run(const char *path)
+{
+    static timeline_t tl;
+    static sim_t sim;
+
+    if (!load(path, &tl)) {
+        return false;
+    }
+
+    memset(&sim, 0, sizeof(sim));
+    gesture_init(&sim.rec, &tl.config);
+    gesture_set_enabled(&sim.rec, tl.mask);
+    gesture_debounce_init(&sim.debounce, tl.debounce_ms);
+
+    for (size_t i = 0; i < tl.edge_count; i++) {
+        const item_t *edge = &tl.edges[i];
+        advance(&sim, edge->time_us);
+        sim.level = edge->value;
+        if (gesture_debounce_edge(&sim.debounce, edge->time_us)) {
+            feed(&sim, edge->value, edge->time_us, edge->time_us);
+        }
+    }
+    advance(&sim, INT64_MAX - 1);
+
+    bool pass = sim.got_count == tl.expected_count;
+    for (size_t i = 0; pass && i < tl.expected_count; i++) {
+        pass = sim.got[i].time_us == tl.expected[i].time_us &&
+               sim.got[i].value == tl.expected[i].value;
+    }
+
+    printf("%s %s\n", pass ? "PASS" : "FAIL", path);
+    if (!pass) {
+        for (size_t i = 0; i < tl.expected_count || i < sim.got_count; i++) {
+            char expected[32] = "-";
+            char got[32] = "-";
+            if (i < tl.expected_count) {
+                snprintf(expected, sizeof(expected), "%.3f %s",
+                         tl.expected[i].time_us / 1000.0, s_names[tl.expected[i].value]);
+            }
+            if (i < sim.got_count) {
+                snprintf(got, sizeof(got), "%.3f %s",
+                         sim.got[i].time_us / 1000.0, s_names[sim.got[i].value]);
+            }
+            printf("    expected %-24s got %s\n", expected, got);
+        }
+    }
+    return pass;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <timeline>...\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        failed += !run(argv[i]);
+    }
+
+    printf("%d of %d timelines passed\n", argc - 1 - failed, argc - 1);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file bench.c
+ * @brief Host benchmark for json_stream, used by run.py bench
+ *
+ * Usage: bench <file> <iterations> <path>...
+ *
+ * Parses the file repeatedly in 512-byte chunks, as weather.c reads
+ * responses, and reports the time per parse and the heap allocations made
+ * while parsing (counted by wrapping malloc, glibc only).
+ */
+
+#define _GNU_SOURCE
+#include "json_stream.h"
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHUNK_SIZE 512
+
+static long s_allocs;
+static size_t s_values;
+
+void *malloc(size_t size)
+{
+    static void *(*real_malloc)(size_t);
+    if (real_malloc == NULL) {
+        real_malloc = (void *(*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    }
+    s_allocs++;
+    return real_malloc(size);
+}
+
+static void count_value(void *ctx, size_t path, int index,
+                        json_stream_type_t type, const char *value)
+{
+    s_values++;
+}
+
+int main(int argc, char **argv)
+{
+    static char buf[1 << 20];
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <file> <iterations> <path>...\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 2;
+    }
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    long iterations = strtol(argv[2], NULL, 10);
+    json_stream_t js;
+    struct timespec start, end;
+
+    long allocs_before = s_allocs;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i++) {
+        json_stream_init(&js, (const char *const *)&argv[3], argc - 3, count_value, NULL);
+        for (size_t offset = 0; offset < len; offset += CHUNK_SIZE) {
+            json_stream_feed(&js, buf + offset, len - offset < CHUNK_SIZE ? len - offset : CHUNK_SIZE);
+        }
+        if (!json_stream_finish(&js)) {
+            fprintf(stderr, "%s: not a complete JSON document\n", argv[1]);
+            return 1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long allocs = s_allocs - allocs_before;
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%zu bytes, %.2f us/parse, %zu values/parse, %ld allocations, "
+           "sizeof(json_stream_t) = %zu\n",
+           len, ns / iterations / 1e3, s_values / (size_t)iterations, allocs, sizeof(js));
+    return 0;
+}
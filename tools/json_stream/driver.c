@@ -0,0 +1,68 @@
+/**
+ * @file driver.c
+ * @brief Host driver for json_stream, used by run.py fuzz
+ *
+ * Usage: driver <file> <seed> <path>...
+ *
+ * Feeds the file to json_stream in one piece (seed 0) or in pseudo-random
+ * 1-17 byte chunks, each in its own allocation so ASan catches reads past
+ * a chunk. Prints one line per value (path, index, type, value as hex),
+ * then OK or ERR for the document's verdict.
+ */
+
+#include "json_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_value(void *ctx, size_t path, int index,
+                        json_stream_type_t type, const char *value)
+{
+    printf("%zu\t%d\t%d\t", path, index, (int)type);
+    for (const unsigned char *p = (const unsigned char *)value; *p; p++) {
+        printf("%02x", *p);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    static char buf[1 << 20];
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <file> <seed> <path>...\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 2;
+    }
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    unsigned seed = (unsigned)strtoul(argv[2], NULL, 10);
+    srand(seed);
+
+    json_stream_t js;
+    json_stream_init(&js, (const char *const *)&argv[3], argc - 3, print_value, NULL);
+
+    size_t offset = 0;
+    bool ok = true;
+    while (offset < len && ok) {
+        size_t n = seed == 0 ? len : 1 + rand() % 17;
+        if (n > len - offset) {
+            n = len - offset;
+        }
+        char *chunk = malloc(n);
+        memcpy(chunk, buf + offset, n);
+        ok = json_stream_feed(&js, chunk, n);
+        free(chunk);
+        offset += n;
+    }
+    ok = ok && json_stream_finish(&js);
+
+    printf("%s\n", ok ? "OK" : "ERR");
+    return 0;
+}
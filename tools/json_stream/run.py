@@ -0,0 +1,272 @@
+#!/usr/bin/env python3
+"""Host fuzzing and benchmark for the weather component's json_stream parser.
+
+Builds driver.c and bench.c against components/weather/json_stream.c with
+the host compiler, then either
+
+    fuzz   compares the values json_stream extracts, fed in random 1-17
+           byte chunks, with Python's json module on random documents, and
+           its valid/invalid verdict on mutated ones (driver built with
+           ASan and UBSan)
+    bench  times parsing a response in 512-byte chunks, counts the heap
+           allocations, and estimates those cJSON_Parse would make
+
+    tools/json_stream/run.py fuzz --count 5000
+    tools/json_stream/run.py bench tools/weather_responses/openweather_current.json \\
+        main.temp "weather[0].id"
+"""
+
+import argparse
+import itertools
+import json
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+WEATHER = os.path.join(HERE, "..", "..", "components", "weather")
+CC = os.environ.get("CC", "cc")
+
+KEYS = ["main", "temp", "weather", "id", "list", "a", "b", "dt", "xé", "k\"q",
+        "longkeyname_over_15"]
+
+
+def build(out_dir, name, flags):
+    exe = os.path.join(out_dir, name)
+    subprocess.run([CC, "-std=c11", "-Wall", "-I", WEATHER, *flags, "-o", exe,
+                    os.path.join(HERE, name + ".c"), os.path.join(WEATHER, "json_stream.c"),
+                    "-ldl"], check=True)
+    return exe
+
+
+# ---------------------------------------------------------------------------
+# Fuzzing
+# ---------------------------------------------------------------------------
+
+def random_string(rng):
+    return "".join(rng.choice(["a", "b", " ", "\"", "\\", "\n", "é", "中", "/", "\t"])
+                   for _ in range(rng.randint(0, 60)))
+
+
+def random_number(rng):
+    c = rng.random()
+    if c < .3:
+        return rng.randint(-10**6, 10**6)
+    if c < .6:
+        return round(rng.uniform(-1000, 1000), rng.randint(0, 4))
+    return rng.choice([0, -0.0, 1e-7, 1.5e300, -2e-5, 10**20])
+
+
+def random_value(rng, depth=0):
+    c = rng.random()
+    if depth > 5 or c < .4:
+        return rng.choice([lambda: random_number(rng), lambda: random_string(rng),
+                           lambda: True, lambda: False, lambda: None])()
+    if c < .7:
+        return {rng.choice(KEYS): random_value(rng, depth + 1) for _ in range(rng.randint(0, 4))}
+    return [random_value(rng, depth + 1) for _ in range(rng.randint(0, 4))]
+
+
+def leaves(value, path=()):
+    """(path, scalar) for every scalar, path as (("k", key) | ("i", index), ...)"""
+    if isinstance(value, dict):
+        for key, child in value.items():
+            yield from leaves(child, path + (("k", key),))
+    elif isinstance(value, list):
+        for index, child in enumerate(value):
+            yield from leaves(child, path + (("i", index),))
+    else:
+        yield path, value
+
+
+def path_string(path, wildcards):
+    s = ""
+    for n, (kind, key) in enumerate(path):
+        if kind == "k":
+            s += ("." if n else "") + key
+        else:
+            s += "[*]" if n in wildcards else "[%d]" % key
+    return s
+
+
+def matchable(path):
+    """Within JSON_STREAM_MAX_DEPTH and JSON_STREAM_KEY_MAX, no path syntax in keys"""
+    return len(path) <= 8 and all(kind == "i" or (len(key.encode()) <= 15 and "." not in key
+                                                  and "[" not in key) for kind, key in path)
+
+
+def encode(value):
+    """Expected (type, bytes) of a value, bytes None for numbers (compared by value)"""
+    if value is True:
+        return 2, b"true"
+    if value is False:
+        return 3, b"false"
+    if value is None:
+        return 4, b"null"
+    if isinstance(value, str):
+        return 0, value.encode()[:47]
+    return 1, None
+
+
+def expected_values(all_leaves, paths):
+    expected = []
+    for pi, ps in enumerate(paths):
+        for path, value in all_leaves:
+            if not matchable(path):
+                continue
+            arrays = [n for n, (kind, _) in enumerate(path) if kind == "i"]
+            for r in range(len(arrays) + 1):
+                for wildcards in itertools.combinations(arrays, r):
+                    if path_string(path, set(wildcards)) == ps:
+                        index = path[max(wildcards)][1] if wildcards else -1
+                        expected.append((pi, index, value))
+    return expected
+
+
+def run_driver(driver, work, doc, paths, seed):
+    doc_path = os.path.join(work, "doc.json")
+    with open(doc_path, "wb") as f:
+        f.write(doc)
+    out = subprocess.run([driver, doc_path, str(seed), *paths],
+                         capture_output=True, check=True).stdout.decode().split("\n")
+    return out[-2], [line.split("\t") for line in out[:-2]]
+
+
+def values_match(expected, got):
+    if len(expected) != len(got):
+        return False
+    for (pi, index, value), (g_path, g_index, g_type, g_hex) in zip(expected, got):
+        e_type, e_bytes = encode(value)
+        g_bytes = bytes.fromhex(g_hex)
+        if int(g_path) != pi or int(g_index) != index or int(g_type) != e_type:
+            return False
+        if e_bytes is not None and g_bytes != e_bytes:
+            return False
+        if e_bytes is None and float(g_bytes) != float(value):
+            return False
+    return True
+
+
+def mutate(rng, text):
+    b = bytearray(text)
+    for _ in range(rng.randint(1, 3)):
+        if not b:
+            break
+        op, p = rng.random(), rng.randrange(len(b))
+        if op < .4:
+            b[p] = rng.choice(b'{}[],:"\\-+.eE0123456789 tfnulx\x01\xff')
+        elif op < .7:
+            del b[p:p + rng.randint(1, 5)]
+        else:
+            b[p:p] = bytes(rng.choice(b'{}[],:"\\-.e0 ') for _ in range(rng.randint(1, 3)))
+    return bytes(b)
+
+
+def strict_verdict(doc):
+    """Valid per Python's json, or None if the input is not UTF-8 (json_stream does not check)"""
+    try:
+        text = doc.decode("utf-8")
+    except UnicodeDecodeError:
+        return None
+
+    def reject(constant):
+        raise ValueError(constant)
+
+    try:
+        json.loads(text, parse_constant=reject)
+        return True
+    except (ValueError, RecursionError):
+        return False
+
+
+def fuzz(args, work):
+    driver = build(work, "driver", ["-g", "-O1", "-fsanitize=address,undefined",
+                                    "-fno-sanitize-recover=all"])
+    rng = random.Random(args.seed)
+    value_fails = verdict_fails = 0
+
+    for _ in range(args.count):
+        value = random_value(rng)
+        text = json.dumps(value, ensure_ascii=rng.random() < .5,
+                          indent=rng.choice([None, 1, "\t"])).encode()
+        all_leaves = list(leaves(value))
+
+        # Up to 4 paths of existing values, some with a wildcard index
+        candidates = [leaf for leaf in all_leaves if matchable(leaf[0])]
+        rng.shuffle(candidates)
+        paths = []
+        for path, _ in candidates[:4]:
+            arrays = [n for n, (kind, _) in enumerate(path) if kind == "i"]
+            wildcards = set(rng.sample(arrays, 1)) if arrays and rng.random() < .5 else set()
+            ps = path_string(path, wildcards)
+            if ps and ps not in paths:
+                paths.append(ps)
+
+        # Values, whole document or random chunks
+        status, got = run_driver(driver, work, text, paths, rng.choice([0, rng.randint(1, 10**6)]))
+        got.sort(key=lambda g: int(g[0]))
+        if status != "OK" or not values_match(expected_values(all_leaves, paths), got):
+            value_fails += 1
+            if value_fails <= 5:
+                print("VALUES", text[:300], paths, status, got)
+
+        # Verdict on a mutated copy
+        doc = mutate(rng, text)
+        valid = strict_verdict(doc)
+        status, _ = run_driver(driver, work, doc, paths, rng.randint(0, 10**6))
+        if valid is not None and valid != (status == "OK"):
+            verdict_fails += 1
+            if verdict_fails <= 5:
+                print("VERDICT", "valid" if valid else "invalid", status, doc[:200])
+
+    print(f"{args.count} random + {args.count} mutated documents (seed {args.seed}): "
+          f"{value_fails} value mismatches, {verdict_fails} verdict mismatches")
+    return 1 if value_fails or verdict_fails else 0
+
+
+# ---------------------------------------------------------------------------
+# Benchmark
+# ---------------------------------------------------------------------------
+
+def cjson_allocations(value):
+    """cJSON_Parse allocates a node per value, plus a copy of every key and string"""
+    if isinstance(value, dict):
+        return 1 + sum(1 + cjson_allocations(child) for child in value.values())
+    if isinstance(value, list):
+        return 1 + sum(cjson_allocations(child) for child in value)
+    return 2 if isinstance(value, str) else 1
+
+
+def bench(args, work):
+    exe = build(work, "bench", ["-O2"])
+    subprocess.run([exe, args.file, str(args.iterations), *args.paths], check=True)
+    with open(args.file, "rb") as f:
+        print(f"cJSON_Parse estimate: {cjson_allocations(json.load(f))} allocations, "
+              f"plus the response buffer")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("fuzz", help="differential fuzzing against Python's json")
+    p.add_argument("--count", type=int, default=1000, help="random documents (and as many mutated)")
+    p.add_argument("--seed", type=int, default=1, help="generator seed")
+    p = sub.add_parser("bench", help="time and allocations per parse")
+    p.add_argument("file", help="JSON document, e.g. from tools/weather_responses/")
+    p.add_argument("paths", nargs="*", help="paths to extract")
+    p.add_argument("--iterations", type=int, default=200000, help="parses to time")
+    args = parser.parse_args()
+
+    work = tempfile.mkdtemp(prefix="json_stream_")
+    try:
+        return fuzz(args, work) if args.command == "fuzz" else bench(args, work)
+    finally:
+        shutil.rmtree(work)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,101 @@
+/**
+ * @file sim.c
+ * @brief Host simulation of the clock discipline against a drifting crystal
+ *
+ * Usage: sim
+ *
+ * Runs a simulated clock that loses or gains a fixed number of ppm through
+ * the discipline the way ntp_sync does: the drift estimate is corrected
+ * every minute, every sync measures the offset left (plus some noise) and
+ * steps or slews it away. Each case checks that the drift estimate
+ * converges to the crystal's error and the poll interval grows to its
+ * maximum. Prints one line per case and exits non-zero on any failure.
+ */
+
+#include "discipline.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Period of the drift correction, as in ntp_sync.c
+#define DRIFT_TICK_US   (60 * 1000000LL)
+
+// Syncs simulated per case
+#define SYNCS           40
+
+typedef struct {
+    const char *name;
+    int32_t drift_ppb;          // Crystal error, positive = clock runs slow
+    uint32_t min_interval_s;
+    uint32_t max_interval_s;
+    int64_t noise_us;           // Measurement error, alternating in sign
+    int64_t jump_us;            // Phase jump before sync SYNCS / 2, 0 = none
+} sim_case_t;
+
+static const sim_case_t s_cases[] = {
+    { "40 ppm slow, 1 h",         40000, 3600, 86400,   500, 0 },
+    { "40 ppm fast, 1 h",        -40000, 3600, 86400,   500, 0 },
+    { "40 ppm slow, 15 min",      40000,  900, 86400,  2000, 0 },
+    { "5 ppm slow, 1 h",           5000, 3600, 86400,   500, 0 },
+    { "100 ppm fast, 1 h",      -100000, 3600, 86400,   500, 0 },
+    { "40 ppm slow, 10 s jump",   40000, 3600, 86400,   500, 10000000 },
+};
+
+static bool run(const sim_case_t *c)
+{
+    ntp_discipline_t d;
+    ntp_discipline_init(&d, c->min_interval_s, c->max_interval_s);
+
+    // Local minus reference time; the first sync finds the clock unset
+    int64_t error_us = -1700000000LL * 1000000;
+    int64_t mono_us = 0;
+    int steps = 0;
+
+    for (int sync = 0; sync < SYNCS; sync++) {
+        if (sync == SYNCS / 2) {
+            error_us += c->jump_us;
+        }
+
+        int64_t offset_us = -error_us + ((sync & 1) ? c->noise_us : -c->noise_us);
+        if (ntp_discipline_sample(&d, offset_us, mono_us) == NTP_DISCIPLINE_STEP) {
+            steps++;
+        }
+        error_us += offset_us;
+
+        // Run to the next sync, correcting the estimated drift every tick
+        int64_t next_us = mono_us + (int64_t)d.interval_s * 1000000;
+        while (mono_us < next_us) {
+            int64_t tick_us = next_us - mono_us < DRIFT_TICK_US ? next_us - mono_us : DRIFT_TICK_US;
+            mono_us += tick_us;
+            error_us -= tick_us * c->drift_ppb / 1000000000LL;
+            error_us += ntp_discipline_drift_us(&d, tick_us);
+        }
+    }
+
+    // Noise over the shortest interval bounds the estimate's error
+    int64_t tolerance_ppb = 4 * c->noise_us * 1000000000LL / ((int64_t)c->min_interval_s * 1000000);
+    int64_t drift_error_ppb = llabs((int64_t)d.drift_ppb - c->drift_ppb);
+
+    // Setting the clock, the first interval's drift and the jump
+    int max_steps = c->jump_us != 0 ? 3 : 2;
+
+    bool ok = d.drift_valid && drift_error_ppb <= tolerance_ppb &&
+              d.interval_s == d.max_interval_s && steps <= max_steps;
+    printf("%s  %-24s drift %+8ld ppb (true %+8ld), interval %6lu s, %d steps\n",
+           ok ? "PASS" : "FAIL", c->name, (long)d.drift_ppb, (long)c->drift_ppb,
+           (unsigned long)d.interval_s, steps);
+    return ok;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        if (!run(&s_cases[i])) {
+            failures++;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Minimal NTP server stand-in for testing the ntp_sync sampler.
+
+Answers NTP client queries with the host's time plus a configurable
+offset, optionally delaying, jittering or dropping replies, so clock
+filtering and falseticker rejection can be exercised on a LAN or on the
+host. Run two instances, one with a large --offset, and point
+TIMEMACHINE_NTP_SERVER1/2 at them as "host:port":
+
+    tools/ntp_standin.py --port 12300
+    tools/ntp_standin.py --port 12301 --offset 5
+"""
+
+import argparse
+import random
+import socket
+import struct
+import time
+
+NTP_UNIX_OFFSET = 2208988800
+
+
+def to_ntp(t):
+    sec = int(t)
+    frac = int((t - sec) * (1 << 32))
+    return ((sec + NTP_UNIX_OFFSET) & 0xFFFFFFFF) << 32 | frac
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0", help="address to listen on")
+    parser.add_argument("--port", type=int, default=12300, help="UDP port (123 needs root)")
+    parser.add_argument("--offset", type=float, default=0.0,
+                        help="seconds added to the host time (falseticker)")
+    parser.add_argument("--delay", type=float, default=0.0,
+                        help="ms to hold each reply (asymmetric delay)")
+    parser.add_argument("--jitter", type=float, default=0.0,
+                        help="ms of random extra hold per reply")
+    parser.add_argument("--drop", type=float, default=0.0,
+                        help="fraction of queries left unanswered")
+    parser.add_argument("--stratum", type=int, default=2,
+                        help="stratum to report, 0 sends kiss-o'-death")
+    parser.add_argument("--unsync", action="store_true",
+                        help="report leap indicator 3 (not synchronized)")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    print(f"NTP stand-in on {args.bind}:{args.port}, offset {args.offset:+.3f} s")
+
+    while True:
+        data, addr = sock.recvfrom(512)
+        received = time.time() + args.offset
+        if len(data) < 48 or (data[0] & 0x07) != 3:
+            continue
+        if random.random() < args.drop:
+            print(f"{addr[0]}:{addr[1]} dropped")
+            continue
+
+        hold = (args.delay + random.uniform(0, args.jitter)) / 1000.0
+        if hold > 0:
+            time.sleep(hold)
+
+        li = 3 if args.unsync else 0
+        originate = data[40:48]  # Client transmit time, echoed as originate
+        reply = struct.pack(
+            "!BBbbII4s8s8sQQ",
+            (li << 6) | (4 << 3) | 4,           # LI, version 4, mode server
+            args.stratum,
+            6,                                  # Poll
+            -20,                                # Precision (~1 us)
+            0,                                  # Root delay
+            0,                                  # Root dispersion
+            b"RATE" if args.stratum == 0 else b"LOCL",  # Reference ID, kiss code
+            struct.pack("!Q", to_ntp(received)),  # Reference time
+            originate,
+            to_ntp(received),
+            to_ntp(time.time() + args.offset),
+        )
+        sock.sendto(reply, addr)
+        print(f"{addr[0]}:{addr[1]} answered, held {hold * 1000:.1f} ms")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""Local weather API stand-in for testing the weather providers offline.
+
+Serves the recorded OpenWeather and Open-Meteo responses in
+tools/weather_responses/ under the real request paths, with their times
+moved to now and their forecasts cut to the requested steps. Replies can
+be delayed, failed, truncated, padded, chunked or sent without keep-alive,
+so fetch, parse and retry paths can be exercised and timed without the
+real services. Point TIMEMACHINE_WEATHER_SERVER at it:
+
+    tools/weather_standin.py --port 8080
+    tools/weather_standin.py --port 8080 --delay 300 --fail 0.2
+"""
+
+import argparse
+import json
+import os
+import random
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlsplit
+
+RESPONSES = os.path.join(os.path.dirname(os.path.abspath(__file__)), "weather_responses")
+
+# Unix times in the recordings, moved by the same amount
+TIME_KEYS = ("dt", "time", "sunrise", "sunset")
+
+
+def shift_times(node, delta):
+    if isinstance(node, dict):
+        for key, value in node.items():
+            if key in TIME_KEYS and isinstance(value, int):
+                node[key] = value + delta
+            elif key in TIME_KEYS and isinstance(value, list):
+                node[key] = [t + delta for t in value]
+            elif key == "dt_txt":
+                node[key] = time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(node["dt"]))
+            else:
+                shift_times(value, delta)
+    elif isinstance(node, list):
+        for value in node:
+            shift_times(value, delta)
+
+
+def load(name, recorded_now, shift):
+    with open(os.path.join(RESPONSES, name), encoding="utf-8") as f:
+        doc = json.load(f)
+    if shift:
+        shift_times(doc, int(time.time()) // 3600 * 3600 - recorded_now(doc))
+    return doc
+
+
+def openweather_current(query, shift):
+    if "appid" not in query:
+        return 401, {"cod": 401, "message": "Invalid API key."}
+    return 200, load("openweather_current.json", lambda d: d["dt"], shift)
+
+
+def openweather_forecast(query, shift):
+    if "appid" not in query:
+        return 401, {"cod": 401, "message": "Invalid API key."}
+    doc = load("openweather_forecast.json", lambda d: d["list"][0]["dt"] - 3 * 3600, shift)
+    if "cnt" in query:
+        doc["list"] = doc["list"][:int(query["cnt"][0])]
+        doc["cnt"] = len(doc["list"])
+    return 200, doc
+
+
+def openmeteo_forecast(query, shift):
+    if "latitude" not in query or "longitude" not in query:
+        return 400, {"error": True, "reason": "Parameter 'latitude' and 'longitude' must be set"}
+    doc = load("openmeteo_forecast.json", lambda d: d["current"]["time"], shift)
+    if "hourly" not in query:
+        del doc["hourly_units"], doc["hourly"]
+    elif "forecast_hours" in query:
+        hours = int(query["forecast_hours"][0])
+        doc["hourly"] = {key: values[:hours] for key, values in doc["hourly"].items()}
+    return 200, doc
+
+
+ROUTES = {
+    "/data/2.5/weather": openweather_current,
+    "/data/2.5/forecast": openweather_forecast,
+    "/v1/forecast": openmeteo_forecast,
+}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    args = None
+
+    def do_GET(self):
+        args = self.args
+        start = time.monotonic()
+        url = urlsplit(self.path)
+        route = ROUTES.get(url.path)
+
+        hold = (args.delay + random.uniform(0, args.jitter)) / 1000.0
+        if hold > 0:
+            time.sleep(hold)
+
+        if route is None:
+            status, doc = 404, {"cod": "404", "message": "Not found"}
+        elif random.random() < args.fail:
+            status, doc = args.fail_status, {"cod": args.fail_status, "message": "Injected failure"}
+        else:
+            status, doc = route(parse_qs(url.query), not args.no_shift)
+
+        body = json.dumps(doc, separators=(",", ":"), ensure_ascii=False).encode()
+        if args.pad > 0:
+            body = body[:-1] + b" " * args.pad + body[-1:]
+        sent = body if args.truncate <= 0 else body[:args.truncate]
+
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json; charset=utf-8")
+        if args.close or args.truncate > 0:
+            self.send_header("Connection", "close")
+            self.close_connection = True
+        if args.chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            for i in range(0, len(sent), 256):
+                chunk = sent[i:i + 256]
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(chunk), chunk))
+            if len(sent) == len(body):
+                self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(sent)
+
+        print(f"{self.client_address[0]} {url.path} {status} {len(sent)}/{len(body)} bytes "
+              f"{(time.monotonic() - start) * 1000:.1f} ms")
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0", help="address to listen on")
+    parser.add_argument("--port", type=int, default=8080, help="TCP port")
+    parser.add_argument("--delay", type=float, default=0.0,
+                        help="ms to hold each reply")
+    parser.add_argument("--jitter", type=float, default=0.0,
+                        help="ms of random extra hold per reply")
+    parser.add_argument("--fail", type=float, default=0.0,
+                        help="fraction of requests answered with --fail-status")
+    parser.add_argument("--fail-status", type=int, default=503,
+                        help="HTTP status of failed requests")
+    parser.add_argument("--truncate", type=int, default=0,
+                        help="send only this many body bytes, then close")
+    parser.add_argument("--pad", type=int, default=0,
+                        help="bytes of whitespace added to each body (oversize)")
+    parser.add_argument("--chunked", action="store_true",
+                        help="chunked transfer encoding, no Content-Length")
+    parser.add_argument("--close", action="store_true",
+                        help="close the connection after each reply (no keep-alive)")
+    parser.add_argument("--no-shift", action="store_true",
+                        help="serve the recorded times instead of moving them to now")
+    Handler.args = parser.parse_args()
+
+    server = ThreadingHTTPServer((Handler.args.bind, Handler.args.port), Handler)
+    print(f"Weather stand-in on http://{Handler.args.bind}:{Handler.args.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()